@@ -55,6 +55,8 @@ class OctreeApplication : public gintonic::Application
     {
         using namespace gintonic;
 
+        mOctreeRoot.commitUpdates();
+
         // const auto lYAxis = (1.0f + std::cos(mElapsedTime)) / 2.0f;
         // const auto lZAxis = (1.0f + std::sin(mElapsedTime)) / 2.0f;
         // const auto lRotationAxis = vec3f(0.0f, lYAxis, lZAxis).normalize();
@@ -221,6 +221,9 @@ class ShadowsApplication : public gintonic::Application
         mSphere->postMultiplyRotation(quatf::axis_angle(
             vec3f(0.0f, 1.0f, 0.0f), static_cast<float>(mDeltaTime) / 10.0f));
 
+        // Relocate everything that moved this frame before querying.
+        mOctreeRoot.commitUpdates();
+
         std::vector<std::shared_ptr<Entity>> lNearbyEntities;
         getNearbyEntities(Renderer::getCameraEntity(), 8.0f,
                           std::back_inserter(lNearbyEntities));
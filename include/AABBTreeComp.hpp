@@ -0,0 +1,336 @@
+#pragma once
+
+#include "Component.hpp"
+#include "Foundation/SpatialStatistics.hpp"
+#include "Foundation/allocator.hpp"
+#include "Math/box3f.hpp"
+#include "Math/frustum.hpp"
+#include <vector>
+
+namespace gintonic
+{
+
+class Transform;
+class Collider;
+
+/**
+ * @brief      Puts the Collider of an Entity in a dynamic bounding volume
+ *             hierarchy.
+ *
+ * @details    This is an alternative to OctreeComp for scenes with many
+ *             moving objects of varied sizes. Every component is a leaf of
+ *             a binary tree. Inner nodes have the union of the bounds of
+ *             their children, so a large object never ends up in a node
+ *             where every query has to test it. Both components offer the
+ *             same queries, so choose per scene.
+ */
+class AABBTreeComp : public Component
+{
+    GT_COMPONENT_SERIALIZATION_BOILERPLATE(AABBTreeComp);
+
+  public:
+    class Tree
+    {
+      public:
+        /**
+         * @brief      Apply a unary function to all AABBTreeComp in the
+         *             given volume.
+         *
+         * @param[in]  volume  The volume.
+         * @param[in]  f       The unary function. The parameter must be of
+         *                     type `AABBTreeComp*`. Its return value must be
+         *                     `void`.
+         *
+         * @tparam     F       Automatically deduced.
+         */
+        template <class F> void query(const box3f& volume, F f);
+
+        /**
+         * @brief      Apply a unary function to all AABBTreeComp in the
+         *             given volume.
+         *
+         * @param[in]  volume  The volume.
+         * @param[in]  f       The unary function. The parameter must be of
+         *                     type `const AABBTreeComp*`. Its return value
+         *                     must be `void`.
+         *
+         * @tparam     F       Automatically deduced.
+         */
+        template <class F> void query(const box3f& volume, F f) const;
+
+        /**
+         * @brief      Apply a unary function to all AABBTreeComp in the
+         *             given frustum.
+         *
+         * @param[in]  volume  The frustum.
+         * @param[in]  f       The unary function. The parameter must be of
+         *                     type `AABBTreeComp*`. Its return value must be
+         *                     `void`.
+         *
+         * @tparam     F       Automatically deduced.
+         */
+        template <class F> void query(const frustum& volume, F f);
+
+        /**
+         * @brief      Apply a unary function to all AABBTreeComp in the
+         *             given frustum.
+         *
+         * @param[in]  volume  The frustum.
+         * @param[in]  f       The unary function. The parameter must be of
+         *                     type `const AABBTreeComp*`. Its return value
+         *                     must be `void`.
+         *
+         * @tparam     F       Automatically deduced.
+         */
+        template <class F> void query(const frustum& volume, F f) const;
+
+        Tree() = default;
+        Tree(const Tree&) = delete;
+        Tree& operator=(const Tree&) = delete;
+        ~Tree() noexcept;
+
+        /**
+         * @brief      Get the number of AABBTreeComp in this tree.
+         *
+         * @return     The number of AABBTreeComp.
+         */
+        std::size_t count() const noexcept { return mCount; }
+
+        /**
+         * @brief      Get the height of this tree.
+         *
+         * @return     The height. An empty tree has height zero, a tree with
+         *             a single AABBTreeComp has height one.
+         */
+        std::size_t height() const noexcept;
+
+        /**
+         * @brief      Get statistics about the shape of this tree.
+         *
+         * @details    Every leaf holds one AABBTreeComp, so the occupancy
+         *             histogram is not very interesting. The number of nodes
+         *             per depth shows how well balanced the tree is.
+         *
+         * @return     Statistics about the shape of the tree.
+         */
+        SpatialStatistics statistics() const;
+
+      private:
+        static constexpr int kNull = -1;
+
+        // A node of the tree. The leaves hold a component and its fat
+        // bounds. The parent of a free node is the next free node.
+        struct Node
+        {
+            box3f bounds;
+            AABBTreeComp* comp;
+            int parent;
+            int children[2];
+            int height;
+
+            bool isLeaf() const noexcept { return children[0] == kNull; }
+        };
+
+        std::vector<Node, allocator<Node>> mNodes;
+        int mRoot = kNull;
+        int mFree = kNull;
+        std::size_t mCount = 0;
+
+        friend class AABBTreeComp;
+        int allocateNode();
+        void freeNode(const int index) noexcept;
+        void insert(AABBTreeComp* comp);
+        void remove(AABBTreeComp* comp) noexcept;
+        void update(AABBTreeComp* comp);
+        void insertLeaf(const int leaf);
+        void removeLeaf(const int leaf) noexcept;
+        void refit(int index) noexcept;
+        int balance(const int index) noexcept;
+        void gatherStatistics(SpatialStatistics& statistics, const int index,
+                              const std::size_t depth) const;
+        template <class F>
+        void queryRecursive(const int index, const box3f& volume, F& f) const;
+        template <class F>
+        void queryFrustum(const int index, const frustum& volume,
+                          unsigned planeMask, F& f) const;
+        template <class F> void apply(const int index, F& f) const;
+    };
+
+    AABBTreeComp(EntityBase* owner);
+    ~AABBTreeComp() noexcept override;
+
+    Tree* getTree() noexcept { return mTree; }
+    const Tree* getTree() const noexcept { return mTree; }
+
+    void setTree(Tree& tree);
+
+    /**
+     * @brief      Set how much larger than the collider the leaf of this
+     *             AABBTreeComp is.
+     *
+     * @details    The leaf is only taken out and inserted again once the
+     *             collider leaves it. A larger margin means fewer
+     *             reinsertions, but more overlap between the nodes, so
+     *             queries visit more of them. The new margin takes effect at
+     *             the next reinsertion.
+     *
+     * @param[in]  margin  The margin, in world units. It must not be negative.
+     */
+    void setMargin(const float margin) noexcept { mMargin = margin; }
+
+    /**
+     * @brief      Get how much larger than the collider the leaf is.
+     *
+     * @return     The margin, in world units.
+     */
+    float getMargin() const noexcept { return mMargin; }
+
+    /**
+     * @brief      Mark this AABBTreeComp as static or dynamic.
+     *
+     * @details    A static AABBTreeComp is never reinserted by the per-frame
+     *             update. Marking it static reinserts it one last time, so
+     *             move the entity into place first.
+     *
+     * @param[in]  isStatic  Wether this AABBTreeComp is static.
+     */
+    void setStatic(const bool isStatic);
+
+    /**
+     * @brief      Determine wether this AABBTreeComp is static.
+     *
+     * @return     True if static, false if dynamic.
+     */
+    bool isStatic() const noexcept { return mStatic; }
+
+    /**
+     * @brief      Get the inflated bounds with which this AABBTreeComp was
+     *             last inserted into the tree.
+     *
+     * @details    Only call this while this AABBTreeComp is in a tree.
+     *
+     * @return     The inflated bounds.
+     */
+    const box3f& getFatBounds() const noexcept;
+
+    static bool classOf(const Component* comp)
+    {
+        return comp->getKind() == Kind::AABBTreeComp;
+    }
+
+  protected:
+    void update() override;
+
+  private:
+    friend class Tree;
+    Tree* mTree = nullptr;
+    int mLeaf = Tree::kNull;
+    Transform* mTransform = nullptr;
+    Collider* mCollider = nullptr;
+    float mMargin;
+    bool mStatic = false;
+
+    std::unique_ptr<Component> clone(EntityBase* newOwner) const override;
+
+    box3f getBounds() const noexcept;
+
+    template <class Archive>
+    void serialize(Archive& archive, const unsigned /*version*/)
+    {
+        using namespace boost::serialization;
+        archive& BOOST_SERIALIZATION_BASE_OBJECT_NVP(Component) &
+            make_nvp("margin", mMargin) & make_nvp("static", mStatic);
+    }
+};
+
+template <class F> void AABBTreeComp::Tree::query(const box3f& volume, F f)
+{
+    if (mRoot != kNull) queryRecursive(mRoot, volume, f);
+}
+
+template <class F>
+void AABBTreeComp::Tree::query(const box3f& volume, F f) const
+{
+    if (mRoot != kNull) queryRecursive(mRoot, volume, f);
+}
+
+template <class F> void AABBTreeComp::Tree::query(const frustum& volume, F f)
+{
+    if (mRoot != kNull) queryFrustum(mRoot, volume, frustum::kAllPlanes, f);
+}
+
+template <class F>
+void AABBTreeComp::Tree::query(const frustum& volume, F f) const
+{
+    if (mRoot != kNull) queryFrustum(mRoot, volume, frustum::kAllPlanes, f);
+}
+
+template <class F>
+void AABBTreeComp::Tree::queryRecursive(const int index, const box3f& volume,
+                                        F& f) const
+{
+    GT_SPATIAL_COUNT(nodesVisited, 1);
+    const auto& node = mNodes[index];
+    if (!intersects(volume, node.bounds)) return;
+    if (node.isLeaf())
+    {
+        // The fat bounds intersect, but the actual bounds might not.
+        GT_SPATIAL_COUNT(boxesTested, 1);
+        if (intersects(volume, node.comp->getBounds()))
+        {
+            f(node.comp);
+            GT_SPATIAL_COUNT(results, 1);
+        }
+        return;
+    }
+    queryRecursive(node.children[0], volume, f);
+    queryRecursive(node.children[1], volume, f);
+}
+
+template <class F>
+void AABBTreeComp::Tree::queryFrustum(const int index, const frustum& volume,
+                                      unsigned planeMask, F& f) const
+{
+    GT_SPATIAL_COUNT(nodesVisited, 1);
+    const auto& node = mNodes[index];
+    switch (volume.classify(node.bounds, planeMask))
+    {
+    case frustum::kOutside:
+        return;
+    case frustum::kInside:
+        // The whole subtree is visible.
+        apply(index, f);
+        return;
+    default:
+        break;
+    }
+    if (node.isLeaf())
+    {
+        GT_SPATIAL_COUNT(boxesTested, 1);
+        if (volume.classify(node.comp->getBounds(), planeMask) !=
+            frustum::kOutside)
+        {
+            f(node.comp);
+            GT_SPATIAL_COUNT(results, 1);
+        }
+        return;
+    }
+    queryFrustum(node.children[0], volume, planeMask, f);
+    queryFrustum(node.children[1], volume, planeMask, f);
+}
+
+template <class F> void AABBTreeComp::Tree::apply(const int index, F& f) const
+{
+    const auto& node = mNodes[index];
+    if (node.isLeaf())
+    {
+        f(node.comp);
+        GT_SPATIAL_COUNT(results, 1);
+        return;
+    }
+    GT_SPATIAL_COUNT(nodesVisited, 1);
+    apply(node.children[0], f);
+    apply(node.children[1], f);
+}
+
+} // namespace gintonic
@@ -1,17 +1,47 @@
 #pragma once
 
 #include "Collider.hpp"
+#include <cstdint>
+
 namespace gintonic
 {
 
 class BoxCollider : public Collider
 {
-    GT_COMPONENT_BOILERPLATE(BoxCollider, Collider);
+    GT_COMPONENT_SERIALIZATION_BOILERPLATE(BoxCollider);
 
   public:
+    BoxCollider(EntityBase* entity);
+    ~BoxCollider() noexcept override;
+
+    /// The bounds in the local space of the Entity, before the localOffset.
     box3f localBounds;
+
+    /**
+     * @brief      Get the bounds in world space.
+     *
+     * @details    The local bounds, moved by the local offset, are
+     *             transformed by the global transform of the Entity. If
+     *             neither the transform nor localBounds and localOffset
+     *             changed since the last call to
+     *             BoxCollider::updateGlobalBounds, the bounds come from its
+     *             cache. Otherwise, they are computed on the spot.
+     *
+     * @return     The bounds in world space.
+     */
     box3f getGlobalBounds() const noexcept override;
 
+    /**
+     * @brief      Compute the bounds in world space of all box colliders at
+     *             once.
+     *
+     * @details    The bounds are stored in one array in SoA layout, and
+     *             computed for four colliders at a time. Call this once per
+     *             frame, after the entities have moved and before the
+     *             spatial indices and the broadphase update.
+     */
+    static void updateGlobalBounds();
+
     GINTONIC_DEFINE_SSE_OPERATOR_NEW_DELETE();
 
     static bool classOf(const Component* comp)
@@ -23,6 +53,18 @@ class BoxCollider : public Collider
     void onEnable() override;
 
   private:
+    std::size_t mSlot;
+    // The cache key: the version of the global transform, and the local
+    // bounds moved by the local offset, which are public and can change
+    // behind the back of the cache.
+    std::uint32_t mCachedVersion = 0;
+    box3f mCachedLocalBounds;
+    bool mIsCached = false;
+
+    box3f offsetLocalBounds() const noexcept;
+
+    box3f computeGlobalBounds() const noexcept;
+
     template <class Archive>
     void serialize(Archive& archive, const unsigned /*version*/)
     {
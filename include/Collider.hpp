@@ -2,11 +2,13 @@
 
 #include "Component.hpp"
 #include "Math/box3f.hpp"
+#include <cstdint>
 
 namespace gintonic
 {
 
 class Transform;
+class SweepAndPrune;
 
 class Collider : public Component
 {
@@ -14,8 +16,10 @@ class Collider : public Component
     Collider(const Kind kind, EntityBase* owner);
 
   public:
-    ~Collider() noexcept override = default;
+    ~Collider() noexcept override;
     virtual box3f getGlobalBounds() const noexcept = 0;
+
+    /// The offset of the bounds in the local space of the Entity.
     vec3f localOffset;
 
     static bool classOf(const Component* comp)
@@ -30,6 +34,10 @@ class Collider : public Component
     Transform* mTransform = nullptr;
 
   private:
+    friend class SweepAndPrune;
+    SweepAndPrune* mBroadphase = nullptr;
+    std::uint32_t mBroadphaseProxy = 0;
+
     friend class boost::serialization::access;
 
     template <class Archive>
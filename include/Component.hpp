@@ -64,19 +64,21 @@ class Component
         // These enums must be placed in such a way that the order defines a
         // valid topological sorting of the graph that represents the class
         // hierarchy.
-        Camera = 0,       // *
-        OctreeComp,       // *
-        Collider,         // *
-        BoxCollider,      // **
-        RendererComp,     // *
-        MeshRenderer,     // **
-        Transform,        // *
-        Light,            // *
-        AmbientLight,     // **
-        DirectionalLight, // ***
-        PointLight,       // **
-        SpotLight,        // ***
-        Behaviour,        // *
+        Camera = 0,          // *
+        OctreeComp,          // *
+        AABBTreeComp,        // *
+        SpatialHashGridComp, // *
+        Collider,            // *
+        BoxCollider,         // **
+        RendererComp,        // *
+        MeshRenderer,        // **
+        Transform,           // *
+        Light,               // *
+        AmbientLight,        // **
+        DirectionalLight,    // ***
+        PointLight,          // **
+        SpotLight,           // ***
+        Behaviour,           // *
         Count
     };
 
@@ -9,15 +9,21 @@
 #include "Casting.hpp"
 #include "Component.hpp"
 #include "EntityBase.hpp"
+#include "EntityHandle.hpp"
 #include "ForwardDeclarations.hpp"
+#include "Foundation/BlockPool.hpp"
+#include "Foundation/LazySignal.hpp"
 #include "Foundation/Object.hpp"
 #include "Math/SQT.hpp"
 #include "Math/box3f.hpp"
 #include "Math/mat4f.hpp"
 #include <boost/serialization/access.hpp>
 #include <boost/serialization/base_object.hpp>
+#include <boost/serialization/version.hpp>
 #include <boost/signals2.hpp>
 #include <list>
+#include <type_traits>
+#include <utility>
 
 namespace gintonic
 {
@@ -82,7 +88,8 @@ class Entity : public Object<Entity, std::string>
     using Super = Object<Entity, std::string>;
 
     /// The type of datastructure for the list of children.
-    typedef std::list<Entity::SharedPtr> children_datastructure_type;
+    typedef std::list<Entity::SharedPtr, PoolAllocator<Entity::SharedPtr>>
+        children_datastructure_type;
 
     /// The iterator type for the list of children.
     typedef children_datastructure_type::iterator iterator;
@@ -94,13 +101,36 @@ class Entity : public Object<Entity, std::string>
     std::vector<std::unique_ptr<Component>> mComponents;
 
     SQT mLocalTransform;
-    mat4f mGlobalTransform;
+    mutable mat4f mGlobalTransform;
 
     children_datastructure_type mChildren;
 
-    WeakPtr mParent = SharedPtr(nullptr);
+    // The parent owns this Entity through its list of children, so a raw
+    // pointer suffices. It is null for roots, and the parent clears it
+    // when it dies before its children.
+    Entity* mParent = nullptr;
+
+    EntityHandle mHandle;
+
+    // True if mGlobalTransform is out of date. All descendants of a dirty
+    // Entity are dirty too, so all ancestors of a clean Entity are clean.
+    mutable bool mGlobalTransformIsDirty = false;
+
+    // True if the handle of this Entity is in the list of render state
+    // changes.
+    bool mRenderStateChanged = false;
+
+    void renderStateChanged();
+
+    void invalidateGlobalTransform() noexcept;
+    void resolveGlobalTransform() const noexcept;
+
+    // The place of this Entity in the change set of the deferred transform
+    // notifications, or kNotChanged if it is not in there.
+    static constexpr std::size_t kNotChanged = ~std::size_t(0);
+    std::size_t mTransformChangeIndex = kNotChanged;
 
-    void updateGlobalInfo() noexcept;
+    void notifyTransformChange();
 
   public:
     /// \brief Calls update on all of its components.
@@ -188,8 +218,11 @@ class Entity : public Object<Entity, std::string>
         // explicitly, while std::make_shared uses its own allocation
         // strategy. In practise, this means std::make_shared does not
         // allocate on a 16-byte boundary, which is required for Entity
-        // to function properly.
-        return SharedPtr(new Entity(std::forward<Args>(args)...));
+        // to function properly. The control block of the shared pointer
+        // comes from a pool too.
+        return SharedPtr(new Entity(std::forward<Args>(args)...),
+                         std::default_delete<Entity>(),
+                         PoolAllocator<Entity>());
     }
 
   private:
@@ -269,12 +302,131 @@ class Entity : public Object<Entity, std::string>
 
     /**
      * @brief Clone this entity; clone all its children too.
+     * @details The children of the clone are in the same order as the
+     * children of this Entity.
      * @return The cloned entity.
      */
     SharedPtr cloneRecursive() const;
 
+    /**
+     * @brief Clone this entity and all its children many times.
+     *
+     * @details This gives the same entities as calling cloneRecursive()
+     * count times, but it is much faster. The subtree is traversed once,
+     * storage for all copies is reserved up front, and the global
+     * transforms are computed once for all copies: the copies are roots,
+     * so every copy has the same global transforms. No transform change
+     * notifications are sent, since nothing can listen to the copies yet.
+     *
+     * @param[in]  count  The number of copies.
+     *
+     * @return     The roots of the copies.
+     */
+    std::vector<SharedPtr> cloneRecursive(const std::size_t count) const;
+
     //@}
 
+    /**
+     * @brief A member of an Entity that decides in which render lists of
+     * the Renderer the Entity goes.
+     *
+     * @details It reads like a T. Every assignment records the Entity in
+     * the list of render state changes, see takeRenderStateChanges, so
+     * that the Renderer sorts only the changed entities into its render
+     * lists. Note that changing the object that a pointer points to is
+     * not an assignment.
+     *
+     * @tparam T The type of the member.
+     */
+    template <class T> class RenderState
+    {
+      public:
+        /// The type of the member.
+        typedef T value_type;
+
+        RenderState(const RenderState&) = delete;
+
+        /**
+         * @brief Assign a new value and record the change.
+         * @param[in]  value  The new value.
+         * @return     `*this`
+         */
+        template <class U> RenderState& operator=(U&& value)
+        {
+            mValue = std::forward<U>(value);
+            mOwner->renderStateChanged();
+            return *this;
+        }
+
+        /**
+         * @brief Assign the value of another member and record the change.
+         * @param[in]  other  The other member.
+         * @return     `*this`
+         */
+        RenderState& operator=(const RenderState& other)
+        {
+            return *this = other.mValue;
+        }
+
+        /**
+         * @brief Move the value of another member and record the change of
+         * both entities.
+         * @param[in]  other  The other member.
+         * @return     `*this`
+         */
+        RenderState& operator=(RenderState&& other)
+        {
+            mValue = std::move(other.mValue);
+            mOwner->renderStateChanged();
+            other.mOwner->renderStateChanged();
+            return *this;
+        }
+
+        /// Get the value.
+        operator const T&() const noexcept { return mValue; }
+
+        /// Get the raw pointer of a smart pointer member.
+        template <class U = T>
+        auto get() const noexcept -> decltype(std::declval<const U&>().get())
+        {
+            return mValue.get();
+        }
+
+        /// Access the pointee of a smart pointer member.
+        template <class U = T>
+        auto operator-> () const noexcept
+            -> decltype(std::declval<const U&>().get())
+        {
+            return mValue.get();
+        }
+
+        /// Dereference a smart pointer member.
+        template <class U = T>
+        auto operator*() const noexcept -> decltype(*std::declval<const U&>())
+        {
+            return *mValue;
+        }
+
+        /// Check whether a smart pointer member is not null.
+        template <class U = T, class = typename std::enable_if<
+                                   !std::is_same<U, bool>::value>::type>
+        explicit operator bool() const noexcept
+        {
+            return static_cast<bool>(mValue);
+        }
+
+      private:
+        friend class Entity;
+
+        RenderState(Entity* owner, T value = T())
+            : mValue(std::move(value)), mOwner(owner)
+        {
+        }
+
+        T mValue;
+        Entity* mOwner;
+    };
+
     /**
      * @brief Set wether this Entity casts a shadow.
      * @details If the Entity has a Light component, then
@@ -283,22 +435,22 @@ class Entity : public Object<Entity, std::string>
      * If the Entity has a Mesh and Material component, then
      * it will receive shadow.
      */
-    bool castShadow = false;
+    RenderState<bool> castShadow{this, false};
 
     /**
      * @brief The Material associated to this Entity.
      */
-    std::shared_ptr<Material> material;
+    RenderState<std::shared_ptr<Material>> material{this};
 
     /**
      * @brief The Mesh associated to this Entity.
      */
-    std::shared_ptr<Mesh> mesh;
+    RenderState<std::shared_ptr<Mesh>> mesh{this};
 
     /**
      * @brief The Light associated to this Entity.
      */
-    std::shared_ptr<Light> light;
+    RenderState<std::shared_ptr<Light>> light{this};
 
     /**
      * @brief The Camera associated to this Entity.
@@ -328,13 +480,63 @@ class Entity : public Object<Entity, std::string>
      * @brief Event that fires when this Entity is about to die.
      * @param e A pointer to a const Entity that is about to die.
      */
-    boost::signals2::signal<void(Entity*)> onDie;
+    LazySignal<void(Entity*)> onDie;
 
     /**
      * @brief Event that fires when the global transform has changed.
+     * @details In TransformNotification::Deferred mode, this fires at most
+     * once per Entity in Entity::flushTransformChanges.
      * @param e A reference to the Entity whose global transform has changed.
      */
-    boost::signals2::signal<void(SharedPtr)> onTransformChange;
+    LazySignal<void(SharedPtr)> onTransformChange;
+
+    /**
+     * @brief Event that fires once in every Entity::flushTransformChanges
+     * that has changed entities, in TransformNotification::Deferred mode.
+     * @param first Pointer to the first Entity whose local transform
+     * changed since the previous flush.
+     * @param last Pointer to one-past-the-end.
+     */
+    static boost::signals2::signal<void(const SharedPtr* first,
+                                        const SharedPtr* last)>
+        onTransformChangeBatch;
+
+    /// When the transform change events fire.
+    enum class TransformNotification
+    {
+        /// Every transform setter fires onTransformChange on the spot.
+        Immediate,
+
+        /// The transform setters only remember the Entity. The events fire
+        /// in Entity::flushTransformChanges, once per changed Entity.
+        Deferred
+    };
+
+    /**
+     * @brief Set when the transform change events fire, for all entities.
+     * @details Switching from Deferred to Immediate flushes the changes
+     * that are still pending. The mode is Immediate by default.
+     * @param mode The new mode.
+     */
+    static void setTransformNotification(const TransformNotification mode);
+
+    /**
+     * @brief Get when the transform change events fire.
+     * @return The current mode.
+     */
+    static TransformNotification getTransformNotification() noexcept;
+
+    /**
+     * @brief Fire the transform change events of all entities that changed
+     * since the previous flush.
+     * @details Call this once per frame, after the gameplay code moved the
+     * entities and before anything that listens to the events needs them,
+     * like Octree::commitUpdates. Renderer::submitEntityRecursive calls it
+     * too. Every changed Entity is reported once, no matter how many times
+     * it was moved. Entities that are moved by a listener during the flush
+     * are reported in the next flush. Does nothing in Immediate mode.
+     */
+    static void flushTransformChanges();
 
     //@}
 
@@ -347,8 +549,8 @@ class Entity : public Object<Entity, std::string>
     /**
      * @brief Set the scale of the local SQT transform.
      *
-     * @details If the Entity has children, this will update the global
-     * transform of all of its children.
+     * @details This marks the global transform of this Entity and of all
+     * of its descendants as out of date. They are recomputed when needed.
      * @param s The new scale.
      */
     void setScale(const vec3f& s) noexcept;
@@ -356,8 +558,8 @@ class Entity : public Object<Entity, std::string>
     /**
      * @brief Multiply the current scale of the local SQT transform.
      *
-     * @details If the Entity has children, this will update the global
-     * transform of all of its children.
+     * @details This marks the global transform of this Entity and of all
+     * of its descendants as out of date. They are recomputed when needed.
      *
      * @param s The scale to multiply the current local scale with.
      */
@@ -366,8 +568,8 @@ class Entity : public Object<Entity, std::string>
     /**
      * @brief Set the translation of the local SQT transform.
      *
-     * @details If the Entity has children, this will update the global
-     * transform of all of its children.
+     * @details This marks the global transform of this Entity and of all
+     * of its descendants as out of date. They are recomputed when needed.
      *
      * @param t The new translation.
      */
@@ -376,8 +578,8 @@ class Entity : public Object<Entity, std::string>
     /**
      * @brief Set the translation's X-coordinate of the local SQT transform.
      *
-     * @details If the Entity has children, this will update the global
-     * transform of all of its children.
+     * @details This marks the global transform of this Entity and of all
+     * of its descendants as out of date. They are recomputed when needed.
      *
      * @param x The new X-coordinate.
      */
@@ -386,8 +588,8 @@ class Entity : public Object<Entity, std::string>
     /**
      * @brief Set the translation's Y-coordinate of the local SQT transform.
      *
-     * @details If the Entity has children, this will update the global
-     * transform of all of its children.
+     * @details This marks the global transform of this Entity and of all
+     * of its descendants as out of date. They are recomputed when needed.
      *
      * @param y The new Y-coordinate.
      */
@@ -396,8 +598,8 @@ class Entity : public Object<Entity, std::string>
     /**
      * @brief Set the translation's Z-coordinate of the local SQT transform.
      *
-     * @details If the Entity has children, this will update the global
-     * transform of all of its children.
+     * @details This marks the global transform of this Entity and of all
+     * of its descendants as out of date. They are recomputed when needed.
      *
      * @param z The new Z-coordinate.
      */
@@ -406,8 +608,8 @@ class Entity : public Object<Entity, std::string>
     /**
      * @brief Add a translation to the current SQT transform's translation.
      *
-     * @details If the Entity has children, this will update the global
-     * transform of all of its children.
+     * @details This marks the global transform of this Entity and of all
+     * of its descendants as out of date. They are recomputed when needed.
      *
      * @param t The translation to add.
      */
@@ -416,8 +618,8 @@ class Entity : public Object<Entity, std::string>
     /**
      * @brief Set the rotation quaternion of the local SQT transform.
      *
-     * @details If the Entity has children, this will update the global
-     * transform of all of its children.
+     * @details This marks the global transform of this Entity and of all
+     * of its descendants as out of date. They are recomputed when needed.
      *
      * @param q The new rotation quaternion.
      */
@@ -426,8 +628,8 @@ class Entity : public Object<Entity, std::string>
     /**
      * @brief Post-multiply the current rotation of the local SQT transform.
      *
-     * @details If the Entity has children, this will update the global
-     * transform of all of its children.
+     * @details This marks the global transform of this Entity and of all
+     * of its descendants as out of date. They are recomputed when needed.
      *
      * @param q The rotation quaternion to post-multiply with.
      */
@@ -436,8 +638,8 @@ class Entity : public Object<Entity, std::string>
     /**
      * @brief Pre-multiply the current rotation of the local SQT transform.
      *
-     * @details If the Entity has children, this will update the global
-     * transform of all of its children.
+     * @details This marks the global transform of this Entity and of all
+     * of its descendants as out of date. They are recomputed when needed.
      *
      * @param q The rotation quaternion to pre-multiply with.
      */
@@ -446,8 +648,8 @@ class Entity : public Object<Entity, std::string>
     /**
      * @brief Set the local SQT transform of this Entity.
      *
-     * @details If the Entity has children, this will update the global
-     * transform of all of its children.
+     * @details This marks the global transform of this Entity and of all
+     * of its descendants as out of date. They are recomputed when needed.
      *
      * @param sqt The new SQT transform.
      */
@@ -456,8 +658,8 @@ class Entity : public Object<Entity, std::string>
     /**
      * @brief Post-add an SQT to the current local SQT transform.
      *
-     * @details If the Entity has children, this will update the global
-     * transform of all of its children.
+     * @details This marks the global transform of this Entity and of all
+     * of its descendants as out of date. They are recomputed when needed.
      *
      * @param sqt The SQT transform to post-add.
      */
@@ -466,8 +668,8 @@ class Entity : public Object<Entity, std::string>
     /**
      * @brief Pre-add an SQT to the current local SQT transform.
      *
-     * @details If the Entity has children, this will update the global
-     * transform of all of its children.
+     * @details This marks the global transform of this Entity and of all
+     * of its descendants as out of date. They are recomputed when needed.
      *
      * @param sqt The SQT transform to pre-add.
      */
@@ -476,8 +678,8 @@ class Entity : public Object<Entity, std::string>
     /**
      * @brief Move the Entity in the direction of the local forward direction.
      *
-     * @details If the Entity has children, this will update the global
-     * transform of all of its children.
+     * @details This marks the global transform of this Entity and of all
+     * of its descendants as out of date. They are recomputed when needed.
      *
      * @param amount The amount of translation.
      */
@@ -487,8 +689,8 @@ class Entity : public Object<Entity, std::string>
      * @brief Move the Entity in the direction of the local backward
      * direction.
      *
-     * @details If the Entity has children, this will update the global
-     * transform of all of its children.
+     * @details This marks the global transform of this Entity and of all
+     * of its descendants as out of date. They are recomputed when needed.
      *
      * @param amount The amount of translation.
      */
@@ -497,8 +699,8 @@ class Entity : public Object<Entity, std::string>
     /**
      * @brief Move the Entity in the direction of the local right direction.
      *
-     * @details If the Entity has children, this will update the global
-     * transform of all of its children.
+     * @details This marks the global transform of this Entity and of all
+     * of its descendants as out of date. They are recomputed when needed.
      *
      * @param amount The amount of translation.
      */
@@ -506,24 +708,24 @@ class Entity : public Object<Entity, std::string>
 
     /**
      * @brief Move the Entity in the direction of the local left direction.
-     * @details If the Entity has children, this will update the global
-     * transform of all of its children.
+     * @details This marks the global transform of this Entity and of all
+     * of its descendants as out of date. They are recomputed when needed.
      * @param amount The amount of translation.
      */
     void moveLeft(const float amount) noexcept;
 
     /**
      * @brief Move the Entity in the direction of the local up direction.
-     * @details If the Entity has children, this will update the global
-     * transform of all of its children.
+     * @details This marks the global transform of this Entity and of all
+     * of its descendants as out of date. They are recomputed when needed.
      * @param amount The amount of translation.
      */
     void moveUp(const float amount) noexcept;
 
     /**
      * @brief Move the Entity in the direction of the local down direction.
-     * @details If the Entity has children, this will update the global
-     * transform of all of its children.
+     * @details This marks the global transform of this Entity and of all
+     * of its descendants as out of date. They are recomputed when needed.
      * @param amount The amount of translation.
      */
     void moveDown(const float amount) noexcept;
@@ -598,7 +800,10 @@ class Entity : public Object<Entity, std::string>
      * @endcode
      * @return A weak pointer to the parent of this Entity.
      */
-    inline std::weak_ptr<Entity> parent() noexcept { return mParent; }
+    inline std::weak_ptr<Entity> parent() noexcept
+    {
+        return mParent ? WeakPtr(mParent->shared_from_this()) : WeakPtr();
+    }
 
     /**
      * @brief Get a constant pointer to the parent of this Entity.
@@ -607,9 +812,24 @@ class Entity : public Object<Entity, std::string>
      */
     inline const std::weak_ptr<const Entity> parent() const noexcept
     {
-        return mParent;
+        return mParent ? ConstWeakPtr(mParent->shared_from_this())
+                       : ConstWeakPtr();
     }
 
+    /**
+     * @brief Get the parent of this Entity without touching reference
+     * counts. Use this in code that runs every frame.
+     * @return The parent, or null if this Entity has no parent.
+     */
+    inline Entity* getParent() noexcept { return mParent; }
+
+    /**
+     * @brief Get the parent of this Entity without touching reference
+     * counts. Use this in code that runs every frame.
+     * @return The parent, or null if this Entity has no parent.
+     */
+    inline const Entity* getParent() const noexcept { return mParent; }
+
     /**
      * @brief Get an iterator to the beginning of children list.
      * @return An iterator to the beginning of the children list.
@@ -686,13 +906,29 @@ class Entity : public Object<Entity, std::string>
     /**
      * @brief Get the global transformation matrix, i.e. from `MODEL` space
      * to `WORLD` space.
+     * @details Changing the local transform of an Entity only marks it and
+     * its descendants as dirty. The global transform is computed here, on
+     * first use, from the global transform of the parent. Because of that,
+     * do not call this method from several threads at once on entities of
+     * the same hierarchy, unless Entity::updateGlobalTransforms ran on its
+     * root since the last change.
      * @return A constant reference to the global transformation matrix.
      */
     inline const mat4f& globalTransform() const noexcept
     {
+        if (mGlobalTransformIsDirty) resolveGlobalTransform();
         return mGlobalTransform;
     }
 
+    /**
+     * @brief Bring the global transformation matrices of this Entity and
+     * all of its descendants up to date.
+     * @details This is a single top-down pass, in which every global
+     * transform is computed at most once. Renderer::submitEntityRecursive
+     * calls this on the root once per frame.
+     */
+    void updateGlobalTransforms() const noexcept;
+
     /**
      * @brief Get the global bounding box.
      * @return A constant reference to the global bounding box.
@@ -776,32 +1012,105 @@ class Entity : public Object<Entity, std::string>
 
     //@}
 
-    GINTONIC_DEFINE_SSE_OPERATOR_NEW_DELETE();
+    /**
+     * @name Handles
+     */
+
+    //@{
+
+    /**
+     * @brief Get the handle of this Entity.
+     * @details The handle stays the same for the lifetime of this Entity,
+     * and never refers to another Entity afterwards.
+     * @return The handle.
+     */
+    inline EntityHandle getHandle() const noexcept { return mHandle; }
+
+    /**
+     * @brief Get the Entity that a handle refers to.
+     * @details This is a lookup in a flat table, without reference counts.
+     * @param handle The handle.
+     * @return The Entity, or null if it died or the handle is null.
+     */
+    static Entity* fromHandle(const EntityHandle handle) noexcept;
+
+    /**
+     * @brief Get the number of entities that are alive.
+     * @return The number of entities.
+     */
+    static std::size_t count() noexcept;
+
+    //@}
+
+    /**
+     * @name Render state
+     */
+
+    //@{
+
+    /**
+     * @brief Take the handles of the entities whose render state changed.
+     *
+     * @details The render state of an Entity is its parent, castShadow,
+     * material, mesh and light. An Entity is recorded when one of them
+     * changes and when it dies, at most once between two calls. Nothing is
+     * recorded before the first call, so programs without a Renderer pay
+     * nothing. Renderer::submitEntityRecursive calls this once per frame.
+     *
+     * @param[out] changes Receives the handles. The handles of entities
+     *                     that died since they changed no longer resolve.
+     */
+    static void takeRenderStateChanges(std::vector<EntityHandle>& changes);
+
+    //@}
+
+    // Entities come from a BlockPool. Like the SSE operator new, this
+    // aligns them on a 16-byte boundary.
+    static void* operator new(const std::size_t count);
+    static void operator delete(void* ptr, const std::size_t count) noexcept;
+    inline static void* operator new(const std::size_t /*count*/, void* here)
+    {
+        return here;
+    }
+    inline static void operator delete(void* /*ptr*/, void* /*here*/) {}
 
   private:
     friend boost::serialization::access;
 
     template <class Archive>
-    void serialize(Archive& archive, const unsigned int /*version*/)
+    void serialize(Archive& archive, const unsigned int version)
     {
         archive& boost::serialization::base_object<Super>(*this);
+        if (Archive::is_saving::value) globalTransform();
         archive& mLocalTransform;
         archive& mGlobalTransform;
-        archive& mParent;
+        if (Archive::is_loading::value) mGlobalTransformIsDirty = true;
+        if (version == 0)
+        {
+            // Version 0 stored the parent. It follows from the children.
+            WeakPtr parent;
+            archive& parent;
+        }
         // archive & mOctree;
         // archive & mOctreeListIter;
-        archive& castShadow;
-        archive& material;
-        archive& mesh;
-        archive& light;
+        archive& castShadow.mValue;
+        archive& material.mValue;
+        archive& mesh.mValue;
+        archive& light.mValue;
         archive& camera;
         archive& animationClips;
         archive& activeAnimationClip;
         archive& activeAnimationStartTime;
         archive& mChildren;
+        if (Archive::is_loading::value)
+        {
+            for (const auto& child : mChildren) child->mParent = this;
+            renderStateChanged();
+        }
     }
 };
 
 } // namespace gintonic
 
 BOOST_CLASS_TRACKING(gintonic::Entity, boost::serialization::track_always);
+BOOST_CLASS_VERSION(gintonic::Entity, 1);
@@ -1,14 +1,24 @@
 #pragma once
 
 #include "Casting.hpp"
+#include "Component.hpp"
+#include <cstdint>
 #include <vector>
 #include <memory>
 
 namespace gintonic
 {
 
-class Component;
-
+/**
+ * @brief Base class for objects that own components.
+ *
+ * @details Besides the list of components, which defines the order of the
+ * updates, an EntityBase keeps a table with a slot per Component::Kind and a
+ * bitmask of the occupied slots. Each slot points to the first added
+ * Component of its kind. The kinds that a component type T covers are
+ * topologically sorted and so are a small set of bits, so get<T> and has<T>
+ * are a mask and a table lookup instead of a walk over all components.
+ */
 class EntityBase
 {
   public:
@@ -50,6 +60,13 @@ class EntityBase
      */
     template <class T> const T* get() const noexcept;
 
+    /**
+     * @brief Check whether this Entity has a Component.
+     * @tparam T A type which derives from Component.
+     * @return True if a Component subclassed from T is present, false if not.
+     */
+    template <class T> bool has() const noexcept;
+
   protected:
     EntityBase(const Kind kind);
     virtual ~EntityBase() = default;
@@ -62,54 +79,114 @@ class EntityBase
     void lateUpdate();
 
   private:
+    static constexpr std::size_t kKindCount =
+        static_cast<std::size_t>(Component::Kind::Count);
+    static_assert(kKindCount <= 32, "The kinds must fit in the bitmask.");
+
     const Kind mKind;
     std::vector<std::unique_ptr<Component>> mComponents;
+
+    // The first added Component of each kind, and a bit for each occupied
+    // slot.
+    Component* mSlots[kKindCount] = {};
+    std::uint32_t mKinds = 0;
+
     void clone(const EntityBase&);
     void assertSameType(const EntityBase&) const;
+    void takeSlots(EntityBase&) noexcept;
+    void clearSlots() noexcept;
+    void occupySlot(Component*) noexcept;
+    void releaseSlot(const Component*) noexcept;
+
+    template <class T> Component* find() const noexcept;
+    template <class T> static std::uint32_t kindMask() noexcept;
+    static std::size_t firstKind(const std::uint32_t kinds) noexcept;
+
+    // A Component that is never added to an Entity. It asks T::classOf which
+    // kinds belong to T.
+    class KindProbe final : public Component
+    {
+      public:
+        KindProbe(const Component::Kind kind) : Component(kind, nullptr) {}
+        ~KindProbe() noexcept override = default;
+
+      private:
+        std::unique_ptr<Component> clone(EntityBase*) const override
+        {
+            return nullptr;
+        }
+    };
 };
 
 template <class T> T* EntityBase::add()
 {
     auto t = new T(this);
     mComponents.emplace_back(t);
+    occupySlot(t);
     return t;
 }
 
 template <class T> bool EntityBase::remove()
 {
+    const auto comp = find<T>();
+    if (!comp) return false;
+    releaseSlot(comp);
     for (auto iter = mComponents.begin(); iter != mComponents.end(); ++iter)
     {
-        if (auto ptr = dynCast<T>(iter->get()))
+        if (iter->get() == comp)
         {
             mComponents.erase(iter);
-            return true;
+            break;
         }
     }
-    return false;
+    return true;
 }
 
 template <class T> T* EntityBase::get() noexcept
 {
-    for (auto& comp : mComponents)
-    {
-        if (auto ptr = dynCast<T>(comp.get()))
-        {
-            return ptr;
-        }
-    }
-    return nullptr;
+    return static_cast<T*>(find<T>());
 }
 
 template <class T> const T* EntityBase::get() const noexcept
 {
-    for (const auto& comp : mComponents)
-    {
-        if (const auto ptr = dynCast<const T>(comp.get()))
+    return static_cast<const T*>(find<T>());
+}
+
+template <class T> bool EntityBase::has() const noexcept
+{
+    return (mKinds & kindMask<T>()) != 0;
+}
+
+template <class T> Component* EntityBase::find() const noexcept
+{
+    // When T is a base class, the Component of the lowest kind wins.
+    const auto kinds = mKinds & kindMask<T>();
+    return kinds ? mSlots[firstKind(kinds)] : nullptr;
+}
+
+template <class T> std::uint32_t EntityBase::kindMask() noexcept
+{
+    static const std::uint32_t mask = [] {
+        std::uint32_t result = 0;
+        for (std::size_t k = 0; k < kKindCount; ++k)
         {
-            return ptr;
+            const KindProbe probe(static_cast<Component::Kind>(k));
+            if (isa<T>(&probe)) result |= std::uint32_t(1) << k;
         }
-    }
-    return nullptr;
+        return result;
+    }();
+    return mask;
+}
+
+inline std::size_t EntityBase::firstKind(const std::uint32_t kinds) noexcept
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<std::size_t>(__builtin_ctz(kinds));
+#else
+    std::size_t result = 0;
+    while (!(kinds & (std::uint32_t(1) << result))) ++result;
+    return result;
+#endif
 }
 
 } // gintonic
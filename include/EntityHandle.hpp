@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+namespace gintonic
+{
+
+/**
+ * @brief      A weak reference to an Entity in 32 bits.
+ *
+ * @details    A handle is the index of a slot in the handle table of the
+ *             entities, together with the generation of that slot. When an
+ *             Entity dies, the generation of its slot is bumped, so old
+ *             handles no longer resolve even when the slot is reused. Use
+ *             Entity::fromHandle to get the Entity back.
+ *
+ *             Unlike an Entity::WeakPtr, copying or resolving a handle
+ *             involves no reference counts, so hot paths can store handles
+ *             in flat arrays and pass them around freely. A
+ *             default-constructed handle refers to no Entity.
+ */
+class EntityHandle
+{
+  public:
+    /// The number of bits of the slot index.
+    static constexpr std::uint32_t kIndexBits = 22;
+
+    /// The number of bits of the generation.
+    static constexpr std::uint32_t kGenerationBits = 32 - kIndexBits;
+
+    /// The largest slot index plus one.
+    static constexpr std::uint32_t kMaxIndex = std::uint32_t(1) << kIndexBits;
+
+    /// The largest generation plus one.
+    static constexpr std::uint32_t kMaxGeneration = std::uint32_t(1)
+                                                    << kGenerationBits;
+
+    /// Constructs a handle that refers to no Entity.
+    constexpr EntityHandle() noexcept = default;
+
+    /**
+     * @brief      Constructor.
+     *
+     * @param[in]  index       The slot index. Must be less than kMaxIndex.
+     * @param[in]  generation  The generation. Must be less than
+     *                         kMaxGeneration.
+     */
+    constexpr EntityHandle(const std::uint32_t index,
+                           const std::uint32_t generation) noexcept
+        : mValue(index | (generation << kIndexBits))
+    {
+    }
+
+    constexpr std::uint32_t index() const noexcept
+    {
+        return mValue & (kMaxIndex - 1);
+    }
+
+    constexpr std::uint32_t generation() const noexcept
+    {
+        return mValue >> kIndexBits;
+    }
+
+    /// Get the 32 bits of the handle.
+    constexpr std::uint32_t value() const noexcept { return mValue; }
+
+    /// Check whether the handle refers to an Entity, dead or alive.
+    constexpr explicit operator bool() const noexcept { return mValue != 0; }
+
+    constexpr bool operator==(const EntityHandle other) const noexcept
+    {
+        return mValue == other.mValue;
+    }
+
+    constexpr bool operator!=(const EntityHandle other) const noexcept
+    {
+        return mValue != other.mValue;
+    }
+
+    constexpr bool operator<(const EntityHandle other) const noexcept
+    {
+        return mValue < other.mValue;
+    }
+
+  private:
+    // Generations start at one, so no live Entity has the value zero.
+    std::uint32_t mValue = 0;
+};
+
+} // namespace gintonic
+
+namespace std
+{
+
+template <> struct hash<gintonic::EntityHandle>
+{
+    std::size_t operator()(const gintonic::EntityHandle handle) const noexcept
+    {
+        return std::hash<std::uint32_t>()(handle.value());
+    }
+};
+
+} // namespace std
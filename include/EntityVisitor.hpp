@@ -78,12 +78,13 @@ private:
 	/**
 	 * @brief This method gets called everytime a new Entity is encountered
 	 * in the search tree. You should return true if the search should continue
-	 * and return false if the search should be aborted.
+	 * and return false if the search should be aborted. The search does not
+	 * copy shared pointers, so it touches no reference counts.
 	 * @param entity The current Entity that is visited.
 	 * @return True if the search should continue, false if the search
 	 * should be aborted.
 	 */
-	virtual bool onVisit(std::shared_ptr<Entity> entity) = 0;
+	virtual bool onVisit(Entity& entity) = 0;
 	
 	/**
 	 * @brief This method gets called at the end of the search, just before
@@ -93,7 +94,7 @@ private:
 	 */
 	inline virtual void onFinish() {}
 
-	void visit(std::shared_ptr<Entity>);
+	void visit(Entity&);
 };
 
 } // namespace gintonic
\ No newline at end of file
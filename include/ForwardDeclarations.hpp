@@ -12,6 +12,11 @@ class exception;
 class ReadLock;
 class ReadWriteLock;
 class Octree;
+class OctreeImage;
+class OctreeSnapshot;
+class LinearOctree;
+class TriangleBVH;
+class TransformHierarchy;
 class timer;
 class one_shot_timer;
 class loop_timer;
@@ -50,6 +55,7 @@ class PointLight;
 class SpotLight;
 class Material;
 class Renderer;
+class RenderLists;
 class Skybox;
 class Skeleton;
 class Mesh;
@@ -64,6 +70,7 @@ class FlatTextShaderProgram;
 
 /* general classes */
 class Entity;
+class EntityHandle;
 class Camera;
 class Component;
 
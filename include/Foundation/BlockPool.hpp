@@ -0,0 +1,211 @@
+/**
+ * @file BlockPool.hpp
+ * @brief Defines a pool of fixed-size memory blocks, and an allocator that
+ * takes single objects from such a pool.
+ * @author Raoul Wols
+ */
+
+#pragma once
+
+#include "Foundation/simd.hpp"
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace gintonic {
+
+/**
+ * @brief A pool of fixed-size memory blocks.
+ *
+ * @details Blocks are carved from chunks that grow geometrically, and freed
+ * blocks go onto an intrusive free list. Allocating and freeing a block are
+ * a handful of instructions and never touch the system allocator once the
+ * pool has warmed up. Blocks of the same chunk are adjacent in memory, so
+ * objects that are allocated together are also traversed together cheaply.
+ *
+ * The pool is not thread-safe.
+ *
+ * @tparam BlockSize The size of a block in bytes.
+ * @tparam Alignment The alignment of a block in bytes.
+ */
+template <std::size_t BlockSize, std::size_t Alignment>
+class BlockPool
+{
+public:
+
+	/// Constructs an empty BlockPool.
+	BlockPool() = default;
+
+	BlockPool(const BlockPool&) = delete;
+	BlockPool& operator = (const BlockPool&) = delete;
+
+	/// Returns all chunks to the system. Outstanding blocks become invalid.
+	~BlockPool() noexcept
+	{
+		for (auto* lChunk : mChunks) _mm_free(lChunk);
+	}
+
+	/**
+	 * @brief Allocate a block.
+	 * @return A pointer to BlockSize bytes, aligned to Alignment bytes.
+	 */
+	void* allocate()
+	{
+		if (!mFreeList) grow();
+		auto* lBlock = mFreeList;
+		mFreeList = lBlock->next;
+		++mUsedBlocks;
+		return lBlock;
+	}
+
+	/**
+	 * @brief Return a block to the pool.
+	 * @param block A block that was returned by allocate.
+	 */
+	void deallocate(void* block) noexcept
+	{
+		auto* lBlock = static_cast<Block*>(block);
+		lBlock->next = mFreeList;
+		mFreeList = lBlock;
+		--mUsedBlocks;
+	}
+
+	/**
+	 * @brief Make sure that the next allocations do not need new chunks.
+	 * @param count The number of blocks that can then be allocated without
+	 * touching the system allocator.
+	 */
+	void reserve(const std::size_t count)
+	{
+		const auto lFreeBlocks = mCapacity - mUsedBlocks;
+		if (lFreeBlocks < count) addChunk(count - lFreeBlocks);
+	}
+
+	/// Get the number of blocks that are in use.
+	std::size_t usedBlocks() const noexcept { return mUsedBlocks; }
+
+	/// Get the number of bytes that the chunks take.
+	std::size_t memoryUsage() const noexcept
+	{
+		return mCapacity * sizeof(Block) + mChunks.capacity() * sizeof(Block*);
+	}
+
+private:
+
+	union alignas(Alignment) Block
+	{
+		Block* next;
+		unsigned char storage[BlockSize];
+	};
+
+	Block* mFreeList = nullptr;
+	std::vector<Block*> mChunks;
+	std::size_t mCapacity = 0;
+	std::size_t mUsedBlocks = 0;
+
+	void grow()
+	{
+		// Double the capacity, starting at 64 blocks and up to 4096 blocks
+		// per chunk.
+		std::size_t lCount = mCapacity < 64 ? 64 : mCapacity;
+		if (lCount > 4096) lCount = 4096;
+		addChunk(lCount);
+	}
+
+	void addChunk(const std::size_t count)
+	{
+		auto* lChunk = static_cast<Block*>(
+			_mm_malloc(count * sizeof(Block), alignof(Block)));
+		if (!lChunk) throw std::bad_alloc();
+		mChunks.push_back(lChunk);
+		mCapacity += count;
+
+		// Thread the new blocks onto the free list in address order.
+		for (std::size_t i = 0; i + 1 < count; ++i)
+		{
+			lChunk[i].next = lChunk + i + 1;
+		}
+		lChunk[count - 1].next = mFreeList;
+		mFreeList = lChunk;
+	}
+};
+
+/**
+ * @brief An allocator that takes single objects from a BlockPool.
+ *
+ * @details All PoolAllocator<T> share one BlockPool per type T. Requests for
+ * more than one object go to the system allocator, so this allocator is
+ * meant for node-based containers and for the control blocks of
+ * std::shared_ptr, not for std::vector. The shared pool is never destroyed,
+ * so objects may outlive static destruction. Like the pool, the allocator
+ * is not thread-safe.
+ *
+ * @tparam T The value type.
+ */
+template <class T>
+class PoolAllocator
+{
+public:
+
+	/// The value type.
+	typedef T value_type;
+
+	/// The alignment of the blocks.
+	static constexpr std::size_t kAlignment =
+		alignof(T) < alignof(void*) ? alignof(void*) : alignof(T);
+
+	/// The BlockPool type that is shared by all PoolAllocator<T>.
+	typedef BlockPool<sizeof(T), kAlignment> pool_type;
+
+	PoolAllocator() = default;
+
+	/// Converting constructor. Does nothing interesting.
+	template <class U>
+	PoolAllocator(const PoolAllocator<U>&) noexcept {}
+
+	/**
+	 * @brief Allocate storage for objects.
+	 * @param n The number of objects.
+	 * @return Uninitialized storage for n objects.
+	 */
+	T* allocate(const std::size_t n)
+	{
+		if (n == 1) return static_cast<T*>(pool().allocate());
+		auto* lResult = _mm_malloc(n * sizeof(T), kAlignment);
+		if (!lResult) throw std::bad_alloc();
+		return static_cast<T*>(lResult);
+	}
+
+	/**
+	 * @brief Free storage of objects.
+	 * @param p The storage, as returned by allocate.
+	 * @param n The number of objects, as given to allocate.
+	 */
+	void deallocate(T* p, const std::size_t n) noexcept
+	{
+		if (n == 1) pool().deallocate(p);
+		else _mm_free(p);
+	}
+
+	/// Get the BlockPool that is shared by all PoolAllocator<T>.
+	static pool_type& pool()
+	{
+		// Intentionally leaked, see the class description.
+		static auto* sPool = new pool_type();
+		return *sPool;
+	}
+
+	/// Always returns true.
+	template <class U>
+	bool operator == (const PoolAllocator<U>&) const noexcept { return true; }
+
+	/// Always returns false.
+	template <class U>
+	bool operator != (const PoolAllocator<U>&) const noexcept { return false; }
+};
+
+template <class T>
+constexpr std::size_t PoolAllocator<T>::kAlignment;
+
+} // namespace gintonic
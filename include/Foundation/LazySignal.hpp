@@ -0,0 +1,95 @@
+/**
+ * @file LazySignal.hpp
+ * @brief Defines a signal that allocates its state on the first connection.
+ * @author Raoul Wols
+ */
+
+#pragma once
+
+#include <boost/signals2/signal.hpp>
+
+#include <memory>
+#include <utility>
+
+namespace gintonic {
+
+/**
+ * @brief A boost::signals2::signal that only exists once something connects
+ * to it.
+ *
+ * @details A default-constructed boost::signals2::signal allocates its slot
+ * list, its combiner and its mutex on the heap, a few hundred bytes in
+ * total. Objects that exist by the thousands and of which only a few are
+ * ever listened to, like entities, pay that for nothing. A LazySignal is a
+ * single pointer until the first call to connect. Firing a LazySignal that
+ * nobody ever connected to does nothing.
+ *
+ * @tparam Signature The signature of the signal, like `void(int)`.
+ */
+template <class Signature>
+class LazySignal
+{
+public:
+
+	/// The type of the underlying signal.
+	typedef boost::signals2::signal<Signature> signal_type;
+
+	/// The type that firing the signal returns.
+	typedef typename signal_type::result_type result_type;
+
+	LazySignal() = default;
+	LazySignal(LazySignal&&) = default;
+	LazySignal& operator = (LazySignal&&) = default;
+
+	/**
+	 * @brief Connect a slot. Creates the underlying signal if needed.
+	 * @param args The arguments for boost::signals2::signal::connect.
+	 * @return The connection.
+	 */
+	template <class... Args>
+	boost::signals2::connection connect(Args&&... args)
+	{
+		return get().connect(std::forward<Args>(args)...);
+	}
+
+	/**
+	 * @brief Fire the signal.
+	 * @param args The arguments for the slots.
+	 * @return What the combiner returns, or a default-constructed result if
+	 * nothing ever connected.
+	 */
+	template <class... Args>
+	result_type operator () (Args&&... args) const
+	{
+		if (!mSignal) return result_type();
+		return (*mSignal)(std::forward<Args>(args)...);
+	}
+
+	/// Check whether no slots are connected.
+	bool empty() const noexcept { return !mSignal || mSignal->empty(); }
+
+	/// Get the number of connected slots.
+	std::size_t num_slots() const noexcept
+	{
+		return mSignal ? mSignal->num_slots() : 0;
+	}
+
+	/// Disconnect all slots.
+	void disconnect_all_slots()
+	{
+		if (mSignal) mSignal->disconnect_all_slots();
+	}
+
+	/// Get the underlying signal. Creates it if needed.
+	signal_type& get()
+	{
+		if (!mSignal) mSignal.reset(new signal_type());
+		return *mSignal;
+	}
+
+private:
+
+	std::unique_ptr<signal_type> mSignal;
+};
+
+} // namespace gintonic
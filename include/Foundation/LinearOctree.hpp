@@ -0,0 +1,547 @@
+/**
+ * @file LinearOctree.hpp
+ * @brief Defines a linear Octree datastructure that stores its nodes in a
+ * flat array keyed by Morton codes.
+ * @author Raoul Wols
+ */
+
+#pragma once
+
+#include "Math/box3f.hpp"
+#include "Foundation/allocator.hpp"
+#include "Foundation/morton.hpp"
+#include "Entity.hpp"
+
+#include <boost/signals2/connection.hpp>
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace gintonic {
+
+/**
+ * @brief A linear Octree datastructure.
+ *
+ * @details The classic Octree is a pointer tree where every node owns eight
+ * children and a linked list of entities. The LinearOctree instead identifies
+ * every node by a location code: the Morton code of the path from the root
+ * to the node, prefixed with a single sentinel bit. The nodes are stored in
+ * one flat array in depth-first (pre-)order, and the entities are stored in
+ * parallel arrays sorted in the same order. Consequently, the entities of a
+ * node and of all of its descendants form one contiguous range, and a query
+ * walks both arrays front to back.
+ *
+ * Inserting, erasing and moving entities only marks the tree as dirty. The
+ * flat arrays are rebuilt lazily right before the next query. The tree
+ * listens to the onTransformChange and onDie events of every Entity, just
+ * like the classic Octree does.
+ *
+ * The cells of the tree are half-open: an Entity whose bounding box touches
+ * the splitting plane of two octants from below is stored in the parent.
+ * Entities that move outside the bounding box of the tree are stored in the
+ * root node so that they are never lost.
+ */
+class LinearOctree
+{
+public:
+
+	class EntityNotContainedInOctreeBoundingBox : public std::exception
+	{
+	public:
+		EntityNotContainedInOctreeBoundingBox() = delete;
+		virtual ~EntityNotContainedInOctreeBoundingBox() noexcept = default;
+		virtual const char* what() const noexcept
+		{
+			return "EntityNotContainedInOctreeBoundingBox";
+		}
+		inline Entity::SharedPtr      getEntity()           noexcept { return mEntity; }
+		inline Entity::ConstSharedPtr getEntity()     const noexcept { return mEntity; }
+		inline       LinearOctree*    getOctree()           noexcept { return mOctree; }
+		inline const LinearOctree*    getOctree()     const noexcept { return mOctree; }
+	private:
+		friend class LinearOctree;
+		template <class A, class B>
+		EntityNotContainedInOctreeBoundingBox(A&& octree, B&& entity)
+		: mOctree(std::forward<A>(octree))
+		, mEntity(std::forward<B>(entity))
+		{
+			/* Empty on purpose. */
+		}
+		LinearOctree* mOctree = nullptr;
+		Entity::SharedPtr mEntity = Entity::SharedPtr(nullptr);
+	};
+
+	/**
+	 * @brief A node of the linear Octree.
+	 * @details A node does not store its bounding box. It is recomputed from
+	 * the location code when needed.
+	 */
+	struct Node
+	{
+		/// The location code of this node.
+		std::uint64_t locationCode;
+
+		/// Index of the first entity of this node in the entity arrays.
+		std::uint32_t firstEntity;
+
+		/// The number of entities that are stored in this node itself.
+		std::uint32_t entityCount;
+
+		/// Index of the next node that is not a descendant of this node.
+		std::uint32_t skip;
+	};
+
+	/**
+	 * @brief A lightweight view of a node that is handed out by
+	 * LinearOctree::forEachNode.
+	 * @details The interface mimics that of the classic Octree, so that
+	 * generic code can call bounds() on both.
+	 */
+	class NodeView
+	{
+	public:
+
+		/**
+		 * @brief Get the axis-aligned bounding box of this node.
+		 * @return The axis-aligned bounding box of this node.
+		 */
+		box3f bounds() const noexcept;
+
+		/**
+		 * @brief Get the depth of this node. The root has depth zero.
+		 * @return The depth of this node.
+		 */
+		std::size_t depth() const noexcept;
+
+		/**
+		 * @brief Check wether this node is the root.
+		 * @return True if this node is the root, false otherwise.
+		 */
+		bool isRoot() const noexcept;
+
+		/**
+		 * @brief Check wether this node is a leaf.
+		 * @return True if this node is a leaf, false otherwise.
+		 */
+		bool isLeaf() const noexcept;
+
+		/**
+		 * @brief Check wether this node has no entities it refers to.
+		 * @return True if it houses no entities, false otherwise.
+		 */
+		bool hasNoEntities() const noexcept;
+
+		/**
+		 * @brief Get the number of entities in this node itself.
+		 * @return The number of entities in this node itself.
+		 */
+		std::size_t entityCount() const noexcept;
+
+	private:
+
+		friend class LinearOctree;
+
+		NodeView(const LinearOctree* tree, const std::size_t index) noexcept
+		: mTree(tree)
+		, mIndex(index)
+		{
+			/* Empty on purpose. */
+		}
+
+		const LinearOctree* mTree;
+		std::size_t mIndex;
+	};
+
+	/**
+	 * @brief Subdivision threshold.
+	 *
+	 * @details The subdivision threshold has the same meaning as the one
+	 * of the classic Octree: a node whose half-extent is at most this value
+	 * in any dimension is not subdivided any further. Changing this value
+	 * takes effect at the next query.
+	 */
+	float subdivisionThreshold = 1.0f;
+
+	/**
+	 * @brief Constructor that takes a bounding box.
+	 * @param b The bounding box of the Octree.
+	 */
+	LinearOctree(const box3f& b);
+
+	/**
+	 * @brief Constructor that takes a bounding box.
+	 * @param minCorner The minimum corner of the bounding box.
+	 * @param maxCorner The maximum corner of the bounding box.
+	 */
+	LinearOctree(const vec3f& minCorner, const vec3f& maxCorner);
+
+	/**
+	 * @brief Constructor that inserts elements from a container.
+	 * @tparam ForwardIter The forward iterator type. It should dereference
+	 * to an Entity::SharedPtr.
+	 * @param b The bounding box of the Octree.
+	 * @param first Iterator pointing to the first element.
+	 * @param last Iterator pointing to one-past-the-end element.
+	 */
+	template <class ForwardIter>
+	LinearOctree(const box3f& b, ForwardIter first, ForwardIter last);
+
+	/// You cannot copy a LinearOctree.
+	LinearOctree(const LinearOctree&) = delete;
+
+	/// You cannot move a LinearOctree.
+	LinearOctree(LinearOctree&&) = delete;
+
+	/// You cannot copy a LinearOctree.
+	LinearOctree& operator = (const LinearOctree&) = delete;
+
+	/// You cannot move a LinearOctree.
+	LinearOctree& operator = (LinearOctree&&) = delete;
+
+	/**
+	 * @brief Destructor.
+	 * @details Disconnects from the events of all entities.
+	 */
+	~LinearOctree();
+
+	/**
+	 * @brief Get the axis-aligned bounding box of this Octree.
+	 * @return A const reference to the axis-aligned bounding box.
+	 */
+	inline const box3f& bounds() const noexcept
+	{
+		return mBounds;
+	}
+
+	/**
+	 * @brief Get the number of entities in this Octree.
+	 * @return The number of entities in this Octree.
+	 */
+	std::size_t count() const;
+
+	/**
+	 * @brief Get the number of nodes in this Octree.
+	 * @return The number of nodes in this Octree.
+	 */
+	std::size_t nodeCount() const;
+
+	/**
+	 * @brief Get the number of bytes used by the flat arrays.
+	 * @return The number of bytes used by the flat arrays.
+	 */
+	std::size_t memoryUsage() const;
+
+	/**
+	 * @brief Query a volume to obtain all the entities in that volume.
+	 * @param volume The volume to fetch all entities from.
+	 * @param iter An output iterator to store the results.
+	 */
+	template <class OutputIter>
+	void query(const box3f& volume, OutputIter iter);
+
+	/**
+	 * @brief Query a volume to obtain all the entities in that volume.
+	 * @param volume The volume to fetch all entities from.
+	 * @param iter An output iterator to store the results.
+	 */
+	template <class OutputIter>
+	void query(const box3f& volume, OutputIter iter) const;
+
+	/**
+	 * @brief Query a volume to obtain all the entities in that volume.
+	 * @param volume The volume to fetch all entities from.
+	 * @param iter An output iterator to store the results.
+	 * @param filter A filter to apply to each entity within the search result.
+	 * If the filter returns true, then the entity is added to the result set.
+	 * Otherwise it is discarded.
+	 */
+	template <class OutputIter, class FilterFunc>
+	void query(const box3f& volume, OutputIter iter, FilterFunc filter);
+
+	/**
+	 * @brief Query a volume to obtain all the entities in that volume.
+	 * @param volume The volume to fetch all entities from.
+	 * @param iter An output iterator to store the results.
+	 * @param filter A filter to apply to each entity within the search result.
+	 * If the filter returns true, then the entity is added to the result set.
+	 * Otherwise it is discarded.
+	 */
+	template <class OutputIter, class FilterFunc>
+	void query(const box3f& volume, OutputIter iter, FilterFunc filter) const;
+
+	/**
+	 * @brief Get all the entities of this Octree.
+	 * @param iter An output iterator.
+	 */
+	template <class OutputIter>
+	void getEntities(OutputIter iter);
+
+	/**
+	 * @brief Get all the entities of this Octree.
+	 * @param iter An output iterator.
+	 */
+	template <class OutputIter>
+	void getEntities(OutputIter iter) const;
+
+	/**
+	 * @brief Apply a function to every Entity.
+	 * @tparam Func Type of a function pointer, lambda, functor, etc.
+	 * @param f A function pointer, lambda, functor, etc.
+	 */
+	template <class Func>
+	void foreach(Func f);
+
+	/**
+	 * @brief Apply a function to every Entity, const version.
+	 * @tparam Func Type of a function pointer, lambda, functor, etc.
+	 * @param f A function pointer, lambda, functor, etc.
+	 */
+	template <class Func>
+	void foreach(Func f) const;
+
+	/**
+	 * @brief Apply a function to every node in depth-first order.
+	 * @details The function receives a pointer to a NodeView, so that code
+	 * written for the classic Octree (which receives a pointer to an Octree
+	 * node) can be reused with generic lambdas.
+	 * @tparam Func Type of a function pointer, lambda, functor, etc.
+	 * @param f A function pointer, lambda, functor, etc.
+	 */
+	template <class Func>
+	void forEachNode(Func f) const;
+
+	/**
+	 * @brief Insert an Entity into the tree.
+	 * @details The Entity is appended to the flat arrays. Its final place is
+	 * determined when the tree is rebuilt right before the next query.
+	 * Inserting an Entity that is already in the tree does nothing.
+	 * @param entity The Entity to insert.
+	 * @throws EntityNotContainedInOctreeBoundingBox if the global bounding
+	 * box of the Entity is not contained in the bounds of this Octree.
+	 */
+	void insert(Entity::SharedPtr entity);
+
+	/**
+	 * @brief Erase the given entity from this Octree.
+	 * @param entity The Entity to erase.
+	 * @return True if the Entity was part of this Octree, false otherwise.
+	 */
+	bool erase(Entity::SharedPtr entity);
+
+	/**
+	 * @brief Erase all entities from this Octree.
+	 */
+	void clear();
+
+	GINTONIC_DEFINE_SSE_OPERATOR_NEW_DELETE();
+
+private:
+
+	struct Connections
+	{
+		boost::signals2::connection transformChange;
+		boost::signals2::connection die;
+	};
+
+	box3f mBounds;
+
+	// The flat arrays. They are only valid when mIsDirty is false.
+	mutable std::vector<Node> mNodes;
+	mutable std::vector<Entity*> mEntities;
+	mutable std::vector<box3f, allocator<box3f>> mEntityBounds;
+	mutable std::vector<std::uint64_t> mEntityCodes;
+
+	// Bookkeeping for the lazy rebuild.
+	std::unordered_map<Entity*, Connections> mConnections;
+	mutable std::vector<Entity*> mMovedEntities;
+	mutable std::vector<Entity*> mErasedEntities;
+	mutable std::size_t mMaxDepth = 0;
+	mutable float mBuiltSubdivisionThreshold = -1.0f;
+	mutable bool mIsDirty = false;
+
+	void connect(Entity* entity);
+
+	bool erase(Entity* entity);
+
+	void update() const;
+	void updateMaxDepth() const;
+
+	std::uint64_t locationCode(const box3f& box) const noexcept;
+	box3f nodeBounds(const std::uint64_t locationCode) const noexcept;
+
+	inline std::size_t subtreeEnd(const std::size_t nodeIndex) const noexcept
+	{
+		const auto lSkip = mNodes[nodeIndex].skip;
+		return lSkip < mNodes.size() ? mNodes[lSkip].firstEntity : mEntities.size();
+	}
+
+	template <class Func>
+	void queryImpl(const box3f& volume, Func f) const;
+};
+
+template <class ForwardIter>
+LinearOctree::LinearOctree(
+	const box3f& bounds,
+	ForwardIter first, ForwardIter last)
+: mBounds(bounds)
+{
+	while (first != last)
+	{
+		this->insert(*first);
+		++first;
+	}
+}
+
+template <class Func>
+void LinearOctree::queryImpl(const box3f& volume, Func f) const
+{
+	update();
+
+	// Entities that moved outside the bounds of the tree live in the root,
+	// so the entities of the root itself are always tested.
+	for (std::size_t j = 0; j < mNodes[0].entityCount; ++j)
+	{
+		if (intersects(volume, mEntityBounds[j])) f(mEntities[j]);
+	}
+	if (!intersects(volume, mBounds)) return;
+
+	std::size_t i = 1;
+	const auto lNodeCount = mNodes.size();
+	while (i < lNodeCount)
+	{
+		const auto& lNode = mNodes[i];
+		const auto lBounds = nodeBounds(lNode.locationCode);
+
+		// Case 1: The search volume and the node are disjoint. Skip the
+		// entire subtree.
+		if (!intersects(volume, lBounds))
+		{
+			i = lNode.skip;
+			continue;
+		}
+
+		// Case 2: The node is completely contained by the search volume.
+		// Everything in the subtree is a hit, and the entities of the
+		// subtree form one contiguous range.
+		if (volume.contains(lBounds))
+		{
+			const auto lEnd = subtreeEnd(i);
+			for (std::size_t j = lNode.firstEntity; j < lEnd; ++j)
+			{
+				f(mEntities[j]);
+			}
+			i = lNode.skip;
+			continue;
+		}
+
+		// Case 3: The search volume intersects the node. Test the entities
+		// of this node and continue with the first child.
+		const auto lEnd = lNode.firstEntity + lNode.entityCount;
+		for (std::size_t j = lNode.firstEntity; j < lEnd; ++j)
+		{
+			if (intersects(volume, mEntityBounds[j])) f(mEntities[j]);
+		}
+		++i;
+	}
+}
+
+template <class OutputIter>
+void LinearOctree::query(const box3f& volume, OutputIter iter)
+{
+	queryImpl(volume, [&iter] (Entity* entity)
+	{
+		*iter = entity->shared_from_this();
+		++iter;
+	});
+}
+
+template <class OutputIter>
+void LinearOctree::query(const box3f& volume, OutputIter iter) const
+{
+	queryImpl(volume, [&iter] (const Entity* entity)
+	{
+		*iter = entity->shared_from_this();
+		++iter;
+	});
+}
+
+template <class OutputIter, class FilterFunc>
+void LinearOctree::query(const box3f& volume, OutputIter iter, FilterFunc filter)
+{
+	queryImpl(volume, [&iter, &filter] (Entity* entity)
+	{
+		auto lEntityPtr = entity->shared_from_this();
+		if (filter(lEntityPtr))
+		{
+			*iter = std::move(lEntityPtr);
+			++iter;
+		}
+	});
+}
+
+template <class OutputIter, class FilterFunc>
+void LinearOctree::query(const box3f& volume, OutputIter iter, FilterFunc filter) const
+{
+	queryImpl(volume, [&iter, &filter] (const Entity* entity)
+	{
+		Entity::ConstSharedPtr lEntityPtr = entity->shared_from_this();
+		if (filter(lEntityPtr))
+		{
+			*iter = std::move(lEntityPtr);
+			++iter;
+		}
+	});
+}
+
+template <class OutputIter>
+void LinearOctree::getEntities(OutputIter iter)
+{
+	update();
+	for (auto* lEntity : mEntities)
+	{
+		*iter = lEntity->shared_from_this();
+		++iter;
+	}
+}
+
+template <class OutputIter>
+void LinearOctree::getEntities(OutputIter iter) const
+{
+	update();
+	for (const auto* lEntity : mEntities)
+	{
+		*iter = lEntity->shared_from_this();
+		++iter;
+	}
+}
+
+template <class Func>
+void LinearOctree::foreach(Func f)
+{
+	update();
+	for (auto* lEntity : mEntities) f(lEntity->shared_from_this());
+}
+
+template <class Func>
+void LinearOctree::foreach(Func f) const
+{
+	update();
+	for (const auto* lEntity : mEntities)
+	{
+		f(Entity::ConstSharedPtr(lEntity->shared_from_this()));
+	}
+}
+
+template <class Func>
+void LinearOctree::forEachNode(Func f) const
+{
+	update();
+	for (std::size_t i = 0; i < mNodes.size(); ++i)
+	{
+		const NodeView lView(this, i);
+		f(&lView);
+	}
+}
+
+} // namespace gintonic
@@ -6,7 +6,6 @@
 
 #pragma once
 
-#include "Foundation/ReadWriteLock.hpp"
 #include "Foundation/filesystem.hpp"
 
 #include <boost/serialization/access.hpp>
@@ -47,9 +46,6 @@ class Object : public std::enable_shared_from_this<Derived>
     /// The name of this Object.
     name_type name;
 
-    /// The ReadWriteLock for this Object.
-    ReadWriteLock readWriteLock;
-
     /// Default constructor.
     Object() = default;
 
@@ -66,48 +62,42 @@ class Object : public std::enable_shared_from_this<Derived>
     Object(name_type&& name) : name(std::move(name)) { /* Empty on purpose. */ }
 
     /**
-     * @brief Copy constructor. The ReadWriteLock is not copied along.
-     * Only the name is copied.
+     * @brief Copy constructor. Only the name is copied.
      * @param [in] other Another object.
      */
     Object(const Object& other) : name(other.name)
     {
-        /* Don't copy the ReadWriteLock */
+        /* Empty on purpose. */
     }
 
     /**
-     * @brief Move constructor. The ReadWriteLock is not moved.
-     * Only the name is moved.
+     * @brief Move constructor. Only the name is moved.
      * @param [in] other Another object.
      */
     Object(Object&& other) : name(std::move(other.name))
     {
-        /* Don't move the ReadWriteLock */
+        /* Empty on purpose. */
     }
 
     /**
-     * @brief Copy assignment operator. The ReadWriteLock is not copied.
-     * Only the name is copied.
+     * @brief Copy assignment operator. Only the name is copied.
      * @param [in] other Another object.
      * @return `*this`
      */
     Object& operator=(const Object& other)
     {
         name = other.name;
-        /* Don't copy the ReadWriteLock */
         return *this;
     }
 
     /**
-     * @brief Move assignment operator. The ReadWriteLock is not moved.
-     * Only the name is moved.
+     * @brief Move assignment operator. Only the name is moved.
      * @param [in] other Another object.
      * @return `*this`
      */
     Object& operator=(Object&& other)
     {
         name = std::move(other.name);
-        /* Don't move the ReadWriteLock */
         return *this;
     }
 
@@ -7,16 +7,30 @@
 #pragma once
 
 #include "Math/box3f.hpp"
+#include "Math/box3fSoA.hpp"
+#include "Math/frustum.hpp"
+#include "Math/ray3f.hpp"
 #include "Entity.hpp"
+#include "Foundation/SpatialStatistics.hpp"
+#include "Foundation/ThreadPool.hpp"
+#include "Foundation/allocator.hpp"
 
 #include <boost/signals2/signal.hpp>
 
-#include <list>
+#include <memory>
+#include <vector>
 
 namespace gintonic {
 
 /**
  * @brief An Octree datastructure.
+ *
+ * @details The Octree listens to the onTransformChange event of every
+ * Entity in it, but it does not relocate a moved Entity right away. It only
+ * remembers that the Entity moved. Call Octree::commitUpdates once per frame,
+ * after the entities have moved, to relocate all of them in one pass. Until
+ * then, queries see the entities where they were at the previous commit.
+ * Entities that die leave the tree immediately.
  */
 class Octree
 {
@@ -31,21 +45,33 @@ public:
 		{
 			return "EntityNotContainedInOctreeBoundingBox";
 		}
-		inline Entity::SharedPtr      getEntity()           noexcept { return mEntity; }
-		inline Entity::ConstSharedPtr getEntity()     const noexcept { return mEntity; }
+		inline Entity::SharedPtr      getEntity()           noexcept { return mEntities.front(); }
+		inline Entity::ConstSharedPtr getEntity()     const noexcept { return mEntities.front(); }
 		inline       Octree*          getOctreeNode()       noexcept { return mOctreeNode; }
 		inline const Octree*          getOctreeNode() const noexcept { return mOctreeNode; }
+
+		/// Get all entities that did not fit. The first one is getEntity.
+		inline const std::vector<Entity::SharedPtr>& getEntities() const noexcept
+		{
+			return mEntities;
+		}
 	private:
 		friend class Octree;
 		template <class A, class B>
 		EntityNotContainedInOctreeBoundingBox(A&& octree, B&& entity)
 		: mOctreeNode(std::forward<A>(octree))
-		, mEntity(std::forward<B>(entity))
+		, mEntities(1, std::forward<B>(entity))
+		{
+			/* Empty on purpose. */
+		}
+		EntityNotContainedInOctreeBoundingBox(Octree* octree, std::vector<Entity::SharedPtr>&& entities)
+		: mOctreeNode(octree)
+		, mEntities(std::move(entities))
 		{
 			/* Empty on purpose. */
 		}
 		Octree* mOctreeNode = nullptr;
-		Entity::SharedPtr mEntity = Entity::SharedPtr(nullptr);
+		std::vector<Entity::SharedPtr> mEntities;
 	};
 
 	// friend class Entity;
@@ -59,34 +85,20 @@ public:
 
 private:
 
+	// Owns the connections to the events of an Entity. A holder never moves
+	// in memory, so the event handlers refer to it directly. It knows its
+	// node and its slot in the arrays of that node.
 	struct EntityHolder
 	{
 		Entity::WeakPtr             entity;
 		boost::signals2::connection transformChangeConnection;
 		boost::signals2::connection destructConnection;
+		Octree*                     node = nullptr;
+		std::size_t                 slot = 0;
+		bool                        dirty = false;
+		std::size_t                 dirtyIndex = 0;
 
-		EntityHolder()                                = default;
-		EntityHolder(const EntityHolder&)             = default;
-		EntityHolder(EntityHolder&&)                  = default;
-		EntityHolder& operator= (const EntityHolder&) = default;
-		EntityHolder& operator= (EntityHolder&&)      = default;
 		~EntityHolder() noexcept;
-
-		template <class A>
-		EntityHolder(A&& a)
-		: entity(std::forward<A>(a))
-		{
-			/* Empty on purpose. */
-		}
-
-		template <class A, class B, class C>
-		EntityHolder(A&& a, B&& b, C&& c)
-		: entity(std::forward<A>(a))
-		, transformChangeConnection(std::forward<B>(b))
-		, destructConnection(std::forward<C>(c))
-		{
-			/* Empty on purpose. */
-		}
 	};
 
 	// static void destroyEntityHolder(EntityHolder&);
@@ -94,7 +106,22 @@ private:
 	Octree* mParent = nullptr;
 	Octree* mChild[8] = { nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr };
 	box3f mBounds;
-	std::list<EntityHolder> mEntities;
+
+	// The entities of this node in three parallel arrays. The raw pointers
+	// stay valid because an Entity leaves the tree as soon as it starts
+	// dying. The bounding boxes are cached in SoA layout, so that queries
+	// test four of them at once and never touch an Entity that misses.
+	std::vector<std::unique_ptr<EntityHolder>> mEntities;
+	std::vector<Entity*> mEntityPointers;
+	box3fSoA mEntityBounds;
+
+	// Only used by the root: the entities that moved since the last call to
+	// Octree::commitUpdates. An entry is null if its Entity left the tree.
+	std::vector<EntityHolder*> mDirtyEntities;
+
+	// Set on the nodes that lost entities during Octree::commitUpdates, and
+	// on all of their ancestors.
+	bool mNeedsPruning = false;
 
 public:
 
@@ -131,33 +158,50 @@ public:
 	
 	/**
 	 * @brief Constructor that inserts elements from a container.
-	 * @tparam ForwardIter The forward iterator type.
+	 * @details The tree is built in bulk instead of inserting the entities
+	 * one by one. The entities are sorted by the Morton code of their
+	 * center, after which the tree is built top-down. Subtrees with enough
+	 * entities are built in parallel on the global ThreadPool. The resulting
+	 * tree is identical to the one you get by inserting the entities one by
+	 * one in the same order.
+	 * @tparam ForwardIter The forward iterator type. It should dereference
+	 * to an Entity::SharedPtr.
 	 * @param b The bounding box of the Octree.
 	 * @param first Iterator pointing to the first element.
 	 * @param last Iterator pointing to one-past-the-end element.
+	 * @param subdivisionThreshold The subdivision threshold.
+	 * @throws EntityNotContainedInOctreeBoundingBox if one of the entities
+	 * does not fit in the bounding box.
 	 */
 	template <class ForwardIter> 
 	Octree(
 		const box3f& b, 
 		ForwardIter first, 
-		ForwardIter last);
+		ForwardIter last,
+		const float subdivisionThreshold = 1.0f);
 
 	// Constructor that inserts elements at construction time.
 	
 	/**
 	 * @brief Constructor that inserts elements from a container.
-	 * @tparam ForwardIter The forward iterator type.
+	 * @details See the other range constructor.
+	 * @tparam ForwardIter The forward iterator type. It should dereference
+	 * to an Entity::SharedPtr.
 	 * @param minCorner The minimum corner of the bounding box.
 	 * @param maxCorner the maximum corner of the bounding box.
 	 * @param first Iterator pointing to the first element.
 	 * @param last Iterator pointing to one-past-the-end element.
+	 * @param subdivisionThreshold The subdivision threshold.
+	 * @throws EntityNotContainedInOctreeBoundingBox if one of the entities
+	 * does not fit in the bounding box.
 	 */
 	template <class ForwardIter> 
 	Octree(
 		const vec3f& minCorner, 
 		const vec3f& maxCorner, 
 		ForwardIter first, 
-		ForwardIter last);
+		ForwardIter last,
+		const float subdivisionThreshold = 1.0f);
 
 	/**
 	 * @brief Copy constructor.
@@ -256,6 +300,25 @@ public:
 	 */
 	std::size_t count() const;
 
+	/**
+	 * @brief Get the number of entities in this node itself, excluding
+	 * its children.
+	 * @return The number of entities in this node itself.
+	 */
+	inline std::size_t entityCount() const noexcept
+	{
+		return mEntities.size();
+	}
+
+	/**
+	 * @brief Get statistics about the shape of this Octree and all of its
+	 * children.
+	 * @details Use them to tune the subdivision threshold. This method
+	 * recurses into the tree.
+	 * @return Statistics about the shape of the tree.
+	 */
+	SpatialStatistics statistics() const;
+
 	/**
 	 * @brief Get the entities of this Octree and of its children too.
 	 * @tparam OutputIter The output iterator type.
@@ -348,6 +411,195 @@ public:
 	template <class OutputIter, class FilterFunc>
 	void query(const box3f& volume, OutputIter iter, FilterFunc filter) const;
 
+	/**
+	 * @brief Query a frustum to obtain all the entities in that frustum.
+	 * @details Every node is tested only against the planes that its parent
+	 * straddles. Once a node is completely inside the frustum, all entities
+	 * of its subtree are added without any further tests. The test is
+	 * conservative, so an entity near a corner of the frustum may be
+	 * reported even though it is outside.
+	 * @param volume The frustum to fetch all entities from.
+	 * @param iter An output iterator to store the results.
+	 */
+	template <class OutputIter>
+	void query(const frustum& volume, OutputIter iter);
+
+	/**
+	 * @brief Query a frustum to obtain all the entities in that frustum.
+	 * @details This is the const version, so you'll get a container of
+	 * immutable entities.
+	 * @param volume The frustum to fetch all entities from.
+	 * @param iter An output iterator to store the results.
+	 */
+	template <class OutputIter>
+	void query(const frustum& volume, OutputIter iter) const;
+
+	/**
+	 * @brief Apply a function to every Entity in a volume.
+	 * @details This is the fast version of query: the function receives raw
+	 * pointers, so there is no reference counting and no allocation. The
+	 * pointers are only valid during the call; do not hold on to them.
+	 * @tparam Func Type of a function pointer, lambda, functor, etc. It is
+	 * called as f(Entity*).
+	 * @param volume The volume to fetch all entities from.
+	 * @param f A function pointer, lambda, functor, etc.
+	 */
+	template <class Func>
+	void visit(const box3f& volume, Func f);
+
+	/**
+	 * @brief Apply a function to every Entity in a volume, const version.
+	 * @tparam Func Type of a function pointer, lambda, functor, etc. It is
+	 * called as f(const Entity*).
+	 * @param volume The volume to fetch all entities from.
+	 * @param f A function pointer, lambda, functor, etc.
+	 */
+	template <class Func>
+	void visit(const box3f& volume, Func f) const;
+
+	/**
+	 * @brief Apply a function to every Entity in a frustum.
+	 * @details This is the fast version of query: the function receives raw
+	 * pointers, so there is no reference counting and no allocation. The
+	 * pointers are only valid during the call; do not hold on to them.
+	 * @tparam Func Type of a function pointer, lambda, functor, etc. It is
+	 * called as f(Entity*).
+	 * @param volume The frustum to fetch all entities from.
+	 * @param f A function pointer, lambda, functor, etc.
+	 */
+	template <class Func>
+	void visit(const frustum& volume, Func f);
+
+	/**
+	 * @brief Apply a function to every Entity in a frustum, const version.
+	 * @tparam Func Type of a function pointer, lambda, functor, etc. It is
+	 * called as f(const Entity*).
+	 * @param volume The frustum to fetch all entities from.
+	 * @param f A function pointer, lambda, functor, etc.
+	 */
+	template <class Func>
+	void visit(const frustum& volume, Func f) const;
+
+	/**
+	 * @brief Find the closest Entity that a ray hits.
+	 * @details The ray is tested against the global bounding boxes of the
+	 * entities. The children of every node are visited front to back along
+	 * the ray, and a child that starts beyond the closest hit found so far
+	 * is skipped together with the remaining children.
+	 * @param origin The origin of the ray.
+	 * @param direction The direction of the ray. It need not be normalized.
+	 * @param maxDistance The maximum distance along the ray.
+	 * @param distance If an Entity is hit, this is set to the distance from
+	 * the origin to the point where the ray enters its bounding box.
+	 * @return The closest Entity, or a null pointer if nothing is hit.
+	 */
+	Entity::SharedPtr raycast(
+		const vec3f& origin, 
+		const vec3f& direction, 
+		const float maxDistance, 
+		float& distance);
+
+	/**
+	 * @brief Find the closest Entity that a ray hits.
+	 * @details This is the const version, so you'll get an immutable Entity.
+	 * @param origin The origin of the ray.
+	 * @param direction The direction of the ray. It need not be normalized.
+	 * @param maxDistance The maximum distance along the ray.
+	 * @param distance If an Entity is hit, this is set to the distance from
+	 * the origin to the point where the ray enters its bounding box.
+	 * @return The closest Entity, or a null pointer if nothing is hit.
+	 */
+	Entity::ConstSharedPtr raycast(
+		const vec3f& origin, 
+		const vec3f& direction, 
+		const float maxDistance, 
+		float& distance) const;
+
+	/**
+	 * @brief Apply a function to every Entity that a ray hits.
+	 * @details The entities are passed in order of increasing distance.
+	 * @tparam Func Type of a function pointer, lambda, functor, etc. It is
+	 * called as f(Entity::SharedPtr, float distance).
+	 * @param origin The origin of the ray.
+	 * @param direction The direction of the ray. It need not be normalized.
+	 * @param maxDistance The maximum distance along the ray.
+	 * @param f A function pointer, lambda, functor, etc.
+	 */
+	template <class Func>
+	void raycastAll(
+		const vec3f& origin, 
+		const vec3f& direction, 
+		const float maxDistance, 
+		Func f);
+
+	/**
+	 * @brief Apply a function to every Entity that a ray hits, const
+	 * version.
+	 * @details The entities are passed in order of increasing distance.
+	 * @tparam Func Type of a function pointer, lambda, functor, etc. It is
+	 * called as f(Entity::ConstSharedPtr, float distance).
+	 * @param origin The origin of the ray.
+	 * @param direction The direction of the ray. It need not be normalized.
+	 * @param maxDistance The maximum distance along the ray.
+	 * @param f A function pointer, lambda, functor, etc.
+	 */
+	template <class Func>
+	void raycastAll(
+		const vec3f& origin, 
+		const vec3f& direction, 
+		const float maxDistance, 
+		Func f) const;
+
+	/**
+	 * @brief Find the entities nearest to a point.
+	 * @details The distance of an Entity is the distance from the point to
+	 * its global bounding box. The nodes are visited best-first, ordered by
+	 * the distance to their bounds. Once k entities are found, nodes that
+	 * are farther away than the k-th nearest Entity are skipped.
+	 * @tparam Func Type of a function pointer, lambda, functor, etc. It is
+	 * called as f(Entity::SharedPtr, float distance).
+	 * @param point The point to search around.
+	 * @param k The maximum number of entities.
+	 * @param f A function pointer, lambda, functor, etc. It is called at
+	 * most k times, nearest Entity first.
+	 */
+	template <class Func>
+	void nearest(const vec3f& point, const std::size_t k, Func f);
+
+	/**
+	 * @brief Find the entities nearest to a point, const version.
+	 * @details See the non-const version.
+	 * @tparam Func Type of a function pointer, lambda, functor, etc. It is
+	 * called as f(Entity::ConstSharedPtr, float distance).
+	 * @param point The point to search around.
+	 * @param k The maximum number of entities.
+	 * @param f A function pointer, lambda, functor, etc. It is called at
+	 * most k times, nearest Entity first.
+	 */
+	template <class Func>
+	void nearest(const vec3f& point, const std::size_t k, Func f) const;
+
+	/**
+	 * @brief Obtain all the entities within a distance of a point.
+	 * @details An Entity is within the radius if its global bounding box
+	 * is. Subtrees whose bounds are farther away are skipped.
+	 * @param point The center of the sphere.
+	 * @param radius The radius of the sphere.
+	 * @param iter An output iterator to store the results.
+	 */
+	template <class OutputIter>
+	void withinRadius(const vec3f& point, const float radius, OutputIter iter);
+
+	/**
+	 * @brief Obtain all the entities within a distance of a point, const
+	 * version.
+	 * @param point The center of the sphere.
+	 * @param radius The radius of the sphere.
+	 * @param iter An output iterator to store the results.
+	 */
+	template <class OutputIter>
+	void withinRadius(const vec3f& point, const float radius, OutputIter iter) const;
+
 	/**
 	 * @brief Apply a function to every Entity.
 	 * @tparam Func Type of a function pointer, lambda, functor, etc.
@@ -379,6 +631,23 @@ public:
 	 */
 	void insert(Entity::SharedPtr entity);
 
+	/**
+	 * @brief Relocate all entities that moved since the last call.
+	 * @details Every moved Entity is handled once, no matter how often it
+	 * moved. An Entity that still fits best in its current node only gets
+	 * its cached bounding box updated. The others are taken out and
+	 * inserted again in one batch, sorted by Morton code and partitioned
+	 * down the tree like the bulk constructor does, so that entities that
+	 * go to the same subtree are inserted together. Afterwards, empty
+	 * subtrees are removed. This method may be called on any node; it
+	 * always commits the whole tree.
+	 * @throws EntityNotContainedInOctreeBoundingBox if entities moved out
+	 * of the bounding box of the root. The exception lists all of them.
+	 * They are no longer part of the tree, but all other entities are
+	 * relocated.
+	 */
+	void commitUpdates();
+
 	/**
 	 * @brief Erase all weak pointer entities which are no longer valid in
 	 * this Octree node.
@@ -407,8 +676,6 @@ public:
 	 */
 	Octree* erase(Entity::SharedPtr entity);
 
-	Octree* erase(const std::list<EntityHolder>::iterator& iter);
-
 	/**
 	 * @brief Returns the root of the octree node.
 	 * @return The root of the octree node.
@@ -426,6 +693,7 @@ public:
 private:
 
 	friend class boost::serialization::access;
+	friend class OctreeImage;
 
 	Octree() = default;
 
@@ -433,11 +701,79 @@ private:
 
 	Octree(const float subdivisionThreshold, Octree* parent, const vec3f& min, const vec3f& max);
 
-	void backRecursiveInsert(std::shared_ptr<Entity>);
+	void insert(Entity::SharedPtr entity, const box3f& bounds);
+	void backRecursiveInsert(Entity::SharedPtr entity, const box3f& bounds);
+	bool isBestFitFor(const box3f& bounds) const noexcept;
+	void removeSlot(const std::size_t slot) noexcept;
+	Octree* eraseSlot(const std::size_t slot);
+	void copyFrom(const Octree& other, Octree* root);
+	void destroyChildren() noexcept;
+	void adoptChildrenAndEntities() noexcept;
 	Octree* backRecursiveDelete();
 
 	void subdivide();
 
+	void gatherStatistics(SpatialStatistics& statistics, const std::size_t depth) const;
+
+	template <class OutputIter>
+	void queryFrustum(const frustum& volume, unsigned planeMask, OutputIter iter);
+
+	template <class OutputIter>
+	void queryFrustum(const frustum& volume, unsigned planeMask, OutputIter iter) const;
+
+	using DistanceAndEntity = std::pair<float, Entity::SharedPtr>;
+	void raycastRecursive(
+		const ray3f& ray, 
+		float& maxDistance, 
+		const bool closestOnly, 
+		std::vector<DistanceAndEntity>& hits) const;
+	void raycastSorted(
+		const vec3f& origin, 
+		const vec3f& direction, 
+		const float maxDistance, 
+		std::vector<DistanceAndEntity>& hits) const;
+
+	void nearestSorted(
+		const vec3f& point, 
+		const std::size_t k, 
+		std::vector<DistanceAndEntity>& result) const;
+
+	template <class OutputIter>
+	void withinRadiusRecursive(const vec3f& point, const float radius2, OutputIter iter);
+
+	template <class OutputIter>
+	void withinRadiusRecursive(const vec3f& point, const float radius2, OutputIter iter) const;
+
+	void attach(Entity::SharedPtr entity, const box3f& bounds);
+
+	template <class Func>
+	void visitAll(Func f);
+
+	template <class Func>
+	void visitAll(Func f) const;
+
+	template <class Func>
+	void visitFrustum(const frustum& volume, unsigned planeMask, Func f);
+
+	template <class Func>
+	void visitFrustum(const frustum& volume, unsigned planeMask, Func f) const;
+
+	struct BulkItem;
+	using BulkItemVector = std::vector<BulkItem, allocator<BulkItem>>;
+	void bulkInsert(std::vector<Entity::SharedPtr> entities);
+	std::uint64_t bulkCode(const box3f& bounds) const noexcept;
+	void insertBulkItems(
+		BulkItemVector& items, 
+		const std::vector<Entity::SharedPtr>& entities);
+	void markForPruning() noexcept;
+	void prune() noexcept;
+	void bulkInsertRecursive(
+		BulkItem* items, 
+		BulkItem* scratch, 
+		const std::size_t count, 
+		const std::vector<Entity::SharedPtr>& entities, 
+		ThreadPool::TaskGroup& group);
+
 	template <class Archive> 
 	void save(Archive& archive, const unsigned version)
 	{
@@ -517,17 +853,15 @@ private:
 template <class ForwardIter>
 Octree::Octree(
 	const box3f& bounds,
-	ForwardIter first, ForwardIter last)
+	ForwardIter first, ForwardIter last,
+	const float subdivisionThreshold)
 : mBounds(bounds)
+, subdivisionThreshold(subdivisionThreshold)
 {
 	mChild[0] = mChild[1] = mChild[2] 
 		= mChild[3] = mChild[4] = mChild[5] 
 		= mChild[6] = mChild[7] = nullptr;
-	while (first != last)
-	{
-		this->insert(&(*first));
-		++first;
-	}
+	bulkInsert(std::vector<Entity::SharedPtr>(first, last));
 }
 
 template <class ForwardIter>
@@ -535,28 +869,28 @@ Octree::Octree(
 	const vec3f& minCorner, 
 	const vec3f& maxCorner, 
 	ForwardIter first, 
-	ForwardIter last)
+	ForwardIter last,
+	const float subdivisionThreshold)
 : mBounds(minCorner, maxCorner)
+, subdivisionThreshold(subdivisionThreshold)
 {
 	mChild[0] = mChild[1] = mChild[2] 
 		= mChild[3] = mChild[4] = mChild[5] 
 		= mChild[6] = mChild[7] = nullptr;
-	while (first != last)
-	{
-		this->insert(&(*first));
-		++first;
-	}
+	bulkInsert(std::vector<Entity::SharedPtr>(first, last));
 }
 
 template <class OutputIter> 
 void Octree::getEntities(OutputIter iter)
 {
+	GT_SPATIAL_COUNT(nodesVisited, 1);
 	for (auto& lHolder : mEntities)
 	{
-		if (auto lEntityPtr = lHolder.entity.lock())
+		if (auto lEntityPtr = lHolder->entity.lock())
 		{
 			*iter = lEntityPtr;
 			++iter;
+			GT_SPATIAL_COUNT(results, 1);
 		}
 	}
 	for (auto* lChildNode : mChild) if (lChildNode) lChildNode->getEntities(iter);
@@ -565,12 +899,14 @@ void Octree::getEntities(OutputIter iter)
 template <class OutputIter> 
 void Octree::getEntities(OutputIter iter) const
 {
+	GT_SPATIAL_COUNT(nodesVisited, 1);
 	for (const auto& lHolder : mEntities)
 	{
-		if (const auto lEntityPtr = lHolder.entity.lock())
+		if (const auto lEntityPtr = lHolder->entity.lock())
 		{
 			*iter = lEntityPtr;
 			++iter;
+			GT_SPATIAL_COUNT(results, 1);
 		}
 	}
 	for (const auto* lChildNode : mChild) if (lChildNode) lChildNode->getEntities(iter);
@@ -579,14 +915,16 @@ void Octree::getEntities(OutputIter iter) const
 template <class OutputIter, class FilterFunc> 
 void Octree::getEntities(OutputIter iter, FilterFunc filter)
 {
+	GT_SPATIAL_COUNT(nodesVisited, 1);
 	for (auto& lHolder : mEntities)
 	{
-		if (auto lEntityPtr = lHolder.entity.lock())
+		if (auto lEntityPtr = lHolder->entity.lock())
 		{
 			if (filter(lEntityPtr))
 			{
 				*iter = lEntityPtr;
 				++iter;
+				GT_SPATIAL_COUNT(results, 1);
 			}
 
 		}
@@ -597,14 +935,16 @@ void Octree::getEntities(OutputIter iter, FilterFunc filter)
 template <class OutputIter, class FilterFunc>
 void Octree::getEntities(OutputIter iter, FilterFunc filter) const
 {
+	GT_SPATIAL_COUNT(nodesVisited, 1);
 	for (const auto& lHolder : mEntities)
 	{
-		if (std::shared_ptr<const Entity> lEntityPtr = lHolder.entity.lock())
+		if (std::shared_ptr<const Entity> lEntityPtr = lHolder->entity.lock())
 		{
 			if (filter(lEntityPtr))
 			{
 				*iter = lEntityPtr;
 				++iter;
+				GT_SPATIAL_COUNT(results, 1);
 			}
 
 		}
@@ -616,18 +956,18 @@ void Octree::getEntities(OutputIter iter, FilterFunc filter) const
 template <class OutputIter>
 void Octree::query(const box3f& volume, OutputIter iter)
 {
-	// PRINT_VAR(this);
-	for (auto& lHolder : mEntities)
+	GT_SPATIAL_COUNT(nodesVisited, 1);
+	GT_SPATIAL_COUNT(boxesTested, mEntities.size());
+	// Only the entities whose cached bounds intersect are ever locked.
+	mEntityBounds.intersecting(volume, [this, &iter] (const std::size_t i)
 	{
-		if (auto lEntityPtr = lHolder.entity.lock())
+		if (auto lEntityPtr = mEntities[i]->entity.lock())
 		{
-			if (intersects(volume, lEntityPtr->globalBoundingBox()))
-			{
-				*iter = std::move(lEntityPtr);
-				++iter;
-			}
+			*iter = std::move(lEntityPtr);
+			++iter;
+			GT_SPATIAL_COUNT(results, 1);
 		}
-	}
+	});
 	if (mAllocationPlace == nullptr) return;
 	for (auto* lChildNode : mChild)
 	{
@@ -705,18 +1045,17 @@ void Octree::query(const box3f& volume, OutputIter iter)
 template <class OutputIter>
 void Octree::query(const box3f& volume, OutputIter iter) const
 {
-	for (const auto& lHolder : mEntities)
+	GT_SPATIAL_COUNT(nodesVisited, 1);
+	GT_SPATIAL_COUNT(boxesTested, mEntities.size());
+	mEntityBounds.intersecting(volume, [this, &iter] (const std::size_t i)
 	{
-		if (std::shared_ptr<const Entity> lEntityPtr = lHolder.entity.lock())
+		if (std::shared_ptr<const Entity> lEntityPtr = mEntities[i]->entity.lock())
 		{
-			if (intersects(volume, lEntityPtr->globalBoundingBox()))
-			{
-				*iter = std::move(lEntityPtr);
-				++iter;
-			}
+			*iter = std::move(lEntityPtr);
+			++iter;
+			GT_SPATIAL_COUNT(results, 1);
 		}
-
-	}
+	});
 	if (mAllocationPlace == nullptr) return;
 	for (const auto* lChildNode : mChild)
 	{
@@ -742,21 +1081,20 @@ void Octree::query(const box3f& volume, OutputIter iter) const
 template <class OutputIter, class FilterFunc>
 void Octree::query(const box3f& volume, OutputIter iter, FilterFunc filter)
 {
-	for (auto& lHolder : mEntities)
+	GT_SPATIAL_COUNT(nodesVisited, 1);
+	GT_SPATIAL_COUNT(boxesTested, mEntities.size());
+	mEntityBounds.intersecting(volume, [this, &iter, &filter] (const std::size_t i)
 	{
-		if (auto lEntityPtr = lHolder.entity.lock())
+		if (auto lEntityPtr = mEntities[i]->entity.lock())
 		{
-			if (intersects(volume, lEntityPtr->globalBoundingBox()))
+			if (filter(lEntityPtr))
 			{
-				if (filter(lEntityPtr))
-				{
-					*iter = std::move(lEntityPtr);
-					++iter;
-				}
-
+				*iter = std::move(lEntityPtr);
+				++iter;
+				GT_SPATIAL_COUNT(results, 1);
 			}
 		}
-	}
+	});
 	if (mAllocationPlace == nullptr) return;
 	for (auto* lChildNode : mChild)
 	{
@@ -782,21 +1120,20 @@ void Octree::query(const box3f& volume, OutputIter iter, FilterFunc filter)
 template <class OutputIter, class FilterFunc>
 void Octree::query(const box3f& volume, OutputIter iter, FilterFunc filter) const
 {
-	for (const auto& lHolder : mEntities)
+	GT_SPATIAL_COUNT(nodesVisited, 1);
+	GT_SPATIAL_COUNT(boxesTested, mEntities.size());
+	mEntityBounds.intersecting(volume, [this, &iter, &filter] (const std::size_t i)
 	{
-		if (std::shared_ptr<const Entity> lEntityPtr = lHolder.entity.lock())
+		if (std::shared_ptr<const Entity> lEntityPtr = mEntities[i]->entity.lock())
 		{
-			if (intersects(volume, lEntityPtr->globalBoundingBox()))
+			if (filter(lEntityPtr))
 			{
-				if (filter(lEntityPtr))
-				{
-					*iter = std::move(lEntityPtr);
-					++iter;
-				}
-
+				*iter = std::move(lEntityPtr);
+				++iter;
+				GT_SPATIAL_COUNT(results, 1);
 			}
 		}
-	}
+	});
 	if (mAllocationPlace == nullptr) return;
 	for (const auto* lChildNode : mChild)
 	{
@@ -819,10 +1156,325 @@ void Octree::query(const box3f& volume, OutputIter iter, FilterFunc filter) cons
 	}
 }
 
+template <class OutputIter>
+void Octree::query(const frustum& volume, OutputIter iter)
+{
+	queryFrustum(volume, frustum::kAllPlanes, iter);
+}
+
+template <class OutputIter>
+void Octree::query(const frustum& volume, OutputIter iter) const
+{
+	queryFrustum(volume, frustum::kAllPlanes, iter);
+}
+
+template <class OutputIter>
+void Octree::queryFrustum(const frustum& volume, unsigned planeMask, OutputIter iter)
+{
+	switch (volume.classify(mBounds, planeMask))
+	{
+		case frustum::kOutside:
+			GT_SPATIAL_COUNT(nodesVisited, 1);
+			return;
+		case frustum::kInside:
+			// The whole subtree is visible.
+			getEntities(iter);
+			return;
+		default:
+			break;
+	}
+	GT_SPATIAL_COUNT(nodesVisited, 1);
+	GT_SPATIAL_COUNT(boxesTested, mEntities.size());
+	mEntityBounds.intersecting(volume, planeMask, [this, &iter] (const std::size_t i)
+	{
+		if (auto lEntityPtr = mEntities[i]->entity.lock())
+		{
+			*iter = std::move(lEntityPtr);
+			++iter;
+			GT_SPATIAL_COUNT(results, 1);
+		}
+	});
+	if (mAllocationPlace == nullptr) return;
+	for (auto* lChildNode : mChild) lChildNode->queryFrustum(volume, planeMask, iter);
+}
+
+template <class OutputIter>
+void Octree::queryFrustum(const frustum& volume, unsigned planeMask, OutputIter iter) const
+{
+	switch (volume.classify(mBounds, planeMask))
+	{
+		case frustum::kOutside:
+			GT_SPATIAL_COUNT(nodesVisited, 1);
+			return;
+		case frustum::kInside:
+			getEntities(iter);
+			return;
+		default:
+			break;
+	}
+	GT_SPATIAL_COUNT(nodesVisited, 1);
+	GT_SPATIAL_COUNT(boxesTested, mEntities.size());
+	mEntityBounds.intersecting(volume, planeMask, [this, &iter] (const std::size_t i)
+	{
+		if (std::shared_ptr<const Entity> lEntityPtr = mEntities[i]->entity.lock())
+		{
+			*iter = std::move(lEntityPtr);
+			++iter;
+			GT_SPATIAL_COUNT(results, 1);
+		}
+	});
+	if (mAllocationPlace == nullptr) return;
+	for (const auto* lChildNode : mChild) lChildNode->queryFrustum(volume, planeMask, iter);
+}
+
+template <class Func>
+void Octree::raycastAll(
+	const vec3f& origin, 
+	const vec3f& direction, 
+	const float maxDistance, 
+	Func f)
+{
+	std::vector<DistanceAndEntity> lHits;
+	raycastSorted(origin, direction, maxDistance, lHits);
+	for (auto& lHit : lHits) f(std::move(lHit.second), lHit.first);
+}
+
+template <class Func>
+void Octree::raycastAll(
+	const vec3f& origin, 
+	const vec3f& direction, 
+	const float maxDistance, 
+	Func f) const
+{
+	std::vector<DistanceAndEntity> lHits;
+	raycastSorted(origin, direction, maxDistance, lHits);
+	for (auto& lHit : lHits) f(Entity::ConstSharedPtr(std::move(lHit.second)), lHit.first);
+}
+
+template <class Func>
+void Octree::nearest(const vec3f& point, const std::size_t k, Func f)
+{
+	std::vector<DistanceAndEntity> lResult;
+	nearestSorted(point, k, lResult);
+	for (auto& lPair : lResult) f(std::move(lPair.second), lPair.first);
+}
+
+template <class Func>
+void Octree::nearest(const vec3f& point, const std::size_t k, Func f) const
+{
+	std::vector<DistanceAndEntity> lResult;
+	nearestSorted(point, k, lResult);
+	for (auto& lPair : lResult) f(Entity::ConstSharedPtr(std::move(lPair.second)), lPair.first);
+}
+
+template <class OutputIter>
+void Octree::withinRadius(const vec3f& point, const float radius, OutputIter iter)
+{
+	withinRadiusRecursive(point, radius * radius, iter);
+}
+
+template <class OutputIter>
+void Octree::withinRadius(const vec3f& point, const float radius, OutputIter iter) const
+{
+	withinRadiusRecursive(point, radius * radius, iter);
+}
+
+template <class OutputIter>
+void Octree::withinRadiusRecursive(const vec3f& point, const float radius2, OutputIter iter)
+{
+	GT_SPATIAL_COUNT(nodesVisited, 1);
+	GT_SPATIAL_COUNT(boxesTested, mEntities.size());
+	for (std::size_t i = 0; i < mEntities.size(); ++i)
+	{
+		if (distance2(mEntityBounds.get(i), point) > radius2) continue;
+		if (auto lEntityPtr = mEntities[i]->entity.lock())
+		{
+			*iter = std::move(lEntityPtr);
+			++iter;
+			GT_SPATIAL_COUNT(results, 1);
+		}
+	}
+	if (mAllocationPlace == nullptr) return;
+	for (auto* lChildNode : mChild)
+	{
+		if (lChildNode->isLeaf() && lChildNode->hasNoEntities()) continue;
+		if (distance2(lChildNode->mBounds, point) <= radius2)
+		{
+			lChildNode->withinRadiusRecursive(point, radius2, iter);
+		}
+	}
+}
+
+template <class OutputIter>
+void Octree::withinRadiusRecursive(const vec3f& point, const float radius2, OutputIter iter) const
+{
+	GT_SPATIAL_COUNT(nodesVisited, 1);
+	GT_SPATIAL_COUNT(boxesTested, mEntities.size());
+	for (std::size_t i = 0; i < mEntities.size(); ++i)
+	{
+		if (distance2(mEntityBounds.get(i), point) > radius2) continue;
+		if (std::shared_ptr<const Entity> lEntityPtr = mEntities[i]->entity.lock())
+		{
+			*iter = std::move(lEntityPtr);
+			++iter;
+			GT_SPATIAL_COUNT(results, 1);
+		}
+	}
+	if (mAllocationPlace == nullptr) return;
+	for (const auto* lChildNode : mChild)
+	{
+		if (lChildNode->isLeaf() && lChildNode->hasNoEntities()) continue;
+		if (distance2(lChildNode->mBounds, point) <= radius2)
+		{
+			lChildNode->withinRadiusRecursive(point, radius2, iter);
+		}
+	}
+}
+
+template <class Func>
+void Octree::visit(const box3f& volume, Func f)
+{
+	GT_SPATIAL_COUNT(nodesVisited, 1);
+	GT_SPATIAL_COUNT(boxesTested, mEntities.size());
+	mEntityBounds.intersecting(volume, [this, &f] (const std::size_t i)
+	{
+		f(mEntityPointers[i]);
+		GT_SPATIAL_COUNT(results, 1);
+	});
+	if (mAllocationPlace == nullptr) return;
+	for (auto* lChildNode : mChild)
+	{
+		if (lChildNode->mBounds.contains(volume))
+		{
+			lChildNode->visit(volume, f);
+			break;
+		}
+		else if (volume.contains(lChildNode->mBounds))
+		{
+			lChildNode->visitAll(f);
+		}
+		else if (intersects(volume, lChildNode->mBounds))
+		{
+			lChildNode->visit(volume, f);
+		}
+	}
+}
+
+template <class Func>
+void Octree::visit(const box3f& volume, Func f) const
+{
+	GT_SPATIAL_COUNT(nodesVisited, 1);
+	GT_SPATIAL_COUNT(boxesTested, mEntities.size());
+	mEntityBounds.intersecting(volume, [this, &f] (const std::size_t i)
+	{
+		f(static_cast<const Entity*>(mEntityPointers[i]));
+		GT_SPATIAL_COUNT(results, 1);
+	});
+	if (mAllocationPlace == nullptr) return;
+	for (const auto* lChildNode : mChild)
+	{
+		if (lChildNode->mBounds.contains(volume))
+		{
+			lChildNode->visit(volume, f);
+			break;
+		}
+		else if (volume.contains(lChildNode->mBounds))
+		{
+			lChildNode->visitAll(f);
+		}
+		else if (intersects(volume, lChildNode->mBounds))
+		{
+			lChildNode->visit(volume, f);
+		}
+	}
+}
+
+template <class Func>
+void Octree::visit(const frustum& volume, Func f)
+{
+	visitFrustum(volume, frustum::kAllPlanes, f);
+}
+
+template <class Func>
+void Octree::visit(const frustum& volume, Func f) const
+{
+	visitFrustum(volume, frustum::kAllPlanes, f);
+}
+
+template <class Func>
+void Octree::visitFrustum(const frustum& volume, unsigned planeMask, Func f)
+{
+	switch (volume.classify(mBounds, planeMask))
+	{
+		case frustum::kOutside:
+			GT_SPATIAL_COUNT(nodesVisited, 1);
+			return;
+		case frustum::kInside:
+			visitAll(f);
+			return;
+		default:
+			break;
+	}
+	GT_SPATIAL_COUNT(nodesVisited, 1);
+	GT_SPATIAL_COUNT(boxesTested, mEntities.size());
+	mEntityBounds.intersecting(volume, planeMask, [this, &f] (const std::size_t i)
+	{
+		f(mEntityPointers[i]);
+		GT_SPATIAL_COUNT(results, 1);
+	});
+	if (mAllocationPlace == nullptr) return;
+	for (auto* lChildNode : mChild) lChildNode->visitFrustum(volume, planeMask, f);
+}
+
+template <class Func>
+void Octree::visitFrustum(const frustum& volume, unsigned planeMask, Func f) const
+{
+	switch (volume.classify(mBounds, planeMask))
+	{
+		case frustum::kOutside:
+			GT_SPATIAL_COUNT(nodesVisited, 1);
+			return;
+		case frustum::kInside:
+			visitAll(f);
+			return;
+		default:
+			break;
+	}
+	GT_SPATIAL_COUNT(nodesVisited, 1);
+	GT_SPATIAL_COUNT(boxesTested, mEntities.size());
+	mEntityBounds.intersecting(volume, planeMask, [this, &f] (const std::size_t i)
+	{
+		f(static_cast<const Entity*>(mEntityPointers[i]));
+		GT_SPATIAL_COUNT(results, 1);
+	});
+	if (mAllocationPlace == nullptr) return;
+	for (const auto* lChildNode : mChild) lChildNode->visitFrustum(volume, planeMask, f);
+}
+
+template <class Func>
+void Octree::visitAll(Func f)
+{
+	GT_SPATIAL_COUNT(nodesVisited, 1);
+	GT_SPATIAL_COUNT(results, mEntityPointers.size());
+	for (auto* lEntity : mEntityPointers) f(lEntity);
+	if (mAllocationPlace == nullptr) return;
+	for (auto* lChildNode : mChild) lChildNode->visitAll(f);
+}
+
+template <class Func>
+void Octree::visitAll(Func f) const
+{
+	GT_SPATIAL_COUNT(nodesVisited, 1);
+	GT_SPATIAL_COUNT(results, mEntityPointers.size());
+	for (const auto* lEntity : mEntityPointers) f(lEntity);
+	if (mAllocationPlace == nullptr) return;
+	for (const auto* lChildNode : mChild) lChildNode->visitAll(f);
+}
+
 template <class Func> 
 void Octree::foreach(Func f)
 {
-	for (auto& o : mEntities) if (auto ptr = o.entity.lock()) f(ptr);
+	for (auto& o : mEntities) if (auto ptr = o->entity.lock()) f(ptr);
 	if (mAllocationPlace == nullptr) return;
 	for (auto* c : mChild) if (c) c->foreach(f);
 }
@@ -830,7 +1482,7 @@ void Octree::foreach(Func f)
 template <class Func>
 void Octree::foreach(Func f) const
 {
-	for (const auto& o : mEntities) if (const auto ptr = o.entity.lock()) f(ptr);
+	for (const auto& o : mEntities) if (const auto ptr = o->entity.lock()) f(ptr);
 	if (mAllocationPlace == nullptr) return;
 	for (const auto* c : mChild) if (c) c->foreach(f);
 }
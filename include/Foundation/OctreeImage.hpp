@@ -0,0 +1,423 @@
+/**
+ * @file OctreeImage.hpp
+ * @brief Defines a flat binary image of an Octree that can be queried
+ * in place.
+ * @author Raoul Wols
+ */
+
+#pragma once
+
+#include "Octree.hpp"
+
+#include <boost/filesystem/path.hpp>
+
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <queue>
+
+namespace gintonic {
+
+/**
+ * @brief A read-only view of an Octree that lives in one contiguous block
+ * of memory.
+ *
+ * @details OctreeImage::write turns an Octree into an image: a header,
+ * the array of nodes and the array of entities. The nodes are stored in
+ * breadth-first order, so that the eight children of a node are adjacent.
+ * A node refers to its first child and to its range of entities by index.
+ * Consequently, the image contains no pointers and can be placed anywhere
+ * in memory. An Entity is stored as its bounding box and a 32-bit index
+ * that the caller of OctreeImage::write chooses, for instance an index
+ * into the list of entities of a level.
+ *
+ * An OctreeImage either views memory that someone else owns, or maps a
+ * file into memory. Opening an image only checks the header; there is no
+ * parsing and no allocation, and the mapped pages are shared between all
+ * processes that map the same file. Queries return the indices of the
+ * entities and allocate nothing either.
+ *
+ * The image uses the byte order of the machine that wrote it. An image
+ * with a different byte order is rejected. Apart from the header and the
+ * size, the contents of an image are trusted, so only open images that
+ * OctreeImage::write produced.
+ */
+class OctreeImage
+{
+public:
+
+	/// The header at the start of every image.
+	struct Header
+	{
+		/// Always "GTOCTREE".
+		char magic[8];
+
+		/// The version of the image format.
+		std::uint32_t version;
+
+		/// The number 0x01020304 in the byte order of the writer.
+		std::uint32_t byteOrder;
+
+		/// The number of nodes.
+		std::uint32_t nodeCount;
+
+		/// The number of entities.
+		std::uint32_t entityCount;
+
+		/// The subdivision threshold of the Octree that was written.
+		float subdivisionThreshold;
+
+		/// Always zero.
+		std::uint32_t reserved;
+	};
+
+	/// A node of the image.
+	struct Node
+	{
+		/// The minimum corner of the bounds of the node.
+		float minCorner[3];
+
+		/// The maximum corner of the bounds of the node.
+		float maxCorner[3];
+
+		/// The index of the first of the eight children, or zero for a leaf.
+		std::uint32_t firstChild;
+
+		/// The index of the first Entity of the node.
+		std::uint32_t firstEntity;
+
+		/// The number of entities of the node.
+		std::uint32_t entityCount;
+
+		/// Always zero.
+		std::uint32_t reserved;
+
+		/**
+		 * @brief Get the bounds of the node.
+		 * @return The bounds of the node.
+		 */
+		inline box3f bounds() const noexcept
+		{
+			return box3f(
+				vec3f(minCorner[0], minCorner[1], minCorner[2]),
+				vec3f(maxCorner[0], maxCorner[1], maxCorner[2]));
+		}
+	};
+
+	/// An Entity of the image.
+	struct EntityRecord
+	{
+		/// The minimum corner of the bounds of the Entity.
+		float minCorner[3];
+
+		/// The maximum corner of the bounds of the Entity.
+		float maxCorner[3];
+
+		/// The index that was given to OctreeImage::write.
+		std::uint32_t index;
+
+		/// Always zero.
+		std::uint32_t reserved;
+
+		/**
+		 * @brief Get the bounds of the Entity.
+		 * @return The bounds of the Entity.
+		 */
+		inline box3f bounds() const noexcept
+		{
+			return box3f(
+				vec3f(minCorner[0], minCorner[1], minCorner[2]),
+				vec3f(maxCorner[0], maxCorner[1], maxCorner[2]));
+		}
+	};
+
+	/// The current version of the image format.
+	static constexpr std::uint32_t kVersion = 1;
+
+	/**
+	 * @brief Write an image of an Octree.
+	 * @details The whole tree is written, also when tree is not the root.
+	 * The bounds of the entities are the bounds as of the last call to
+	 * Octree::commitUpdates.
+	 * @tparam Func Type of a function pointer, lambda, functor, etc. It is
+	 * called with a const reference to every Entity and must return its
+	 * index as an std::uint32_t.
+	 * @param tree The Octree.
+	 * @param os The output stream. Open it in binary mode.
+	 * @param entityIndex A function pointer, lambda, functor, etc.
+	 */
+	template <class Func>
+	static void write(const Octree& tree, std::ostream& os, Func entityIndex);
+
+	/**
+	 * @brief Get the number of bytes of the image of an Octree.
+	 * @param tree The Octree.
+	 * @return The number of bytes that OctreeImage::write writes.
+	 */
+	static std::size_t imageSize(const Octree& tree) noexcept;
+
+	/**
+	 * @brief View an image in memory.
+	 * @details The memory must stay valid for as long as this object (and
+	 * every object that it is moved into) exists.
+	 * @param data The start of the image. It must be aligned to four bytes.
+	 * @param size The size of the memory block in bytes.
+	 * @throws exception if the memory block does not contain a valid image.
+	 */
+	OctreeImage(const void* data, const std::size_t size);
+
+	/**
+	 * @brief Map an image file into memory.
+	 * @param filename The file that OctreeImage::write wrote to.
+	 * @throws exception if the file does not contain a valid image.
+	 * @throws boost::interprocess::interprocess_exception if the file
+	 * cannot be mapped.
+	 */
+	explicit OctreeImage(const boost::filesystem::path& filename);
+
+	/// Move constructor.
+	OctreeImage(OctreeImage&&) noexcept;
+
+	/// Move assignment operator.
+	OctreeImage& operator=(OctreeImage&&) noexcept;
+
+	/// Destructor unmaps the file, if any.
+	~OctreeImage() noexcept;
+
+	/**
+	 * @brief Get the bounds of the root node.
+	 * @return The bounds of the root node.
+	 */
+	inline box3f bounds() const noexcept
+	{
+		return mNodes[0].bounds();
+	}
+
+	/**
+	 * @brief Get the subdivision threshold of the Octree that was written.
+	 * @return The subdivision threshold.
+	 */
+	inline float subdivisionThreshold() const noexcept
+	{
+		return mHeader->subdivisionThreshold;
+	}
+
+	/**
+	 * @brief Get the number of nodes.
+	 * @return The number of nodes.
+	 */
+	inline std::size_t nodeCount() const noexcept
+	{
+		return mHeader->nodeCount;
+	}
+
+	/**
+	 * @brief Get the number of entities.
+	 * @return The number of entities.
+	 */
+	inline std::size_t count() const noexcept
+	{
+		return mHeader->entityCount;
+	}
+
+	/**
+	 * @brief Get the array of nodes. The root node comes first.
+	 * @return The array of nodes.
+	 */
+	inline const Node* nodes() const noexcept
+	{
+		return mNodes;
+	}
+
+	/**
+	 * @brief Get the array of entities.
+	 * @return The array of entities.
+	 */
+	inline const EntityRecord* entities() const noexcept
+	{
+		return mEntities;
+	}
+
+	/**
+	 * @brief Query for entities that intersect a volume.
+	 * @tparam OutputIter Output iterator type. It is assigned the index of
+	 * every Entity, as an std::uint32_t.
+	 * @param volume The volume.
+	 * @param iter An output iterator.
+	 */
+	template <class OutputIter>
+	void query(const box3f& volume, OutputIter iter) const;
+
+	/**
+	 * @brief Query for entities that are not outside a frustum.
+	 * @details The test is conservative in the same way as
+	 * Octree::query(const frustum&, OutputIter).
+	 * @tparam OutputIter Output iterator type. It is assigned the index of
+	 * every Entity, as an std::uint32_t.
+	 * @param volume The frustum.
+	 * @param iter An output iterator.
+	 */
+	template <class OutputIter>
+	void query(const frustum& volume, OutputIter iter) const;
+
+private:
+
+	struct Mapping;
+
+	std::unique_ptr<Mapping> mMapping;
+	const Header* mHeader;
+	const Node* mNodes;
+	const EntityRecord* mEntities;
+
+	void view(const void* data, const std::size_t size);
+
+	static void writeHeader(const Octree& root, std::ostream& os);
+	static void writeNode(const Node& node, std::ostream& os);
+	static void writeEntity(const box3f& bounds, const std::uint32_t index, std::ostream& os);
+
+	template <class OutputIter>
+	void queryRecursive(const Node& node, const box3f& volume, OutputIter& iter) const;
+
+	template <class OutputIter>
+	void queryRecursive(const Node& node, const frustum& volume, unsigned planeMask, OutputIter& iter) const;
+
+	template <class OutputIter>
+	void queryAll(const Node& node, OutputIter& iter) const;
+};
+
+template <class Func>
+void OctreeImage::write(const Octree& tree, std::ostream& os, Func entityIndex)
+{
+	const auto* lRoot = tree.getRoot();
+	writeHeader(*lRoot, os);
+
+	// The nodes in breadth-first order. The children of a node are pushed
+	// together, so they end up adjacent.
+	std::queue<const Octree*> lQueue;
+	lQueue.push(lRoot);
+	std::uint32_t lNextNode = 1;
+	std::uint32_t lNextEntity = 0;
+	while (!lQueue.empty())
+	{
+		const auto* lNode = lQueue.front();
+		lQueue.pop();
+		Node lImageNode;
+		const auto& lBounds = lNode->mBounds;
+		lImageNode.minCorner[0] = lBounds.minCorner.x;
+		lImageNode.minCorner[1] = lBounds.minCorner.y;
+		lImageNode.minCorner[2] = lBounds.minCorner.z;
+		lImageNode.maxCorner[0] = lBounds.maxCorner.x;
+		lImageNode.maxCorner[1] = lBounds.maxCorner.y;
+		lImageNode.maxCorner[2] = lBounds.maxCorner.z;
+		lImageNode.firstChild = 0;
+		lImageNode.firstEntity = lNextEntity;
+		lImageNode.entityCount = static_cast<std::uint32_t>(lNode->mEntities.size());
+		lImageNode.reserved = 0;
+		if (!lNode->isLeaf())
+		{
+			lImageNode.firstChild = lNextNode;
+			lNextNode += 8;
+			for (const auto* lChildNode : lNode->mChild) lQueue.push(lChildNode);
+		}
+		lNextEntity += lImageNode.entityCount;
+		writeNode(lImageNode, os);
+	}
+
+	// The entities in the same order as the nodes.
+	lQueue.push(lRoot);
+	while (!lQueue.empty())
+	{
+		const auto* lNode = lQueue.front();
+		lQueue.pop();
+		for (std::size_t i = 0; i < lNode->mEntities.size(); ++i)
+		{
+			const Entity& lEntity = *lNode->mEntityPointers[i];
+			const auto lIndex = static_cast<std::uint32_t>(entityIndex(lEntity));
+			writeEntity(lNode->mEntityBounds.get(i), lIndex, os);
+		}
+		if (!lNode->isLeaf())
+		{
+			for (const auto* lChildNode : lNode->mChild) lQueue.push(lChildNode);
+		}
+	}
+}
+
+template <class OutputIter>
+void OctreeImage::query(const box3f& volume, OutputIter iter) const
+{
+	queryRecursive(mNodes[0], volume, iter);
+}
+
+template <class OutputIter>
+void OctreeImage::query(const frustum& volume, OutputIter iter) const
+{
+	queryRecursive(mNodes[0], volume, frustum::kAllPlanes, iter);
+}
+
+template <class OutputIter>
+void OctreeImage::queryRecursive(const Node& node, const box3f& volume, OutputIter& iter) const
+{
+	if (!intersects(node.bounds(), volume)) return;
+	const auto* lEntity = mEntities + node.firstEntity;
+	for (const auto* lLast = lEntity + node.entityCount; lEntity != lLast; ++lEntity)
+	{
+		if (intersects(lEntity->bounds(), volume))
+		{
+			*iter = lEntity->index;
+			++iter;
+		}
+	}
+	if (node.firstChild == 0) return;
+	for (std::uint32_t c = 0; c < 8; ++c)
+	{
+		queryRecursive(mNodes[node.firstChild + c], volume, iter);
+	}
+}
+
+template <class OutputIter>
+void OctreeImage::queryRecursive(const Node& node, const frustum& volume, unsigned planeMask, OutputIter& iter) const
+{
+	switch (volume.classify(node.bounds(), planeMask))
+	{
+		case frustum::kOutside:
+			return;
+		case frustum::kInside:
+			queryAll(node, iter);
+			return;
+		default:
+			break;
+	}
+	const auto* lEntity = mEntities + node.firstEntity;
+	for (const auto* lLast = lEntity + node.entityCount; lEntity != lLast; ++lEntity)
+	{
+		auto lEntityMask = planeMask;
+		if (volume.classify(lEntity->bounds(), lEntityMask) != frustum::kOutside)
+		{
+			*iter = lEntity->index;
+			++iter;
+		}
+	}
+	if (node.firstChild == 0) return;
+	for (std::uint32_t c = 0; c < 8; ++c)
+	{
+		queryRecursive(mNodes[node.firstChild + c], volume, planeMask, iter);
+	}
+}
+
+template <class OutputIter>
+void OctreeImage::queryAll(const Node& node, OutputIter& iter) const
+{
+	const auto* lEntity = mEntities + node.firstEntity;
+	for (const auto* lLast = lEntity + node.entityCount; lEntity != lLast; ++lEntity)
+	{
+		*iter = lEntity->index;
+		++iter;
+	}
+	if (node.firstChild == 0) return;
+	for (std::uint32_t c = 0; c < 8; ++c)
+	{
+		queryAll(mNodes[node.firstChild + c], iter);
+	}
+}
+
+} // namespace gintonic
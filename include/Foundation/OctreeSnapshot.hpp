@@ -0,0 +1,151 @@
+/**
+ * @file OctreeSnapshot.hpp
+ * @brief Defines an immutable snapshot of an Octree that may be queried
+ * from any thread.
+ * @author Raoul Wols
+ */
+
+#pragma once
+
+#include "OctreeImage.hpp"
+#include "SnapshotPublisher.hpp"
+
+#include <vector>
+
+namespace gintonic {
+
+/**
+ * @brief An immutable copy of an Octree that may be queried from any
+ * thread.
+ *
+ * @details The snapshot stores the tree as an OctreeImage in one block of
+ * memory, together with a weak pointer to every Entity. Queries see the
+ * bounding boxes of the entities at the time the snapshot was taken, so
+ * moving entities on the main thread does not affect readers. Entities that
+ * died since then are skipped.
+ *
+ * Together with SnapshotPublisher, this lets worker threads run spatial
+ * queries while the main thread moves entities:
+ *
+ * @code
+ * // Main thread, once per frame.
+ * lTree.commitUpdates();
+ * lPublisher.publish(std::unique_ptr<const OctreeSnapshot>(new OctreeSnapshot(lTree)));
+ *
+ * // Any thread.
+ * const auto lSnapshot = lPublisher.read();
+ * lSnapshot->query(lFrustum, std::back_inserter(lVisible));
+ * @endcode
+ *
+ * The Entity pointers that a query returns are const, but an Entity is not
+ * thread-safe by itself. Do not read its mutable state from a worker
+ * thread while the main thread changes it.
+ */
+class OctreeSnapshot
+{
+public:
+
+	/// The publisher type for Octree snapshots.
+	using Publisher = SnapshotPublisher<OctreeSnapshot>;
+
+	/**
+	 * @brief Take a snapshot of an Octree.
+	 * @details The whole tree is copied, also when tree is not the root.
+	 * Call Octree::commitUpdates first to include the latest movements.
+	 * @param tree The Octree.
+	 */
+	explicit OctreeSnapshot(const Octree& tree);
+
+	OctreeSnapshot(const OctreeSnapshot&) = delete;
+	OctreeSnapshot& operator=(const OctreeSnapshot&) = delete;
+
+	/**
+	 * @brief Get the image of the tree.
+	 * @details The indices in the image are indices for
+	 * OctreeSnapshot::entity.
+	 * @return The image of the tree.
+	 */
+	inline const OctreeImage& image() const noexcept
+	{
+		return mImage;
+	}
+
+	/**
+	 * @brief Get the number of entities at the time of the snapshot.
+	 * @return The number of entities.
+	 */
+	inline std::size_t count() const noexcept
+	{
+		return mEntities.size();
+	}
+
+	/**
+	 * @brief Get an Entity by its index in the image.
+	 * @param index The index of the Entity.
+	 * @return The Entity, or nullptr if it died.
+	 */
+	inline Entity::ConstSharedPtr entity(const std::uint32_t index) const noexcept
+	{
+		return mEntities[index].lock();
+	}
+
+	/**
+	 * @brief Query for entities that intersect a volume.
+	 * @tparam OutputIter Output iterator type for Entity::ConstSharedPtr.
+	 * @param volume The volume.
+	 * @param iter An output iterator.
+	 */
+	template <class OutputIter>
+	void query(const box3f& volume, OutputIter iter) const
+	{
+		mImage.query(volume, EntityInserter<OutputIter>(mEntities, iter));
+	}
+
+	/**
+	 * @brief Query for entities that are not outside a frustum.
+	 * @tparam OutputIter Output iterator type for Entity::ConstSharedPtr.
+	 * @param volume The frustum.
+	 * @param iter An output iterator.
+	 */
+	template <class OutputIter>
+	void query(const frustum& volume, OutputIter iter) const
+	{
+		mImage.query(volume, EntityInserter<OutputIter>(mEntities, iter));
+	}
+
+private:
+
+	std::vector<Entity::ConstWeakPtr> mEntities;
+	std::vector<std::uint32_t> mStorage;
+	OctreeImage mImage;
+
+	static std::vector<std::uint32_t> makeImage(
+		const Octree& tree,
+		std::vector<Entity::ConstWeakPtr>& entities);
+
+	// Turns the indices of the image into live entities.
+	template <class OutputIter>
+	struct EntityInserter
+	{
+		const std::vector<Entity::ConstWeakPtr>& entities;
+		OutputIter iter;
+
+		EntityInserter(const std::vector<Entity::ConstWeakPtr>& entities, OutputIter iter)
+		: entities(entities), iter(iter) {}
+
+		EntityInserter& operator*() noexcept { return *this; }
+		EntityInserter& operator++() noexcept { return *this; }
+
+		EntityInserter& operator=(const std::uint32_t index)
+		{
+			if (auto lEntityPtr = entities[index].lock())
+			{
+				*iter = std::move(lEntityPtr);
+				++iter;
+			}
+			return *this;
+		}
+	};
+};
+
+} // namespace gintonic
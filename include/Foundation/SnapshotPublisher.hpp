@@ -0,0 +1,273 @@
+/**
+ * @file SnapshotPublisher.hpp
+ * @brief Defines a class that publishes immutable snapshots to reader
+ * threads without locking.
+ * @author Raoul Wols
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace gintonic {
+
+/**
+ * @brief Publishes immutable snapshots of some data structure to reader
+ * threads, in the style of read-copy-update.
+ *
+ * @details There is one writer thread, for instance the main thread. Once
+ * per frame it builds a new immutable snapshot and hands it to
+ * SnapshotPublisher::publish. Any number of reader threads call
+ * SnapshotPublisher::read to get the current snapshot. A reader never
+ * blocks the writer and the writer never blocks a reader: reading costs
+ * two atomic stores and two atomic loads, and publishing is a pointer swap.
+ *
+ * Old snapshots are reclaimed with epochs. Every publication increments
+ * the epoch. A reader announces the epoch in which it started reading in
+ * one of a fixed number of slots, and clears the slot when it is done. A
+ * snapshot that was replaced in epoch E is destroyed as soon as no reader
+ * that started before epoch E is still active. Until then, the snapshot is
+ * kept on a retired list. Reclamation runs on the writer thread only, in
+ * SnapshotPublisher::publish and SnapshotPublisher::reclaim.
+ *
+ * A reader should not hold on to a snapshot for longer than a frame or so,
+ * because it keeps every snapshot published after it alive as well.
+ *
+ * @tparam T The type of the snapshots.
+ */
+template <class T>
+class SnapshotPublisher
+{
+public:
+
+	/// The maximum number of simultaneous reads.
+	static constexpr std::size_t kMaxReaders = 64;
+
+	/**
+	 * @brief Grants read access to a snapshot for as long as it exists.
+	 * @details Obtain one with SnapshotPublisher::read. The snapshot stays
+	 * valid until the ReadGuard is destroyed, also when the writer
+	 * publishes newer snapshots in the meantime.
+	 */
+	class ReadGuard
+	{
+	public:
+
+		/// Move constructor.
+		ReadGuard(ReadGuard&& other) noexcept
+		: mSlot(other.mSlot)
+		, mSnapshot(other.mSnapshot)
+		{
+			other.mSlot = nullptr;
+			other.mSnapshot = nullptr;
+		}
+
+		ReadGuard(const ReadGuard&) = delete;
+		ReadGuard& operator=(const ReadGuard&) = delete;
+		ReadGuard& operator=(ReadGuard&&) = delete;
+
+		/// Destructor releases the snapshot.
+		~ReadGuard() noexcept
+		{
+			if (mSlot) mSlot->store(kIdle, std::memory_order_release);
+		}
+
+		/**
+		 * @brief Get the snapshot.
+		 * @return The snapshot, or nullptr if nothing was published yet.
+		 */
+		inline const T* get() const noexcept
+		{
+			return mSnapshot;
+		}
+
+		/// Access the snapshot.
+		inline const T& operator*() const noexcept
+		{
+			return *mSnapshot;
+		}
+
+		/// Access the snapshot.
+		inline const T* operator->() const noexcept
+		{
+			return mSnapshot;
+		}
+
+		/// Check wether there is a snapshot.
+		inline explicit operator bool() const noexcept
+		{
+			return mSnapshot != nullptr;
+		}
+
+	private:
+
+		friend class SnapshotPublisher;
+
+		ReadGuard(std::atomic<std::uint64_t>* slot, const T* snapshot) noexcept
+		: mSlot(slot)
+		, mSnapshot(snapshot)
+		{
+			/* Empty on purpose. */
+		}
+
+		std::atomic<std::uint64_t>* mSlot;
+		const T* mSnapshot;
+	};
+
+	/// Default constructor creates a publisher without a snapshot.
+	SnapshotPublisher() noexcept
+	{
+		for (auto& lSlot : mSlots) lSlot.epoch.store(kIdle, std::memory_order_relaxed);
+	}
+
+	/**
+	 * @brief Constructor that publishes a first snapshot.
+	 * @param initial The first snapshot.
+	 */
+	explicit SnapshotPublisher(std::unique_ptr<const T> initial) noexcept
+	: SnapshotPublisher()
+	{
+		mCurrent.store(initial.release(), std::memory_order_relaxed);
+	}
+
+	SnapshotPublisher(const SnapshotPublisher&) = delete;
+	SnapshotPublisher& operator=(const SnapshotPublisher&) = delete;
+
+	/**
+	 * @brief Destructor destroys all snapshots.
+	 * @details There must be no ReadGuard objects left.
+	 */
+	~SnapshotPublisher() noexcept
+	{
+		delete mCurrent.load(std::memory_order_relaxed);
+		for (auto& lRetired : mRetired) delete lRetired.second;
+	}
+
+	/**
+	 * @brief Get read access to the current snapshot.
+	 * @details This method may be called from any thread. It only waits if
+	 * kMaxReaders reads are active at the same time.
+	 * @return A ReadGuard that holds on to the current snapshot.
+	 */
+	ReadGuard read() const noexcept
+	{
+		// Start at a slot that depends on the thread, so that threads
+		// usually do not compete for the same slot.
+		const auto lStart = std::hash<std::thread::id>()(std::this_thread::get_id());
+		for (;;)
+		{
+			for (std::size_t i = 0; i < kMaxReaders; ++i)
+			{
+				auto& lSlot = mSlots[(lStart + i) % kMaxReaders].epoch;
+				auto lExpected = kIdle;
+				if (lSlot.load(std::memory_order_relaxed) == kIdle
+					&& lSlot.compare_exchange_strong(lExpected, mEpoch.load()))
+				{
+					// The announcement must be visible before the pointer is
+					// loaded; both operations are sequentially consistent.
+					return ReadGuard(&lSlot, mCurrent.load());
+				}
+			}
+			std::this_thread::yield();
+		}
+	}
+
+	/**
+	 * @brief Replace the current snapshot.
+	 * @details Only call this method from the writer thread. Readers that
+	 * are still reading the previous snapshot keep doing so; new readers get
+	 * the new snapshot. Afterwards, snapshots that no reader can see any
+	 * more are destroyed.
+	 * @param next The new snapshot.
+	 */
+	void publish(std::unique_ptr<const T> next)
+	{
+		mRetired.reserve(mRetired.size() + 1);
+		const auto* lPrevious = mCurrent.exchange(next.release());
+		const auto lEpoch = mEpoch.fetch_add(1) + 1;
+		if (lPrevious) mRetired.emplace_back(lEpoch, lPrevious);
+		reclaim();
+	}
+
+	/**
+	 * @brief Destroy the retired snapshots that no reader can see any more.
+	 * @details Only call this method from the writer thread.
+	 * @return The number of retired snapshots that are still alive.
+	 */
+	std::size_t reclaim() noexcept
+	{
+		auto lOldest = kIdle;
+		for (const auto& lSlot : mSlots)
+		{
+			const auto lEpoch = lSlot.epoch.load();
+			if (lEpoch < lOldest) lOldest = lEpoch;
+		}
+		std::size_t lKept = 0;
+		for (auto& lRetired : mRetired)
+		{
+			// Readers that started in the epoch in which the snapshot was
+			// replaced, or later, got a newer snapshot.
+			if (lRetired.first <= lOldest) delete lRetired.second;
+			else mRetired[lKept++] = lRetired;
+		}
+		mRetired.resize(lKept);
+		return lKept;
+	}
+
+	/**
+	 * @brief Get the current snapshot.
+	 * @details Only call this method from the writer thread.
+	 * @return The current snapshot, or nullptr if nothing was published.
+	 */
+	inline const T* current() const noexcept
+	{
+		return mCurrent.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * @brief Get the number of publications so far.
+	 * @return The current epoch.
+	 */
+	inline std::uint64_t epoch() const noexcept
+	{
+		return mEpoch.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * @brief Get the number of retired snapshots that are still alive.
+	 * @details Only call this method from the writer thread.
+	 * @return The number of retired snapshots.
+	 */
+	inline std::size_t retiredCount() const noexcept
+	{
+		return mRetired.size();
+	}
+
+private:
+
+	static constexpr std::uint64_t kIdle = ~std::uint64_t(0);
+
+	// Every slot gets its own cache line, so that readers on different
+	// cores do not invalidate each other's caches.
+	struct Slot
+	{
+		std::atomic<std::uint64_t> epoch;
+		char padding[64 - sizeof(std::atomic<std::uint64_t>)];
+	};
+
+	mutable Slot mSlots[kMaxReaders];
+	std::atomic<const T*> mCurrent{nullptr};
+	std::atomic<std::uint64_t> mEpoch{0};
+	std::vector<std::pair<std::uint64_t, const T*>> mRetired;
+};
+
+template <class T> constexpr std::size_t SnapshotPublisher<T>::kMaxReaders;
+template <class T> constexpr std::uint64_t SnapshotPublisher<T>::kIdle;
+
+} // namespace gintonic
@@ -0,0 +1,191 @@
+/**
+ * @file SpatialStatistics.hpp
+ * @brief Defines structural statistics and query counters for the spatial
+ * datastructures.
+ * @author Raoul Wols
+ */
+
+#pragma once
+
+#include "config.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+#ifdef gintonic_WITH_SPATIAL_STATISTICS
+/**
+ * @brief Add to one of the query counters of the current thread.
+ * @details Does nothing unless gintonic_WITH_SPATIAL_STATISTICS is defined
+ * (in the config.cmake file).
+ * @param counter One of nodesVisited, boxesTested or results.
+ * @param amount The amount to add.
+ */
+#define GT_SPATIAL_COUNT(counter, amount) ::gintonic::detail::localSpatialQueryCounters().counter.add(amount)
+#else
+#define GT_SPATIAL_COUNT(counter, amount)
+#endif
+
+namespace gintonic {
+
+/**
+ * @brief The shape of a spatial tree, for tuning its parameters.
+ * @details Octree::statistics and OctreeComp::Node::statistics fill one
+ * in. The depth of a node is relative to the node on which statistics()
+ * was called.
+ */
+struct SpatialStatistics
+{
+	/// The number of nodes.
+	std::size_t nodeCount = 0;
+
+	/// The number of leaf nodes.
+	std::size_t leafCount = 0;
+
+	/// The number of entities.
+	std::size_t entityCount = 0;
+
+	/**
+	 * @brief The number of entities in inner nodes.
+	 * @details An Entity ends up in an inner node when it straddles the
+	 * boundary between two children. Every query that reaches the node
+	 * tests it.
+	 */
+	std::size_t innerEntityCount = 0;
+
+	/// The largest number of entities in a single node.
+	std::size_t maxEntitiesPerNode = 0;
+
+	/// The number of nodes at every depth.
+	std::vector<std::size_t> nodesPerDepth;
+
+	/// The number of entities at every depth.
+	std::vector<std::size_t> entitiesPerDepth;
+
+	/**
+	 * @brief Histogram of the number of entities per node.
+	 * @details Bucket 0 counts the empty nodes. Bucket b > 0 counts the
+	 * nodes with at least 2^(b-1) and less than 2^b entities.
+	 */
+	std::vector<std::size_t> occupancyHistogram;
+
+	/// The number of bytes of memory used by the nodes.
+	std::size_t memoryUsage = 0;
+
+	/**
+	 * @brief Get the percentage of entities in inner nodes.
+	 * @return The percentage of entities in inner nodes, or zero if there
+	 * are no entities.
+	 */
+	float innerEntityPercentage() const noexcept;
+
+	/**
+	 * @brief Add a node.
+	 * @param depth The depth of the node.
+	 * @param entities The number of entities in the node itself.
+	 * @param isLeaf Wether the node is a leaf.
+	 * @param bytes The number of bytes of memory that the node uses.
+	 */
+	void addNode(
+		const std::size_t depth,
+		const std::size_t entities,
+		const bool isLeaf,
+		const std::size_t bytes);
+};
+
+/**
+ * @brief Output stream support for SpatialStatistics.
+ * @details Writes a human-readable, multi-line report.
+ */
+std::ostream& operator << (std::ostream&, const SpatialStatistics&);
+
+/**
+ * @brief Counts the work done by spatial queries.
+ * @details Every thread counts for itself without synchronization. The
+ * static methods add up the counters of all threads, including threads that
+ * have exited. The counters only count if gintonic_WITH_SPATIAL_STATISTICS
+ * is defined; otherwise, they stay zero.
+ */
+struct SpatialQueryCounters
+{
+	/// The number of tree nodes that were visited.
+	std::uint64_t nodesVisited = 0;
+
+	/// The number of bounding boxes of entities that were tested.
+	std::uint64_t boxesTested = 0;
+
+	/// The number of entities that were returned.
+	std::uint64_t results = 0;
+
+	/**
+	 * @brief Get the counters of all threads since the start.
+	 * @return The counters of all threads since the start.
+	 */
+	static SpatialQueryCounters total();
+
+	/**
+	 * @brief Get the counters of all threads since the previous call.
+	 * @details Call this once per frame, for instance from the main loop,
+	 * to get the work done during the frame.
+	 * @return The counters of all threads since the previous call.
+	 */
+	static SpatialQueryCounters frame();
+
+	/// Add counters.
+	SpatialQueryCounters& operator += (const SpatialQueryCounters&) noexcept;
+
+	/// Subtract counters.
+	SpatialQueryCounters& operator -= (const SpatialQueryCounters&) noexcept;
+};
+
+/**
+ * @brief Output stream support for SpatialQueryCounters.
+ * @details Writes the counters as one line of comma-separated values, in
+ * the order nodesVisited, boxesTested, results.
+ */
+std::ostream& operator << (std::ostream&, const SpatialQueryCounters&);
+
+//!@cond
+namespace detail {
+
+// A counter that only its own thread increments, but that other threads
+// may read.
+class LocalCounter
+{
+public:
+	inline void add(const std::uint64_t amount) noexcept
+	{
+		mValue.store(mValue.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+	}
+	inline std::uint64_t get() const noexcept
+	{
+		return mValue.load(std::memory_order_relaxed);
+	}
+private:
+	std::atomic<std::uint64_t> mValue{0};
+};
+
+// The counters of one thread. They register themselves so that
+// SpatialQueryCounters::total can find them.
+struct LocalSpatialQueryCounters
+{
+	LocalCounter nodesVisited;
+	LocalCounter boxesTested;
+	LocalCounter results;
+
+	LocalSpatialQueryCounters();
+	~LocalSpatialQueryCounters() noexcept;
+	SpatialQueryCounters get() const noexcept;
+};
+
+inline LocalSpatialQueryCounters& localSpatialQueryCounters() noexcept
+{
+	static thread_local LocalSpatialQueryCounters sCounters;
+	return sCounters;
+}
+
+} // namespace detail
+//!@endcond
+
+} // namespace gintonic
@@ -0,0 +1,176 @@
+/**
+ * @file ThreadPool.hpp
+ * @brief Defines a simple thread pool with task groups.
+ * @author Raoul Wols
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace gintonic {
+
+/**
+ * @brief A fixed-size pool of worker threads.
+ *
+ * @details Work is handed to the pool through a TaskGroup. A thread that
+ * waits for a TaskGroup does not block: it keeps executing pending tasks of
+ * the pool until its own group is done. Consequently, tasks may themselves
+ * create task groups and wait for them without deadlocking the pool. If the
+ * pool has no worker threads at all, every task runs immediately on the
+ * calling thread.
+ */
+class ThreadPool
+{
+public:
+
+	/**
+	 * @brief A set of tasks that can be waited for as a whole.
+	 * @details The first exception thrown by a task is rethrown from
+	 * TaskGroup::wait. The destructor waits for all tasks but swallows
+	 * exceptions.
+	 */
+	class TaskGroup
+	{
+	public:
+
+		/**
+		 * @brief Constructor.
+		 * @param pool The pool that executes the tasks.
+		 */
+		explicit TaskGroup(ThreadPool& pool = ThreadPool::get());
+
+		/// You cannot copy a TaskGroup.
+		TaskGroup(const TaskGroup&) = delete;
+
+		/// You cannot copy a TaskGroup.
+		TaskGroup& operator = (const TaskGroup&) = delete;
+
+		/// Waits for all tasks to finish.
+		~TaskGroup() noexcept;
+
+		/**
+		 * @brief Schedule a task.
+		 * @param task The task. It is called without arguments.
+		 */
+		void run(std::function<void()> task);
+
+		/**
+		 * @brief Wait for all tasks of this group to finish. The calling
+		 * thread executes pending tasks of the pool in the meantime.
+		 */
+		void wait();
+
+	private:
+
+		ThreadPool& mPool;
+		std::atomic<std::size_t> mPending;
+		std::mutex mExceptionMutex;
+		std::exception_ptr mException;
+
+		void execute(const std::function<void()>& task) noexcept;
+	};
+
+	/**
+	 * @brief Get the global thread pool.
+	 * @details The global pool has one worker thread less than the number
+	 * of hardware threads, because the calling thread participates too.
+	 * @return The global thread pool.
+	 */
+	static ThreadPool& get();
+
+	/**
+	 * @brief Constructor.
+	 * @param threadCount The number of worker threads.
+	 */
+	explicit ThreadPool(const std::size_t threadCount);
+
+	/// You cannot copy a ThreadPool.
+	ThreadPool(const ThreadPool&) = delete;
+
+	/// You cannot copy a ThreadPool.
+	ThreadPool& operator = (const ThreadPool&) = delete;
+
+	/**
+	 * @brief Destructor.
+	 * @details Finishes all pending tasks and joins the worker threads.
+	 */
+	~ThreadPool();
+
+	/**
+	 * @brief Get the number of worker threads.
+	 * @return The number of worker threads.
+	 */
+	inline std::size_t threadCount() const noexcept
+	{
+		return mThreads.size();
+	}
+
+	/**
+	 * @brief Call a function on consecutive chunks of an index range in
+	 * parallel.
+	 * @tparam Func Type of a function pointer, lambda, functor, etc. It is
+	 * called as f(first, last) for every chunk.
+	 * @param first The first index.
+	 * @param last One past the last index.
+	 * @param grainSize The minimum number of indices per chunk.
+	 * @param f A function pointer, lambda, functor, etc.
+	 */
+	template <class Func>
+	void parallelFor(
+		const std::size_t first,
+		const std::size_t last,
+		const std::size_t grainSize,
+		Func f);
+
+private:
+
+	std::vector<std::thread> mThreads;
+	std::deque<std::function<void()>> mTasks;
+	std::mutex mMutex;
+	std::condition_variable mCondition;
+	bool mStop = false;
+
+	void push(std::function<void()> task);
+	bool tryRunPendingTask();
+	void workerLoop();
+};
+
+template <class Func>
+void ThreadPool::parallelFor(
+	const std::size_t first,
+	const std::size_t last,
+	const std::size_t grainSize,
+	Func f)
+{
+	if (first >= last) return;
+	const auto lCount = last - first;
+	const auto lMaxChunks = threadCount() + 1;
+	auto lChunkSize = (lCount + lMaxChunks - 1) / lMaxChunks;
+	if (lChunkSize < grainSize) lChunkSize = grainSize;
+	if (lChunkSize >= lCount)
+	{
+		f(first, last);
+		return;
+	}
+	TaskGroup lGroup(*this);
+	auto lBegin = first;
+	while (lBegin + lChunkSize < last)
+	{
+		const auto lEnd = lBegin + lChunkSize;
+		lGroup.run([&f, lBegin, lEnd] () { f(lBegin, lEnd); });
+		lBegin = lEnd;
+	}
+	// The calling thread takes the last chunk itself.
+	f(lBegin, last);
+	lGroup.wait();
+}
+
+} // namespace gintonic
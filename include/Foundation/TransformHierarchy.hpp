@@ -0,0 +1,212 @@
+/**
+ * @file TransformHierarchy.hpp
+ * @brief Defines a flat store of transforms and their parents that computes
+ * all world matrices in one linear pass.
+ * @author Raoul Wols
+ */
+
+#pragma once
+
+#include "Foundation/allocator.hpp"
+#include "Math/SQT.hpp"
+#include "Math/mat4f.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace gintonic {
+
+/**
+ * @brief A flat store of transforms and their parents.
+ *
+ * @details Every node has a local SQT, an optional parent and a world
+ * matrix, which is the world matrix of the parent times the matrix of the
+ * local SQT. The locals, parents and world matrices live in separate
+ * contiguous arrays. The arrays are kept sorted in depth-first order, so
+ * that a parent always precedes its children and every subtree occupies a
+ * contiguous range. Computing the world matrices is then one pass from front
+ * to back over the arrays, and the pass splits into independent subtrees
+ * that run in parallel on the global ThreadPool.
+ *
+ * Nodes are referred to by an Index. Indices stay valid until the node is
+ * destroyed, even when the arrays are sorted again. Creating nodes,
+ * destroying nodes and changing parents only marks the arrays as unsorted;
+ * the next call to update sorts them in linear time.
+ *
+ * A world matrix can also be asked for before update runs. Changes are
+ * tracked with time stamps, so getWorld recomputes only the part of the
+ * chain of ancestors that is stale. This is what makes the store usable
+ * when local transforms and world transforms are read and written in an
+ * interleaved fashion.
+ *
+ * The class is not thread-safe, with one exception: when no world
+ * transform is stale, getWorld and getVersion only read. After update,
+ * any number of threads may therefore read world transforms at once, as
+ * long as nothing changes in the meantime.
+ */
+class TransformHierarchy
+{
+public:
+
+	/// Refers to a node. Stays valid until the node is destroyed.
+	typedef std::uint32_t Index;
+
+	/// The Index of no node. Roots have this as their parent.
+	static constexpr Index kNone = ~Index(0);
+
+	/// Constructs an empty TransformHierarchy.
+	TransformHierarchy() = default;
+
+	TransformHierarchy(const TransformHierarchy&) = delete;
+	TransformHierarchy& operator = (const TransformHierarchy&) = delete;
+
+	/**
+	 * @brief Create a node.
+	 * @param local The local transform of the new node.
+	 * @param parent The parent of the new node, or kNone for a root.
+	 * @return The Index of the new node.
+	 */
+	Index create(const SQT& local = SQT(), const Index parent = kNone);
+
+	/**
+	 * @brief Destroy a node.
+	 * @details The children of the node become roots. They keep their
+	 * local transforms, so their world transforms change.
+	 * @param index The node to destroy. Its Index may be handed out again
+	 * by create.
+	 */
+	void destroy(const Index index) noexcept;
+
+	/**
+	 * @brief Change the parent of a node.
+	 * @param index The node.
+	 * @param parent The new parent, or kNone to make the node a root. It
+	 * must not be the node itself or one of its descendants.
+	 */
+	void setParent(const Index index, const Index parent) noexcept;
+
+	/**
+	 * @brief Get the parent of a node.
+	 * @param index The node.
+	 * @return The parent, or kNone if the node is a root.
+	 */
+	Index getParent(const Index index) const noexcept;
+
+	/**
+	 * @brief Get the local transform of a node.
+	 * @param index The node.
+	 * @return The local transform.
+	 */
+	const SQT& getLocal(const Index index) const noexcept
+	{
+		return mLocals[mSlotOfIndex[index]];
+	}
+
+	/**
+	 * @brief Get the local transform of a node for modification.
+	 * @details The world transforms of the node and its descendants are
+	 * marked as stale. The reference is invalidated by the next call to
+	 * create or update, so do not hold on to it.
+	 * @param index The node.
+	 * @return The local transform.
+	 */
+	SQT& local(const Index index) noexcept;
+
+	/**
+	 * @brief Get the world transform of a node.
+	 * @details If the node or one of its ancestors changed since its world
+	 * transform was computed, the stale part of the chain of ancestors is
+	 * computed first. The reference is invalidated by the next call to
+	 * create or update.
+	 * @param index The node.
+	 * @return The world transform.
+	 */
+	const mat4f& getWorld(const Index index) const noexcept;
+
+	/**
+	 * @brief Get the version of the world transform of a node.
+	 * @details The version changes every time a recomputation gives a
+	 * different world transform. Caches of values derived from the world
+	 * transform can compare versions to see if they are stale.
+	 * @param index The node.
+	 * @return The version of the world transform.
+	 */
+	std::uint32_t getVersion(const Index index) const noexcept;
+
+	/**
+	 * @brief Compute all stale world transforms.
+	 * @details Sorts the arrays first if nodes were created, destroyed or
+	 * reparented since the last update. Subtrees larger than
+	 * GT_TRANSFORMHIERARCHY_GRAIN nodes are split: their upper levels are
+	 * computed on the calling thread, and the smaller subtrees below them
+	 * are computed in parallel.
+	 */
+	void update();
+
+	/// Get the number of nodes.
+	std::size_t size() const noexcept
+	{
+		return mSlotOfIndex.size() - mFreeIndices.size();
+	}
+
+	/// Get the number of bytes that the arrays allocated.
+	std::size_t memoryUsage() const noexcept;
+
+private:
+
+	// A range of slots that the parallel pass of update hands to one
+	// task. It holds one or more complete subtrees.
+	struct Range
+	{
+		std::uint32_t first;
+		std::uint32_t last;
+	};
+
+	// The per-node arrays, indexed by slot. The slot of a node changes
+	// when the arrays are sorted.
+	std::vector<SQT, allocator<SQT>> mLocals;
+	mutable std::vector<mat4f, allocator<mat4f>> mWorlds;
+	std::vector<Index> mParents;
+	std::vector<Index> mIndexOfSlot;
+	mutable std::vector<std::uint32_t> mChangedAt;
+	mutable std::vector<std::uint32_t> mComputedAt;
+	mutable std::vector<std::uint32_t> mVersions;
+
+	// The mapping from indices to slots, and the indices that can be
+	// handed out again.
+	std::vector<Index> mSlotOfIndex;
+	std::vector<Index> mFreeIndices;
+
+	// Time stamps. A world transform is stale if it was computed before
+	// the last change of the node or one of its ancestors. Changes made
+	// since the epoch started have the current epoch as time stamp, so a
+	// new epoch starts before anything is computed.
+	mutable std::uint32_t mEpoch = 1;
+	mutable bool mEpochHasChanges = false;
+
+	// The result of the last sort: the slots at the top of large subtrees,
+	// which update computes one by one, and the ranges of small subtrees
+	// below them.
+	std::vector<Index> mTopSlots;
+	std::vector<Range> mRanges;
+	bool mNeedsSort = false;
+	std::size_t mDeadSlotCount = 0;
+
+	// Scratch space for update. The latest change of every node and its
+	// ancestors.
+	std::vector<std::uint32_t> mLatestChange;
+
+	void markChanged(const Index slot) noexcept;
+	bool isStale(const Index slot) const noexcept;
+	void computeChain(const Index slot) const noexcept;
+	std::uint32_t beginCompute() const noexcept;
+	void compute(const Index slot, const std::uint32_t stamp) const noexcept;
+	void computeRange(
+		const std::uint32_t first,
+		const std::uint32_t last,
+		const std::uint32_t stamp) noexcept;
+	void sort();
+	void resetTimeStamps() const noexcept;
+};
+
+} // namespace gintonic
@@ -0,0 +1,188 @@
+/**
+ * @file TriangleBVH.hpp
+ * @brief Defines a bounding volume hierarchy over the triangles of a mesh,
+ * for precise ray picking and line-of-sight tests.
+ * @author Raoul Wols
+ */
+
+#pragma once
+
+#include "Foundation/allocator.hpp"
+#include "Math/box3f.hpp"
+#include "Math/ray3f.hpp"
+
+#include <boost/serialization/access.hpp>
+#include <boost/serialization/array.hpp>
+#include <boost/serialization/nvp.hpp>
+#include <boost/serialization/vector.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace gintonic {
+
+/**
+ * @brief A bounding volume hierarchy over the triangles of a mesh.
+ *
+ * @details The spatial trees only know the bounding boxes of entities. This
+ * class answers the next question: which triangle of the mesh does a ray
+ * hit, and where. Rays are given in the local space of the mesh, so
+ * transform a world space ray with the inverse of the global transform of
+ * the entity first.
+ *
+ * The tree is built top-down with the surface area heuristic, evaluated
+ * at a fixed number of bins along the largest axis of the triangle
+ * centroids. A node takes 32 bytes and the nodes are stored in depth-first
+ * order: the left child of an inner node directly follows its parent. The
+ * triangles of a leaf are stored in packs of four in structure-of-arrays
+ * layout, so that a ray is tested against four triangles at a time with
+ * SSE instructions.
+ *
+ * The tree copies the vertex positions it needs. It does not change
+ * afterwards; rebuild it when the mesh changes.
+ */
+class TriangleBVH
+{
+public:
+
+	/// Constructs an empty TriangleBVH. Rays never hit it.
+	TriangleBVH() = default;
+
+	/**
+	 * @brief Build a TriangleBVH.
+	 * @details Every three consecutive indices form a triangle. Remaining
+	 * indices are ignored.
+	 * @param indices The index array.
+	 * @param indexCount The number of indices.
+	 * @param positions The vertex array. Vertex i has its X, Y and Z
+	 * coordinates at positions[i * stride + 0], positions[i * stride + 1]
+	 * and positions[i * stride + 2].
+	 * @param stride The number of floats between the starts of two vertices.
+	 */
+	TriangleBVH(
+		const std::uint32_t* indices,
+		const std::size_t indexCount,
+		const float* positions,
+		const std::size_t stride);
+
+	/**
+	 * @brief Find the nearest triangle that a ray hits.
+	 * @details Only the part of the ray with 0 <= t <= maxDistance is
+	 * considered. Triangles are hit from both sides.
+	 * @param ray The ray, in the local space of the mesh.
+	 * @param maxDistance The end of the considered part of the ray.
+	 * @param distance If a triangle is hit, this is set to its parameter t.
+	 * @param triangle If a triangle is hit, this is set to its index: the
+	 * triangle formed by the indices 3 * triangle, 3 * triangle + 1 and
+	 * 3 * triangle + 2.
+	 * @return True if a triangle is hit, false otherwise.
+	 */
+	bool raycast(
+		const ray3f& ray,
+		const float maxDistance,
+		float& distance,
+		std::uint32_t& triangle) const noexcept;
+
+	/**
+	 * @brief Check wether a ray hits any triangle.
+	 * @details This stops at the first hit, so it is faster than raycast.
+	 * Use it for line-of-sight tests.
+	 * @param ray The ray, in the local space of the mesh.
+	 * @param maxDistance The end of the considered part of the ray.
+	 * @return True if a triangle is hit, false otherwise.
+	 */
+	bool occluded(const ray3f& ray, const float maxDistance) const noexcept;
+
+	/// Get the number of triangles.
+	inline std::size_t triangleCount() const noexcept { return mTriangleCount; }
+
+	/// Get the number of nodes.
+	inline std::size_t nodeCount() const noexcept { return mNodes.size(); }
+
+	/// Get the number of bytes of memory used by the nodes and triangles.
+	std::size_t memoryUsage() const noexcept;
+
+	/**
+	 * @brief Get the bounding box of all triangles.
+	 * @return The bounding box. Meaningless if there are no triangles.
+	 */
+	box3f getBounds() const noexcept;
+
+private:
+
+	// A node of the tree. An inner node has count zero; its left child
+	// follows it directly, and first is the index of its right child. A
+	// leaf has count triangles, stored in the packs starting at first.
+	struct Node
+	{
+		float minCorner[3];
+		std::uint32_t first;
+		float maxCorner[3];
+		std::uint32_t count;
+
+		inline bool isLeaf() const noexcept { return count != 0; }
+
+		template <class Archive>
+		void serialize(Archive& archive, const unsigned int /*version*/)
+		{
+			using boost::serialization::make_array;
+			using boost::serialization::make_nvp;
+			archive & make_nvp("min", make_array(minCorner, 3))
+				& make_nvp("first", first)
+				& make_nvp("max", make_array(maxCorner, 3))
+				& make_nvp("count", count);
+		}
+	};
+
+	// Four triangles, stored as a vertex and two edges, with one SSE
+	// register per coordinate. Unused lanes have zero edges and never hit.
+	struct alignas(16) TrianglePack
+	{
+		float v0[3][4];
+		float e1[3][4];
+		float e2[3][4];
+		std::uint32_t index[4];
+
+		template <class Archive>
+		void serialize(Archive& archive, const unsigned int /*version*/)
+		{
+			using boost::serialization::make_array;
+			using boost::serialization::make_nvp;
+			archive & make_nvp("v0", make_array(&v0[0][0], 12))
+				& make_nvp("e1", make_array(&e1[0][0], 12))
+				& make_nvp("e2", make_array(&e2[0][0], 12))
+				& make_nvp("index", make_array(index, 4));
+		}
+	};
+
+	static_assert(sizeof(Node) == 32, "A node must fit in 32 bytes.");
+
+	std::vector<Node> mNodes;
+	std::vector<TrianglePack, allocator<TrianglePack>> mPacks;
+	std::uint32_t mTriangleCount = 0;
+
+	struct BuildTriangle;
+
+	void build(BuildTriangle* first, BuildTriangle* last, const unsigned depth);
+
+	void makeLeaf(Node& node, const BuildTriangle* first, const BuildTriangle* last);
+
+	template <bool AnyHit>
+	bool traverse(
+		const ray3f& ray,
+		float& distance,
+		std::uint32_t& triangle) const noexcept;
+
+	friend class boost::serialization::access;
+
+	template <class Archive>
+	void serialize(Archive& archive, const unsigned int /*version*/)
+	{
+		using boost::serialization::make_nvp;
+		archive & make_nvp("nodes", mNodes)
+			& make_nvp("packs", mPacks)
+			& make_nvp("triangleCount", mTriangleCount);
+	}
+};
+
+} // namespace gintonic
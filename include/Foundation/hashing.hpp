@@ -0,0 +1,61 @@
+/**
+ * @file hashing.hpp
+ * @brief Defines the helpers of the open-addressing hash tables with 64-bit
+ * keys.
+ * @author Raoul Wols
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace gintonic {
+
+/**
+ * @brief Mix all bits of a 64-bit key into the low bits.
+ * @details This is the finalizer of MurmurHash3. Tables whose size is a
+ * power of two take the low bits of the result as the home slot of a key.
+ * @param key The key.
+ * @return The hash of the key.
+ */
+inline std::uint64_t hashKey64(std::uint64_t key) noexcept
+{
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ULL;
+	key ^= key >> 33;
+	return key;
+}
+
+/**
+ * @brief Find a key in a table with linear probing.
+ * @details The walk starts at the home slot of the key and stops at the
+ * slot with the key or at the first empty slot. The size of the table must
+ * be a power of two, and the table must always keep an empty slot, or the
+ * walk does not end.
+ * @tparam Slot A type with a std::uint64_t member named key.
+ * @param slots The table.
+ * @param key The key to look for.
+ * @param empty The key of empty slots.
+ * @return The index of the slot with the key, or of the empty slot where
+ * the key belongs.
+ */
+template <class Slot, class Allocator>
+std::size_t probeLinear(
+	const std::vector<Slot, Allocator>& slots,
+	const std::uint64_t key,
+	const std::uint64_t empty) noexcept
+{
+	const auto lMask = slots.size() - 1;
+	auto lIndex = static_cast<std::size_t>(hashKey64(key)) & lMask;
+	while (slots[lIndex].key != key && slots[lIndex].key != empty)
+	{
+		lIndex = (lIndex + 1) & lMask;
+	}
+	return lIndex;
+}
+
+} // namespace gintonic
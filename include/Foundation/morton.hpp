@@ -0,0 +1,136 @@
+/**
+ * @file morton.hpp
+ * @brief Defines functions to encode and decode three-dimensional Morton
+ * codes (also known as Z-order curve indices).
+ * @author Raoul Wols
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace gintonic {
+
+/**
+ * @brief The maximum number of bits per axis that fit in a 64-bit Morton
+ * code with one extra sentinel bit.
+ */
+constexpr std::size_t kMortonBitsPerAxis = 21;
+
+/**
+ * @brief Spread the lower 21 bits of a number so that there are two zero bits
+ * in between every bit.
+ * @param x The number to spread out.
+ * @return The spread out number.
+ */
+inline std::uint64_t mortonSplitBy3(std::uint64_t x) noexcept
+{
+	x &= 0x1fffff;
+	x = (x | x << 32) & 0x1f00000000ffff;
+	x = (x | x << 16) & 0x1f0000ff0000ff;
+	x = (x | x << 8)  & 0x100f00f00f00f00f;
+	x = (x | x << 4)  & 0x10c30c30c30c30c3;
+	x = (x | x << 2)  & 0x1249249249249249;
+	return x;
+}
+
+/**
+ * @brief The inverse of mortonSplitBy3.
+ * @param x A spread out number.
+ * @return The compacted number, using at most 21 bits.
+ */
+inline std::uint64_t mortonCompactBy3(std::uint64_t x) noexcept
+{
+	x &= 0x1249249249249249;
+	x = (x ^ (x >> 2))  & 0x10c30c30c30c30c3;
+	x = (x ^ (x >> 4))  & 0x100f00f00f00f00f;
+	x = (x ^ (x >> 8))  & 0x1f0000ff0000ff;
+	x = (x ^ (x >> 16)) & 0x1f00000000ffff;
+	x = (x ^ (x >> 32)) & 0x1fffff;
+	return x;
+}
+
+/**
+ * @brief Interleave three 21-bit cell coordinates into a Morton code.
+ * @details The X coordinate occupies the least significant bit of every
+ * triple, then Y, then Z.
+ * @param x The X cell coordinate.
+ * @param y The Y cell coordinate.
+ * @param z The Z cell coordinate.
+ * @return The interleaved Morton code.
+ */
+inline std::uint64_t mortonEncode(
+	const std::uint32_t x,
+	const std::uint32_t y,
+	const std::uint32_t z) noexcept
+{
+	return mortonSplitBy3(x) | (mortonSplitBy3(y) << 1)
+		| (mortonSplitBy3(z) << 2);
+}
+
+/**
+ * @brief Decode a Morton code into three 21-bit cell coordinates.
+ * @param code The Morton code.
+ * @param x Will hold the X cell coordinate.
+ * @param y Will hold the Y cell coordinate.
+ * @param z Will hold the Z cell coordinate.
+ */
+inline void mortonDecode(
+	const std::uint64_t code,
+	std::uint32_t& x,
+	std::uint32_t& y,
+	std::uint32_t& z) noexcept
+{
+	x = static_cast<std::uint32_t>(mortonCompactBy3(code));
+	y = static_cast<std::uint32_t>(mortonCompactBy3(code >> 1));
+	z = static_cast<std::uint32_t>(mortonCompactBy3(code >> 2));
+}
+
+/**
+ * @brief Get the index of the most significant set bit.
+ * @param x A non-zero number.
+ * @return The index of the most significant set bit.
+ */
+inline std::size_t mostSignificantBit(const std::uint64_t x) noexcept
+{
+	#if defined(__GNUC__) || defined(__clang__)
+		return 63 - static_cast<std::size_t>(__builtin_clzll(x));
+	#else
+		std::size_t lResult = 0;
+		auto lValue = x;
+		while (lValue >>= 1) ++lResult;
+		return lResult;
+	#endif
+}
+
+/**
+ * @brief Get the depth of a location code.
+ * @details A location code is a Morton code of the path from the root to a
+ * node, prefixed with a single sentinel bit. The root has location code 1.
+ * @param locationCode A location code.
+ * @return The depth of the node, where the root has depth zero.
+ */
+inline std::size_t locationCodeDepth(const std::uint64_t locationCode) noexcept
+{
+	return mostSignificantBit(locationCode) / 3;
+}
+
+/**
+ * @brief Check wether one location code is an ancestor of (or equal to)
+ * another location code.
+ * @param ancestor The candidate ancestor.
+ * @param descendant The candidate descendant.
+ * @return True if ancestor is an ancestor of descendant or equal to it.
+ */
+inline bool locationCodeIsAncestor(
+	const std::uint64_t ancestor,
+	const std::uint64_t descendant) noexcept
+{
+	const auto lAncestorDepth = locationCodeDepth(ancestor);
+	const auto lDescendantDepth = locationCodeDepth(descendant);
+	return lAncestorDepth <= lDescendantDepth
+		&& (descendant >> (3 * (lDescendantDepth - lAncestorDepth))) == ancestor;
+}
+
+} // namespace gintonic
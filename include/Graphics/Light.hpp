@@ -43,7 +43,7 @@ class Light : public Object<Light, std::string>
      * shadow-casting geometry entities.
      */
     virtual void shine(const Entity& lightEntity,
-                       const std::vector<std::shared_ptr<Entity>>&
+                       const std::vector<Entity*>&
                            shadowCastingGeometryEntities) const noexcept = 0;
 
     /**
@@ -9,6 +9,7 @@
 #include "../ForwardDeclarations.hpp"
 
 #include "../Foundation/Object.hpp"
+#include "../Foundation/TriangleBVH.hpp"
 #include "../Foundation/allocator.hpp"
 #include "../Foundation/filesystem.hpp"
 
@@ -21,7 +22,9 @@
 #include "OpenGL/VertexArrayObject.hpp"
 
 #include <boost/serialization/base_object.hpp>
+#include <boost/serialization/version.hpp>
 #include <map>
+#include <memory>
 #include <vector>
 
 #define GT_MESH_BUFFER_POS_XYZ_UV_X 0 // Buffer for the positions and uv.x
@@ -499,6 +502,38 @@ class Mesh : public Object<Mesh, std::string>
         return mJointIndices.empty() == false;
     }
 
+    /**
+     * @brief Find the nearest triangle of this mesh that a ray hits.
+     * @details The first query builds the triangle BVH of this mesh, so it
+     * is much slower than the next ones. Building is not thread-safe; call
+     * getBVH once before querying from several threads.
+     * @param [in] ray The ray, in the local space of this mesh.
+     * @param [in] maxDistance Only hits at most this far along the ray count.
+     * @param [out] distance If a triangle is hit, the distance along the ray.
+     * @param [out] triangle If a triangle is hit, its index. The triangle is
+     * formed by the indices 3 * triangle, 3 * triangle + 1 and 3 * triangle +
+     * 2.
+     * @return True if a triangle is hit, false otherwise.
+     */
+    bool raycast(const ray3f& ray, const float maxDistance, float& distance,
+                 GLuint& triangle) const;
+
+    /**
+     * @brief Check wether a ray hits any triangle of this mesh.
+     * @details Use this for line-of-sight tests. Builds the triangle BVH on
+     * first use, just like raycast.
+     * @param [in] ray The ray, in the local space of this mesh.
+     * @param [in] maxDistance Only hits at most this far along the ray count.
+     * @return True if a triangle is hit, false otherwise.
+     */
+    bool occluded(const ray3f& ray, const float maxDistance) const;
+
+    /**
+     * @brief Get the triangle BVH of this mesh, building it if needed.
+     * @return The triangle BVH.
+     */
+    const TriangleBVH& getBVH() const;
+
     GINTONIC_DEFINE_SSE_OPERATOR_NEW_DELETE();
 
   private:
@@ -525,6 +560,9 @@ class Mesh : public Object<Mesh, std::string>
 
     OpenGL::Vector<GL_ARRAY_BUFFER, mat3f> mNormalMatrixBuffer;
 
+    // Built on first use, and thrown away when the geometry changes.
+    mutable std::unique_ptr<TriangleBVH> mBVH;
+
     void setupInstancedRenderingMatrices() noexcept;
     void computeLocalBoundingBoxFromPositionInformation(
         const std::vector<Mesh::vec4f>& position_XYZ_uv_X);
@@ -550,10 +588,16 @@ class Mesh : public Object<Mesh, std::string>
 
         archive& mJointIndices;
         archive& mJointWeights;
+
+        // Save the triangle BVH if it was built, so that loading the mesh
+        // does not have to build it again.
+        const bool hasBVH = mBVH != nullptr;
+        archive& hasBVH;
+        if (hasBVH) archive&* mBVH;
     }
 
     template <class Archive>
-    void load(Archive& archive, const unsigned int /*version*/)
+    void load(Archive& archive, const unsigned int version)
     {
         archive& mLocalBoundingBox;
 
@@ -569,6 +613,15 @@ class Mesh : public Object<Mesh, std::string>
         archive& mJointIndices;
         archive& mJointWeights;
 
+        mBVH.reset();
+        bool hasBVH = false;
+        if (version >= 1) archive& hasBVH;
+        if (hasBVH)
+        {
+            mBVH.reset(new TriangleBVH());
+            archive&* mBVH;
+        }
+
         uploadData();
     }
 
@@ -599,3 +652,4 @@ inline std::ostream& operator<<(std::ostream& os, const Mesh::vec4i& v)
 } // namespace gintonic
 
 BOOST_CLASS_TRACKING(gintonic::Mesh, boost::serialization::track_always);
+BOOST_CLASS_VERSION(gintonic::Mesh, 1);
@@ -95,7 +95,7 @@ public:
 
 	virtual void shine(
 		const Entity& lightEntity, 
-		const std::vector<std::shared_ptr<Entity>>& shadowCastingGeometryEntities) const noexcept;
+		const std::vector<Entity*>& shadowCastingGeometryEntities) const noexcept;
 
 	virtual void initializeShadowBuffer(Entity& lightEntity) const;
 
@@ -0,0 +1,145 @@
+/**
+ * @file RenderLists.hpp
+ * @brief Defines the lists of entities that the Renderer draws, kept up to
+ * date incrementally.
+ * @author Raoul Wols
+ */
+
+#pragma once
+
+#include "../EntityHandle.hpp"
+#include "../ForwardDeclarations.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace gintonic {
+
+/**
+ * @brief The lights and the geometry of a scene, sorted by whether they
+ * cast shadows.
+ *
+ * @details The scene is a root Entity and all of its descendants. A light
+ * is an Entity with a Light. A geometry is an Entity with a Material and a
+ * Mesh. An Entity can be both.
+ *
+ * The lists persist from frame to frame. Instead of visiting the whole
+ * scene, update asks Entity::takeRenderStateChanges which entities were
+ * attached, detached, destroyed or got a different castShadow, material,
+ * mesh or light, and moves only those between the lists. When an Entity
+ * enters or leaves the scene, its descendants do too. Keeping the lists up
+ * to date thus costs time in the number of changes, not in the size of the
+ * scene.
+ *
+ * Like the Renderer, this class also creates the ShadowBuffer of a light
+ * that casts shadows and destroys the ShadowBuffer of a light that does
+ * not.
+ */
+class RenderLists
+{
+public:
+
+	/// Constructs empty lists without a root.
+	RenderLists() = default;
+
+	RenderLists(const RenderLists&) = delete;
+	RenderLists& operator = (const RenderLists&) = delete;
+
+	/**
+	 * @brief Set the root of the scene.
+	 * @details If the root is different from the current root, the lists
+	 * are built again from scratch. Does nothing otherwise.
+	 * @param root The new root, or null to clear the lists.
+	 */
+	void setRoot(Entity* root);
+
+	/// Get the root of the scene, or null if there is none.
+	Entity* getRoot() const noexcept { return mRoot; }
+
+	/**
+	 * @brief Move the entities whose render state changed since the
+	 * previous update between the lists.
+	 * @details Clears the lists if the root died.
+	 */
+	void update();
+
+	/// Get the non-point lights that cast shadows.
+	const std::vector<Entity*>& shadowCastingLights() const noexcept
+	{
+		return mLists[kShadowCastingLights];
+	}
+
+	/// Get the point lights that cast shadows.
+	const std::vector<Entity*>& shadowCastingPointLights() const noexcept
+	{
+		return mLists[kShadowCastingPointLights];
+	}
+
+	/// Get the geometries that cast shadows.
+	const std::vector<Entity*>& shadowCastingGeometries() const noexcept
+	{
+		return mLists[kShadowCastingGeometries];
+	}
+
+	/// Get the lights that do not cast shadows.
+	const std::vector<Entity*>& nonShadowCastingLights() const noexcept
+	{
+		return mLists[kNonShadowCastingLights];
+	}
+
+	/// Get the geometries that do not cast shadows.
+	const std::vector<Entity*>& nonShadowCastingGeometries() const noexcept
+	{
+		return mLists[kNonShadowCastingGeometries];
+	}
+
+private:
+
+	enum List : std::uint8_t
+	{
+		kShadowCastingLights,
+		kShadowCastingPointLights,
+		kShadowCastingGeometries,
+		kNonShadowCastingLights,
+		kNonShadowCastingGeometries,
+		kListCount,
+		kNoList = kListCount
+	};
+
+	// What the lists know about an Entity, indexed by the index of its
+	// handle. The slot belongs to the Entity with the stored handle.
+	struct Slot
+	{
+		EntityHandle handle;
+		bool inScene = false;
+		std::uint8_t lightList = kNoList;
+		std::uint8_t geometryList = kNoList;
+		std::uint32_t lightPosition = 0;
+		std::uint32_t geometryPosition = 0;
+	};
+
+	Entity* mRoot = nullptr;
+	EntityHandle mRootHandle;
+
+	// The lists, and the handles of their entities in the same order. The
+	// handles are what removing a dead Entity relies on.
+	std::vector<Entity*> mLists[kListCount];
+	std::vector<EntityHandle> mHandles[kListCount];
+	std::vector<Slot> mSlots;
+
+	// Scratch space for update.
+	std::vector<EntityHandle> mChanges;
+	std::vector<Entity*> mStack;
+
+	void clear() noexcept;
+	void process(const EntityHandle handle);
+	Slot& slotOf(Entity& entity);
+	bool isInScene(const Entity& entity) const noexcept;
+	void setInScene(Entity& entity, const bool inScene);
+	void sort(Entity& entity, Slot& slot);
+	void insert(Entity& entity, Slot& slot, const List list, const bool isLight);
+	void erase(const List list, const std::uint32_t position) noexcept;
+	void eraseAll(Slot& slot) noexcept;
+};
+
+} // namespace gintonic
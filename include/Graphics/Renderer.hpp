@@ -664,6 +664,17 @@ class Renderer
         sOctreeRoot = root;
     }
 
+    inline static void debugDrawOctree(const LinearOctree* root) noexcept
+    {
+        sLinearOctreeRoot = root;
+    }
+
+    inline static void debugDrawOctree(std::nullptr_t) noexcept
+    {
+        sOctreeRoot = nullptr;
+        sLinearOctreeRoot = nullptr;
+    }
+
     /**
      * @brief Enable or disable virtual synchronization.
      * @param b True to enable, false to disable.
@@ -902,6 +913,7 @@ class Renderer
     static std::shared_ptr<Entity> sCameraEntity;
     static std::shared_ptr<Entity> sDebugShadowBufferEntity;
     static const Octree* sOctreeRoot;
+    static const LinearOctree* sLinearOctreeRoot;
     static vec3f sCameraPosition;
 
     static std::shared_ptr<Mesh> sUnitQuadPUN;
@@ -915,7 +927,7 @@ class Renderer
     static void prepareRendering() noexcept;
     static void renderGeometry() noexcept;
 
-    static void renderGeometry(const std::vector<std::shared_ptr<Entity>>&,
+    static void renderGeometry(const std::vector<Entity*>&,
                                std::vector<mat4f, allocator<mat4f>>&,
                                std::vector<mat3f>&) noexcept;
 
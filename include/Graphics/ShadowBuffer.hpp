@@ -27,7 +27,7 @@ public:
 	 */
 	virtual void collect(
 		const Entity& lightEntity, 
-		const std::vector<std::shared_ptr<Entity>>& shadowCastingGeometryEntities) noexcept = 0;
+		const std::vector<Entity*>& shadowCastingGeometryEntities) noexcept = 0;
 
 	/**
 	 * @brief Bind the depth textures that recorded the shadows.
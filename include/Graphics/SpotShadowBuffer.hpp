@@ -14,7 +14,7 @@ public:
 
 	virtual void collect(
 		const Entity& lightEntity, 
-		const std::vector<std::shared_ptr<Entity>>& shadowCastingGeometryEntities) noexcept;
+		const std::vector<Entity*>& shadowCastingGeometryEntities) noexcept;
 
 	virtual void bindDepthTextures() const noexcept;
 
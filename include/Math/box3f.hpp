@@ -131,6 +131,17 @@ private:
  */
 bool intersects(const box3f& a, const box3f& b) noexcept;
 
+/**
+ * @brief Get the squared distance between a bounding box and a point.
+ *
+ * @param box Some bounding box.
+ * @param point Some point.
+ *
+ * @return The squared distance from the point to the nearest point of the
+ * box. This is zero if the point is inside the box.
+ */
+float distance2(const box3f& box, const vec3f& point) noexcept;
+
 /**
  * @brief Output stream support for box2f.
  * 
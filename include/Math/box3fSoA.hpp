@@ -0,0 +1,188 @@
+/**
+ * @file box3fSoA.hpp
+ * @brief Defines an array of axis-aligned bounding boxes in SoA layout.
+ * @author Raoul Wols
+ */
+
+#pragma once
+
+#include "box3f.hpp"
+#include "frustum.hpp"
+#include "../Foundation/allocator.hpp"
+
+#include <vector>
+
+namespace gintonic {
+
+union mat4f; // Forward declaration.
+
+/**
+ * @brief An array of axis-aligned bounding boxes in structure-of-arrays
+ * layout.
+ *
+ * @details The boxes are stored in blocks of four. A block holds the
+ * minimum X coordinates of its four boxes in one SSE register, then the
+ * minimum Y coordinates, and so on. Consequently, a query volume is tested
+ * against four boxes at once. The array keeps no particular order when
+ * boxes are removed: box3fSoA::swapRemove moves the last box into the hole,
+ * so that parallel arrays can do the same.
+ */
+class box3fSoA
+{
+public:
+
+	/// Default constructor creates an empty array.
+	box3fSoA() = default;
+
+	/**
+	 * @brief Get the number of boxes.
+	 * @return The number of boxes.
+	 */
+	inline std::size_t size() const noexcept
+	{
+		return mSize;
+	}
+
+	/**
+	 * @brief Check wether there are no boxes.
+	 * @return True if there are no boxes, false otherwise.
+	 */
+	inline bool empty() const noexcept
+	{
+		return mSize == 0;
+	}
+
+	/// Remove all boxes.
+	void clear() noexcept;
+
+	/**
+	 * @brief Reserve memory for a number of boxes.
+	 * @param count The number of boxes.
+	 */
+	void reserve(const std::size_t count);
+
+	/**
+	 * @brief Append a box.
+	 * @param box The box to append.
+	 */
+	void push_back(const box3f& box);
+
+	/**
+	 * @brief Replace a box.
+	 * @param index The index of the box.
+	 * @param box The new box.
+	 */
+	void set(const std::size_t index, const box3f& box) noexcept;
+
+	/**
+	 * @brief Get a box.
+	 * @param index The index of the box.
+	 * @return The box.
+	 */
+	box3f get(const std::size_t index) const noexcept;
+
+	/**
+	 * @brief Replace all boxes by transformed boxes of another array.
+	 * @details Box i becomes the axis-aligned bounding box of box i of the
+	 * other array, transformed by the affine matrix *matrices[i]. The
+	 * center of every box is transformed as a point and its extent by the
+	 * absolute values of the matrix. That takes three dot products per box
+	 * instead of eight transformed corners, for four boxes at once.
+	 * @param boxes The boxes to transform. Must not be this array.
+	 * @param matrices The matrices, one for every box.
+	 */
+	void assignTransformed(const box3fSoA& boxes, const mat4f* const* matrices);
+
+	/**
+	 * @brief Remove a box by moving the last box into its place.
+	 * @param index The index of the box to remove.
+	 */
+	void swapRemove(const std::size_t index) noexcept;
+
+	/**
+	 * @brief Call a function for every box that intersects a volume.
+	 * @details Touching boxes intersect, just like with intersects(const
+	 * box3f&, const box3f&).
+	 * @tparam Func Type of a function pointer, lambda, functor, etc. It is
+	 * called with the index of the box.
+	 * @param volume The volume.
+	 * @param f A function pointer, lambda, functor, etc.
+	 */
+	template <class Func>
+	void intersecting(const box3f& volume, Func f) const;
+
+	/**
+	 * @brief Call a function for every box that is not outside a frustum.
+	 * @details Only the planes in the plane mask are tested. The test is
+	 * conservative in the same way as frustum::classify.
+	 * @tparam Func Type of a function pointer, lambda, functor, etc. It is
+	 * called with the index of the box.
+	 * @param volume The frustum.
+	 * @param planeMask The mask of planes to test.
+	 * @param f A function pointer, lambda, functor, etc.
+	 */
+	template <class Func>
+	void intersecting(const frustum& volume, const unsigned planeMask, Func f) const;
+
+	/**
+	 * @brief Get the number of bytes of heap memory in use.
+	 * @return The number of bytes of heap memory in use.
+	 */
+	inline std::size_t memoryUsage() const noexcept
+	{
+		return mBlocks.capacity() * sizeof(Block);
+	}
+
+private:
+
+	struct Block
+	{
+		__m128 minX;
+		__m128 minY;
+		__m128 minZ;
+		__m128 maxX;
+		__m128 maxY;
+		__m128 maxZ;
+	};
+
+	std::vector<Block, allocator<Block>> mBlocks;
+	std::size_t mSize = 0;
+
+	// A bit for every box of the block that really exists.
+	inline unsigned validLanes(const std::size_t block) const noexcept
+	{
+		const auto lCount = mSize - 4 * block;
+		return lCount >= 4 ? 0xf : (1u << lCount) - 1;
+	}
+
+	static unsigned intersectionMask(const Block& block, const box3f& volume) noexcept;
+	static unsigned intersectionMask(const Block& block, const frustum& volume, const unsigned planeMask) noexcept;
+};
+
+template <class Func>
+void box3fSoA::intersecting(const box3f& volume, Func f) const
+{
+	for (std::size_t b = 0; b < mBlocks.size(); ++b)
+	{
+		const auto lMask = intersectionMask(mBlocks[b], volume) & validLanes(b);
+		for (std::size_t l = 0; l < 4; ++l)
+		{
+			if (lMask & (1u << l)) f(4 * b + l);
+		}
+	}
+}
+
+template <class Func>
+void box3fSoA::intersecting(const frustum& volume, const unsigned planeMask, Func f) const
+{
+	for (std::size_t b = 0; b < mBlocks.size(); ++b)
+	{
+		const auto lMask = intersectionMask(mBlocks[b], volume, planeMask) & validLanes(b);
+		for (std::size_t l = 0; l < 4; ++l)
+		{
+			if (lMask & (1u << l)) f(4 * b + l);
+		}
+	}
+}
+
+} // namespace gintonic
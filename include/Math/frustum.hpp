@@ -0,0 +1,134 @@
+/**
+ * @file frustum.hpp
+ * @brief Defines a view frustum bounded by six planes.
+ * @author Raoul Wols
+ */
+
+#pragma once
+
+#include "box3f.hpp"
+#include "mat4f.hpp"
+#include "vec4f.hpp"
+
+namespace gintonic {
+
+/**
+ * @brief A view frustum, bounded by six planes.
+ *
+ * @details The planes are extracted from a combined projection and view
+ * matrix with the method of Gribb and Hartmann. Every plane is stored as
+ * a vec4f (a, b, c, d) with a normalized normal (a, b, c) pointing into the
+ * frustum, so that a point p is on the inner side of the plane if
+ * a * p.x + b * p.y + c * p.z + d >= 0.
+ *
+ * Internally, the planes are also stored transposed in two groups of four,
+ * so that a box is tested against all six planes with a handful of SSE
+ * instructions.
+ */
+struct frustum
+{
+	/// The result of classifying a box against a frustum.
+	enum Classification
+	{
+		/// The box is completely outside the frustum.
+		kOutside,
+		/// The box straddles at least one of the planes.
+		kIntersecting,
+		/// The box is completely inside the frustum.
+		kInside
+	};
+
+	/// Plane indices.
+	enum Plane
+	{
+		kLeft = 0,
+		kRight,
+		kBottom,
+		kTop,
+		kNear,
+		kFar
+	};
+
+	/// A plane mask that has a bit set for every plane.
+	static constexpr unsigned kAllPlanes = 0x3f;
+
+	/// The six planes, in the order of the Plane enum.
+	vec4f planes[6];
+
+	/// Default constructor creates a frustum that contains everything.
+	frustum();
+
+	/**
+	 * @brief Constructor that extracts the planes of a clip space matrix.
+	 * @param projectionView The projection matrix times the view matrix,
+	 * for instance Camera::projectionMatrix() * Renderer::matrix_V(). If
+	 * you pass the full projection-view-model matrix then the planes are in
+	 * the local coordinates of the model.
+	 */
+	frustum(const mat4f& projectionView);
+
+	/**
+	 * @brief Check wether a point is inside this frustum.
+	 * @param point Some point.
+	 * @return True if the point is inside or on the boundary.
+	 */
+	bool contains(const vec3f& point) const noexcept;
+
+	/**
+	 * @brief Check wether a box is completely inside this frustum.
+	 * @param box Some bounding box.
+	 * @return True if the box is completely inside.
+	 */
+	bool contains(const box3f& box) const noexcept;
+
+	/**
+	 * @brief Classify a box against the planes in a plane mask.
+	 *
+	 * @details Only the planes whose bit is set in planeMask are tested.
+	 * On return, the bits of the planes that the box is completely inside of
+	 * are cleared. Because a child box is inside every plane its parent box
+	 * is inside of, a tree traversal can hand the updated mask down to the
+	 * children. Once the mask reaches zero, a subtree is completely inside
+	 * the frustum and no further tests are needed.
+	 *
+	 * The test is conservative: a box near a corner of the frustum may be
+	 * classified as intersecting even though it is outside.
+	 *
+	 * @param box The box to classify.
+	 * @param planeMask The mask of planes to test. It is updated.
+	 * @return The classification of the box.
+	 */
+	Classification classify(const box3f& box, unsigned& planeMask) const noexcept;
+
+	GINTONIC_DEFINE_SSE_OPERATOR_NEW_DELETE();
+
+private:
+
+	// The planes transposed: {a0 a1 a2 a3}, {b0 b1 b2 b3}, etc. The second
+	// group holds planes 4 and 5 and two planes that contain everything.
+	__m128 mA[2];
+	__m128 mB[2];
+	__m128 mC[2];
+	__m128 mD[2];
+
+	void transpose() noexcept;
+};
+
+/**
+ * @brief Check wether a box intersects a frustum.
+ * @param a Some frustum.
+ * @param b Some bounding box.
+ * @return False if the box is definitely outside the frustum, true
+ * otherwise.
+ */
+bool intersects(const frustum& a, const box3f& b) noexcept;
+
+/**
+ * @brief Output stream support for frustum.
+ *
+ * @param os An output stream.
+ * @param f Some frustum.
+ */
+std::ostream& operator << (std::ostream& os, const frustum& f);
+
+} // namespace gintonic
@@ -0,0 +1,92 @@
+/**
+ * @file ray3f.hpp
+ * @brief Defines a three-dimensional ray.
+ * @author Raoul Wols
+ */
+
+#pragma once
+
+#include "box3f.hpp"
+
+namespace gintonic {
+
+/**
+ * @brief A three-dimensional ray.
+ *
+ * @details A point on the ray is origin + t * direction with t >= 0. The
+ * reciprocal of the direction is precomputed once, so that testing a ray
+ * against many boxes with ray3f::intersects is a handful of SSE instructions
+ * per box.
+ */
+struct ray3f
+{
+	/// The origin of the ray.
+	vec3f origin;
+
+	/// The direction of the ray. Distances are measured in its length.
+	vec3f direction;
+
+	/// The componentwise reciprocal of the direction.
+	vec3f invDirection;
+
+	/// Default constructor creates a ray from the origin along the X-axis.
+	ray3f();
+
+	/**
+	 * @brief Constructor.
+	 * @param origin The origin of the ray.
+	 * @param direction The direction of the ray. It should not be the zero
+	 * vector, but it need not be normalized.
+	 */
+	ray3f(const vec3f& origin, const vec3f& direction);
+
+	/**
+	 * @brief Get a point on the ray.
+	 * @param distance The parameter t.
+	 * @return The point origin + t * direction.
+	 */
+	inline vec3f pointAt(const float distance) const noexcept
+	{
+		return origin + distance * direction;
+	}
+
+	/**
+	 * @brief Intersect this ray with a box with the slab method.
+	 * @details Only the part of the ray with minDistance <= t <= maxDistance
+	 * is considered. The box is closed: a ray that grazes an edge or that
+	 * runs inside one of the faces hits the box, and so does a ray whose
+	 * origin is inside the box. Degenerate (flat or point) boxes are
+	 * supported.
+	 * @param box The box to test.
+	 * @param minDistance The start of the considered part of the ray.
+	 * @param maxDistance The end of the considered part of the ray.
+	 * @param distance If the box is hit, this is set to the smallest t of
+	 * the part of the ray inside the box.
+	 * @return True if the box is hit, false otherwise.
+	 */
+	bool intersects(
+		const box3f& box,
+		const float minDistance,
+		const float maxDistance,
+		float& distance) const noexcept;
+
+	GINTONIC_DEFINE_SSE_OPERATOR_NEW_DELETE();
+};
+
+/**
+ * @brief Check wether a ray hits a box.
+ * @param a Some ray.
+ * @param b Some bounding box.
+ * @return True if the ray hits the box, false otherwise.
+ */
+bool intersects(const ray3f& a, const box3f& b) noexcept;
+
+/**
+ * @brief Output stream support for ray3f.
+ *
+ * @param os An output stream.
+ * @param r Some ray.
+ */
+std::ostream& operator << (std::ostream& os, const ray3f& r);
+
+} // namespace gintonic
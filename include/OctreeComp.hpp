@@ -1,7 +1,11 @@
 #pragma once
 
 #include "Component.hpp"
+#include "Foundation/SpatialStatistics.hpp"
 #include "Math/box3f.hpp"
+#include "Math/frustum.hpp"
+#include "Math/ray3f.hpp"
+#include <boost/serialization/version.hpp>
 #include <vector>
 
 namespace gintonic
@@ -17,6 +21,79 @@ class OctreeComp : public Component
     GT_COMPONENT_SERIALIZATION_BOILERPLATE(OctreeComp);
 
   public:
+    /**
+     * @brief      The results of a batch of box queries, in one flat buffer.
+     *
+     * @details    Keep a QueryBatch around from frame to frame, so that its
+     *             buffers are reused.
+     */
+    class QueryBatch
+    {
+      public:
+        /**
+         * @brief      Get the number of queries in the batch.
+         *
+         * @return     The number of queries.
+         */
+        std::size_t size() const noexcept
+        {
+            return mOffsets.empty() ? 0 : mOffsets.size() - 1;
+        }
+
+        /**
+         * @brief      Get the first result of a query.
+         *
+         * @param[in]  query  The index of the query.
+         *
+         * @return     A pointer to the first result.
+         */
+        OctreeComp* const* begin(const std::size_t query) const noexcept
+        {
+            return mResults.data() + mOffsets[query];
+        }
+
+        /**
+         * @brief      Get one past the last result of a query.
+         *
+         * @param[in]  query  The index of the query.
+         *
+         * @return     A pointer one past the last result.
+         */
+        OctreeComp* const* end(const std::size_t query) const noexcept
+        {
+            return mResults.data() + mOffsets[query + 1];
+        }
+
+        /**
+         * @brief      Get the number of results of a query.
+         *
+         * @param[in]  query  The index of the query.
+         *
+         * @return     The number of results.
+         */
+        std::size_t count(const std::size_t query) const noexcept
+        {
+            return mOffsets[query + 1] - mOffsets[query];
+        }
+
+        /**
+         * @brief      Get the results of all queries.
+         *
+         * @return     The results of all queries, in the order of the
+         *             queries.
+         */
+        const std::vector<OctreeComp*>& results() const noexcept
+        {
+            return mResults;
+        }
+
+      private:
+        friend class OctreeComp;
+        std::vector<OctreeComp*> mResults;
+        std::vector<std::size_t> mOffsets;
+        std::vector<std::vector<OctreeComp*>> mPackets;
+    };
+
     class Node
     {
       public:
@@ -45,6 +122,189 @@ class OctreeComp : public Component
          */
         template <class F> void query(const box3f& volume, F f) const;
 
+        /**
+         * @brief      Apply a unary function to all OctreeComp in the given
+         *             frustum.
+         *
+         * @details    A plane mask is carried down the tree, so that a node
+         *             is only tested against the planes that its parent
+         *             straddles. Subtrees that are completely inside the
+         *             frustum are handed to `apply` without further tests.
+         *
+         * @param[in]  volume  The frustum.
+         * @param[in]  f       The unary function. The parameter must be of type
+         *                     `OctreeComp*`. Its return value must be `void`.
+         *
+         * @tparam     F       Automatically deduced.
+         */
+        template <class F> void query(const frustum& volume, F f);
+
+        /**
+         * @brief      Apply a unary function to all OctreeComp in the given
+         *             frustum.
+         *
+         * @param[in]  volume  The frustum.
+         * @param[in]  f       The unary function. The parameter must be of type
+         *                     `const OctreeComp*`. Its return value must be
+         * `void`.
+         *
+         * @tparam     F       Automatically deduced.
+         */
+        template <class F> void query(const frustum& volume, F f) const;
+
+        /**
+         * @brief      Find the closest OctreeComp that a ray hits.
+         *
+         * @details    The children of every node are visited front to back
+         *             along the ray. A child that starts beyond the closest
+         *             hit found so far is skipped, together with all
+         *             children behind it.
+         *
+         * @param[in]  origin       The origin of the ray.
+         * @param[in]  direction    The direction of the ray. It need not be
+         *                          normalized.
+         * @param[in]  maxDistance  The maximum distance along the ray.
+         * @param[out] distance     The distance to the hit, if any.
+         *
+         * @return     The closest OctreeComp, or `nullptr`.
+         */
+        OctreeComp* raycast(const vec3f& origin, const vec3f& direction,
+                            const float maxDistance, float& distance);
+
+        /**
+         * @brief      Find the closest OctreeComp that a ray hits.
+         *
+         * @param[in]  origin       The origin of the ray.
+         * @param[in]  direction    The direction of the ray. It need not be
+         *                          normalized.
+         * @param[in]  maxDistance  The maximum distance along the ray.
+         * @param[out] distance     The distance to the hit, if any.
+         *
+         * @return     The closest OctreeComp, or `nullptr`.
+         */
+        const OctreeComp* raycast(const vec3f& origin, const vec3f& direction,
+                                  const float maxDistance,
+                                  float& distance) const;
+
+        /**
+         * @brief      Apply a binary function to all OctreeComp that a ray
+         *             hits, in order of increasing distance.
+         *
+         * @param[in]  origin       The origin of the ray.
+         * @param[in]  direction    The direction of the ray. It need not be
+         *                          normalized.
+         * @param[in]  maxDistance  The maximum distance along the ray.
+         * @param[in]  f            The binary function. The parameters must
+         *                          be of type `OctreeComp*` and `float`. Its
+         *                          return value must be `void`.
+         *
+         * @tparam     F            Automatically deduced.
+         */
+        template <class F>
+        void raycastAll(const vec3f& origin, const vec3f& direction,
+                        const float maxDistance, F f);
+
+        /**
+         * @brief      Apply a binary function to all OctreeComp that a ray
+         *             hits, in order of increasing distance.
+         *
+         * @param[in]  origin       The origin of the ray.
+         * @param[in]  direction    The direction of the ray. It need not be
+         *                          normalized.
+         * @param[in]  maxDistance  The maximum distance along the ray.
+         * @param[in]  f            The binary function. The parameters must
+         *                          be of type `const OctreeComp*` and
+         *                          `float`. Its return value must be `void`.
+         *
+         * @tparam     F            Automatically deduced.
+         */
+        template <class F>
+        void raycastAll(const vec3f& origin, const vec3f& direction,
+                        const float maxDistance, F f) const;
+
+        /**
+         * @brief      Apply a binary function to the k OctreeComp nearest to
+         *             a point, nearest first.
+         *
+         * @details    The distance of an OctreeComp is the distance from the
+         *             point to its bounds. The nodes are visited best-first.
+         *             Once k components are found, nodes that are farther
+         *             away than the k-th nearest one are skipped.
+         *
+         * @param[in]  point  The point to search around.
+         * @param[in]  k      The maximum number of components.
+         * @param[in]  f      The binary function. The parameters must be of
+         *                    type `OctreeComp*` and `float`. Its return value
+         *                    must be `void`.
+         *
+         * @tparam     F      Automatically deduced.
+         */
+        template <class F>
+        void nearest(const vec3f& point, const std::size_t k, F f);
+
+        /**
+         * @brief      Apply a binary function to the k OctreeComp nearest to
+         *             a point, nearest first.
+         *
+         * @param[in]  point  The point to search around.
+         * @param[in]  k      The maximum number of components.
+         * @param[in]  f      The binary function. The parameters must be of
+         *                    type `const OctreeComp*` and `float`. Its return
+         *                    value must be `void`.
+         *
+         * @tparam     F      Automatically deduced.
+         */
+        template <class F>
+        void nearest(const vec3f& point, const std::size_t k, F f) const;
+
+        /**
+         * @brief      Apply a unary function to all OctreeComp within a
+         *             distance of a point.
+         *
+         * @param[in]  point   The center of the sphere.
+         * @param[in]  radius  The radius of the sphere.
+         * @param[in]  f       The unary function. The parameter must be of
+         *                     type `OctreeComp*`. Its return value must be
+         *                     `void`.
+         *
+         * @tparam     F       Automatically deduced.
+         */
+        template <class F>
+        void withinRadius(const vec3f& point, const float radius, F f);
+
+        /**
+         * @brief      Apply a unary function to all OctreeComp within a
+         *             distance of a point.
+         *
+         * @param[in]  point   The center of the sphere.
+         * @param[in]  radius  The radius of the sphere.
+         * @param[in]  f       The unary function. The parameter must be of
+         *                     type `const OctreeComp*`. Its return value must
+         *                     be `void`.
+         *
+         * @tparam     F       Automatically deduced.
+         */
+        template <class F>
+        void withinRadius(const vec3f& point, const float radius, F f) const;
+
+        /**
+         * @brief      Run many box queries at once.
+         *
+         * @details    The queries are grouped into packets. Every packet
+         *             traverses the tree once, and every node tests all the
+         *             boxes of the packet that reach it. The packets run in
+         *             parallel on the global ThreadPool.
+         *
+         *             The bounds of the components are computed on worker
+         *             threads, so do not move entities while the batch runs.
+         *             Run it after the per-frame update.
+         *
+         * @param[in]  first  Pointer to the first query volume.
+         * @param[in]  last   Pointer one past the last query volume.
+         * @param[out] batch  The results, per query.
+         */
+        void query(const box3f* first, const box3f* last, QueryBatch& batch);
+
         Node* getRoot() noexcept;
         const Node* getRoot() const noexcept;
 
@@ -58,6 +318,17 @@ class OctreeComp : public Component
         bool isLeaf() const noexcept;
         bool hasNoOctreeComponents() const noexcept;
 
+        /**
+         * @brief      Get statistics about the shape of this node and all of
+         *             its children.
+         *
+         * @details    Use them to tune the size of the root. This method
+         *             recurses into the tree.
+         *
+         * @return     Statistics about the shape of the tree.
+         */
+        SpatialStatistics statistics() const;
+
       private:
         box3f mBounds;
         void* mAllocPlace = nullptr;
@@ -68,12 +339,40 @@ class OctreeComp : public Component
         Node(Node* parent, const vec3f& min, const vec3f& max);
         void insert(OctreeComp*);
         OctreeComp::Node* remove(OctreeComp*) noexcept;
+        bool erase(OctreeComp*) noexcept;
         void update(OctreeComp*);
         void insertRecursive(OctreeComp*);
+        void insertFat(OctreeComp*);
         OctreeComp::Node* removeRecursive() noexcept;
         void subdivide();
+        void gatherStatistics(SpatialStatistics& statistics,
+                              const std::size_t depth) const;
+        using QueryAndComp = std::pair<unsigned, OctreeComp*>;
+        void queryPacket(const box3f* volumes, const unsigned count,
+                         const unsigned mask,
+                         std::vector<QueryAndComp>& hits) const;
+        using DistanceAndComp = std::pair<float, OctreeComp*>;
+        void raycastRecursive(const ray3f& ray, float& maxDistance,
+                              const bool closestOnly,
+                              std::vector<DistanceAndComp>& hits) const;
+        void raycastSorted(const vec3f& origin, const vec3f& direction,
+                           const float maxDistance,
+                           std::vector<DistanceAndComp>& hits) const;
+        void nearestSorted(const vec3f& point, const std::size_t k,
+                           std::vector<DistanceAndComp>& result) const;
+        template <class F>
+        void withinRadiusRecursive(const vec3f& point, const float radius2,
+                                   F f);
+        template <class F>
+        void withinRadiusRecursive(const vec3f& point, const float radius2,
+                                   F f) const;
         template <class F> void apply(F f);
         template <class F> void apply(F f) const;
+        template <class F>
+        void queryFrustum(const frustum& volume, unsigned planeMask, F f);
+        template <class F>
+        void queryFrustum(const frustum& volume, unsigned planeMask,
+                          F f) const;
     };
 
     OctreeComp(EntityBase* owner);
@@ -84,6 +383,56 @@ class OctreeComp : public Component
 
     void setNode(Node& node);
 
+    /**
+     * @brief      Set the margin by which the bounds are inflated when this
+     *             OctreeComp is inserted into a node.
+     *
+     * @details    The octree keeps the inflated bounds, and only relocates
+     *             this OctreeComp once the collider leaves them. A larger
+     *             margin means fewer relocations, but the OctreeComp may end
+     *             up in a larger node than necessary. The new margin takes
+     *             effect at the next relocation.
+     *
+     * @param[in]  margin  The margin, in world units. It must not be negative.
+     */
+    void setMargin(const float margin) noexcept { mMargin = margin; }
+
+    /**
+     * @brief      Get the margin by which the bounds are inflated.
+     *
+     * @return     The margin, in world units.
+     */
+    float getMargin() const noexcept { return mMargin; }
+
+    /**
+     * @brief      Mark this OctreeComp as static or dynamic.
+     *
+     * @details    A static OctreeComp is never relocated by the per-frame
+     *             update. Marking it static relocates it one last time, so
+     *             move the entity into place first. To move a static entity
+     *             later on, mark it dynamic again.
+     *
+     * @param[in]  isStatic  Wether this OctreeComp is static.
+     */
+    void setStatic(const bool isStatic);
+
+    /**
+     * @brief      Determine wether this OctreeComp is static.
+     *
+     * @return     True if static, false if dynamic.
+     */
+    bool isStatic() const noexcept { return mStatic; }
+
+    /**
+     * @brief      Get the inflated bounds with which this OctreeComp was last
+     *             inserted into a node.
+     *
+     * @return     The inflated bounds.
+     */
+    const box3f& getFatBounds() const noexcept { return mFatBounds; }
+
+    GINTONIC_DEFINE_SSE_OPERATOR_NEW_DELETE();
+
     static bool classOf(const Component* comp)
     {
         return comp->getKind() == Kind::OctreeComp;
@@ -97,24 +446,39 @@ class OctreeComp : public Component
     Node* mNode = nullptr;
     Transform* mTransform = nullptr;
     Collider* mCollider = nullptr;
+    box3f mFatBounds;
+    float mMargin;
+    bool mStatic = false;
 
     std::unique_ptr<Component> clone(EntityBase* newOwner) const override;
 
     box3f getBounds() const noexcept;
 
+    // Version 0 archives have no margin and no static flag. They get the
+    // defaults.
     template <class Archive>
-    void serialize(Archive& archive, const unsigned /*version*/)
+    void serialize(Archive& archive, const unsigned version)
     {
         using namespace boost::serialization;
         archive& BOOST_SERIALIZATION_BASE_OBJECT_NVP(Component);
+        if (version >= 1)
+        {
+            archive& make_nvp("margin", mMargin) & make_nvp("static", mStatic);
+        }
     }
 };
 
 template <class F> void OctreeComp::Node::query(const box3f& volume, F f)
 {
+    GT_SPATIAL_COUNT(nodesVisited, 1);
+    GT_SPATIAL_COUNT(boxesTested, mComps.size());
     for (auto* comp : mComps)
     {
-        if (intersects(volume, comp->getBounds())) f(comp);
+        if (intersects(volume, comp->getBounds()))
+        {
+            f(comp);
+            GT_SPATIAL_COUNT(results, 1);
+        }
     }
 
     // Case 0: If this is a leaf node, return now.
@@ -189,9 +553,15 @@ template <class F> void OctreeComp::Node::query(const box3f& volume, F f)
 
 template <class F> void OctreeComp::Node::query(const box3f& volume, F f) const
 {
+    GT_SPATIAL_COUNT(nodesVisited, 1);
+    GT_SPATIAL_COUNT(boxesTested, mComps.size());
     for (const auto* comp : mComps)
     {
-        if (intersects(volume, comp->getBounds())) f(comp);
+        if (intersects(volume, comp->getBounds()))
+        {
+            f(comp);
+            GT_SPATIAL_COUNT(results, 1);
+        }
     }
     if (isLeaf()) return;
     for (const auto* child : mChildren)
@@ -214,8 +584,190 @@ template <class F> void OctreeComp::Node::query(const box3f& volume, F f) const
     }
 }
 
+template <class F> void OctreeComp::Node::query(const frustum& volume, F f)
+{
+    queryFrustum(volume, frustum::kAllPlanes, f);
+}
+
+template <class F>
+void OctreeComp::Node::query(const frustum& volume, F f) const
+{
+    queryFrustum(volume, frustum::kAllPlanes, f);
+}
+
+template <class F>
+void OctreeComp::Node::queryFrustum(const frustum& volume, unsigned planeMask,
+                                    F f)
+{
+    switch (volume.classify(mBounds, planeMask))
+    {
+    case frustum::kOutside:
+        GT_SPATIAL_COUNT(nodesVisited, 1);
+        return;
+    case frustum::kInside:
+        // The whole subtree is visible.
+        apply(f);
+        return;
+    default:
+        break;
+    }
+    GT_SPATIAL_COUNT(nodesVisited, 1);
+    GT_SPATIAL_COUNT(boxesTested, mComps.size());
+    for (auto* comp : mComps)
+    {
+        auto compMask = planeMask;
+        if (volume.classify(comp->getBounds(), compMask) != frustum::kOutside)
+        {
+            f(comp);
+            GT_SPATIAL_COUNT(results, 1);
+        }
+    }
+    if (isLeaf()) return;
+    for (auto* child : mChildren) child->queryFrustum(volume, planeMask, f);
+}
+
+template <class F>
+void OctreeComp::Node::queryFrustum(const frustum& volume, unsigned planeMask,
+                                    F f) const
+{
+    switch (volume.classify(mBounds, planeMask))
+    {
+    case frustum::kOutside:
+        GT_SPATIAL_COUNT(nodesVisited, 1);
+        return;
+    case frustum::kInside:
+        apply(f);
+        return;
+    default:
+        break;
+    }
+    GT_SPATIAL_COUNT(nodesVisited, 1);
+    GT_SPATIAL_COUNT(boxesTested, mComps.size());
+    for (const auto* comp : mComps)
+    {
+        auto compMask = planeMask;
+        if (volume.classify(comp->getBounds(), compMask) != frustum::kOutside)
+        {
+            f(comp);
+            GT_SPATIAL_COUNT(results, 1);
+        }
+    }
+    if (isLeaf()) return;
+    for (const auto* child : mChildren)
+    {
+        child->queryFrustum(volume, planeMask, f);
+    }
+}
+
+template <class F>
+void OctreeComp::Node::raycastAll(const vec3f& origin, const vec3f& direction,
+                                  const float maxDistance, F f)
+{
+    std::vector<DistanceAndComp> hits;
+    raycastSorted(origin, direction, maxDistance, hits);
+    for (const auto& hit : hits) f(hit.second, hit.first);
+}
+
+template <class F>
+void OctreeComp::Node::raycastAll(const vec3f& origin, const vec3f& direction,
+                                  const float maxDistance, F f) const
+{
+    std::vector<DistanceAndComp> hits;
+    raycastSorted(origin, direction, maxDistance, hits);
+    for (const auto& hit : hits)
+    {
+        f(static_cast<const OctreeComp*>(hit.second), hit.first);
+    }
+}
+
+template <class F>
+void OctreeComp::Node::nearest(const vec3f& point, const std::size_t k, F f)
+{
+    std::vector<DistanceAndComp> result;
+    nearestSorted(point, k, result);
+    for (const auto& pair : result) f(pair.second, pair.first);
+}
+
+template <class F>
+void OctreeComp::Node::nearest(const vec3f& point, const std::size_t k,
+                               F f) const
+{
+    std::vector<DistanceAndComp> result;
+    nearestSorted(point, k, result);
+    for (const auto& pair : result)
+    {
+        f(static_cast<const OctreeComp*>(pair.second), pair.first);
+    }
+}
+
+template <class F>
+void OctreeComp::Node::withinRadius(const vec3f& point, const float radius,
+                                    F f)
+{
+    withinRadiusRecursive(point, radius * radius, f);
+}
+
+template <class F>
+void OctreeComp::Node::withinRadius(const vec3f& point, const float radius,
+                                    F f) const
+{
+    withinRadiusRecursive(point, radius * radius, f);
+}
+
+template <class F>
+void OctreeComp::Node::withinRadiusRecursive(const vec3f& point,
+                                             const float radius2, F f)
+{
+    GT_SPATIAL_COUNT(nodesVisited, 1);
+    GT_SPATIAL_COUNT(boxesTested, mComps.size());
+    for (auto* comp : mComps)
+    {
+        if (distance2(comp->getBounds(), point) <= radius2)
+        {
+            f(comp);
+            GT_SPATIAL_COUNT(results, 1);
+        }
+    }
+    if (isLeaf()) return;
+    for (auto* child : mChildren)
+    {
+        if (child->isLeaf() && child->hasNoOctreeComponents()) continue;
+        if (distance2(child->mBounds, point) <= radius2)
+        {
+            child->withinRadiusRecursive(point, radius2, f);
+        }
+    }
+}
+
+template <class F>
+void OctreeComp::Node::withinRadiusRecursive(const vec3f& point,
+                                             const float radius2, F f) const
+{
+    GT_SPATIAL_COUNT(nodesVisited, 1);
+    GT_SPATIAL_COUNT(boxesTested, mComps.size());
+    for (const auto* comp : mComps)
+    {
+        if (distance2(comp->getBounds(), point) <= radius2)
+        {
+            f(comp);
+            GT_SPATIAL_COUNT(results, 1);
+        }
+    }
+    if (isLeaf()) return;
+    for (const auto* child : mChildren)
+    {
+        if (child->isLeaf() && child->hasNoOctreeComponents()) continue;
+        if (distance2(child->mBounds, point) <= radius2)
+        {
+            child->withinRadiusRecursive(point, radius2, f);
+        }
+    }
+}
+
 template <class F> void OctreeComp::Node::apply(F f)
 {
+    GT_SPATIAL_COUNT(nodesVisited, 1);
+    GT_SPATIAL_COUNT(results, mComps.size());
     for (auto* comp : mComps) f(comp);
     if (isLeaf()) return;
     for (auto* child : mChildren) child->apply(f);
@@ -223,9 +775,13 @@ template <class F> void OctreeComp::Node::apply(F f)
 
 template <class F> void OctreeComp::Node::apply(F f) const
 {
+    GT_SPATIAL_COUNT(nodesVisited, 1);
+    GT_SPATIAL_COUNT(results, mComps.size());
     for (const auto* comp : mComps) f(comp);
     if (isLeaf()) return;
     for (const auto* child : mChildren) child->apply(f);
 }
 
 } // gintonic
+
+BOOST_CLASS_VERSION(gintonic::OctreeComp, 1);
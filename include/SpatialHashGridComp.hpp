@@ -0,0 +1,365 @@
+#pragma once
+
+#include "Component.hpp"
+#include "Foundation/SpatialStatistics.hpp"
+#include "Foundation/allocator.hpp"
+#include "Math/box3f.hpp"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace gintonic
+{
+
+class Transform;
+class Collider;
+
+/**
+ * @brief      Puts the Collider of an Entity in a uniform spatial hash grid.
+ *
+ * @details    This is an alternative to OctreeComp and AABBTreeComp for
+ *             swarms of small, similarly sized objects that all move every
+ *             frame, like projectiles or crowd agents. Instead of updating
+ *             a tree object by object, the grid is rebuilt as a whole once
+ *             per frame. Every component goes into the cell that contains
+ *             the center of its bounds, so choose a cell size of about the
+ *             size of the objects.
+ */
+class SpatialHashGridComp : public Component
+{
+    GT_COMPONENT_SERIALIZATION_BOILERPLATE(SpatialHashGridComp);
+
+  public:
+    class Grid
+    {
+      public:
+        /**
+         * @brief      Apply a unary function to all SpatialHashGridComp in
+         *             the given volume.
+         *
+         * @details    The bounds of the components as of the last rebuild
+         *             are used. Components added since then are not found.
+         *
+         * @param[in]  volume  The volume.
+         * @param[in]  f       The unary function. The parameter must be of
+         *                     type `SpatialHashGridComp*`. Its return value
+         *                     must be `void`.
+         *
+         * @tparam     F       Automatically deduced.
+         */
+        template <class F> void query(const box3f& volume, F f);
+
+        /**
+         * @brief      Apply a unary function to all SpatialHashGridComp in
+         *             the given volume.
+         *
+         * @param[in]  volume  The volume.
+         * @param[in]  f       The unary function. The parameter must be of
+         *                     type `const SpatialHashGridComp*`. Its return
+         *                     value must be `void`.
+         *
+         * @tparam     F       Automatically deduced.
+         */
+        template <class F> void query(const box3f& volume, F f) const;
+
+        /**
+         * @brief      Apply a unary function to all SpatialHashGridComp
+         *             within a distance of a point.
+         *
+         * @param[in]  point   The center of the sphere.
+         * @param[in]  radius  The radius of the sphere.
+         * @param[in]  f       The unary function. The parameter must be of
+         *                     type `SpatialHashGridComp*`. Its return value
+         *                     must be `void`.
+         *
+         * @tparam     F       Automatically deduced.
+         */
+        template <class F>
+        void withinRadius(const vec3f& point, const float radius, F f);
+
+        /**
+         * @brief      Apply a unary function to all SpatialHashGridComp
+         *             within a distance of a point.
+         *
+         * @param[in]  point   The center of the sphere.
+         * @param[in]  radius  The radius of the sphere.
+         * @param[in]  f       The unary function. The parameter must be of
+         *                     type `const SpatialHashGridComp*`. Its return
+         *                     value must be `void`.
+         *
+         * @tparam     F       Automatically deduced.
+         */
+        template <class F>
+        void withinRadius(const vec3f& point, const float radius,
+                          F f) const;
+
+        /**
+         * @brief      Constructor.
+         *
+         * @param[in]  cellSize  The length of the edges of the cells, in
+         *                       world units.
+         */
+        explicit Grid(const float cellSize);
+
+        Grid(const Grid&) = delete;
+        Grid& operator=(const Grid&) = delete;
+        ~Grid() noexcept;
+
+        /**
+         * @brief      Set the length of the edges of the cells.
+         *
+         * @details    The new cell size takes effect at the next rebuild.
+         *
+         * @param[in]  cellSize  The cell size, in world units. It must be
+         *                       positive.
+         */
+        void setCellSize(const float cellSize) noexcept
+        {
+            mNextCellSize = cellSize;
+        }
+
+        /**
+         * @brief      Get the length of the edges of the cells.
+         *
+         * @return     The cell size, in world units.
+         */
+        float getCellSize() const noexcept { return mNextCellSize; }
+
+        /**
+         * @brief      Put all components in their cells again.
+         *
+         * @details    Call this once per frame, after the entities have
+         *             moved. The bounds of all components are gathered and
+         *             sorted into the cells with a counting sort. Gathering
+         *             the bounds and filling the cells run in parallel on
+         *             the global ThreadPool, so do not move entities while
+         *             the rebuild runs. Counting the components per cell
+         *             runs on the calling thread.
+         */
+        void rebuild();
+
+        /**
+         * @brief      Get the number of SpatialHashGridComp in this grid.
+         *
+         * @return     The number of SpatialHashGridComp.
+         */
+        std::size_t count() const noexcept { return mComps.size(); }
+
+        /**
+         * @brief      Get the number of non-empty cells as of the last
+         *             rebuild.
+         *
+         * @return     The number of non-empty cells.
+         */
+        std::size_t cellCount() const noexcept { return mCells.size(); }
+
+        /**
+         * @brief      Get the number of bytes that the grid allocated.
+         *
+         * @return     The memory usage in bytes, including the scratch
+         *             space of the rebuild.
+         */
+        std::size_t memoryUsage() const noexcept;
+
+      private:
+        // A component and its bounds as of the last rebuild. The entries of
+        // a cell are contiguous. The component is null if it was removed
+        // since.
+        struct Entry
+        {
+            box3f bounds;
+            SpatialHashGridComp* comp;
+        };
+
+        // A slot of the open addressing hash table of cells.
+        struct Slot
+        {
+            std::uint64_t key;
+            std::uint32_t cell;
+        };
+
+        // The range of entries of a non-empty cell.
+        struct Cell
+        {
+            std::uint32_t first;
+            std::uint32_t count;
+        };
+
+        static constexpr std::uint64_t kEmpty = ~std::uint64_t(0);
+        static constexpr std::uint32_t kNone = ~std::uint32_t(0);
+
+        std::vector<SpatialHashGridComp*> mComps;
+        std::vector<Entry, allocator<Entry>> mEntries;
+        std::vector<Slot> mSlots;
+        std::vector<Cell> mCells;
+        float mCellSize;
+        float mInverseCellSize;
+        float mNextCellSize;
+
+        // Scratch space for the rebuild, per component.
+        std::vector<box3f, allocator<box3f>> mBounds;
+        std::vector<std::uint64_t> mKeys;
+        std::vector<std::uint32_t> mCellOfComp;
+        std::vector<std::uint32_t> mRankInCell;
+
+        // The largest distance from the center of the bounds of a component
+        // to their boundary, along any axis. Queries look that much further.
+        float mReach = 0.0f;
+
+        // Packs 21 bits of every cell coordinate. Cells that are a multiple
+        // of 2^21 cells apart share a key, which only costs some extra
+        // bounds tests.
+        static std::uint64_t cellKey(const int x, const int y,
+                                     const int z) noexcept
+        {
+            const std::uint64_t mask = 0x1fffff;
+            return ((std::uint64_t(x) & mask) << 42) |
+                   ((std::uint64_t(y) & mask) << 21) | (std::uint64_t(z) & mask);
+        }
+
+        friend class SpatialHashGridComp;
+        void insert(SpatialHashGridComp* comp);
+        void remove(SpatialHashGridComp* comp) noexcept;
+        int cellCoordinate(const float value) const noexcept;
+        Slot& findOrInsert(const std::uint64_t key) noexcept;
+        const Slot* find(const std::uint64_t key) const noexcept;
+        template <class F>
+        void forEachCandidate(const box3f& region, F f) const;
+        template <class F> void queryImpl(const box3f& volume, F& f) const;
+        template <class F>
+        void withinRadiusImpl(const vec3f& point, const float radius,
+                              F& f) const;
+    };
+
+    SpatialHashGridComp(EntityBase* owner);
+    ~SpatialHashGridComp() noexcept override;
+
+    Grid* getGrid() noexcept { return mGrid; }
+    const Grid* getGrid() const noexcept { return mGrid; }
+
+    void setGrid(Grid& grid);
+
+    static bool classOf(const Component* comp)
+    {
+        return comp->getKind() == Kind::SpatialHashGridComp;
+    }
+
+  private:
+    friend class Grid;
+    Grid* mGrid = nullptr;
+    std::uint32_t mIndex = Grid::kNone;
+    std::uint32_t mEntry = Grid::kNone;
+    Transform* mTransform = nullptr;
+    Collider* mCollider = nullptr;
+
+    std::unique_ptr<Component> clone(EntityBase* newOwner) const override;
+
+    box3f getBounds() const noexcept;
+
+    template <class Archive>
+    void serialize(Archive& archive, const unsigned /*version*/)
+    {
+        archive& BOOST_SERIALIZATION_BASE_OBJECT_NVP(Component);
+    }
+};
+
+template <class F>
+void SpatialHashGridComp::Grid::query(const box3f& volume, F f)
+{
+    queryImpl(volume, f);
+}
+
+template <class F>
+void SpatialHashGridComp::Grid::query(const box3f& volume, F f) const
+{
+    queryImpl(volume, f);
+}
+
+template <class F>
+void SpatialHashGridComp::Grid::withinRadius(const vec3f& point,
+                                             const float radius, F f)
+{
+    withinRadiusImpl(point, radius, f);
+}
+
+template <class F>
+void SpatialHashGridComp::Grid::withinRadius(const vec3f& point,
+                                             const float radius, F f) const
+{
+    withinRadiusImpl(point, radius, f);
+}
+
+template <class F>
+void SpatialHashGridComp::Grid::queryImpl(const box3f& volume, F& f) const
+{
+    const vec3f reach(mReach, mReach, mReach);
+    const box3f region(volume.minCorner - reach, volume.maxCorner + reach);
+    forEachCandidate(region, [&](const Entry& entry) {
+        GT_SPATIAL_COUNT(boxesTested, 1);
+        if (entry.comp && intersects(volume, entry.bounds))
+        {
+            f(entry.comp);
+            GT_SPATIAL_COUNT(results, 1);
+        }
+    });
+}
+
+template <class F>
+void SpatialHashGridComp::Grid::withinRadiusImpl(const vec3f& point,
+                                                 const float radius,
+                                                 F& f) const
+{
+    const auto radius2 = radius * radius;
+    const vec3f reach(radius + mReach, radius + mReach, radius + mReach);
+    const box3f region(point - reach, point + reach);
+    forEachCandidate(region, [&](const Entry& entry) {
+        GT_SPATIAL_COUNT(boxesTested, 1);
+        if (entry.comp && distance2(entry.bounds, point) <= radius2)
+        {
+            f(entry.comp);
+            GT_SPATIAL_COUNT(results, 1);
+        }
+    });
+}
+
+template <class F>
+void SpatialHashGridComp::Grid::forEachCandidate(const box3f& region,
+                                                 F f) const
+{
+    if (mEntries.empty()) return;
+    const int minCell[3] = {cellCoordinate(region.minCorner.x),
+                            cellCoordinate(region.minCorner.y),
+                            cellCoordinate(region.minCorner.z)};
+    const int maxCell[3] = {cellCoordinate(region.maxCorner.x),
+                            cellCoordinate(region.maxCorner.y),
+                            cellCoordinate(region.maxCorner.z)};
+
+    // Looking up every cell of a large region costs more than testing all
+    // entries. Huge regions would also visit cells with the same key twice.
+    double cells = 1.0;
+    for (int i = 0; i < 3; ++i) cells *= double(maxCell[i] - minCell[i]) + 1.0;
+    if (cells > double(mCells.size()) || cells >= double(0x1fffff))
+    {
+        GT_SPATIAL_COUNT(nodesVisited, 1);
+        for (const auto& entry : mEntries) f(entry);
+        return;
+    }
+
+    for (int x = minCell[0]; x <= maxCell[0]; ++x)
+    {
+        for (int y = minCell[1]; y <= maxCell[1]; ++y)
+        {
+            for (int z = minCell[2]; z <= maxCell[2]; ++z)
+            {
+                GT_SPATIAL_COUNT(nodesVisited, 1);
+                const auto* slot = find(cellKey(x, y, z));
+                if (!slot) continue;
+                const auto& cell = mCells[slot->cell];
+                const auto last = cell.first + cell.count;
+                for (auto i = cell.first; i != last; ++i) f(mEntries[i]);
+            }
+        }
+    }
+}
+
+} // namespace gintonic
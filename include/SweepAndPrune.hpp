@@ -0,0 +1,216 @@
+#pragma once
+
+#include "Foundation/SpatialStatistics.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace gintonic
+{
+
+class Collider;
+
+/**
+ * @brief      Finds the pairs of Collider components whose bounds overlap.
+ *
+ * @details    This is an incremental sweep-and-prune broadphase. For each
+ *             axis, it keeps the minimum and maximum endpoints of the global
+ *             bounds of every Collider in a sorted list. Colliders move
+ *             only a little from one frame to the next, so the lists are
+ *             nearly sorted. An insertion sort restores the order in close
+ *             to linear time. Two colliders start or stop overlapping
+ *             exactly when the sort swaps an endpoint of one with an
+ *             endpoint of the other, so the overlapping pairs are
+ *             maintained without ever testing all pairs. They are kept in
+ *             a hash table with open addressing.
+ *
+ *             Colliders that are added or removed in bulk would make the
+ *             insertion sort quadratic, so they are handled once per
+ *             update instead. The endpoints of new colliders are sorted
+ *             and merged into the lists, and a sweep along the first axis
+ *             finds their overlaps. The endpoints and pairs of removed
+ *             colliders are dropped in one pass.
+ *
+ *             Call update once per frame. It reports every overlapping pair
+ *             as an Overlap::Begin, Overlap::Persist or Overlap::End event.
+ *             A Collider removes itself when it is destroyed. No
+ *             Overlap::End events are reported for its pairs.
+ */
+class SweepAndPrune
+{
+  public:
+    /// The kind of overlap event.
+    enum class Overlap
+    {
+        Begin,   ///< The pair started overlapping this frame.
+        Persist, ///< The pair overlapped in the previous frame, too.
+        End      ///< The pair stopped overlapping this frame.
+    };
+
+    SweepAndPrune();
+    SweepAndPrune(const SweepAndPrune&) = delete;
+    SweepAndPrune& operator=(const SweepAndPrune&) = delete;
+    ~SweepAndPrune() noexcept;
+
+    /**
+     * @brief      Add a Collider.
+     *
+     * @details    Its overlaps are reported from the next update on. A
+     *             Collider can be in at most one SweepAndPrune; adding it
+     *             to another one removes it from the first. Does nothing
+     *             if the Collider is in this SweepAndPrune already.
+     *
+     * @param[in]  collider  The Collider.
+     */
+    void add(Collider* collider);
+
+    /**
+     * @brief      Remove a Collider.
+     *
+     * @details    No Overlap::End events are reported for its pairs. They
+     *             are dropped by the next update. Does nothing if the
+     *             Collider is not in this SweepAndPrune.
+     *
+     * @param[in]  collider  The Collider.
+     */
+    void remove(Collider* collider) noexcept;
+
+    /**
+     * @brief      Update the bounds of all colliders, and apply a function
+     *             to every overlapping pair.
+     *
+     * @param[in]  f     The function. The parameters must be of type
+     *                   `Collider*`, `Collider*` and `Overlap`. Its return
+     *                   value must be `void`. It must not add or remove
+     *                   colliders.
+     *
+     * @tparam     F     Automatically deduced.
+     */
+    template <class F> void update(F f);
+
+    /**
+     * @brief      Get the number of colliders.
+     *
+     * @return     The number of colliders.
+     */
+    std::size_t count() const noexcept { return mCount; }
+
+    /**
+     * @brief      Get the number of overlapping pairs.
+     *
+     * @details    This includes the pairs that are about to be reported as
+     *             Overlap::End, and the pairs of colliders that were
+     *             removed since the last update.
+     *
+     * @return     The number of overlapping pairs.
+     */
+    std::size_t pairCount() const noexcept { return mPairCount; }
+
+  private:
+    // A Collider and a copy of its global bounds. The collider is null for
+    // unused proxies.
+    struct Proxy
+    {
+        Collider* collider;
+        float minCorner[3];
+        float maxCorner[3];
+    };
+
+    // One end of the bounds of a proxy along an axis. The lowest bit of
+    // data is set for a maximum, the other bits are the proxy index.
+    struct Endpoint
+    {
+        float value;
+        std::uint32_t data;
+
+        std::uint32_t proxy() const noexcept { return data >> 1; }
+        bool isMax() const noexcept { return (data & 1) != 0; }
+
+        // At equal values, a minimum sorts before a maximum. That way,
+        // touching bounds overlap, just like for intersects().
+        bool operator<(const Endpoint& other) const noexcept
+        {
+            return value < other.value ||
+                   (value == other.value && !isMax() && other.isMax());
+        }
+    };
+
+    // An entry in the pair table. The key holds the lower proxy index in
+    // the high 32 bits.
+    struct Pair
+    {
+        std::uint64_t key;
+        std::uint32_t state;
+    };
+
+    static constexpr std::uint64_t kEmpty = ~std::uint64_t(0);
+    static constexpr std::uint32_t kNew = 1;
+    static constexpr std::uint32_t kEnded = 2;
+
+    std::vector<Proxy> mProxies;
+    std::vector<std::uint32_t> mFreeProxies;
+    std::vector<Endpoint> mEndpoints[3];
+    std::vector<Pair> mPairs;
+    std::vector<std::uint64_t> mEndedPairs;
+
+    // The proxies that were added or removed since the last update. The
+    // endpoints of added proxies are not in mEndpoints yet. Removed proxies
+    // are not free until their endpoints and pairs are gone.
+    std::vector<std::uint32_t> mAddedProxies;
+    std::vector<std::uint32_t> mRemovedProxies;
+
+    // Scratch space for insertAddedProxies.
+    std::vector<Endpoint> mAddedEndpoints;
+    std::vector<Endpoint> mMergedEndpoints;
+    std::vector<std::uint32_t> mActive;
+    std::vector<std::uint32_t> mActiveAdded;
+
+    std::size_t mCount = 0;
+    std::size_t mPairCount = 0;
+
+    void eraseRemovedProxies();
+    void updateBounds() noexcept;
+    void sortAxis(const int axis);
+    void insertAddedProxies();
+    void sweep(const std::uint32_t proxy, std::vector<std::uint32_t>& active);
+    bool overlaps(const std::uint32_t a, const std::uint32_t b) const
+        noexcept;
+    std::size_t slot(const std::uint64_t key) const noexcept;
+    void addPair(const std::uint32_t a, const std::uint32_t b);
+    void removePair(const std::uint32_t a, const std::uint32_t b) noexcept;
+    void erasePair(std::size_t index) noexcept;
+    void rehash(const std::size_t slots);
+};
+
+template <class F> void SweepAndPrune::update(F f)
+{
+    eraseRemovedProxies();
+    updateBounds();
+    for (int axis = 0; axis < 3; ++axis) sortAxis(axis);
+    insertAddedProxies();
+
+    mEndedPairs.clear();
+    for (auto& pair : mPairs)
+    {
+        if (pair.key == kEmpty) continue;
+        auto* a = mProxies[pair.key >> 32].collider;
+        auto* b = mProxies[pair.key & 0xffffffff].collider;
+        if (pair.state & kEnded)
+        {
+            f(a, b, Overlap::End);
+            mEndedPairs.push_back(pair.key);
+        }
+        else if (pair.state & kNew)
+        {
+            f(a, b, Overlap::Begin);
+            pair.state = 0;
+        }
+        else
+        {
+            f(a, b, Overlap::Persist);
+        }
+        GT_SPATIAL_COUNT(results, 1);
+    }
+    for (const auto key : mEndedPairs) erasePair(slot(key));
+}
+
+} // namespace gintonic
@@ -1,23 +1,57 @@
 #pragma once
 
 #include "Component.hpp"
+#include "Foundation/TransformHierarchy.hpp"
 #include "Math/SQT.hpp"
 #include "Math/mat4f.hpp"
 #include <boost/serialization/base_object.hpp>
+#include <cstdint>
 
 namespace gintonic
 {
 
+/**
+ * @brief      The position, rotation and scale of an Entity.
+ *
+ * @details    The local and global transforms live in a TransformHierarchy
+ *             that all Transform components share. The parent of a
+ *             Transform is the Transform of the parent Entity.
+ */
 class Transform : public Component
 {
-    GT_COMPONENT_BOILERPLATE(Transform, Component)
+    GT_COMPONENT_SERIALIZATION_BOILERPLATE(Transform);
 
   public:
+    Transform(EntityBase* entity);
+    ~Transform() noexcept override;
+
     const SQT& local() const noexcept;
+
+    /**
+     * @brief      Get the local transform for modification.
+     *
+     * @details    The reference is invalidated when Transform components
+     *             are added or when updateGlobalTransforms runs, so do not
+     *             hold on to it.
+     *
+     * @return     The local transform.
+     */
     SQT& local() noexcept;
 
     const mat4f& global() const noexcept;
 
+    /**
+     * @brief      Get the version of the global transform.
+     *
+     * @details    The version changes every time a recomputation gives a
+     *             different global transform. Caches of values derived from
+     *             the global transform can compare versions to see if they
+     *             are stale.
+     *
+     * @return     The version of the global transform.
+     */
+    std::uint32_t getGlobalVersion() const noexcept;
+
     const vec3f& getGlobalPosition() const noexcept;
     const quatf& getGlobalRotation() const noexcept;
     const vec3f& getGlobalScale() const noexcept;
@@ -26,9 +60,27 @@ class Transform : public Component
     void setGlobalRotation(const quatf& rotation) noexcept;
     void setGlobalScale(const vec3f& scale) noexcept;
 
-    void update() override;
     void onParentChange() override;
 
+    /**
+     * @brief      Compute the stale global transforms of all Transform
+     *             components at once.
+     *
+     * @details    Global transforms are also computed on demand, but a
+     *             single pass over the whole hierarchy is much faster when
+     *             many of them changed. Call this once per frame after the
+     *             entities have moved.
+     */
+    static void updateGlobalTransforms();
+
+    /**
+     * @brief      Get the TransformHierarchy that all Transform components
+     *             share.
+     *
+     * @return     The TransformHierarchy.
+     */
+    static TransformHierarchy& getHierarchy();
+
     static bool classOf(const Component* component)
     {
         return component->getKind() == Kind::Transform;
@@ -37,11 +89,14 @@ class Transform : public Component
     GINTONIC_DEFINE_SSE_OPERATOR_NEW_DELETE();
 
   private:
-    SQT mLocal;
+    TransformHierarchy::Index mIndex;
+
+    // The decomposition of the global transform, computed on demand.
     mutable SQT mGlobal;
-    mutable mat4f mGlobalMatrix;
-    mutable bool mIsUpdated = false;
-    void updateImpl() const noexcept;
+    mutable std::uint32_t mGlobalVersion = 0;
+    mutable bool mIsDecomposed = false;
+    void decompose() const noexcept;
+    void attachToParent() noexcept;
 
     std::unique_ptr<Component> clone(EntityBase* newOwner) const override;
 
@@ -49,7 +104,7 @@ class Transform : public Component
     void serialize(Archive& archive, const unsigned /*version*/)
     {
         archive& BOOST_SERIALIZATION_BASE_OBJECT_NVP(Component);
-        archive& boost::serialization::make_nvp("local", mLocal);
+        archive& boost::serialization::make_nvp("local", local());
     }
 };
 
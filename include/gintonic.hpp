@@ -12,6 +12,9 @@
 #include "Entity.hpp"
 #include "EntityVisitor.hpp"
 #include "Foundation/Octree.hpp"
+#include "Foundation/OctreeImage.hpp"
+#include "Foundation/OctreeSnapshot.hpp"
+#include "Foundation/ReadWriteLock.hpp"
 #include "Foundation/exception.hpp"
 #include "Graphics/AmbientLight.hpp"
 #include "Graphics/AnimationClip.hpp"
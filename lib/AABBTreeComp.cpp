@@ -0,0 +1,357 @@
+#include "AABBTreeComp.hpp"
+#include "Collider.hpp"
+#include "Entity.hpp"
+#include "Transform.hpp"
+#include <algorithm>
+#include <cassert>
+
+// How much larger than its collider the leaf of a new AABBTreeComp is, in
+// world units, in every direction.
+#define GT_AABBTREE_DEFAULT_MARGIN 0.5f
+
+using namespace gintonic;
+
+namespace
+{
+
+box3f merged(const box3f& a, const box3f& b) noexcept
+{
+    auto result = a;
+    result.addPoint(b.minCorner);
+    result.addPoint(b.maxCorner);
+    return result;
+}
+
+// The insertion costs are sums and differences of areas, and the balancing
+// does not look at them, so the area of three faces is all that is needed.
+float area(const box3f& box) noexcept
+{
+    const auto d = box.maxCorner - box.minCorner;
+    return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+} // anonymous namespace
+
+constexpr int AABBTreeComp::Tree::kNull;
+
+AABBTreeComp::AABBTreeComp(EntityBase* owner)
+    : Component(Kind::AABBTreeComp, owner), mMargin(GT_AABBTREE_DEFAULT_MARGIN)
+{
+    mTransform = mEntityBase->add<Transform>();
+    mCollider = mEntityBase->get<Collider>();
+    if (!mCollider) throw std::runtime_error("Missing component: Collider");
+}
+
+AABBTreeComp::~AABBTreeComp() noexcept
+{
+    if (mTree) mTree->remove(this);
+}
+
+void AABBTreeComp::setTree(Tree& tree)
+{
+    if (mTree) mTree->remove(this);
+    tree.insert(this);
+}
+
+void AABBTreeComp::setStatic(const bool isStatic)
+{
+    if (isStatic && !mStatic && mTree) mTree->update(this);
+    mStatic = isStatic;
+}
+
+const box3f& AABBTreeComp::getFatBounds() const noexcept
+{
+    assert(mTree);
+    return mTree->mNodes[mLeaf].bounds;
+}
+
+void AABBTreeComp::update()
+{
+    if (mTree && !mStatic) mTree->update(this);
+}
+
+box3f AABBTreeComp::getBounds() const noexcept
+{
+    return mCollider->getGlobalBounds();
+}
+
+std::unique_ptr<Component> AABBTreeComp::clone(EntityBase* newOwner) const
+{
+    auto tree = std::make_unique<AABBTreeComp>(newOwner);
+    tree->mMargin = mMargin;
+    tree->mStatic = mStatic;
+    if (mTree) mTree->insert(tree.get());
+    return std::move(tree);
+}
+
+AABBTreeComp::Tree::~Tree() noexcept
+{
+    for (auto& node : mNodes)
+    {
+        if (node.height >= 0 && node.isLeaf())
+        {
+            node.comp->mTree = nullptr;
+            node.comp->mLeaf = kNull;
+        }
+    }
+}
+
+std::size_t AABBTreeComp::Tree::height() const noexcept
+{
+    return mRoot == kNull ? 0 : mNodes[mRoot].height + 1;
+}
+
+SpatialStatistics AABBTreeComp::Tree::statistics() const
+{
+    SpatialStatistics result;
+    if (mRoot != kNull) gatherStatistics(result, mRoot, 0);
+
+    // Count the free nodes too; they are part of the same allocation.
+    result.memoryUsage = sizeof(Tree) + mNodes.capacity() * sizeof(Node);
+    return result;
+}
+
+void AABBTreeComp::Tree::gatherStatistics(SpatialStatistics& statistics,
+                                          const int index,
+                                          const std::size_t depth) const
+{
+    const auto& node = mNodes[index];
+    statistics.addNode(depth, node.isLeaf() ? 1 : 0, node.isLeaf(), 0);
+    if (node.isLeaf()) return;
+    gatherStatistics(statistics, node.children[0], depth + 1);
+    gatherStatistics(statistics, node.children[1], depth + 1);
+}
+
+int AABBTreeComp::Tree::allocateNode()
+{
+    if (mFree == kNull)
+    {
+        mNodes.emplace_back();
+        mFree = static_cast<int>(mNodes.size()) - 1;
+        mNodes[mFree].parent = kNull;
+    }
+    const auto index = mFree;
+    auto& node = mNodes[index];
+    mFree = node.parent;
+    node.comp = nullptr;
+    node.parent = kNull;
+    node.children[0] = node.children[1] = kNull;
+    node.height = 0;
+    return index;
+}
+
+void AABBTreeComp::Tree::freeNode(const int index) noexcept
+{
+    // A negative height marks the node as free.
+    mNodes[index].parent = mFree;
+    mNodes[index].height = -1;
+    mFree = index;
+}
+
+void AABBTreeComp::Tree::insert(AABBTreeComp* comp)
+{
+    const auto leaf = allocateNode();
+    const auto bounds = comp->getBounds();
+    const vec3f margin(comp->mMargin, comp->mMargin, comp->mMargin);
+    mNodes[leaf].bounds =
+        box3f(bounds.minCorner - margin, bounds.maxCorner + margin);
+    mNodes[leaf].comp = comp;
+    insertLeaf(leaf);
+    comp->mTree = this;
+    comp->mLeaf = leaf;
+    ++mCount;
+}
+
+void AABBTreeComp::Tree::remove(AABBTreeComp* comp) noexcept
+{
+    assert(comp->mTree == this);
+    removeLeaf(comp->mLeaf);
+    freeNode(comp->mLeaf);
+    comp->mTree = nullptr;
+    comp->mLeaf = kNull;
+    --mCount;
+}
+
+void AABBTreeComp::Tree::update(AABBTreeComp* comp)
+{
+    // A leaf whose fat bounds still hold the collider keeps its place, and
+    // its ancestors keep their bounds.
+    const auto bounds = comp->getBounds();
+    auto& node = mNodes[comp->mLeaf];
+    if (node.bounds.contains(bounds)) return;
+
+    // Reuse the leaf node.
+    removeLeaf(comp->mLeaf);
+    const vec3f margin(comp->mMargin, comp->mMargin, comp->mMargin);
+    node.bounds = box3f(bounds.minCorner - margin, bounds.maxCorner + margin);
+    insertLeaf(comp->mLeaf);
+}
+
+void AABBTreeComp::Tree::insertLeaf(const int leaf)
+{
+    if (mRoot == kNull)
+    {
+        mRoot = leaf;
+        mNodes[leaf].parent = kNull;
+        return;
+    }
+
+    // Find the best sibling for the new leaf with the surface area
+    // heuristic. Descend as long as pushing the leaf further down is
+    // cheaper than making it a sibling of the current node. Every ancestor
+    // grows by the new leaf regardless, which is the inheritance cost.
+    const auto leafBounds = mNodes[leaf].bounds;
+    auto index = mRoot;
+    while (!mNodes[index].isLeaf())
+    {
+        const auto& node = mNodes[index];
+        const auto nodeArea = area(node.bounds);
+        const auto combinedArea = area(merged(node.bounds, leafBounds));
+
+        // The cost of creating a new parent for this node and the new leaf.
+        const auto cost = 2.0f * combinedArea;
+
+        // The minimum cost of pushing the leaf further down the tree.
+        const auto inheritanceCost = 2.0f * (combinedArea - nodeArea);
+
+        float childCost[2];
+        for (int i = 0; i < 2; ++i)
+        {
+            const auto& child = mNodes[node.children[i]];
+            const auto childArea = area(merged(child.bounds, leafBounds));
+            childCost[i] = inheritanceCost +
+                           (child.isLeaf() ? childArea
+                                           : childArea - area(child.bounds));
+        }
+
+        if (cost < childCost[0] && cost < childCost[1]) break;
+        index = childCost[0] < childCost[1] ? node.children[0]
+                                            : node.children[1];
+    }
+    const auto sibling = index;
+
+    // Create a new parent for the sibling and the leaf. The reference into
+    // mNodes is taken after the allocation, which may reallocate.
+    const auto oldParent = mNodes[sibling].parent;
+    const auto newParent = allocateNode();
+    auto& parentNode = mNodes[newParent];
+    parentNode.parent = oldParent;
+    parentNode.bounds = merged(leafBounds, mNodes[sibling].bounds);
+    parentNode.height = mNodes[sibling].height + 1;
+    parentNode.children[0] = sibling;
+    parentNode.children[1] = leaf;
+    mNodes[sibling].parent = newParent;
+    mNodes[leaf].parent = newParent;
+
+    if (oldParent == kNull)
+    {
+        mRoot = newParent;
+    }
+    else
+    {
+        auto& children = mNodes[oldParent].children;
+        children[children[0] == sibling ? 0 : 1] = newParent;
+    }
+
+    refit(newParent);
+}
+
+void AABBTreeComp::Tree::removeLeaf(const int leaf) noexcept
+{
+    if (leaf == mRoot)
+    {
+        mRoot = kNull;
+        return;
+    }
+
+    // Replace the parent of the leaf by the sibling of the leaf.
+    const auto parent = mNodes[leaf].parent;
+    const auto grandParent = mNodes[parent].parent;
+    const auto& children = mNodes[parent].children;
+    const auto sibling = children[0] == leaf ? children[1] : children[0];
+
+    if (grandParent == kNull)
+    {
+        mRoot = sibling;
+        mNodes[sibling].parent = kNull;
+        freeNode(parent);
+    }
+    else
+    {
+        auto& grandChildren = mNodes[grandParent].children;
+        grandChildren[grandChildren[0] == parent ? 0 : 1] = sibling;
+        mNodes[sibling].parent = grandParent;
+        freeNode(parent);
+        refit(grandParent);
+    }
+}
+
+void AABBTreeComp::Tree::refit(int index) noexcept
+{
+    // Walk back up the tree, rebalancing and fixing the bounds and heights.
+    while (index != kNull)
+    {
+        index = balance(index);
+        auto& node = mNodes[index];
+        const auto& child0 = mNodes[node.children[0]];
+        const auto& child1 = mNodes[node.children[1]];
+        node.height = 1 + std::max(child0.height, child1.height);
+        node.bounds = merged(child0.bounds, child1.bounds);
+        index = node.parent;
+    }
+}
+
+int AABBTreeComp::Tree::balance(const int a) noexcept
+{
+    // If one subtree of A is more than one level higher than the other,
+    // rotate the higher child C up to take the place of A. C keeps its
+    // higher child F, and A adopts the lower child G in the place of C. In
+    // nested form, with F higher than G:
+    //
+    //     A(B, C(F, G))  -->  C(A(B, G), F)
+    //
+    auto& nodeA = mNodes[a];
+    if (nodeA.isLeaf() || nodeA.height < 2) return a;
+
+    const auto b = nodeA.children[0];
+    const auto c = nodeA.children[1];
+    const auto diff = mNodes[c].height - mNodes[b].height;
+    if (diff >= -1 && diff <= 1) return a;
+
+    // Rotate the higher child up. Its index in the children of A is side.
+    const auto side = diff > 1 ? 1 : 0;
+    const auto up = nodeA.children[side];
+    const auto other = nodeA.children[1 - side];
+    auto& nodeUp = mNodes[up];
+    const auto f = nodeUp.children[0];
+    const auto g = nodeUp.children[1];
+
+    nodeUp.children[0] = a;
+    nodeUp.parent = nodeA.parent;
+    nodeA.parent = up;
+    if (nodeUp.parent == kNull)
+    {
+        mRoot = up;
+    }
+    else
+    {
+        auto& children = mNodes[nodeUp.parent].children;
+        children[children[0] == a ? 0 : 1] = up;
+    }
+
+    // The higher grandchild stays with the rotated node, the lower one goes
+    // to A.
+    const auto keep = mNodes[f].height > mNodes[g].height ? f : g;
+    const auto give = keep == f ? g : f;
+    nodeUp.children[1] = keep;
+    nodeA.children[side] = give;
+    mNodes[give].parent = a;
+
+    const auto& nodeOther = mNodes[other];
+    const auto& nodeGive = mNodes[give];
+    nodeA.bounds = merged(nodeOther.bounds, nodeGive.bounds);
+    nodeA.height = 1 + std::max(nodeOther.height, nodeGive.height);
+    nodeUp.bounds = merged(nodeA.bounds, mNodes[keep].bounds);
+    nodeUp.height = 1 + std::max(nodeA.height, mNodes[keep].height);
+    return up;
+}
@@ -1,13 +1,94 @@
 #include "BoxCollider.hpp"
+#include "Math/box3fSoA.hpp"
 #include "Transform.hpp"
+#include <cmath>
 
 using namespace gintonic;
 
+namespace
+{
+
+// All box colliders, and the cache of their bounds in world space. The
+// collider at index i has its bounds at index i.
+std::vector<BoxCollider*> sColliders;
+box3fSoA sGlobalBounds;
+
+// Scratch space for updateGlobalBounds.
+box3fSoA sLocalBounds;
+std::vector<const mat4f*> sMatrices;
+
+} // anonymous namespace
+
+BoxCollider::BoxCollider(EntityBase* entity)
+    : Collider(Kind::BoxCollider, entity), mSlot(sColliders.size())
+{
+    sColliders.push_back(this);
+    sGlobalBounds.push_back(box3f());
+}
+
+BoxCollider::~BoxCollider() noexcept
+{
+    // Move the last collider into the hole, together with its bounds.
+    sColliders[mSlot] = sColliders.back();
+    sColliders[mSlot]->mSlot = mSlot;
+    sColliders.pop_back();
+    sGlobalBounds.swapRemove(mSlot);
+}
+
 box3f BoxCollider::getGlobalBounds() const noexcept
 {
-    const auto pos = mTransform->getGlobalPosition() +
-                     mTransform->global().apply_to_point(localOffset);
-    return box3f(pos + localBounds.minCorner, pos + localBounds.maxCorner);
+    if (mIsCached && mCachedVersion == mTransform->getGlobalVersion())
+    {
+        const auto local = offsetLocalBounds();
+        if (local.minCorner == mCachedLocalBounds.minCorner &&
+            local.maxCorner == mCachedLocalBounds.maxCorner)
+        {
+            return sGlobalBounds.get(mSlot);
+        }
+    }
+    return computeGlobalBounds();
+}
+
+box3f BoxCollider::offsetLocalBounds() const noexcept
+{
+    return box3f(localBounds.minCorner + localOffset,
+                 localBounds.maxCorner + localOffset);
+}
+
+box3f BoxCollider::computeGlobalBounds() const noexcept
+{
+    // Transform the center as a point, and the extent by the absolute
+    // values of the matrix.
+    const auto& matrix = mTransform->global();
+    const auto center =
+        (localBounds.minCorner + localBounds.maxCorner) * 0.5f + localOffset;
+    const auto extent = (localBounds.maxCorner - localBounds.minCorner) * 0.5f;
+    const auto globalCenter = matrix.apply_to_point(center);
+    const vec3f globalExtent(
+        std::abs(matrix.m00) * extent.x + std::abs(matrix.m01) * extent.y +
+            std::abs(matrix.m02) * extent.z,
+        std::abs(matrix.m10) * extent.x + std::abs(matrix.m11) * extent.y +
+            std::abs(matrix.m12) * extent.z,
+        std::abs(matrix.m20) * extent.x + std::abs(matrix.m21) * extent.y +
+            std::abs(matrix.m22) * extent.z);
+    return box3f(globalCenter - globalExtent, globalCenter + globalExtent);
+}
+
+void BoxCollider::updateGlobalBounds()
+{
+    sLocalBounds.clear();
+    sLocalBounds.reserve(sColliders.size());
+    sMatrices.clear();
+    sMatrices.reserve(sColliders.size());
+    for (auto* collider : sColliders)
+    {
+        collider->mCachedLocalBounds = collider->offsetLocalBounds();
+        sLocalBounds.push_back(collider->mCachedLocalBounds);
+        sMatrices.push_back(&collider->mTransform->global());
+        collider->mCachedVersion = collider->mTransform->getGlobalVersion();
+        collider->mIsCached = true;
+    }
+    sGlobalBounds.assignTransformed(sLocalBounds, sMatrices.data());
 }
 
 void BoxCollider::onEnable() { /* empty */}
@@ -16,5 +97,6 @@ std::unique_ptr<Component> BoxCollider::clone(EntityBase* newOwner) const
 {
     auto boxcoll = std::make_unique<BoxCollider>(newOwner);
     boxcoll->localBounds = localBounds;
+    boxcoll->localOffset = localOffset;
     return std::move(boxcoll);
 }
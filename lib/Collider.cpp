@@ -1,10 +1,17 @@
 #include "Collider.hpp"
 #include "Entity.hpp"
+#include "SweepAndPrune.hpp"
 #include "Transform.hpp"
 
 using namespace gintonic;
 
-Collider::Collider(const Kind kind, EntityBase* owner) : Component(kind, owner)
+Collider::Collider(const Kind kind, EntityBase* owner)
+    : Component(kind, owner), localOffset(0.0f, 0.0f, 0.0f)
 {
     mTransform = mEntityBase->add<Transform>();
 }
+
+Collider::~Collider() noexcept
+{
+    if (mBroadphase) mBroadphase->remove(this);
+}
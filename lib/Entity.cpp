@@ -1,5 +1,6 @@
 #include "Entity.hpp"
 
+#include "Foundation/allocator.hpp"
 // #include "Foundation/Octree.hpp"
 
 #include "Graphics/Mesh.hpp"
@@ -9,6 +10,9 @@
 #include "Math/mat4fstack.hpp"
 #include "Math/vec4f.hpp"
 
+#include <deque>
+#include <stdexcept>
+
 namespace gintonic
 {
 
@@ -26,6 +30,205 @@ void Entity::lateUpdate() { EntityBase::lateUpdate(); }
 
 } // experimental
 
+constexpr std::size_t Entity::kNotChanged;
+
+boost::signals2::signal<void(const Entity::SharedPtr*, const Entity::SharedPtr*)>
+    Entity::onTransformChangeBatch;
+
+namespace
+{
+
+Entity::TransformNotification sTransformNotification =
+    Entity::TransformNotification::Immediate;
+
+// The entities whose transform changed since the last flush, in Deferred
+// mode. An Entity knows its place in here, so it is added only once and it
+// can take itself out when it dies.
+std::vector<Entity*> sChangedEntities;
+
+// The handle table. A slot holds the Entity that lives in it, or null, and
+// the generation of the current or next occupant.
+struct HandleSlot
+{
+    Entity* entity;
+    std::uint32_t generation;
+};
+std::vector<HandleSlot> sHandleSlots;
+
+// The free slots, oldest first. A slot is handed out again only when more
+// than kMinFreeHandleSlots slots are free, so that a slot goes through its
+// generations as slowly as possible. A slot that ran out of generations is
+// retired: it is never handed out again, so no stale handle comes back to
+// life.
+constexpr std::size_t kMinFreeHandleSlots = 1024;
+std::deque<std::uint32_t> sFreeHandleSlots;
+std::size_t sRetiredHandleSlots = 0;
+
+// The handles of the entities whose render state changed since the last
+// call to Entity::takeRenderStateChanges. Nothing is recorded until the
+// first call.
+std::vector<EntityHandle> sRenderStateChanges;
+bool sRecordRenderStateChanges = false;
+
+EntityHandle acquireHandle(Entity* entity)
+{
+    std::uint32_t lIndex;
+    if (sFreeHandleSlots.size() <= kMinFreeHandleSlots)
+    {
+        lIndex = static_cast<std::uint32_t>(sHandleSlots.size());
+        if (lIndex == EntityHandle::kMaxIndex)
+        {
+            throw std::length_error("Too many entities.");
+        }
+        sHandleSlots.push_back(HandleSlot{entity, 1});
+    }
+    else
+    {
+        lIndex = sFreeHandleSlots.front();
+        sFreeHandleSlots.pop_front();
+        sHandleSlots[lIndex].entity = entity;
+    }
+    return EntityHandle(lIndex, sHandleSlots[lIndex].generation);
+}
+
+void releaseHandle(const EntityHandle handle) noexcept
+{
+    auto& lSlot = sHandleSlots[handle.index()];
+    lSlot.entity = nullptr;
+
+    // Generations start at one, so that no handle is zero. The last
+    // generation does not fit in a handle, so nothing resolves to a
+    // retired slot.
+    if (++lSlot.generation == EntityHandle::kMaxGeneration)
+    {
+        ++sRetiredHandleSlots;
+    }
+    else
+    {
+        sFreeHandleSlots.push_back(handle.index());
+    }
+}
+
+// Make sure that the next count calls to acquireHandle do not grow the
+// handle table.
+void reserveHandles(const std::size_t count)
+{
+    const std::size_t lReusable =
+        sFreeHandleSlots.size() > kMinFreeHandleSlots
+            ? sFreeHandleSlots.size() - kMinFreeHandleSlots
+            : 0;
+    if (count > lReusable)
+    {
+        sHandleSlots.reserve(sHandleSlots.size() + count - lReusable);
+    }
+}
+
+} // anonymous namespace
+
+constexpr std::uint32_t EntityHandle::kIndexBits;
+constexpr std::uint32_t EntityHandle::kGenerationBits;
+constexpr std::uint32_t EntityHandle::kMaxIndex;
+constexpr std::uint32_t EntityHandle::kMaxGeneration;
+
+Entity* Entity::fromHandle(const EntityHandle handle) noexcept
+{
+    if (handle.index() >= sHandleSlots.size()) return nullptr;
+    const auto& lSlot = sHandleSlots[handle.index()];
+    return lSlot.generation == handle.generation() ? lSlot.entity : nullptr;
+}
+
+std::size_t Entity::count() noexcept
+{
+    return sHandleSlots.size() - sFreeHandleSlots.size() - sRetiredHandleSlots;
+}
+
+void Entity::takeRenderStateChanges(std::vector<EntityHandle>& changes)
+{
+    sRecordRenderStateChanges = true;
+    changes.clear();
+    changes.swap(sRenderStateChanges);
+    for (const auto lHandle : changes)
+    {
+        if (auto* lEntity = fromHandle(lHandle))
+        {
+            lEntity->mRenderStateChanged = false;
+        }
+    }
+}
+
+void Entity::renderStateChanged()
+{
+    if (!sRecordRenderStateChanges || mRenderStateChanged) return;
+    mRenderStateChanged = true;
+    sRenderStateChanges.push_back(mHandle);
+}
+
+void* Entity::operator new(const std::size_t count)
+{
+    if (count == sizeof(Entity)) return PoolAllocator<Entity>().allocate(1);
+    auto lResult = _mm_malloc(count, GINTONIC_SSE_ALIGNMENT);
+    if (!lResult) throw std::bad_alloc();
+    return lResult;
+}
+
+void Entity::operator delete(void* ptr, const std::size_t count) noexcept
+{
+    if (count == sizeof(Entity))
+    {
+        PoolAllocator<Entity>().deallocate(static_cast<Entity*>(ptr), 1);
+    }
+    else
+    {
+        _mm_free(ptr);
+    }
+}
+
+void Entity::setTransformNotification(const TransformNotification mode)
+{
+    if (sTransformNotification == TransformNotification::Deferred &&
+        mode == TransformNotification::Immediate)
+    {
+        flushTransformChanges();
+    }
+    sTransformNotification = mode;
+}
+
+Entity::TransformNotification Entity::getTransformNotification() noexcept
+{
+    return sTransformNotification;
+}
+
+void Entity::flushTransformChanges()
+{
+    if (sChangedEntities.empty()) return;
+
+    // Take the change set first, so that listeners can move entities again.
+    std::vector<SharedPtr> lChanged;
+    lChanged.reserve(sChangedEntities.size());
+    for (auto* lEntity : sChangedEntities)
+    {
+        lEntity->mTransformChangeIndex = kNotChanged;
+        lChanged.push_back(lEntity->shared_from_this());
+    }
+    sChangedEntities.clear();
+
+    for (const auto& lEntity : lChanged) lEntity->onTransformChange(lEntity);
+    onTransformChangeBatch(lChanged.data(), lChanged.data() + lChanged.size());
+}
+
+void Entity::notifyTransformChange()
+{
+    if (sTransformNotification == TransformNotification::Immediate)
+    {
+        onTransformChange(shared_from_this());
+    }
+    else if (mTransformChangeIndex == kNotChanged)
+    {
+        mTransformChangeIndex = sChangedEntities.size();
+        sChangedEntities.push_back(this);
+    }
+}
+
 Entity::Entity()
     : Entity("UntitledEntity",
              SQT(vec3f(1.0f, 1.0f, 1.0f), quatf(1.0f, 0.0f, 0.0f, 0.0f),
@@ -54,41 +257,59 @@ void Entity::lateUpdate()
 
 Entity::Entity(std::string name, const SQT& localTransform)
     : Super(std::move(name)), mLocalTransform(localTransform),
-      mGlobalTransform(mLocalTransform)
+      mGlobalTransform(mLocalTransform), mHandle(acquireHandle(this))
 {
     /* Empty on purpose. */
 }
 
 Entity::Entity(const Entity& other)
     : Super(other), mLocalTransform(other.mLocalTransform),
-      mGlobalTransform(other.mGlobalTransform)
+      mGlobalTransform(other.mGlobalTransform), mHandle(acquireHandle(this))
       // , mOctree(other.mOctree)
       // , mOctreeListIter(other.mOctreeListIter)
       ,
-      castShadow(other.castShadow), material(other.material), mesh(other.mesh),
-      light(other.light), camera(other.camera)
+      castShadow(this, other.castShadow), material(this, other.material),
+      mesh(this, other.mesh), light(this, other.light), camera(other.camera)
 {
     /* Do NOT copy mChildren */
     /* Do NOT copy mParent */
+    /* Do NOT copy mHandle */
     /* Do NOT copy shadowBuffer */
+
+    // Without a parent, the global transform is the local transform.
+    mGlobalTransformIsDirty = true;
 }
 
 Entity::Entity(Entity&& other) noexcept
     : Super(std::move(other)),
       mLocalTransform(std::move(other.mLocalTransform)),
       mGlobalTransform(std::move(other.mGlobalTransform)),
-      mChildren(std::move(other.mChildren)), mParent(std::move(other.mParent))
+      mChildren(std::move(other.mChildren)), mParent(other.mParent),
+      mHandle(acquireHandle(this))
       // , mOctree(std::move(other.mOctree))
       // , mOctreeListIter(std::move(other.mOctreeListIter))
       ,
-      castShadow(std::move(other.castShadow)),
-      material(std::move(other.material)), mesh(std::move(other.mesh)),
-      light(std::move(other.light)), camera(std::move(other.camera)),
+      castShadow(this, other.castShadow.mValue),
+      material(this, std::move(other.material.mValue)),
+      mesh(this, std::move(other.mesh.mValue)),
+      light(this, std::move(other.light.mValue)),
+      camera(std::move(other.camera)),
       shadowBuffer(std::move(other.shadowBuffer))
 {
     /* DO move mChildren */
     /* DO move mParent */
+    /* Do NOT move mHandle */
     /* DO move shadowBuffer */
+
+    mGlobalTransformIsDirty = other.mGlobalTransformIsDirty;
+    other.mParent = nullptr;
+    for (const auto& lChild : mChildren)
+    {
+        lChild->mParent = this;
+        lChild->renderStateChanged();
+    }
+    renderStateChanged();
+    other.renderStateChanged();
 }
 
 Entity& Entity::operator=(const Entity& other)
@@ -103,6 +324,7 @@ Entity& Entity::operator=(const Entity& other)
     mesh = other.mesh;
     light = other.light;
     camera = other.camera;
+    invalidateGlobalTransform();
 
     /* Do NOT copy mChildren */
     /* Do NOT copy mParent */
@@ -117,7 +339,13 @@ Entity& Entity::operator=(Entity&& other) noexcept
     mLocalTransform = std::move(other.mLocalTransform);
     mGlobalTransform = std::move(other.mGlobalTransform);
     mChildren = std::move(other.mChildren);
-    mParent = std::move(other.mParent);
+    mParent = other.mParent;
+    other.mParent = nullptr;
+    for (const auto& lChild : mChildren)
+    {
+        lChild->mParent = this;
+        lChild->renderStateChanged();
+    }
     // mOctree = std::move(other.mOctree);
     // mOctreeListIter = std::move(other.mOctreeListIter);
     castShadow = std::move(other.castShadow);
@@ -126,9 +354,11 @@ Entity& Entity::operator=(Entity&& other) noexcept
     light = std::move(other.light);
     camera = std::move(other.camera);
     shadowBuffer = std::move(other.shadowBuffer);
+    mGlobalTransformIsDirty = other.mGlobalTransformIsDirty;
 
     /* DO move mChildren */
     /* DO move mParent */
+    /* Do NOT move mHandle */
     /* DO move shadowBuffer */
 
     return *this;
@@ -136,8 +366,8 @@ Entity& Entity::operator=(Entity&& other) noexcept
 
 box3f Entity::globalBoundingBox() const noexcept
 {
-    box3f lGlobalBoundingBox(mGlobalTransform.data[3],
-                             mGlobalTransform.data[3]);
+    box3f lGlobalBoundingBox(globalTransform().data[3],
+                             globalTransform().data[3]);
     if (mesh)
     {
         const auto& lBBox = mesh->getLocalBoundingBox();
@@ -147,158 +377,176 @@ box3f Entity::globalBoundingBox() const noexcept
     return lGlobalBoundingBox;
 }
 
-void Entity::updateGlobalInfo() noexcept
+void Entity::invalidateGlobalTransform() noexcept
+{
+    // The descendants of a dirty Entity are dirty already. Moving an Entity
+    // a second time before its global transform is needed costs nothing.
+    if (mGlobalTransformIsDirty) return;
+    mGlobalTransformIsDirty = true;
+    for (const auto& lChild : mChildren)
+    {
+        lChild->invalidateGlobalTransform();
+    }
+}
+
+void Entity::resolveGlobalTransform() const noexcept
 {
-    if (auto lParent = mParent.lock())
+    if (mParent)
     {
-        mGlobalTransform = lParent->mGlobalTransform * mat4f(mLocalTransform);
+        mGlobalTransform = mParent->globalTransform() * mat4f(mLocalTransform);
     }
     else
     {
         mGlobalTransform = mat4f(mLocalTransform);
     }
-    for (auto lChild : mChildren)
+    mGlobalTransformIsDirty = false;
+}
+
+void Entity::updateGlobalTransforms() const noexcept
+{
+    globalTransform();
+    for (const auto& lChild : mChildren)
     {
-        lChild->updateGlobalInfo();
+        lChild->updateGlobalTransforms();
     }
 }
 
 void Entity::setScale(const vec3f& scale) noexcept
 {
     mLocalTransform.scale = scale;
-    updateGlobalInfo();
-    onTransformChange(shared_from_this());
+    invalidateGlobalTransform();
+    notifyTransformChange();
 }
 
 void Entity::multiplyScale(const vec3f& scale) noexcept
 {
     mLocalTransform.scale *= scale;
-    updateGlobalInfo();
-    onTransformChange(shared_from_this());
+    invalidateGlobalTransform();
+    notifyTransformChange();
 }
 
 void Entity::setTranslation(const vec3f& translation) noexcept
 {
     mLocalTransform.translation = translation;
-    updateGlobalInfo();
-    onTransformChange(shared_from_this());
+    invalidateGlobalTransform();
+    notifyTransformChange();
 }
 
 void Entity::setTranslationX(const float x) noexcept
 {
     mLocalTransform.translation.x = x;
-    updateGlobalInfo();
-    onTransformChange(shared_from_this());
+    invalidateGlobalTransform();
+    notifyTransformChange();
 }
 void Entity::setTranslationY(const float y) noexcept
 {
     mLocalTransform.translation.y = y;
-    updateGlobalInfo();
-    onTransformChange(shared_from_this());
+    invalidateGlobalTransform();
+    notifyTransformChange();
 }
 
 void Entity::setTranslationZ(const float z) noexcept
 {
     mLocalTransform.translation.z = z;
-    updateGlobalInfo();
-    onTransformChange(shared_from_this());
+    invalidateGlobalTransform();
+    notifyTransformChange();
 }
 
 void Entity::addTranslation(const vec3f& translation) noexcept
 {
     mLocalTransform.translation += translation;
-    updateGlobalInfo();
-    onTransformChange(shared_from_this());
+    invalidateGlobalTransform();
+    notifyTransformChange();
 }
 
 void Entity::setRotation(const quatf& rotation) noexcept
 {
     mLocalTransform.rotation = rotation;
-    updateGlobalInfo();
-    onTransformChange(shared_from_this());
+    invalidateGlobalTransform();
+    notifyTransformChange();
 }
 
 void Entity::postMultiplyRotation(const quatf& rotation) noexcept
 {
     mLocalTransform.rotation *= rotation;
-    updateGlobalInfo();
-    onTransformChange(shared_from_this());
+    invalidateGlobalTransform();
+    notifyTransformChange();
 }
 
 void Entity::preMultiplyRotation(const quatf& rotation) noexcept
 {
     mLocalTransform.rotation = rotation * mLocalTransform.rotation;
-    updateGlobalInfo();
-    onTransformChange(shared_from_this());
+    invalidateGlobalTransform();
+    notifyTransformChange();
 }
 
 void Entity::setLocalTransform(const SQT& sqt) noexcept
 {
     mLocalTransform = sqt;
-    updateGlobalInfo();
-    onTransformChange(shared_from_this());
+    invalidateGlobalTransform();
+    notifyTransformChange();
 }
 
 void Entity::postAddLocalTransform(const SQT& sqt) noexcept
 {
     mLocalTransform %= sqt;
-    updateGlobalInfo();
-    onTransformChange(shared_from_this());
+    invalidateGlobalTransform();
+    notifyTransformChange();
 }
 
 void Entity::preAddLocalTransform(const SQT& sqt) noexcept
 {
     mLocalTransform = sqt % mLocalTransform;
-    updateGlobalInfo();
-    onTransformChange(shared_from_this());
+    invalidateGlobalTransform();
+    notifyTransformChange();
 }
 
 void Entity::moveForward(const float amount) noexcept
 {
     mLocalTransform.translation +=
         amount * mLocalTransform.rotation.forward_direction();
-    updateGlobalInfo();
-    onTransformChange(shared_from_this());
+    invalidateGlobalTransform();
+    notifyTransformChange();
 }
 
 void Entity::moveBackward(const float amount) noexcept
 {
     mLocalTransform.translation -=
         amount * mLocalTransform.rotation.forward_direction();
-    updateGlobalInfo();
-    onTransformChange(shared_from_this());
+    invalidateGlobalTransform();
+    notifyTransformChange();
 }
 
 void Entity::moveRight(const float amount) noexcept
 {
     mLocalTransform.translation +=
         amount * mLocalTransform.rotation.right_direction();
-    updateGlobalInfo();
-    onTransformChange(shared_from_this());
+    invalidateGlobalTransform();
+    notifyTransformChange();
 }
 
 void Entity::moveLeft(const float amount) noexcept
 {
     mLocalTransform.translation -=
         amount * mLocalTransform.rotation.right_direction();
-    updateGlobalInfo();
-    onTransformChange(shared_from_this());
+    invalidateGlobalTransform();
+    notifyTransformChange();
 }
 
 void Entity::moveUp(const float amount) noexcept
 {
     mLocalTransform.translation +=
         amount * mLocalTransform.rotation.up_direction();
-    updateGlobalInfo();
-    onTransformChange(shared_from_this());
+    invalidateGlobalTransform();
+    notifyTransformChange();
 }
 
 void Entity::moveDown(const float amount) noexcept
 {
     mLocalTransform.translation -=
         amount * mLocalTransform.rotation.up_direction();
-    updateGlobalInfo();
-    onTransformChange(shared_from_this());
+    invalidateGlobalTransform();
+    notifyTransformChange();
 }
 
 // mat4f Entity::computeGlobalTransform() noexcept
@@ -315,33 +563,36 @@ void Entity::moveDown(const float amount) noexcept
 
 void Entity::addChild(std::shared_ptr<Entity> child)
 {
-    if (child->mParent.lock())
+    if (child->mParent)
     {
         // child has a parent. Do we have to move or clone it?
         if (child.use_count() == 1)
         {
             // We can move it!
-            child->mParent = shared_from_this();
+            child->mParent = this;
             mChildren.push_front(child);
-            child->updateGlobalInfo();
-            child->onTransformChange(child);
+            child->invalidateGlobalTransform();
+            child->notifyTransformChange();
+            child->renderStateChanged();
         }
         else
         {
             // We must make a recursive copy.
             auto lCopy = child->cloneRecursive();
-            lCopy->mParent = shared_from_this();
+            lCopy->mParent = this;
             mChildren.push_front(lCopy);
-            lCopy->updateGlobalInfo();
-            lCopy->onTransformChange(lCopy);
+            lCopy->invalidateGlobalTransform();
+            lCopy->notifyTransformChange();
+            lCopy->renderStateChanged();
         }
     }
     else
     {
-        child->mParent = shared_from_this();
+        child->mParent = this;
         mChildren.push_front(child);
-        child->updateGlobalInfo();
-        child->onTransformChange(child);
+        child->invalidateGlobalTransform();
+        child->notifyTransformChange();
+        child->renderStateChanged();
     }
 }
 
@@ -367,32 +618,31 @@ void Entity::removeChild(std::shared_ptr<Entity> child)
 
 #ifndef NDEBUG
     if (lChildWasRemoved)
-        child->mParent = std::shared_ptr<Entity>(nullptr);
+        child->mParent = nullptr;
     else
         throw std::logic_error("Entity was not a child.");
 #else
-    child->mParent = std::shared_ptr<Entity>(nullptr);
+    child->mParent = nullptr;
 #endif
+
+    child->invalidateGlobalTransform();
+    child->renderStateChanged();
 }
 
 void Entity::setParent(std::shared_ptr<Entity> parent)
 {
-    if (auto lParent = mParent.lock())
+    if (mParent)
     {
-        lParent->removeChild(shared_from_this());
+        mParent->removeChild(shared_from_this());
     }
     parent->addChild(shared_from_this()); // also sets mParent
 }
 
 void Entity::unsetParent()
 {
-    if (auto lParent = mParent.lock())
+    if (mParent)
     {
-        lParent->removeChild(shared_from_this());
-    }
-    else
-    {
-        mParent = std::shared_ptr<Entity>(nullptr);
+        mParent->removeChild(shared_from_this());
     }
 }
 
@@ -490,8 +740,15 @@ Entity::~Entity() noexcept
     {
         // Absorb exceptions.
     }
+    if (mTransformChangeIndex != kNotChanged)
+    {
+        auto* lLast = sChangedEntities.back();
+        sChangedEntities[mTransformChangeIndex] = lLast;
+        lLast->mTransformChangeIndex = mTransformChangeIndex;
+        sChangedEntities.pop_back();
+    }
     // DEBUG_PRINT;
-    for (auto lChild : mChildren)
+    for (const auto& lChild : mChildren)
     {
         if (lChild.use_count()) // Not thread-safe :(
         {
@@ -500,40 +757,111 @@ Entity::~Entity() noexcept
             // DEBUG_PRINT;
             // std::cerr << "\t" << lChild->name << "\n";
             // DEBUG_PRINT;
-            lChild->mParent = SharedPtr(nullptr);
+            // The child can no longer reach this Entity through its
+            // parent pointer, so resolve its global transform here.
+            if (lChild->mGlobalTransformIsDirty)
+            {
+                lChild->mGlobalTransform =
+                    globalTransform() * mat4f(lChild->mLocalTransform);
+                lChild->mGlobalTransformIsDirty = false;
+            }
+            lChild->mParent = nullptr;
+            lChild->renderStateChanged();
             // DEBUG_PRINT;
             lChild->mGlobalTransform.decompose(lChild->mLocalTransform);
             // DEBUG_PRINT;
         }
     }
     // DEBUG_PRINT;
-    if (auto lParent = mParent.lock())
+    renderStateChanged();
+    releaseHandle(mHandle);
+    if (mParent)
     {
-        for (auto lIter = lParent->mChildren.begin();
-             lIter != lParent->mChildren.end(); ++lIter)
+        for (auto lIter = mParent->mChildren.begin();
+             lIter != mParent->mChildren.end(); ++lIter)
         {
             if (lIter->get() == this)
             {
-                lParent->mChildren.erase(lIter);
+                mParent->mChildren.erase(lIter);
                 return;
             }
         }
     }
-    // If no lock can be acquired, the parent is dead.
-    // In that case we don't have to care about removing
-    // ourselves from the children list of the parent
-    // since that's gone.
+    // If there is no parent pointer, the parent is dead or there never was
+    // one. In that case we don't have to care about removing ourselves from
+    // the children list of the parent since that's gone.
 }
 
 std::shared_ptr<Entity> Entity::cloneRecursive() const
 {
     // Invoke the copy constructor.
-    std::shared_ptr<Entity> lClone(new Entity(*this));
-    for (auto lChild : mChildren)
+    auto lClone = create(*this);
+
+    // addChild puts a child in front, so go backwards to keep the order.
+    for (auto lChild = mChildren.rbegin(); lChild != mChildren.rend();
+         ++lChild)
     {
-        lClone->addChild(lChild->cloneRecursive());
+        lClone->addChild((*lChild)->cloneRecursive());
     }
     return lClone;
 }
 
+std::vector<Entity::SharedPtr>
+Entity::cloneRecursive(const std::size_t count) const
+{
+    // Flatten the subtree in breadth-first order, so that a parent comes
+    // before its children.
+    std::vector<const Entity*> lNodes(1, this);
+    std::vector<std::size_t> lParents(1, 0);
+    for (std::size_t i = 0; i < lNodes.size(); ++i)
+    {
+        for (const auto& lChild : lNodes[i]->mChildren)
+        {
+            lNodes.push_back(lChild.get());
+            lParents.push_back(i);
+        }
+    }
+
+    // The copies are roots, so their global transforms do not depend on
+    // the parent of this Entity, and they are the same for every copy.
+    std::vector<mat4f, allocator<mat4f>> lGlobals(lNodes.size());
+    lGlobals[0] = mat4f(mLocalTransform);
+    for (std::size_t i = 1; i < lNodes.size(); ++i)
+    {
+        lGlobals[i] =
+            lGlobals[lParents[i]] * mat4f(lNodes[i]->mLocalTransform);
+    }
+
+    const auto lTotal = count * lNodes.size();
+    PoolAllocator<Entity>::pool().reserve(lTotal);
+    reserveHandles(lTotal);
+
+    std::vector<SharedPtr> lRoots;
+    lRoots.reserve(count);
+    std::vector<Entity*> lCopies(lNodes.size());
+    for (std::size_t c = 0; c < count; ++c)
+    {
+        for (std::size_t i = 0; i < lNodes.size(); ++i)
+        {
+            // Invoke the copy constructor. It shares the material, mesh,
+            // light and camera, and copies the local transform.
+            auto lCopy = create(*lNodes[i]);
+            lCopy->mGlobalTransform = lGlobals[i];
+            lCopy->mGlobalTransformIsDirty = false;
+            lCopies[i] = lCopy.get();
+            if (i == 0)
+            {
+                lRoots.push_back(std::move(lCopy));
+            }
+            else
+            {
+                auto* lParent = lCopies[lParents[i]];
+                lCopy->mParent = lParent;
+                lParent->mChildren.push_back(std::move(lCopy));
+            }
+        }
+    }
+    return lRoots;
+}
+
 } // namespace gintonic
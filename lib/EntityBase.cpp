@@ -1,6 +1,9 @@
 #include "EntityBase.hpp"
 #include "Component.hpp"
 
+#include <algorithm>
+#include <iterator>
+
 using namespace gintonic;
 
 EntityBase::EntityBase(const Kind kind) : mKind(kind) {}
@@ -13,11 +16,13 @@ EntityBase::EntityBase(const EntityBase& other) : mKind(other.mKind)
 EntityBase::EntityBase(EntityBase&& other)
     : mKind(other.mKind), mComponents(std::move(other.mComponents))
 {
+    takeSlots(other);
 }
 
 EntityBase& EntityBase::operator=(const EntityBase& other)
 {
     mComponents.clear();
+    clearSlots();
     clone(other);
     return *this;
 }
@@ -26,6 +31,7 @@ EntityBase& EntityBase::operator=(EntityBase&& other)
 {
     assertSameType(other);
     mComponents = std::move(other.mComponents);
+    takeSlots(other);
     return *this;
 }
 
@@ -35,6 +41,46 @@ void EntityBase::clone(const EntityBase& other)
     for (const auto& ptr : other.mComponents)
     {
         mComponents.emplace_back(ptr->clone(this));
+        occupySlot(mComponents.back().get());
+    }
+}
+
+void EntityBase::takeSlots(EntityBase& other) noexcept
+{
+    std::copy(std::begin(other.mSlots), std::end(other.mSlots), mSlots);
+    mKinds = other.mKinds;
+    other.mComponents.clear();
+    other.clearSlots();
+}
+
+void EntityBase::clearSlots() noexcept
+{
+    std::fill(std::begin(mSlots), std::end(mSlots), nullptr);
+    mKinds = 0;
+}
+
+void EntityBase::occupySlot(Component* comp) noexcept
+{
+    const auto k = static_cast<std::size_t>(comp->getKind());
+    if (mSlots[k]) return;
+    mSlots[k] = comp;
+    mKinds |= std::uint32_t(1) << k;
+}
+
+void EntityBase::releaseSlot(const Component* comp) noexcept
+{
+    // Hand the slot to the next Component of the same kind, if any.
+    const auto k = static_cast<std::size_t>(comp->getKind());
+    if (mSlots[k] != comp) return;
+    mSlots[k] = nullptr;
+    mKinds &= ~(std::uint32_t(1) << k);
+    for (const auto& ptr : mComponents)
+    {
+        if (ptr.get() != comp && ptr->getKind() == comp->getKind())
+        {
+            occupySlot(ptr.get());
+            return;
+        }
     }
 }
 
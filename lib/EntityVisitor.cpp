@@ -14,17 +14,17 @@ void EntityVisitor::execute()
 {
 	mDepth = 0;
 	mContinue = static_cast<bool>(root) && onStart();
-	if (mContinue) visit(root);
+	if (mContinue) visit(*root);
 	onFinish();
 }
 
-void EntityVisitor::visit(std::shared_ptr<Entity> entity)
+void EntityVisitor::visit(Entity& entity)
 {
 	mContinue = onVisit(entity);
 	++mDepth;
-	for (auto lChild : *entity)
+	for (const auto& lChild : entity)
 	{
-		if (mContinue) visit(lChild);
+		if (mContinue) visit(*lChild);
 		else break;
 	}
 	--mDepth;
@@ -0,0 +1,353 @@
+#include "Foundation/LinearOctree.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <unordered_set>
+
+namespace gintonic {
+
+// The location code of the root node: just the sentinel bit.
+#define GT_LINEAR_OCTREE_ROOT_CODE std::uint64_t(1)
+
+box3f LinearOctree::NodeView::bounds() const noexcept
+{
+	return mTree->nodeBounds(mTree->mNodes[mIndex].locationCode);
+}
+
+std::size_t LinearOctree::NodeView::depth() const noexcept
+{
+	return locationCodeDepth(mTree->mNodes[mIndex].locationCode);
+}
+
+bool LinearOctree::NodeView::isRoot() const noexcept
+{
+	return mIndex == 0;
+}
+
+bool LinearOctree::NodeView::isLeaf() const noexcept
+{
+	// In depth-first order, the first child immediately follows its parent.
+	return mTree->mNodes[mIndex].skip == mIndex + 1;
+}
+
+bool LinearOctree::NodeView::hasNoEntities() const noexcept
+{
+	return mTree->mNodes[mIndex].entityCount == 0;
+}
+
+std::size_t LinearOctree::NodeView::entityCount() const noexcept
+{
+	return mTree->mNodes[mIndex].entityCount;
+}
+
+LinearOctree::LinearOctree(const box3f& bounds)
+: mBounds(bounds)
+{
+	/* Empty on purpose. */
+}
+
+LinearOctree::LinearOctree(const vec3f& minCorner, const vec3f& maxCorner)
+: mBounds(minCorner, maxCorner)
+{
+	/* Empty on purpose. */
+}
+
+LinearOctree::~LinearOctree()
+{
+	for (auto& lPair : mConnections)
+	{
+		lPair.second.transformChange.disconnect();
+		lPair.second.die.disconnect();
+	}
+}
+
+std::size_t LinearOctree::count() const
+{
+	update();
+	return mEntities.size();
+}
+
+std::size_t LinearOctree::nodeCount() const
+{
+	update();
+	return mNodes.size();
+}
+
+std::size_t LinearOctree::memoryUsage() const
+{
+	update();
+	return mNodes.capacity() * sizeof(Node)
+		+ mEntities.capacity() * sizeof(Entity*)
+		+ mEntityBounds.capacity() * sizeof(box3f)
+		+ mEntityCodes.capacity() * sizeof(std::uint64_t);
+}
+
+void LinearOctree::insert(Entity::SharedPtr entity)
+{
+	const auto lBounds = entity->globalBoundingBox();
+	if (mBounds.contains(lBounds) == false)
+	{
+		throw EntityNotContainedInOctreeBoundingBox(this, std::move(entity));
+	}
+
+	auto* lEntity = entity.get();
+	if (mConnections.find(lEntity) != mConnections.end()) return;
+	connect(lEntity);
+	mIsDirty = true;
+
+	// If the Entity was erased since the last rebuild then it is still
+	// present in the flat arrays. Revive it instead of adding it twice.
+	const auto lErased = std::find(mErasedEntities.begin(),
+		mErasedEntities.end(), lEntity);
+	if (lErased != mErasedEntities.end())
+	{
+		mErasedEntities.erase(lErased);
+		mMovedEntities.push_back(lEntity);
+		return;
+	}
+
+	if (mBuiltSubdivisionThreshold != subdivisionThreshold) updateMaxDepth();
+	mEntities.push_back(lEntity);
+	mEntityBounds.push_back(lBounds);
+	mEntityCodes.push_back(locationCode(lBounds));
+}
+
+bool LinearOctree::erase(Entity::SharedPtr entity)
+{
+	return erase(entity.get());
+}
+
+bool LinearOctree::erase(Entity* entity)
+{
+	const auto lIter = mConnections.find(entity);
+	if (lIter == mConnections.end()) return false;
+	lIter->second.transformChange.disconnect();
+	lIter->second.die.disconnect();
+	mConnections.erase(lIter);
+	mErasedEntities.push_back(entity);
+	mIsDirty = true;
+	return true;
+}
+
+void LinearOctree::clear()
+{
+	for (auto& lPair : mConnections)
+	{
+		lPair.second.transformChange.disconnect();
+		lPair.second.die.disconnect();
+	}
+	mConnections.clear();
+	mNodes.clear();
+	mEntities.clear();
+	mEntityBounds.clear();
+	mEntityCodes.clear();
+	mMovedEntities.clear();
+	mErasedEntities.clear();
+	mIsDirty = false;
+}
+
+void LinearOctree::connect(Entity* entity)
+{
+	// We only record what happened to the Entity. The flat arrays are
+	// fixed up in one go right before the next query.
+	auto& lConnections = mConnections[entity];
+	lConnections.transformChange = entity->onTransformChange.connect
+	(
+		[this] (Entity::SharedPtr thisEntity)
+		{
+			this->mMovedEntities.push_back(thisEntity.get());
+			this->mIsDirty = true;
+		}
+	);
+	lConnections.die = entity->onDie.connect
+	(
+		[this] (Entity* thisEntity)
+		{
+			this->erase(thisEntity);
+		}
+	);
+}
+
+void LinearOctree::updateMaxDepth() const
+{
+	// A node at depth d is subdivided only if all of its half-extents
+	// exceed the subdivision threshold, just like Octree::subdivide.
+	const auto lExtent = mBounds.maxCorner - mBounds.minCorner;
+	auto lMinExtent = std::min(lExtent.x, std::min(lExtent.y, lExtent.z));
+	mMaxDepth = 0;
+	while (mMaxDepth < kMortonBitsPerAxis
+		&& lMinExtent / 2.0f > subdivisionThreshold)
+	{
+		lMinExtent /= 2.0f;
+		++mMaxDepth;
+	}
+	mBuiltSubdivisionThreshold = subdivisionThreshold;
+
+	// The codes of the stored entities were made for the old depth, and
+	// the sort key of update assumes that no code is deeper than
+	// mMaxDepth.
+	for (std::size_t i = 0; i < mEntities.size(); ++i)
+	{
+		mEntityCodes[i] = locationCode(mEntityBounds[i]);
+	}
+	mIsDirty = true;
+}
+
+std::uint64_t LinearOctree::locationCode(const box3f& box) const noexcept
+{
+	if (mMaxDepth == 0 || mBounds.contains(box) == false)
+	{
+		return GT_LINEAR_OCTREE_ROOT_CODE;
+	}
+
+	const auto lCellCount = std::uint32_t(1) << mMaxDepth;
+	const auto lScale = vec3f(float(lCellCount))
+		/ (mBounds.maxCorner - mBounds.minCorner);
+	const auto lMin = (box.minCorner - mBounds.minCorner) * lScale;
+	const auto lMax = (box.maxCorner - mBounds.minCorner) * lScale;
+
+	const auto lCell = [lCellCount] (const float f) -> std::uint32_t
+	{
+		if (f <= 0.0f) return 0;
+		const auto lResult = static_cast<std::uint32_t>(f);
+		return lResult < lCellCount ? lResult : lCellCount - 1;
+	};
+
+	const auto lMinX = lCell(lMin.x), lMaxX = lCell(lMax.x);
+	const auto lMinY = lCell(lMin.y), lMaxY = lCell(lMax.y);
+	const auto lMinZ = lCell(lMin.z), lMaxZ = lCell(lMax.z);
+
+	// The deepest common ancestor of the two corner cells is found by
+	// looking at the highest bit in which the cell coordinates differ.
+	const auto lDiff = (lMinX ^ lMaxX) | (lMinY ^ lMaxY) | (lMinZ ^ lMaxZ);
+	const auto lShift = lDiff == 0 ? 0 : mostSignificantBit(lDiff) + 1;
+	const auto lDepth = mMaxDepth - lShift;
+
+	return (std::uint64_t(1) << (3 * lDepth))
+		| mortonEncode(lMinX >> lShift, lMinY >> lShift, lMinZ >> lShift);
+}
+
+box3f LinearOctree::nodeBounds(const std::uint64_t code) const noexcept
+{
+	const auto lDepth = locationCodeDepth(code);
+	std::uint32_t x, y, z;
+	mortonDecode(code ^ (std::uint64_t(1) << (3 * lDepth)), x, y, z);
+	const auto lSize = (mBounds.maxCorner - mBounds.minCorner)
+		/ float(std::uint32_t(1) << lDepth);
+	const auto lMin = mBounds.minCorner
+		+ vec3f(float(x), float(y), float(z)) * lSize;
+	return box3f(lMin, lMin + lSize);
+}
+
+void LinearOctree::update() const
+{
+	if (mBuiltSubdivisionThreshold != subdivisionThreshold) updateMaxDepth();
+
+	if (!mIsDirty) return;
+
+	// Step 1: Remove the erased entities, keeping the relative order of
+	// the remaining entities intact.
+	if (!mErasedEntities.empty())
+	{
+		const std::unordered_set<Entity*> lErased(mErasedEntities.begin(),
+			mErasedEntities.end());
+		std::size_t lLast = 0;
+		for (std::size_t i = 0; i < mEntities.size(); ++i)
+		{
+			if (lErased.count(mEntities[i])) continue;
+			mEntities[lLast] = mEntities[i];
+			mEntityBounds[lLast] = mEntityBounds[i];
+			mEntityCodes[lLast] = mEntityCodes[i];
+			++lLast;
+		}
+		mEntities.resize(lLast);
+		mEntityBounds.resize(lLast);
+		mEntityCodes.resize(lLast);
+		mErasedEntities.clear();
+	}
+
+	// Step 2: Recompute the bounds and location codes of the entities
+	// that moved.
+	if (!mMovedEntities.empty())
+	{
+		const std::unordered_set<Entity*> lMoved(mMovedEntities.begin(),
+			mMovedEntities.end());
+		for (std::size_t i = 0; i < mEntities.size(); ++i)
+		{
+			if (lMoved.count(mEntities[i]) == 0) continue;
+			mEntityBounds[i] = mEntities[i]->globalBoundingBox();
+			mEntityCodes[i] = locationCode(mEntityBounds[i]);
+		}
+		mMovedEntities.clear();
+	}
+
+	// Step 3: Sort the entities in depth-first order of their nodes. A
+	// location code is turned into a sort key by aligning its path to the
+	// deepest level. Ancestors share the aligned path of their first
+	// descendant, so ties are broken by depth.
+	const auto lSortKey = [this] (const std::uint64_t code)
+	{
+		const auto lDepth = locationCodeDepth(code);
+		const auto lPath = code ^ (std::uint64_t(1) << (3 * lDepth));
+		return std::make_pair(lPath << (3 * (mMaxDepth - lDepth)), lDepth);
+	};
+	std::vector<std::uint32_t> lOrder(mEntities.size());
+	std::iota(lOrder.begin(), lOrder.end(), 0);
+	std::stable_sort(lOrder.begin(), lOrder.end(),
+		[this, &lSortKey] (const std::uint32_t a, const std::uint32_t b)
+	{
+		return lSortKey(mEntityCodes[a]) < lSortKey(mEntityCodes[b]);
+	});
+	{
+		std::vector<Entity*> lEntities(mEntities.size());
+		std::vector<box3f, allocator<box3f>> lBounds(mEntities.size());
+		std::vector<std::uint64_t> lCodes(mEntities.size());
+		for (std::size_t i = 0; i < lOrder.size(); ++i)
+		{
+			lEntities[i] = mEntities[lOrder[i]];
+			lBounds[i] = mEntityBounds[lOrder[i]];
+			lCodes[i] = mEntityCodes[lOrder[i]];
+		}
+		mEntities.swap(lEntities);
+		mEntityBounds.swap(lBounds);
+		mEntityCodes.swap(lCodes);
+	}
+
+	// Step 4: Build the node array with a stack of open ancestors. Every
+	// node on the path from the root to an Entity is created, so the
+	// nodes come out in depth-first order too.
+	mNodes.clear();
+	mNodes.push_back({GT_LINEAR_OCTREE_ROOT_CODE, 0, 0, 0});
+	std::vector<std::uint32_t> lStack(1, 0);
+	const auto lClose = [this, &lStack] ()
+	{
+		mNodes[lStack.back()].skip = static_cast<std::uint32_t>(mNodes.size());
+		lStack.pop_back();
+	};
+	for (std::uint32_t i = 0; i < mEntities.size(); ++i)
+	{
+		const auto lCode = mEntityCodes[i];
+		if (mNodes[lStack.back()].locationCode == lCode)
+		{
+			++mNodes[lStack.back()].entityCount;
+			continue;
+		}
+		while (!locationCodeIsAncestor(mNodes[lStack.back()].locationCode, lCode))
+		{
+			lClose();
+		}
+		const auto lParentDepth = locationCodeDepth(mNodes[lStack.back()].locationCode);
+		const auto lDepth = locationCodeDepth(lCode);
+		for (auto d = lParentDepth + 1; d <= lDepth; ++d)
+		{
+			lStack.push_back(static_cast<std::uint32_t>(mNodes.size()));
+			mNodes.push_back({lCode >> (3 * (lDepth - d)), i, 0, 0});
+		}
+		mNodes.back().entityCount = 1;
+	}
+	while (!lStack.empty()) lClose();
+
+	mIsDirty = false;
+}
+
+} // namespace gintonic
@@ -1,5 +1,9 @@
 #include "Foundation/Octree.hpp"
+#include "Foundation/allocator.hpp"
 #include "Foundation/exception.hpp"
+#include "Foundation/morton.hpp"
+#include <algorithm>
+#include <cmath>
 #include <sstream>
 
 namespace gintonic {
@@ -44,39 +48,9 @@ Octree::Octree(const vec3f& minCorner, const vec3f& maxCorner)
 
 Octree::Octree(const Octree& other)
 : mBounds(other.mBounds)
-, mEntities(other.mEntities)
+, subdivisionThreshold(other.subdivisionThreshold)
 {
-	if (other.mAllocationPlace)
-	{
-		mAllocationPlace = _mm_malloc(sizeof(Octree) * 8, 16);
-		assert(mAllocationPlace != nullptr);
-		for (std::size_t c = 0; c < 8; ++c)
-		{
-			mChild[0] = new ((Octree*)mAllocationPlace + c) Octree(*(other.mChild[c]));
-		}
-	}
-	else
-	{
-		mChild[0] = mChild[1] = mChild[2] 
-			= mChild[3] = mChild[4] = mChild[5] 
-			= mChild[6] = mChild[7] = nullptr;
-	}
-	// if (other.mChild[0]) mChild[0] = new Octree(*(other.mChild[0]));
-	// else mChild[0] = nullptr;
-	// if (other.mChild[1]) mChild[1] = new Octree(*(other.mChild[1]));
-	// else mChild[1] = nullptr;
-	// if (other.mChild[2]) mChild[2] = new Octree(*(other.mChild[2]));
-	// else mChild[2] = nullptr;
-	// if (other.mChild[3]) mChild[3] = new Octree(*(other.mChild[3]));
-	// else mChild[3] = nullptr;
-	// if (other.mChild[4]) mChild[4] = new Octree(*(other.mChild[4]));
-	// else mChild[4] = nullptr;
-	// if (other.mChild[5]) mChild[5] = new Octree(*(other.mChild[5]));
-	// else mChild[5] = nullptr;
-	// if (other.mChild[6]) mChild[6] = new Octree(*(other.mChild[6]));
-	// else mChild[6] = nullptr;
-	// if (other.mChild[7]) mChild[7] = new Octree(*(other.mChild[7]));
-	// else mChild[7] = nullptr;
+	copyFrom(other, this);
 }
 
 Octree::Octree(Octree&& other)
@@ -84,6 +58,11 @@ Octree::Octree(Octree&& other)
 , mParent(other.mParent)
 , mBounds(std::move(other.mBounds))
 , mEntities(std::move(other.mEntities))
+, mEntityPointers(std::move(other.mEntityPointers))
+, mEntityBounds(std::move(other.mEntityBounds))
+, mDirtyEntities(std::move(other.mDirtyEntities))
+, mNeedsPruning(other.mNeedsPruning)
+, subdivisionThreshold(other.subdivisionThreshold)
 {
 	mChild[0] = other.mChild[0];
 	mChild[1] = other.mChild[1];
@@ -100,49 +79,32 @@ Octree::Octree(Octree&& other)
 	other.mChild[0] = other.mChild[1] = other.mChild[2] 
 		= other.mChild[3] = other.mChild[4] = other.mChild[5] 
 		= other.mChild[6] = other.mChild[7] = nullptr;
+
+	adoptChildrenAndEntities();
 }
 
 Octree& Octree::operator = (const Octree& other)
 {
-	// Explicitly call the destructor.
-	this->~Octree();
+	if (this == &other) return *this;
 
-	assert(mAllocationPlace == nullptr);
-
-	if (other.mAllocationPlace != nullptr)
-	{
-		mAllocationPlace = _mm_malloc(sizeof(Octree) * 8, 16);
-		assert(mAllocationPlace != nullptr);
-		for (std::size_t c = 0; c < 8; ++c)
-		{
-			mChild[0] = new ((Octree*)mAllocationPlace + c) Octree(*(other.mChild[c]));
-		}
-	}
+	destroyChildren();
+	mEntities.clear();
+	mEntityPointers.clear();
+	mEntityBounds.clear();
 
-	// if (other.mChild[0]) mChild[0] = new Octree(*(other.mChild[0]));
-	// else mChild[0] = nullptr;
-	// if (other.mChild[1]) mChild[1] = new Octree(*(other.mChild[1]));
-	// else mChild[1] = nullptr;
-	// if (other.mChild[2]) mChild[2] = new Octree(*(other.mChild[2]));
-	// else mChild[2] = nullptr;
-	// if (other.mChild[3]) mChild[3] = new Octree(*(other.mChild[3]));
-	// else mChild[3] = nullptr;
-	// if (other.mChild[4]) mChild[4] = new Octree(*(other.mChild[4]));
-	// else mChild[4] = nullptr;
-	// if (other.mChild[5]) mChild[5] = new Octree(*(other.mChild[5]));
-	// else mChild[5] = nullptr;
-	// if (other.mChild[6]) mChild[6] = new Octree(*(other.mChild[6]));
-	// else mChild[6] = nullptr;
-	// if (other.mChild[7]) mChild[7] = new Octree(*(other.mChild[7]));
-	// else mChild[7] = nullptr;
+	mDirtyEntities.clear();
+	mBounds = other.mBounds;
+	subdivisionThreshold = other.subdivisionThreshold;
+	copyFrom(other, getRoot());
 
 	return *this;
 }
 
 Octree& Octree::operator = (Octree&& other)
 {
-	// Explicitly call the destructor.
-	this->~Octree();
+	if (this == &other) return *this;
+
+	destroyChildren();
 
 	mAllocationPlace = other.mAllocationPlace;
 	other.mAllocationPlace = nullptr;
@@ -164,11 +126,65 @@ Octree& Octree::operator = (Octree&& other)
 		= other.mChild[3] = other.mChild[4] = other.mChild[5] 
 		= other.mChild[6] = other.mChild[7] = nullptr;
 
+	mBounds = std::move(other.mBounds);
+	mEntities = std::move(other.mEntities);
+	mEntityPointers = std::move(other.mEntityPointers);
+	mEntityBounds = std::move(other.mEntityBounds);
+	mDirtyEntities = std::move(other.mDirtyEntities);
+	mNeedsPruning = other.mNeedsPruning;
+	subdivisionThreshold = other.subdivisionThreshold;
+
+	adoptChildrenAndEntities();
+
 	return *this;
 }
 
 // Non-trivial destructor calls delete on all of its children.
 Octree::~Octree()
+{
+	destroyChildren();
+}
+
+void Octree::copyFrom(const Octree& other, Octree* root)
+{
+	// The copy gets its own connections to the entities. Entities that
+	// moved but were not committed yet are still pending in the copy.
+	for (std::size_t i = 0; i < other.mEntities.size(); ++i)
+	{
+		if (auto lEntityPtr = other.mEntities[i]->entity.lock())
+		{
+			attach(std::move(lEntityPtr), other.mEntityBounds.get(i));
+			if (other.mEntities[i]->dirty)
+			{
+				auto* lHolder = mEntities.back().get();
+				lHolder->dirty = true;
+				lHolder->dirtyIndex = root->mDirtyEntities.size();
+				root->mDirtyEntities.push_back(lHolder);
+			}
+		}
+	}
+	if (other.mAllocationPlace != nullptr)
+	{
+		mAllocationPlace = _mm_malloc(sizeof(Octree) * 8, 16);
+		assert(mAllocationPlace != nullptr);
+		for (std::size_t c = 0; c < 8; ++c)
+		{
+			mChild[c] = new ((Octree*)mAllocationPlace + c) Octree(subdivisionThreshold, this, other.mChild[c]->mBounds);
+			mChild[c]->copyFrom(*(other.mChild[c]), root);
+		}
+	}
+}
+
+void Octree::adoptChildrenAndEntities() noexcept
+{
+	// The event handlers and the children refer to their node, which just
+	// moved to a new address.
+	for (auto& lHolder : mEntities) lHolder->node = this;
+	if (mAllocationPlace == nullptr) return;
+	for (auto* lChildNode : mChild) lChildNode->mParent = this;
+}
+
+void Octree::destroyChildren() noexcept
 {
 	if (mAllocationPlace != nullptr)
 	{
@@ -189,6 +205,28 @@ bool Octree::isLeaf() const noexcept
 	return mAllocationPlace == nullptr;
 }
 
+SpatialStatistics Octree::statistics() const
+{
+	SpatialStatistics lResult;
+	gatherStatistics(lResult, 0);
+	return lResult;
+}
+
+void Octree::gatherStatistics(SpatialStatistics& statistics, const std::size_t depth) const
+{
+	// The children of a node are allocated in one block, so every node
+	// accounts for one slot of that block. The dirty list lives in the root.
+	const auto lBytes = sizeof(Octree)
+		+ mEntities.capacity() * sizeof(std::unique_ptr<EntityHolder>)
+		+ mEntities.size() * sizeof(EntityHolder)
+		+ mEntityPointers.capacity() * sizeof(Entity*)
+		+ mEntityBounds.memoryUsage()
+		+ mDirtyEntities.capacity() * sizeof(EntityHolder*);
+	statistics.addNode(depth, mEntities.size(), isLeaf(), lBytes);
+	if (isLeaf()) return;
+	for (const auto* lChildNode : mChild) lChildNode->gatherStatistics(statistics, depth + 1);
+}
+
 std::size_t Octree::count() const
 {
 	std::size_t lResult = mEntities.size();
@@ -205,7 +243,13 @@ std::size_t Octree::count() const
 
 void Octree::insert(std::shared_ptr<Entity> entity)
 {
-	if (mBounds.contains(entity->globalBoundingBox()) == false)
+	const auto lBounds = entity->globalBoundingBox();
+	insert(std::move(entity), lBounds);
+}
+
+void Octree::insert(Entity::SharedPtr entity, const box3f& bounds)
+{
+	if (mBounds.contains(bounds) == false)
 	{
 		throw EntityNotContainedInOctreeBoundingBox(this, std::move(entity));
 	}
@@ -223,104 +267,113 @@ void Octree::insert(std::shared_ptr<Entity> entity)
 	{
 		for (auto* lChildNode : mChild)
 		{
-			if (lChildNode->mBounds.contains(entity->globalBoundingBox()))
+			if (lChildNode->mBounds.contains(bounds))
 			{
-				lChildNode->insert(std::move(entity));
+				lChildNode->insert(std::move(entity), bounds);
 				return;
 			}
 		}
 	}
 
 
-	// entity->mOctree = this;
-	
-	mEntities.emplace_back(entity);
-	auto lHolderIter = std::prev(mEntities.end());
-
 	// If we arrive here, then none of the mChild nodes
 	// can contain the entity. So we add it to this node.
+	attach(std::move(entity), bounds);
+}
+
+void Octree::attach(Entity::SharedPtr entity, const box3f& bounds)
+{
+	auto* lHolder = new EntityHolder();
+	mEntities.emplace_back(lHolder);
+	lHolder->entity = entity;
+	lHolder->node = this;
+	lHolder->slot = mEntityPointers.size();
+	mEntityPointers.push_back(entity.get());
+	mEntityBounds.push_back(bounds);
 
 	// Subscribe to the onTransformChanged event of the Entity.
 	// When the Entity changes its tranformation matrix, we need to
-	// update the octree along with it. We store the connection object
-	// so that we may disconnect from the entity once it leaves the bounding
-	// box of this octree node.
-	auto lTransformChangeConnection = entity->onTransformChange.connect
+	// update the octree along with it. We only remember that it moved;
+	// Octree::commitUpdates relocates it once, no matter how often it
+	// moved in the meantime.
+	lHolder->transformChangeConnection = entity->onTransformChange.connect
 	(
-		[this, lHolderIter] (Entity::SharedPtr thisEntity)
+		[lHolder] (Entity::SharedPtr thisEntity)
 		{
-			if (auto lSharedPtr = lHolderIter->entity.lock())
-			{
-				auto lUpmostParent = this->erase(lHolderIter);
-				lUpmostParent->backRecursiveInsert(lSharedPtr);
-			}
-			// if (auto lSharedPtr = lPointerForLambda.lock())
-			// {
-			// 	Octree* lUpmostParent = this->mChildren.erase(lIterForLambda);
-			// 	lUpmostParent->backRecursiveInsert(lSharedPtr);
-			// }
-			// else
-			// {
-			// 	// Entity died in the meantime, ignore it.
-			// }
-			// assert(this == thisEntity->mOctree);
-			// auto lUpmostParent = this->erase(thisEntity->mOctreeListIter);
-			// assert(lUpmostParent);
-			// thisEntity->mOctree = nullptr;
-			// lUpmostParent->backRecursiveInsert(thisEntity);
+			if (lHolder->dirty) return;
+			auto* lRoot = lHolder->node->getRoot();
+			lHolder->dirty = true;
+			lHolder->dirtyIndex = lRoot->mDirtyEntities.size();
+			lRoot->mDirtyEntities.push_back(lHolder);
 		}
 	);
 
-	lHolderIter->transformChangeConnection = std::move(lTransformChangeConnection);
-
 	// Subscribe to the onDie event of the Entity.
 	// When the Entity dies (i.e. destructor is called), we need to
 	// be notified of that event so that we remove the Entity from the octree node too.
-	auto lDieConnection = entity->onDie.connect
+	lHolder->destructConnection = entity->onDie.connect
 	(
-		[this, lHolderIter] (Entity* thisEntity)
+		[lHolder] (Entity* thisEntity)
 		{
-			this->erase(lHolderIter);
-			// assert(this == thisEntity->mOctree);
-			// #ifdef NDEBUG
-			// 	thisEntity->mOctree->erase(thisEntity->mOctreeListIter);
-			// #else
-			// 	auto lUpmostParent = thisEntity->mOctree->erase(thisEntity->mOctreeListIter);
-			// 	assert(lUpmostParent);
-			// #endif
+			lHolder->node->eraseSlot(lHolder->slot);
 		}
 	);
+}
+
+bool Octree::isBestFitFor(const box3f& bounds) const noexcept
+{
+	// This must agree with Octree::insert, which subdivides a leaf before
+	// it looks at the children.
+	if (mBounds.contains(bounds) == false) return false;
+	if (isLeaf())
+	{
+		const auto lHalf = (mBounds.maxCorner - mBounds.minCorner) / 2.0f;
+		return lHalf.x <= subdivisionThreshold 
+			|| lHalf.y <= subdivisionThreshold 
+			|| lHalf.z <= subdivisionThreshold;
+	}
+	for (const auto* lChildNode : mChild)
+	{
+		if (lChildNode->mBounds.contains(bounds)) return false;
+	}
+	return true;
+}
 
-	lHolderIter->destructConnection = std::move(lDieConnection);
+void Octree::removeSlot(const std::size_t slot) noexcept
+{
+	// Make sure that Octree::commitUpdates does not visit the holder.
+	const auto& lHolder = mEntities[slot];
+	if (lHolder->dirty) getRoot()->mDirtyEntities[lHolder->dirtyIndex] = nullptr;
 
-	
-	// mEntities.emplace_back(entity, std::move(lTransformChangeConnection), std::move(lDieConnection));
-	// entity->mOctreeListIter = std::prev(mEntities.end());
+	// Move the last Entity into the hole in all three arrays.
+	const auto lLast = mEntities.size() - 1;
+	if (slot != lLast)
+	{
+		mEntities[slot] = std::move(mEntities[lLast]);
+		mEntities[slot]->slot = slot;
+		mEntityPointers[slot] = mEntityPointers[lLast];
+	}
+	mEntities.pop_back();
+	mEntityPointers.pop_back();
+	mEntityBounds.swapRemove(slot);
+}
+
+Octree* Octree::eraseSlot(const std::size_t slot)
+{
+	removeSlot(slot);
+	return mParent ? mParent->backRecursiveDelete() : this;
 }
 
 Octree* Octree::erase()
 {
 	std::size_t lEraseCount(0);
-	// DEBUG_PRINT;
-	// if (entity->mOctree != this) return nullptr;
-	// DEBUG_PRINT;
-	auto lIter = mEntities.begin();
-	while (lIter != mEntities.end())
+	for (auto i = mEntities.size(); i-- > 0; )
 	{
-		if (lIter->entity.expired())
+		if (mEntities[i]->entity.expired())
 		{
-			// lIter->transformChangeConnection.disconnect();
-			// lIter->destructConnection.disconnect();
-			// lIter->transformChangeConnection.disconnect();
-			// lIter->destructConnection.disconnect();
-			// destroyEntityHolder(*lIter);
-			lIter = mEntities.erase(lIter);
+			removeSlot(i);
 			++lEraseCount;
 		}
-		else
-		{
-			++lIter;
-		}
 	}
 	if (lEraseCount > 0)
 	{
@@ -332,21 +385,11 @@ Octree* Octree::erase()
 	}
 }
 
-Octree* Octree::erase(const std::list<EntityHolder>::iterator& iter)
-{
-	mEntities.erase(iter);
-	return mParent ? mParent->backRecursiveDelete() : this;
-}
-
 Octree* Octree::erase(Entity::SharedPtr entity)
 {
-	for (auto lIter = mEntities.begin(); lIter != mEntities.end(); ++lIter)
+	for (std::size_t i = 0; i < mEntityPointers.size(); ++i)
 	{
-		if (entity == lIter->entity.lock())
-		{
-			mEntities.erase(lIter);
-			return mParent ? mParent->backRecursiveDelete() : this;
-		}
+		if (mEntityPointers[i] == entity.get()) return eraseSlot(i);
 	}
 	if (isLeaf())
 	{
@@ -379,15 +422,178 @@ const Octree* Octree::getRoot() const noexcept
 	return lResult;
 }
 
-void Octree::backRecursiveInsert(std::shared_ptr<Entity> entity)
+Entity::SharedPtr Octree::raycast(
+	const vec3f& origin, 
+	const vec3f& direction, 
+	const float maxDistance, 
+	float& distance)
+{
+	const ray3f lRay(origin, vec3f(direction).normalize());
+	auto lMaxDistance = maxDistance;
+	std::vector<DistanceAndEntity> lHits;
+	raycastRecursive(lRay, lMaxDistance, true, lHits);
+	if (lHits.empty()) return nullptr;
+	GT_SPATIAL_COUNT(results, 1);
+	distance = lHits.front().first;
+	return std::move(lHits.front().second);
+}
+
+Entity::ConstSharedPtr Octree::raycast(
+	const vec3f& origin, 
+	const vec3f& direction, 
+	const float maxDistance, 
+	float& distance) const
+{
+	const ray3f lRay(origin, vec3f(direction).normalize());
+	auto lMaxDistance = maxDistance;
+	std::vector<DistanceAndEntity> lHits;
+	raycastRecursive(lRay, lMaxDistance, true, lHits);
+	if (lHits.empty()) return nullptr;
+	GT_SPATIAL_COUNT(results, 1);
+	distance = lHits.front().first;
+	return std::move(lHits.front().second);
+}
+
+void Octree::raycastSorted(
+	const vec3f& origin, 
+	const vec3f& direction, 
+	const float maxDistance, 
+	std::vector<DistanceAndEntity>& hits) const
+{
+	const ray3f lRay(origin, vec3f(direction).normalize());
+	auto lMaxDistance = maxDistance;
+	raycastRecursive(lRay, lMaxDistance, false, hits);
+	GT_SPATIAL_COUNT(results, hits.size());
+	std::stable_sort(hits.begin(), hits.end(), [] (const DistanceAndEntity& a, const DistanceAndEntity& b)
+	{
+		return a.first < b.first;
+	});
+}
+
+void Octree::raycastRecursive(
+	const ray3f& ray, 
+	float& maxDistance, 
+	const bool closestOnly, 
+	std::vector<DistanceAndEntity>& hits) const
+{
+	GT_SPATIAL_COUNT(nodesVisited, 1);
+	GT_SPATIAL_COUNT(boxesTested, mEntities.size());
+	float lDistance;
+	for (std::size_t i = 0; i < mEntities.size(); ++i)
+	{
+		if (!ray.intersects(mEntityBounds.get(i), 0.0f, maxDistance, lDistance)) continue;
+		if (auto lEntityPtr = mEntities[i]->entity.lock())
+		{
+			if (closestOnly)
+			{
+				// Everything beyond this hit can be ignored from now on.
+				hits.clear();
+				maxDistance = lDistance;
+			}
+			hits.emplace_back(lDistance, std::move(lEntityPtr));
+		}
+	}
+	if (isLeaf()) return;
+
+	// Sort the children that the ray hits by their entry distance, so that
+	// the closest hit is found early and prunes the children behind it.
+	std::pair<float, const Octree*> lOrder[8];
+	int lOrderCount = 0;
+	for (const auto* lChildNode : mChild)
+	{
+		if (lChildNode->isLeaf() && lChildNode->hasNoEntities()) continue;
+		if (!ray.intersects(lChildNode->mBounds, 0.0f, maxDistance, lDistance)) continue;
+		auto i = lOrderCount++;
+		for (; i > 0 && lOrder[i - 1].first > lDistance; --i) lOrder[i] = lOrder[i - 1];
+		lOrder[i] = std::make_pair(lDistance, lChildNode);
+	}
+	for (int i = 0; i < lOrderCount; ++i)
+	{
+		if (lOrder[i].first > maxDistance) break;
+		lOrder[i].second->raycastRecursive(ray, maxDistance, closestOnly, hits);
+	}
+}
+
+void Octree::nearestSorted(
+	const vec3f& point, 
+	const std::size_t k, 
+	std::vector<DistanceAndEntity>& result) const
+{
+	result.clear();
+	if (k == 0) return;
+	result.reserve(k);
+
+	// The result is a max-heap of squared distances, so that its front is
+	// the k-th nearest Entity found so far. The nodes still to visit are in
+	// a min-heap on the squared distance to their bounds.
+	using NodeEntry = std::pair<float, const Octree*>;
+	const auto lFartherLast = [] (const DistanceAndEntity& a, const DistanceAndEntity& b)
+	{
+		return a.first < b.first;
+	};
+	const auto lNearerFirst = [] (const NodeEntry& a, const NodeEntry& b)
+	{
+		return a.first > b.first;
+	};
+	std::vector<NodeEntry> lQueue;
+	lQueue.emplace_back(0.0f, this);
+
+	while (!lQueue.empty())
+	{
+		std::pop_heap(lQueue.begin(), lQueue.end(), lNearerFirst);
+		const auto lEntry = lQueue.back();
+		lQueue.pop_back();
+
+		// Every node still in the queue is at least this far away.
+		if (result.size() == k && lEntry.first > result.front().first) break;
+
+		const auto* lNode = lEntry.second;
+		GT_SPATIAL_COUNT(nodesVisited, 1);
+		GT_SPATIAL_COUNT(boxesTested, lNode->mEntities.size());
+		for (std::size_t i = 0; i < lNode->mEntities.size(); ++i)
+		{
+			const auto lDistance2 = distance2(lNode->mEntityBounds.get(i), point);
+			if (result.size() == k && lDistance2 >= result.front().first) continue;
+			if (auto lEntityPtr = lNode->mEntities[i]->entity.lock())
+			{
+				if (result.size() < k)
+				{
+					result.emplace_back(lDistance2, std::move(lEntityPtr));
+					std::push_heap(result.begin(), result.end(), lFartherLast);
+				}
+				else
+				{
+					std::pop_heap(result.begin(), result.end(), lFartherLast);
+					result.back() = DistanceAndEntity(lDistance2, std::move(lEntityPtr));
+					std::push_heap(result.begin(), result.end(), lFartherLast);
+				}
+			}
+		}
+		if (lNode->isLeaf()) continue;
+		for (const auto* lChildNode : lNode->mChild)
+		{
+			if (lChildNode->isLeaf() && lChildNode->hasNoEntities()) continue;
+			const auto lDistance2 = distance2(lChildNode->mBounds, point);
+			if (result.size() == k && lDistance2 > result.front().first) continue;
+			lQueue.emplace_back(lDistance2, lChildNode);
+			std::push_heap(lQueue.begin(), lQueue.end(), lNearerFirst);
+		}
+	}
+
+	std::sort_heap(result.begin(), result.end(), lFartherLast);
+	GT_SPATIAL_COUNT(results, result.size());
+	for (auto& lPair : result) lPair.first = std::sqrt(lPair.first);
+}
+
+void Octree::backRecursiveInsert(Entity::SharedPtr entity, const box3f& bounds)
 {
-	if (mBounds.contains(entity->globalBoundingBox()))
+	if (mBounds.contains(bounds))
 	{
-		insert(std::move(entity));
+		insert(std::move(entity), bounds);
 	}
 	else if (mParent)
 	{
-		mParent->backRecursiveInsert(std::move(entity));
+		mParent->backRecursiveInsert(std::move(entity), bounds);
 	}
 	else
 	{
@@ -485,4 +691,244 @@ void Octree::subdivide()
 	mChild[7] = new ((Octree*)mAllocationPlace + 7) Octree(subdivisionThreshold, this, lMin, lMin + lHalf);
 }
 
-} // namespace gintonic
\ No newline at end of file
+// The minimum number of entities in a subtree before that subtree is built
+// as a separate task on the thread pool.
+#define GT_OCTREE_PARALLEL_BUILD_THRESHOLD 1024
+
+// The number of bits per axis of the Morton codes that sort the entities.
+#define GT_OCTREE_BULK_MORTON_BITS 10
+
+struct Octree::BulkItem
+{
+	box3f bounds;
+	std::uint64_t code;
+	std::uint32_t index;
+	std::uint32_t octant;
+};
+
+void Octree::bulkInsert(std::vector<Entity::SharedPtr> entities)
+{
+	const auto lCount = entities.size();
+	if (lCount == 0) return;
+
+	BulkItemVector lItems(lCount);
+
+	// Global transforms are computed lazily, and entities share their
+	// ancestors. Resolve them here, before the threads read them.
+	for (const auto& lEntity : entities) lEntity->globalTransform();
+
+	// Compute the bounding box of every entity once, together with the
+	// Morton code of its center.
+	ThreadPool::get().parallelFor(0, lCount, GT_OCTREE_PARALLEL_BUILD_THRESHOLD,
+		[this, &lItems, &entities] (const std::size_t first, const std::size_t last)
+	{
+		for (auto i = first; i < last; ++i)
+		{
+			auto& lItem = lItems[i];
+			lItem.bounds = entities[i]->globalBoundingBox();
+			lItem.index = static_cast<std::uint32_t>(i);
+			lItem.code = bulkCode(lItem.bounds);
+		}
+	});
+
+	for (const auto& lItem : lItems)
+	{
+		if (mBounds.contains(lItem.bounds) == false)
+		{
+			throw EntityNotContainedInOctreeBoundingBox(this, entities[lItem.index]);
+		}
+	}
+
+	insertBulkItems(lItems, entities);
+}
+
+std::uint64_t Octree::bulkCode(const box3f& bounds) const noexcept
+{
+	const auto lCellCount = float((1 << GT_OCTREE_BULK_MORTON_BITS) - 1);
+	const auto lScale = vec3f(lCellCount) / (mBounds.maxCorner - mBounds.minCorner);
+	const auto lCenter = (0.5f * (bounds.minCorner + bounds.maxCorner) - mBounds.minCorner) * lScale;
+	return mortonEncode(
+		static_cast<std::uint32_t>(std::max(0.0f, lCenter.x)),
+		static_cast<std::uint32_t>(std::max(0.0f, lCenter.y)),
+		static_cast<std::uint32_t>(std::max(0.0f, lCenter.z)));
+}
+
+void Octree::insertBulkItems(
+	BulkItemVector& items, 
+	const std::vector<Entity::SharedPtr>& entities)
+{
+	// After sorting, the entities that end up in the same subtree are
+	// (mostly) adjacent, so partitioning them touches memory sequentially.
+	std::sort(items.begin(), items.end(), [] (const BulkItem& a, const BulkItem& b)
+	{
+		return a.code < b.code;
+	});
+
+	BulkItemVector lScratch(items.size());
+	ThreadPool::TaskGroup lGroup;
+	bulkInsertRecursive(items.data(), lScratch.data(), items.size(), entities, lGroup);
+	lGroup.wait();
+}
+
+void Octree::commitUpdates()
+{
+	if (mParent)
+	{
+		getRoot()->commitUpdates();
+		return;
+	}
+
+	std::vector<EntityHolder*> lDirty;
+	std::swap(lDirty, mDirtyEntities);
+
+	BulkItemVector lItems;
+	std::vector<Entity::SharedPtr> lEntities;
+	std::vector<Entity::SharedPtr> lOutside;
+
+	for (auto* lHolder : lDirty)
+	{
+		if (lHolder == nullptr) continue; // The Entity left the tree.
+		lHolder->dirty = false;
+		auto* lNode = lHolder->node;
+		const auto lSlot = lHolder->slot;
+		const auto lBounds = lNode->mEntityPointers[lSlot]->globalBoundingBox();
+		if (lNode->isBestFitFor(lBounds))
+		{
+			lNode->mEntityBounds.set(lSlot, lBounds);
+			continue;
+		}
+
+		// This destroys the holder.
+		auto lEntityPtr = lHolder->entity.lock();
+		lNode->removeSlot(lSlot);
+		lNode->markForPruning();
+
+		if (mBounds.contains(lBounds) == false)
+		{
+			lOutside.push_back(std::move(lEntityPtr));
+			continue;
+		}
+		BulkItem lItem;
+		lItem.bounds = lBounds;
+		lItem.code = bulkCode(lBounds);
+		lItem.index = static_cast<std::uint32_t>(lEntities.size());
+		lItems.push_back(lItem);
+		lEntities.push_back(std::move(lEntityPtr));
+	}
+
+	if (!lItems.empty()) insertBulkItems(lItems, lEntities);
+	if (mNeedsPruning) prune();
+	if (!lOutside.empty())
+	{
+		throw EntityNotContainedInOctreeBoundingBox(this, std::move(lOutside));
+	}
+}
+
+void Octree::markForPruning() noexcept
+{
+	for (auto* lNode = this; lNode && !lNode->mNeedsPruning; lNode = lNode->mParent)
+	{
+		lNode->mNeedsPruning = true;
+	}
+}
+
+void Octree::prune() noexcept
+{
+	// Post-order, so that a parent sees the children after they have been
+	// pruned themselves.
+	mNeedsPruning = false;
+	if (isLeaf()) return;
+	for (auto* lChildNode : mChild)
+	{
+		if (lChildNode->mNeedsPruning) lChildNode->prune();
+	}
+	for (const auto* lChildNode : mChild)
+	{
+		if (!lChildNode->isLeaf() || !lChildNode->hasNoEntities()) return;
+	}
+	destroyChildren();
+}
+
+void Octree::bulkInsertRecursive(
+	BulkItem* items, 
+	BulkItem* scratch, 
+	const std::size_t count, 
+	const std::vector<Entity::SharedPtr>& entities, 
+	ThreadPool::TaskGroup& group)
+{
+	// Octree::insert subdivides every node that an entity reaches, even if
+	// the entity stays in that node. Do the same to get an identical tree.
+	if (isLeaf()) subdivide();
+
+	std::size_t lCounts[9] = {0, 0, 0, 0, 0, 0, 0, 0, 0};
+	std::size_t lOwnCount = count;
+	auto* lOwn = items;
+
+	if (!isLeaf())
+	{
+		// Octant 8 means that the entity stays in this node.
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			std::uint32_t lOctant = 0;
+			while (lOctant < 8 && !mChild[lOctant]->mBounds.contains(items[i].bounds)) ++lOctant;
+			items[i].octant = lOctant;
+			++lCounts[lOctant];
+		}
+
+		// Stable counting sort into the scratch buffer. The entities of this
+		// node come first, then those of the children in order.
+		std::size_t lOffsets[9];
+		lOffsets[8] = 0;
+		auto lRunningOffset = lCounts[8];
+		for (std::size_t c = 0; c < 8; ++c)
+		{
+			lOffsets[c] = lRunningOffset;
+			lRunningOffset += lCounts[c];
+		}
+		std::size_t lCursor[9];
+		std::copy(std::begin(lOffsets), std::end(lOffsets), std::begin(lCursor));
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			scratch[lCursor[items[i].octant]++] = items[i];
+		}
+
+		// Every child gets its own disjoint range of both buffers, with the
+		// roles of the buffers swapped. This is what makes it safe to build
+		// the subtrees in parallel.
+		for (std::size_t c = 0; c < 8; ++c)
+		{
+			if (lCounts[c] == 0) continue;
+			auto* lChild = mChild[c];
+			auto* lChildItems = scratch + lOffsets[c];
+			auto* lChildScratch = items + lOffsets[c];
+			const auto lChildCount = lCounts[c];
+			if (lChildCount >= GT_OCTREE_PARALLEL_BUILD_THRESHOLD)
+			{
+				group.run([lChild, lChildItems, lChildScratch, lChildCount, &entities, &group] ()
+				{
+					lChild->bulkInsertRecursive(lChildItems, lChildScratch, lChildCount, entities, group);
+				});
+			}
+			else
+			{
+				lChild->bulkInsertRecursive(lChildItems, lChildScratch, lChildCount, entities, group);
+			}
+		}
+
+		lOwnCount = lCounts[8];
+		lOwn = scratch;
+	}
+
+	// Restore the input order so that the entity list of this node is the
+	// same as with one-by-one insertion.
+	std::sort(lOwn, lOwn + lOwnCount, [] (const BulkItem& a, const BulkItem& b)
+	{
+		return a.index < b.index;
+	});
+	for (std::size_t i = 0; i < lOwnCount; ++i)
+	{
+		attach(entities[lOwn[i].index], lOwn[i].bounds);
+	}
+}
+
+} // namespace gintonic
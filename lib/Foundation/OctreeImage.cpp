@@ -0,0 +1,130 @@
+#include "Foundation/OctreeImage.hpp"
+#include "Foundation/exception.hpp"
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <cstring>
+#include <ostream>
+
+namespace gintonic {
+
+namespace {
+
+const char kMagic[8] = {'G', 'T', 'O', 'C', 'T', 'R', 'E', 'E'};
+const std::uint32_t kByteOrder = 0x01020304;
+
+template <class T>
+inline void writeRaw(const T& value, std::ostream& os)
+{
+	os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+} // anonymous namespace
+
+struct OctreeImage::Mapping
+{
+	boost::interprocess::file_mapping file;
+	boost::interprocess::mapped_region region;
+};
+
+constexpr std::uint32_t OctreeImage::kVersion;
+
+std::size_t OctreeImage::imageSize(const Octree& tree) noexcept
+{
+	const auto* lRoot = tree.getRoot();
+	std::size_t lNodeCount = 0;
+	lRoot->forEachNode([&lNodeCount] (const Octree*) { ++lNodeCount; });
+	return sizeof(Header) + lNodeCount * sizeof(Node) + lRoot->count() * sizeof(EntityRecord);
+}
+
+void OctreeImage::writeHeader(const Octree& root, std::ostream& os)
+{
+	std::size_t lNodeCount = 0;
+	root.forEachNode([&lNodeCount] (const Octree*) { ++lNodeCount; });
+
+	Header lHeader;
+	std::memcpy(lHeader.magic, kMagic, sizeof(kMagic));
+	lHeader.version = kVersion;
+	lHeader.byteOrder = kByteOrder;
+	lHeader.nodeCount = static_cast<std::uint32_t>(lNodeCount);
+	lHeader.entityCount = static_cast<std::uint32_t>(root.count());
+	lHeader.subdivisionThreshold = root.subdivisionThreshold;
+	lHeader.reserved = 0;
+	writeRaw(lHeader, os);
+}
+
+void OctreeImage::writeNode(const Node& node, std::ostream& os)
+{
+	writeRaw(node, os);
+}
+
+void OctreeImage::writeEntity(const box3f& bounds, const std::uint32_t index, std::ostream& os)
+{
+	EntityRecord lRecord;
+	lRecord.minCorner[0] = bounds.minCorner.x;
+	lRecord.minCorner[1] = bounds.minCorner.y;
+	lRecord.minCorner[2] = bounds.minCorner.z;
+	lRecord.maxCorner[0] = bounds.maxCorner.x;
+	lRecord.maxCorner[1] = bounds.maxCorner.y;
+	lRecord.maxCorner[2] = bounds.maxCorner.z;
+	lRecord.index = index;
+	lRecord.reserved = 0;
+	writeRaw(lRecord, os);
+}
+
+OctreeImage::OctreeImage(const void* data, const std::size_t size)
+{
+	view(data, size);
+}
+
+OctreeImage::OctreeImage(const boost::filesystem::path& filename)
+: mMapping(new Mapping)
+{
+	using namespace boost::interprocess;
+	mMapping->file = file_mapping(filename.string().c_str(), read_only);
+	mMapping->region = mapped_region(mMapping->file, read_only);
+	view(mMapping->region.get_address(), mMapping->region.get_size());
+}
+
+OctreeImage::OctreeImage(OctreeImage&&) noexcept = default;
+
+OctreeImage& OctreeImage::operator=(OctreeImage&&) noexcept = default;
+
+OctreeImage::~OctreeImage() noexcept = default;
+
+void OctreeImage::view(const void* data, const std::size_t size)
+{
+	if (reinterpret_cast<std::uintptr_t>(data) % alignof(Header) != 0)
+	{
+		throw exception("OctreeImage: The image is not aligned.");
+	}
+	if (size < sizeof(Header))
+	{
+		throw exception("OctreeImage: The image is too small.");
+	}
+	mHeader = static_cast<const Header*>(data);
+	if (std::memcmp(mHeader->magic, kMagic, sizeof(kMagic)) != 0)
+	{
+		throw exception("OctreeImage: Not an octree image.");
+	}
+	if (mHeader->byteOrder != kByteOrder)
+	{
+		throw exception("OctreeImage: The image has a different byte order.");
+	}
+	if (mHeader->version != kVersion)
+	{
+		throw exception("OctreeImage: Unsupported version " + std::to_string(mHeader->version) + ".");
+	}
+	const auto lExpectedSize = sizeof(Header)
+		+ std::size_t(mHeader->nodeCount) * sizeof(Node)
+		+ std::size_t(mHeader->entityCount) * sizeof(EntityRecord);
+	if (mHeader->nodeCount == 0 || size < lExpectedSize)
+	{
+		throw exception("OctreeImage: The image is truncated.");
+	}
+	mNodes = reinterpret_cast<const Node*>(mHeader + 1);
+	mEntities = reinterpret_cast<const EntityRecord*>(mNodes + mHeader->nodeCount);
+}
+
+} // namespace gintonic
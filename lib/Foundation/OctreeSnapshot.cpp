@@ -0,0 +1,51 @@
+#include "Foundation/OctreeSnapshot.hpp"
+
+#include <ostream>
+#include <streambuf>
+
+namespace gintonic {
+
+namespace {
+
+// Writes into a block of memory that is known to be big enough.
+class MemoryBuffer : public std::streambuf
+{
+public:
+	MemoryBuffer(char* first, char* last)
+	{
+		setp(first, last);
+	}
+};
+
+} // anonymous namespace
+
+OctreeSnapshot::OctreeSnapshot(const Octree& tree)
+: mStorage(makeImage(tree, mEntities))
+, mImage(mStorage.data(), mStorage.size() * sizeof(std::uint32_t))
+{
+	/* Empty on purpose. */
+}
+
+std::vector<std::uint32_t> OctreeSnapshot::makeImage(
+	const Octree& tree,
+	std::vector<Entity::ConstWeakPtr>& entities)
+{
+	// The image consists of 4-byte fields only, so a vector of 32-bit
+	// integers gives the right alignment.
+	const auto lSize = OctreeImage::imageSize(tree);
+	std::vector<std::uint32_t> lStorage(lSize / sizeof(std::uint32_t));
+	MemoryBuffer lBuffer(
+		reinterpret_cast<char*>(lStorage.data()),
+		reinterpret_cast<char*>(lStorage.data()) + lSize);
+	std::ostream lStream(&lBuffer);
+
+	entities.reserve(tree.getRoot()->count());
+	OctreeImage::write(tree, lStream, [&entities] (const Entity& entity)
+	{
+		entities.push_back(entity.shared_from_this());
+		return static_cast<std::uint32_t>(entities.size() - 1);
+	});
+	return lStorage;
+}
+
+} // namespace gintonic
@@ -0,0 +1,144 @@
+#include "Foundation/SpatialStatistics.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <ostream>
+
+namespace gintonic {
+
+namespace {
+
+std::mutex sCountersMutex;
+std::vector<const detail::LocalSpatialQueryCounters*> sThreadCounters;
+SpatialQueryCounters sExitedThreadCounters;
+SpatialQueryCounters sPreviousFrameTotal;
+
+SpatialQueryCounters totalWithLock()
+{
+	auto lResult = sExitedThreadCounters;
+	for (const auto* lCounters : sThreadCounters) lResult += lCounters->get();
+	return lResult;
+}
+
+} // anonymous namespace
+
+float SpatialStatistics::innerEntityPercentage() const noexcept
+{
+	if (entityCount == 0) return 0.0f;
+	return 100.0f * static_cast<float>(innerEntityCount) / static_cast<float>(entityCount);
+}
+
+void SpatialStatistics::addNode(
+	const std::size_t depth,
+	const std::size_t entities,
+	const bool isLeaf,
+	const std::size_t bytes)
+{
+	++nodeCount;
+	if (isLeaf) ++leafCount;
+	else innerEntityCount += entities;
+	entityCount += entities;
+	maxEntitiesPerNode = std::max(maxEntitiesPerNode, entities);
+	memoryUsage += bytes;
+
+	if (nodesPerDepth.size() <= depth)
+	{
+		nodesPerDepth.resize(depth + 1, 0);
+		entitiesPerDepth.resize(depth + 1, 0);
+	}
+	++nodesPerDepth[depth];
+	entitiesPerDepth[depth] += entities;
+
+	std::size_t lBucket = 0;
+	for (auto lCount = entities; lCount != 0; lCount >>= 1) ++lBucket;
+	if (occupancyHistogram.size() <= lBucket) occupancyHistogram.resize(lBucket + 1, 0);
+	++occupancyHistogram[lBucket];
+}
+
+std::ostream& operator << (std::ostream& os, const SpatialStatistics& s)
+{
+	os << "nodes: " << s.nodeCount << " (" << s.leafCount << " leaves)\n"
+		<< "entities: " << s.entityCount << " (" << s.innerEntityCount
+		<< " in inner nodes, " << s.innerEntityPercentage() << "%)\n"
+		<< "max entities per node: " << s.maxEntitiesPerNode << '\n'
+		<< "memory: " << s.memoryUsage << " bytes\n"
+		<< "depth: nodes, entities\n";
+	for (std::size_t d = 0; d < s.nodesPerDepth.size(); ++d)
+	{
+		os << "  " << d << ": " << s.nodesPerDepth[d] << ", " << s.entitiesPerDepth[d] << '\n';
+	}
+	os << "entities per node: nodes\n";
+	for (std::size_t b = 0; b < s.occupancyHistogram.size(); ++b)
+	{
+		if (b == 0) os << "  0: ";
+		else if (b == 1) os << "  1: ";
+		else os << "  " << (std::size_t(1) << (b - 1)) << '-' << (std::size_t(1) << b) - 1 << ": ";
+		os << s.occupancyHistogram[b] << '\n';
+	}
+	return os;
+}
+
+SpatialQueryCounters SpatialQueryCounters::total()
+{
+	std::lock_guard<std::mutex> lLock(sCountersMutex);
+	return totalWithLock();
+}
+
+SpatialQueryCounters SpatialQueryCounters::frame()
+{
+	std::lock_guard<std::mutex> lLock(sCountersMutex);
+	const auto lTotal = totalWithLock();
+	auto lResult = lTotal;
+	lResult -= sPreviousFrameTotal;
+	sPreviousFrameTotal = lTotal;
+	return lResult;
+}
+
+SpatialQueryCounters& SpatialQueryCounters::operator += (const SpatialQueryCounters& other) noexcept
+{
+	nodesVisited += other.nodesVisited;
+	boxesTested += other.boxesTested;
+	results += other.results;
+	return *this;
+}
+
+SpatialQueryCounters& SpatialQueryCounters::operator -= (const SpatialQueryCounters& other) noexcept
+{
+	nodesVisited -= other.nodesVisited;
+	boxesTested -= other.boxesTested;
+	results -= other.results;
+	return *this;
+}
+
+std::ostream& operator << (std::ostream& os, const SpatialQueryCounters& c)
+{
+	return os << c.nodesVisited << ',' << c.boxesTested << ',' << c.results;
+}
+
+namespace detail {
+
+LocalSpatialQueryCounters::LocalSpatialQueryCounters()
+{
+	std::lock_guard<std::mutex> lLock(sCountersMutex);
+	sThreadCounters.push_back(this);
+}
+
+LocalSpatialQueryCounters::~LocalSpatialQueryCounters() noexcept
+{
+	std::lock_guard<std::mutex> lLock(sCountersMutex);
+	sExitedThreadCounters += get();
+	sThreadCounters.erase(std::find(sThreadCounters.begin(), sThreadCounters.end(), this));
+}
+
+SpatialQueryCounters LocalSpatialQueryCounters::get() const noexcept
+{
+	SpatialQueryCounters lResult;
+	lResult.nodesVisited = nodesVisited.get();
+	lResult.boxesTested = boxesTested.get();
+	lResult.results = results.get();
+	return lResult;
+}
+
+} // namespace detail
+
+} // namespace gintonic
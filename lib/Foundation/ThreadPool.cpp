@@ -0,0 +1,134 @@
+#include "Foundation/ThreadPool.hpp"
+
+#include <utility>
+
+namespace gintonic {
+
+ThreadPool::TaskGroup::TaskGroup(ThreadPool& pool)
+: mPool(pool)
+, mPending(0)
+{
+	/* Empty on purpose. */
+}
+
+ThreadPool::TaskGroup::~TaskGroup() noexcept
+{
+	try
+	{
+		wait();
+	}
+	catch (...)
+	{
+		/* Exceptions are only reported through TaskGroup::wait. */
+	}
+}
+
+void ThreadPool::TaskGroup::run(std::function<void()> task)
+{
+	if (mPool.threadCount() == 0)
+	{
+		execute(task);
+		return;
+	}
+	++mPending;
+	mPool.push([this, lTask = std::move(task)] ()
+	{
+		execute(lTask);
+		--mPending;
+	});
+}
+
+void ThreadPool::TaskGroup::wait()
+{
+	while (mPending.load() != 0)
+	{
+		// Help out instead of blocking. This is what makes nested task
+		// groups safe.
+		if (!mPool.tryRunPendingTask()) std::this_thread::yield();
+	}
+	std::exception_ptr lException;
+	{
+		std::lock_guard<std::mutex> lLock(mExceptionMutex);
+		std::swap(lException, mException);
+	}
+	if (lException) std::rethrow_exception(lException);
+}
+
+void ThreadPool::TaskGroup::execute(const std::function<void()>& task) noexcept
+{
+	try
+	{
+		task();
+	}
+	catch (...)
+	{
+		std::lock_guard<std::mutex> lLock(mExceptionMutex);
+		if (!mException) mException = std::current_exception();
+	}
+}
+
+ThreadPool& ThreadPool::get()
+{
+	static ThreadPool sPool(std::thread::hardware_concurrency() > 1
+		? std::thread::hardware_concurrency() - 1 : 0);
+	return sPool;
+}
+
+ThreadPool::ThreadPool(const std::size_t threadCount)
+{
+	mThreads.reserve(threadCount);
+	for (std::size_t i = 0; i < threadCount; ++i)
+	{
+		mThreads.emplace_back([this] () { workerLoop(); });
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lLock(mMutex);
+		mStop = true;
+	}
+	mCondition.notify_all();
+	for (auto& lThread : mThreads) lThread.join();
+}
+
+void ThreadPool::push(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lLock(mMutex);
+		mTasks.push_back(std::move(task));
+	}
+	mCondition.notify_one();
+}
+
+bool ThreadPool::tryRunPendingTask()
+{
+	std::function<void()> lTask;
+	{
+		std::lock_guard<std::mutex> lLock(mMutex);
+		if (mTasks.empty()) return false;
+		lTask = std::move(mTasks.front());
+		mTasks.pop_front();
+	}
+	lTask();
+	return true;
+}
+
+void ThreadPool::workerLoop()
+{
+	for (;;)
+	{
+		std::function<void()> lTask;
+		{
+			std::unique_lock<std::mutex> lLock(mMutex);
+			mCondition.wait(lLock, [this] () { return mStop || !mTasks.empty(); });
+			if (mTasks.empty()) return;
+			lTask = std::move(mTasks.front());
+			mTasks.pop_front();
+		}
+		lTask();
+	}
+}
+
+} // namespace gintonic
@@ -0,0 +1,411 @@
+#include "Foundation/TransformHierarchy.hpp"
+#include "Foundation/ThreadPool.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+// Subtrees with at most this many nodes are computed by a single task of
+// update. Larger subtrees are split below their root.
+#define GT_TRANSFORMHIERARCHY_GRAIN 1024
+
+namespace gintonic {
+
+constexpr TransformHierarchy::Index TransformHierarchy::kNone;
+
+TransformHierarchy::Index TransformHierarchy::create(
+	const SQT& local,
+	const Index parent)
+{
+	// Destroyed nodes keep their slot until the next sort. Don't let them
+	// pile up when update is never called.
+	if (mDeadSlotCount > GT_TRANSFORMHIERARCHY_GRAIN && mDeadSlotCount > size())
+	{
+		sort();
+	}
+
+	const auto lSlot = static_cast<Index>(mLocals.size());
+	Index lIndex;
+	if (mFreeIndices.empty())
+	{
+		lIndex = static_cast<Index>(mSlotOfIndex.size());
+		mSlotOfIndex.push_back(lSlot);
+	}
+	else
+	{
+		lIndex = mFreeIndices.back();
+		mFreeIndices.pop_back();
+		mSlotOfIndex[lIndex] = lSlot;
+	}
+
+	mLocals.push_back(local);
+	mWorlds.push_back(mat4f(1.0f));
+	mParents.push_back(parent == kNone ? kNone : mSlotOfIndex[parent]);
+	mIndexOfSlot.push_back(lIndex);
+	mChangedAt.push_back(0);
+	mComputedAt.push_back(0);
+	mVersions.push_back(0);
+	mLatestChange.push_back(0);
+	markChanged(lSlot);
+
+	if (parent != kNone || mNeedsSort)
+	{
+		mNeedsSort = true;
+	}
+	else if (!mRanges.empty() && mRanges.back().last == lSlot
+		&& lSlot - mRanges.back().first < GT_TRANSFORMHIERARCHY_GRAIN)
+	{
+		// A new root at the end keeps the arrays sorted.
+		++mRanges.back().last;
+	}
+	else
+	{
+		mRanges.push_back(Range{lSlot, lSlot + 1});
+	}
+	return lIndex;
+}
+
+void TransformHierarchy::destroy(const Index index) noexcept
+{
+	const auto lSlot = mSlotOfIndex[index];
+
+	// The children see the change through their dead parent.
+	markChanged(lSlot);
+	mIndexOfSlot[lSlot] = kNone;
+	mSlotOfIndex[index] = kNone;
+	mFreeIndices.push_back(index);
+	++mDeadSlotCount;
+	mNeedsSort = true;
+}
+
+void TransformHierarchy::setParent(const Index index, const Index parent)
+	noexcept
+{
+	const auto lSlot = mSlotOfIndex[index];
+	const auto lParentSlot = parent == kNone ? kNone : mSlotOfIndex[parent];
+	#ifndef NDEBUG
+	for (auto s = lParentSlot; s != kNone && mIndexOfSlot[s] != kNone;
+		s = mParents[s])
+	{
+		assert(s != lSlot && "The new parent is a descendant.");
+	}
+	#endif
+	mParents[lSlot] = lParentSlot;
+	markChanged(lSlot);
+	mNeedsSort = true;
+}
+
+TransformHierarchy::Index TransformHierarchy::getParent(const Index index)
+	const noexcept
+{
+	const auto lParentSlot = mParents[mSlotOfIndex[index]];
+	return lParentSlot == kNone ? kNone : mIndexOfSlot[lParentSlot];
+}
+
+SQT& TransformHierarchy::local(const Index index) noexcept
+{
+	const auto lSlot = mSlotOfIndex[index];
+	markChanged(lSlot);
+	return mLocals[lSlot];
+}
+
+const mat4f& TransformHierarchy::getWorld(const Index index) const noexcept
+{
+	const auto lSlot = mSlotOfIndex[index];
+	if (isStale(lSlot)) computeChain(lSlot);
+	return mWorlds[lSlot];
+}
+
+bool TransformHierarchy::isStale(const Index slot) const noexcept
+{
+	// A node in the chain of ancestors is stale if it was computed before
+	// a change of itself or of one of its ancestors. Walking up, compare
+	// every change with the oldest computation below it. A dead parent
+	// counts as a change at the time it died, after which the node is a
+	// root. This only reads, so threads may call it at the same time.
+	auto lOldest = mComputedAt[slot];
+	for (auto s = slot;;)
+	{
+		lOldest = std::min(lOldest, mComputedAt[s]);
+		if (mChangedAt[s] >= lOldest) return true;
+		const auto lParentSlot = mParents[s];
+		if (lParentSlot == kNone) return false;
+		if (mIndexOfSlot[lParentSlot] == kNone)
+		{
+			return mChangedAt[lParentSlot] >= lOldest;
+		}
+		s = lParentSlot;
+	}
+}
+
+void TransformHierarchy::computeChain(const Index slot) const noexcept
+{
+	// Collect the chain of ancestors in a buffer of this thread.
+	static thread_local std::vector<Index> sChain;
+	sChain.clear();
+	std::uint32_t lLatest = 0;
+	for (auto s = slot;;)
+	{
+		sChain.push_back(s);
+		const auto lParentSlot = mParents[s];
+		if (lParentSlot == kNone) break;
+		if (mIndexOfSlot[lParentSlot] == kNone)
+		{
+			lLatest = mChangedAt[lParentSlot];
+			break;
+		}
+		s = lParentSlot;
+	}
+
+	// Walk down the chain and recompute everything that was computed
+	// before the latest change above it.
+	const auto lStamp = beginCompute();
+	for (auto lIter = sChain.rbegin(); lIter != sChain.rend(); ++lIter)
+	{
+		lLatest = std::max(lLatest, mChangedAt[*lIter]);
+		if (mComputedAt[*lIter] <= lLatest) compute(*lIter, lStamp);
+	}
+}
+
+std::uint32_t TransformHierarchy::getVersion(const Index index) const noexcept
+{
+	getWorld(index);
+	return mVersions[mSlotOfIndex[index]];
+}
+
+void TransformHierarchy::update()
+{
+	if (mNeedsSort) sort();
+	if (mLocals.empty()) return;
+	const auto lStamp = beginCompute();
+
+	// The top slots are the upper levels of large subtrees. Their parents
+	// precede them, so one pass in order suffices.
+	for (const auto lSlot : mTopSlots)
+	{
+		computeRange(lSlot, lSlot + 1, lStamp);
+	}
+
+	// Every range holds complete subtrees whose roots have their parents
+	// among the top slots, so the ranges are independent.
+	ThreadPool::get().parallelFor(0, mRanges.size(), 1,
+		[this, lStamp] (const std::size_t first, const std::size_t last)
+	{
+		for (auto r = first; r != last; ++r)
+		{
+			computeRange(mRanges[r].first, mRanges[r].last, lStamp);
+		}
+	});
+}
+
+std::size_t TransformHierarchy::memoryUsage() const noexcept
+{
+	return sizeof(TransformHierarchy)
+		+ mLocals.capacity() * sizeof(SQT)
+		+ mWorlds.capacity() * sizeof(mat4f)
+		+ mParents.capacity() * sizeof(Index)
+		+ mIndexOfSlot.capacity() * sizeof(Index)
+		+ mChangedAt.capacity() * sizeof(std::uint32_t)
+		+ mComputedAt.capacity() * sizeof(std::uint32_t)
+		+ mVersions.capacity() * sizeof(std::uint32_t)
+		+ mLatestChange.capacity() * sizeof(std::uint32_t)
+		+ mSlotOfIndex.capacity() * sizeof(Index)
+		+ mFreeIndices.capacity() * sizeof(Index)
+		+ mTopSlots.capacity() * sizeof(Index)
+		+ mRanges.capacity() * sizeof(Range);
+}
+
+void TransformHierarchy::markChanged(const Index slot) noexcept
+{
+	mChangedAt[slot] = mEpoch;
+	mEpochHasChanges = true;
+}
+
+std::uint32_t TransformHierarchy::beginCompute() const noexcept
+{
+	if (mEpochHasChanges)
+	{
+		mEpochHasChanges = false;
+		if (++mEpoch == 0) resetTimeStamps();
+	}
+	return mEpoch;
+}
+
+void TransformHierarchy::resetTimeStamps() const noexcept
+{
+	// The epoch wrapped around. Make everything stale once.
+	std::fill(mChangedAt.begin(), mChangedAt.end(), 1);
+	std::fill(mComputedAt.begin(), mComputedAt.end(), 0);
+	mEpoch = 2;
+}
+
+void TransformHierarchy::compute(const Index slot, const std::uint32_t stamp)
+	const noexcept
+{
+	const auto lParentSlot = mParents[slot];
+	mat4f lWorld(mLocals[slot]);
+	if (lParentSlot != kNone && mIndexOfSlot[lParentSlot] != kNone)
+	{
+		lWorld = mWorlds[lParentSlot] * lWorld;
+	}
+	if (std::memcmp(&lWorld, &mWorlds[slot], sizeof(mat4f)) != 0)
+	{
+		mWorlds[slot] = lWorld;
+		++mVersions[slot];
+	}
+	mComputedAt[slot] = stamp;
+}
+
+void TransformHierarchy::computeRange(
+	const std::uint32_t first,
+	const std::uint32_t last,
+	const std::uint32_t stamp) noexcept
+{
+	// The latest change of a node and its ancestors is known once the parent
+	// has been visited. Only the stale nodes touch their locals and world
+	// matrices, so a pass with few changes mostly reads the small arrays.
+	for (auto lSlot = first; lSlot != last; ++lSlot)
+	{
+		const auto lParentSlot = mParents[lSlot];
+		auto lLatest = mChangedAt[lSlot];
+		if (lParentSlot != kNone)
+		{
+			lLatest = std::max(lLatest, mLatestChange[lParentSlot]);
+		}
+		mLatestChange[lSlot] = lLatest;
+		if (mComputedAt[lSlot] <= lLatest) compute(lSlot, stamp);
+	}
+}
+
+void TransformHierarchy::sort()
+{
+	const auto lSlotCount = static_cast<Index>(mLocals.size());
+
+	// Turn the children of dead nodes into roots, and count the children of
+	// every live node.
+	std::vector<std::uint32_t> lChildStart(lSlotCount + 1, 0);
+	for (Index s = 0; s < lSlotCount; ++s)
+	{
+		if (mIndexOfSlot[s] == kNone) continue;
+		const auto lParentSlot = mParents[s];
+		if (lParentSlot == kNone) continue;
+		if (mIndexOfSlot[lParentSlot] == kNone)
+		{
+			mChangedAt[s] = std::max(mChangedAt[s], mChangedAt[lParentSlot]);
+			mParents[s] = kNone;
+		}
+		else
+		{
+			++lChildStart[lParentSlot + 1];
+		}
+	}
+	for (Index s = 0; s < lSlotCount; ++s)
+	{
+		lChildStart[s + 1] += lChildStart[s];
+	}
+	std::vector<Index> lChildren(lChildStart[lSlotCount]);
+	{
+		auto lFill = lChildStart;
+		for (Index s = 0; s < lSlotCount; ++s)
+		{
+			if (mIndexOfSlot[s] == kNone || mParents[s] == kNone) continue;
+			lChildren[lFill[mParents[s]]++] = s;
+		}
+	}
+
+	// Depth-first order, visiting the roots and the children of every node
+	// in the order of their slots.
+	std::vector<Index> lOrder;
+	lOrder.reserve(lSlotCount - mDeadSlotCount);
+	std::vector<Index> lStack;
+	for (Index lRoot = 0; lRoot < lSlotCount; ++lRoot)
+	{
+		if (mIndexOfSlot[lRoot] == kNone || mParents[lRoot] != kNone)
+		{
+			continue;
+		}
+		lStack.push_back(lRoot);
+		while (!lStack.empty())
+		{
+			const auto s = lStack.back();
+			lStack.pop_back();
+			lOrder.push_back(s);
+			for (auto c = lChildStart[s + 1]; c != lChildStart[s]; --c)
+			{
+				lStack.push_back(lChildren[c - 1]);
+			}
+		}
+	}
+	const auto lCount = static_cast<Index>(lOrder.size());
+
+	// Permute the arrays. Reuse the child offsets as the map from old slots
+	// to new slots.
+	auto& lNewSlot = lChildStart;
+	for (Index i = 0; i < lCount; ++i) lNewSlot[lOrder[i]] = i;
+
+	std::vector<SQT, allocator<SQT>> lLocals(lCount);
+	std::vector<mat4f, allocator<mat4f>> lWorlds(lCount);
+	std::vector<Index> lParents(lCount);
+	std::vector<Index> lIndexOfSlot(lCount);
+	std::vector<std::uint32_t> lChangedAt(lCount);
+	std::vector<std::uint32_t> lComputedAt(lCount);
+	std::vector<std::uint32_t> lVersions(lCount);
+	for (Index i = 0; i < lCount; ++i)
+	{
+		const auto s = lOrder[i];
+		lLocals[i] = mLocals[s];
+		lWorlds[i] = mWorlds[s];
+		lParents[i] = mParents[s] == kNone ? kNone : lNewSlot[mParents[s]];
+		lIndexOfSlot[i] = mIndexOfSlot[s];
+		lChangedAt[i] = mChangedAt[s];
+		lComputedAt[i] = mComputedAt[s];
+		lVersions[i] = mVersions[s];
+		mSlotOfIndex[mIndexOfSlot[s]] = i;
+	}
+	mLocals.swap(lLocals);
+	mWorlds.swap(lWorlds);
+	mParents.swap(lParents);
+	mIndexOfSlot.swap(lIndexOfSlot);
+	mChangedAt.swap(lChangedAt);
+	mComputedAt.swap(lComputedAt);
+	mVersions.swap(lVersions);
+	mLatestChange.assign(lCount, 0);
+	mDeadSlotCount = 0;
+
+	// Count the nodes of every subtree. Children follow their parents, so
+	// one backward pass suffices.
+	auto& lSubtreeSize = lOrder;
+	std::fill(lSubtreeSize.begin(), lSubtreeSize.end(), 1);
+	for (auto i = lCount; i-- > 0;)
+	{
+		if (mParents[i] != kNone) lSubtreeSize[mParents[i]] += lSubtreeSize[i];
+	}
+
+	// Large subtrees contribute their root to the top slots, and continue
+	// with their first child. Small subtrees are packed into ranges.
+	mTopSlots.clear();
+	mRanges.clear();
+	for (Index i = 0; i < lCount;)
+	{
+		const auto lSize = lSubtreeSize[i];
+		if (lSize > GT_TRANSFORMHIERARCHY_GRAIN)
+		{
+			mTopSlots.push_back(i);
+			++i;
+			continue;
+		}
+		if (!mRanges.empty() && mRanges.back().last == i
+			&& i + lSize - mRanges.back().first <= GT_TRANSFORMHIERARCHY_GRAIN)
+		{
+			mRanges.back().last = i + lSize;
+		}
+		else
+		{
+			mRanges.push_back(Range{i, i + lSize});
+		}
+		i += lSize;
+	}
+	mNeedsSort = false;
+}
+
+} // namespace gintonic
@@ -0,0 +1,486 @@
+#include "Foundation/TriangleBVH.hpp"
+#include "Foundation/SpatialStatistics.hpp"
+#include "Foundation/simd.hpp"
+
+#include <algorithm>
+#include <limits>
+
+// The number of bins at which the surface area heuristic is evaluated.
+#define GT_TRIANGLEBVH_BINS 16
+
+// Nodes with at most this many triangles always become leaves.
+#define GT_TRIANGLEBVH_MIN_LEAF 4
+
+// Nodes with more triangles than this never become leaves.
+#define GT_TRIANGLEBVH_MAX_LEAF 16
+
+// Past this depth, nodes are split at the median instead. That halves the
+// number of triangles at every level, so the depth of the tree never exceeds
+// GT_TRIANGLEBVH_MAX_SAH_DEPTH + 32.
+#define GT_TRIANGLEBVH_MAX_SAH_DEPTH 32
+
+// The size of the traversal stack. It holds at most one entry per level.
+#define GT_TRIANGLEBVH_STACK_SIZE 64
+
+namespace gintonic {
+
+struct TriangleBVH::BuildTriangle
+{
+	float vertex[3][3];
+	float minCorner[3];
+	float maxCorner[3];
+	float centroid[3];
+	std::uint32_t index;
+};
+
+namespace {
+
+struct Bounds
+{
+	float minCorner[3];
+	float maxCorner[3];
+
+	Bounds() noexcept
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			minCorner[i] = std::numeric_limits<float>::max();
+			maxCorner[i] = std::numeric_limits<float>::lowest();
+		}
+	}
+
+	void addPoint(const float* point) noexcept
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			minCorner[i] = std::min(minCorner[i], point[i]);
+			maxCorner[i] = std::max(maxCorner[i], point[i]);
+		}
+	}
+
+	// Merge per component, so that adding empty bounds changes nothing.
+	void add(const Bounds& other) noexcept
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			minCorner[i] = std::min(minCorner[i], other.minCorner[i]);
+			maxCorner[i] = std::max(maxCorner[i], other.maxCorner[i]);
+		}
+	}
+
+	// The area of three faces. The surface area heuristic only compares the
+	// splits of one node with each other and with a leaf, all scaled alike.
+	float area() const noexcept
+	{
+		const float dx = maxCorner[0] - minCorner[0];
+		const float dy = maxCorner[1] - minCorner[1];
+		const float dz = maxCorner[2] - minCorner[2];
+		return dx * dy + dy * dz + dz * dx;
+	}
+};
+
+inline __m128 cross(const __m128 a0, const __m128 a1, const __m128 b0, const __m128 b1)
+{
+	return _mm_sub_ps(_mm_mul_ps(a0, b0), _mm_mul_ps(a1, b1));
+}
+
+inline __m128 dot(const __m128* a, const __m128* b)
+{
+	return _mm_add_ps(_mm_add_ps(
+		_mm_mul_ps(a[0], b[0]),
+		_mm_mul_ps(a[1], b[1])),
+		_mm_mul_ps(a[2], b[2]));
+}
+
+} // anonymous namespace
+
+TriangleBVH::TriangleBVH(
+	const std::uint32_t* indices,
+	const std::size_t indexCount,
+	const float* positions,
+	const std::size_t stride)
+: mTriangleCount(static_cast<std::uint32_t>(indexCount / 3))
+{
+	if (mTriangleCount == 0) return;
+
+	std::vector<BuildTriangle> lTriangles(mTriangleCount);
+	for (std::uint32_t t = 0; t < mTriangleCount; ++t)
+	{
+		auto& lTriangle = lTriangles[t];
+		Bounds lBounds;
+		for (int v = 0; v < 3; ++v)
+		{
+			const float* lVertex = positions + indices[3 * t + v] * stride;
+			for (int i = 0; i < 3; ++i) lTriangle.vertex[v][i] = lVertex[i];
+			lBounds.addPoint(lVertex);
+		}
+		for (int i = 0; i < 3; ++i)
+		{
+			lTriangle.minCorner[i] = lBounds.minCorner[i];
+			lTriangle.maxCorner[i] = lBounds.maxCorner[i];
+			lTriangle.centroid[i] = 0.5f * (lBounds.minCorner[i] + lBounds.maxCorner[i]);
+		}
+		lTriangle.index = t;
+	}
+
+	mNodes.reserve(2 * (mTriangleCount / GT_TRIANGLEBVH_MIN_LEAF) + 1);
+	mPacks.reserve(mTriangleCount / 2 + 1);
+	build(lTriangles.data(), lTriangles.data() + lTriangles.size(), 0);
+	mNodes.shrink_to_fit();
+	mPacks.shrink_to_fit();
+}
+
+void TriangleBVH::build(BuildTriangle* first, BuildTriangle* last, const unsigned depth)
+{
+	const auto lNodeIndex = mNodes.size();
+	mNodes.emplace_back();
+	const auto lCount = static_cast<std::size_t>(last - first);
+
+	Bounds lBounds;
+	Bounds lCentroidBounds;
+	for (auto lIter = first; lIter != last; ++lIter)
+	{
+		lBounds.addPoint(lIter->minCorner);
+		lBounds.addPoint(lIter->maxCorner);
+		lCentroidBounds.addPoint(lIter->centroid);
+	}
+	{
+		auto& lNode = mNodes[lNodeIndex];
+		for (int i = 0; i < 3; ++i)
+		{
+			lNode.minCorner[i] = lBounds.minCorner[i];
+			lNode.maxCorner[i] = lBounds.maxCorner[i];
+		}
+		if (lCount <= GT_TRIANGLEBVH_MIN_LEAF)
+		{
+			makeLeaf(lNode, first, last);
+			return;
+		}
+	}
+
+	int lAxis = 0;
+	for (int i = 1; i < 3; ++i)
+	{
+		if (lCentroidBounds.maxCorner[i] - lCentroidBounds.minCorner[i] >
+			lCentroidBounds.maxCorner[lAxis] - lCentroidBounds.minCorner[lAxis])
+		{
+			lAxis = i;
+		}
+	}
+	const float lLow = lCentroidBounds.minCorner[lAxis];
+	const float lExtent = lCentroidBounds.maxCorner[lAxis] - lLow;
+
+	BuildTriangle* lMiddle = nullptr;
+	if (lExtent > 0.0f && depth < GT_TRIANGLEBVH_MAX_SAH_DEPTH)
+	{
+		const float lScale = GT_TRIANGLEBVH_BINS / lExtent;
+		const auto lBinOf = [lAxis, lLow, lScale](const BuildTriangle& triangle)
+		{
+			const auto lBin = static_cast<int>((triangle.centroid[lAxis] - lLow) * lScale);
+			return std::min(lBin, GT_TRIANGLEBVH_BINS - 1);
+		};
+
+		std::size_t lBinCount[GT_TRIANGLEBVH_BINS] = {};
+		Bounds lBinBounds[GT_TRIANGLEBVH_BINS];
+		for (auto lIter = first; lIter != last; ++lIter)
+		{
+			const auto lBin = lBinOf(*lIter);
+			++lBinCount[lBin];
+			lBinBounds[lBin].addPoint(lIter->minCorner);
+			lBinBounds[lBin].addPoint(lIter->maxCorner);
+		}
+
+		// Sweep from the right to get the cost of everything to the right
+		// of each split, then from the left to find the cheapest split.
+		// Split s puts the bins below s on the left.
+		float lRightCost[GT_TRIANGLEBVH_BINS];
+		std::size_t lRightCount[GT_TRIANGLEBVH_BINS];
+		Bounds lAccumulated;
+		std::size_t lAccumulatedCount = 0;
+		for (int b = GT_TRIANGLEBVH_BINS - 1; b > 0; --b)
+		{
+			lAccumulated.add(lBinBounds[b]);
+			lAccumulatedCount += lBinCount[b];
+			lRightCount[b] = lAccumulatedCount;
+			lRightCost[b] = lAccumulatedCount ? lAccumulated.area() * lAccumulatedCount : 0.0f;
+		}
+		lAccumulated = Bounds();
+		lAccumulatedCount = 0;
+		int lBestSplit = 0;
+		float lBestCost = std::numeric_limits<float>::max();
+		for (int s = 1; s < GT_TRIANGLEBVH_BINS; ++s)
+		{
+			lAccumulated.add(lBinBounds[s - 1]);
+			lAccumulatedCount += lBinCount[s - 1];
+			if (lAccumulatedCount == 0 || lRightCount[s] == 0) continue;
+			const float lCost = lAccumulated.area() * lAccumulatedCount + lRightCost[s];
+			if (lCost < lBestCost)
+			{
+				lBestCost = lCost;
+				lBestSplit = s;
+			}
+		}
+
+		// Splitting costs one traversal step, which is about as expensive
+		// as testing one triangle.
+		const float lArea = lBounds.area();
+		if (lBestSplit != 0)
+		{
+			if (lCount <= GT_TRIANGLEBVH_MAX_LEAF && lArea * lCount <= lArea + lBestCost)
+			{
+				makeLeaf(mNodes[lNodeIndex], first, last);
+				return;
+			}
+			lMiddle = std::partition(first, last, [&lBinOf, lBestSplit](const BuildTriangle& triangle)
+			{
+				return lBinOf(triangle) < lBestSplit;
+			});
+		}
+	}
+
+	if (!lMiddle)
+	{
+		// The centroids coincide, or the tree is getting too deep. Split at
+		// the median, so that at least the number of triangles halves.
+		if (lExtent == 0.0f && lCount <= GT_TRIANGLEBVH_MAX_LEAF)
+		{
+			makeLeaf(mNodes[lNodeIndex], first, last);
+			return;
+		}
+		lMiddle = first + lCount / 2;
+		std::nth_element(first, lMiddle, last, [lAxis](const BuildTriangle& a, const BuildTriangle& b)
+		{
+			return a.centroid[lAxis] < b.centroid[lAxis];
+		});
+	}
+
+	build(first, lMiddle, depth + 1);
+	const auto lRight = static_cast<std::uint32_t>(mNodes.size());
+	build(lMiddle, last, depth + 1);
+	mNodes[lNodeIndex].first = lRight;
+	mNodes[lNodeIndex].count = 0;
+}
+
+void TriangleBVH::makeLeaf(Node& node, const BuildTriangle* first, const BuildTriangle* last)
+{
+	node.first = static_cast<std::uint32_t>(mPacks.size());
+	node.count = static_cast<std::uint32_t>(last - first);
+	while (first != last)
+	{
+		TrianglePack lPack = {};
+		for (int lLane = 0; lLane < 4; ++lLane)
+		{
+			if (first == last)
+			{
+				lPack.index[lLane] = std::numeric_limits<std::uint32_t>::max();
+				continue;
+			}
+			for (int i = 0; i < 3; ++i)
+			{
+				lPack.v0[i][lLane] = first->vertex[0][i];
+				lPack.e1[i][lLane] = first->vertex[1][i] - first->vertex[0][i];
+				lPack.e2[i][lLane] = first->vertex[2][i] - first->vertex[0][i];
+			}
+			lPack.index[lLane] = first->index;
+			++first;
+		}
+		mPacks.push_back(lPack);
+	}
+}
+
+template <bool AnyHit>
+bool TriangleBVH::traverse(
+	const ray3f& ray,
+	float& distance,
+	std::uint32_t& triangle) const noexcept
+{
+	// The slab test of ray3f::intersects, with the ray kept in registers.
+	// The fourth lanes hold first and count; they are ignored.
+	const auto lRayOrigin = ray.origin.data;
+	const auto lRayInverse = ray.invDirection.data;
+	const auto lInfinity = _mm_set1_ps(std::numeric_limits<float>::infinity());
+	const auto lMinusInfinity = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+	const auto lNodeHit = [&](const std::uint32_t index, const float maxDistance, float& nearDistance)
+	{
+		const auto& lNode = mNodes[index];
+		const auto lT1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(lNode.minCorner), lRayOrigin), lRayInverse);
+		const auto lT2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(lNode.maxCorner), lRayOrigin), lRayInverse);
+		const auto lParallel = _mm_cmpunord_ps(lT1, lT2);
+		const auto lNearPerSlab = _mm_or_ps(
+			_mm_andnot_ps(lParallel, _mm_min_ps(lT1, lT2)),
+			_mm_and_ps(lParallel, lMinusInfinity));
+		const auto lFarPerSlab = _mm_or_ps(
+			_mm_andnot_ps(lParallel, _mm_max_ps(lT1, lT2)),
+			_mm_and_ps(lParallel, lInfinity));
+		auto lNear = _mm_max_ss(lNearPerSlab, _mm_shuffle_ps(lNearPerSlab, lNearPerSlab, _MM_SHUFFLE(1, 1, 1, 1)));
+		lNear = _mm_max_ss(lNear, _mm_shuffle_ps(lNearPerSlab, lNearPerSlab, _MM_SHUFFLE(2, 2, 2, 2)));
+		lNear = _mm_max_ss(lNear, _mm_setzero_ps());
+		auto lFar = _mm_min_ss(lFarPerSlab, _mm_shuffle_ps(lFarPerSlab, lFarPerSlab, _MM_SHUFFLE(1, 1, 1, 1)));
+		lFar = _mm_min_ss(lFar, _mm_shuffle_ps(lFarPerSlab, lFarPerSlab, _MM_SHUFFLE(2, 2, 2, 2)));
+		lFar = _mm_min_ss(lFar, _mm_set_ss(maxDistance));
+		nearDistance = _mm_cvtss_f32(lNear);
+		return _mm_comile_ss(lNear, lFar) != 0;
+	};
+
+	float lNear;
+	if (mNodes.empty() || !lNodeHit(0, distance, lNear)) return false;
+
+	const __m128 lOrigin[3] = {_mm_set1_ps(ray.origin.x), _mm_set1_ps(ray.origin.y), _mm_set1_ps(ray.origin.z)};
+	const __m128 lDirection[3] = {_mm_set1_ps(ray.direction.x), _mm_set1_ps(ray.direction.y), _mm_set1_ps(ray.direction.z)};
+	const auto lZero = _mm_setzero_ps();
+	const auto lOne = _mm_set1_ps(1.0f);
+	auto lBest = _mm_set1_ps(distance);
+	bool lHit = false;
+
+	struct StackEntry { std::uint32_t node; float nearDistance; };
+	StackEntry lStack[GT_TRIANGLEBVH_STACK_SIZE];
+	std::size_t lStackSize = 0;
+	std::uint32_t lIndex = 0;
+
+	for (;;)
+	{
+		GT_SPATIAL_COUNT(nodesVisited, 1);
+		const auto& lNode = mNodes[lIndex];
+		if (!lNode.isLeaf())
+		{
+			const auto lLeft = lIndex + 1;
+			const auto lRight = lNode.first;
+			float lLeftNear, lRightNear;
+			const bool lLeftHit = lNodeHit(lLeft, distance, lLeftNear);
+			const bool lRightHit = lNodeHit(lRight, distance, lRightNear);
+			if (lLeftHit && lRightHit)
+			{
+				// Visit the nearest child first, so that the farther one
+				// can be skipped once a closer triangle is found.
+				if (lLeftNear <= lRightNear)
+				{
+					lStack[lStackSize++] = {lRight, lRightNear};
+					lIndex = lLeft;
+				}
+				else
+				{
+					lStack[lStackSize++] = {lLeft, lLeftNear};
+					lIndex = lRight;
+				}
+				continue;
+			}
+			else if (lLeftHit)
+			{
+				lIndex = lLeft;
+				continue;
+			}
+			else if (lRightHit)
+			{
+				lIndex = lRight;
+				continue;
+			}
+		}
+		else
+		{
+			const auto lPackEnd = lNode.first + (lNode.count + 3) / 4;
+			for (auto p = lNode.first; p != lPackEnd; ++p)
+			{
+				// Möller-Trumbore, for four triangles at once.
+				const auto& lPack = mPacks[p];
+				const __m128 lE1[3] = {_mm_load_ps(lPack.e1[0]), _mm_load_ps(lPack.e1[1]), _mm_load_ps(lPack.e1[2])};
+				const __m128 lE2[3] = {_mm_load_ps(lPack.e2[0]), _mm_load_ps(lPack.e2[1]), _mm_load_ps(lPack.e2[2])};
+				const __m128 lP[3] =
+				{
+					cross(lDirection[1], lDirection[2], lE2[2], lE2[1]),
+					cross(lDirection[2], lDirection[0], lE2[0], lE2[2]),
+					cross(lDirection[0], lDirection[1], lE2[1], lE2[0])
+				};
+				const auto lDeterminant = dot(lE1, lP);
+				const __m128 lT[3] =
+				{
+					_mm_sub_ps(lOrigin[0], _mm_load_ps(lPack.v0[0])),
+					_mm_sub_ps(lOrigin[1], _mm_load_ps(lPack.v0[1])),
+					_mm_sub_ps(lOrigin[2], _mm_load_ps(lPack.v0[2]))
+				};
+				const __m128 lQ[3] =
+				{
+					cross(lT[1], lT[2], lE1[2], lE1[1]),
+					cross(lT[2], lT[0], lE1[0], lE1[2]),
+					cross(lT[0], lT[1], lE1[1], lE1[0])
+				};
+
+				// Rays parallel to a triangle, and the unused lanes, have a
+				// zero determinant. Dividing by it gives NaN or infinity,
+				// which the comparisons below reject.
+				const auto lInverse = _mm_div_ps(lOne, lDeterminant);
+				const auto lU = _mm_mul_ps(dot(lT, lP), lInverse);
+				const auto lV = _mm_mul_ps(dot(lDirection, lQ), lInverse);
+				const auto lDistance = _mm_mul_ps(dot(lE2, lQ), lInverse);
+				auto lMask = _mm_cmpneq_ps(lDeterminant, lZero);
+				lMask = _mm_and_ps(lMask, _mm_cmpge_ps(lU, lZero));
+				lMask = _mm_and_ps(lMask, _mm_cmpge_ps(lV, lZero));
+				lMask = _mm_and_ps(lMask, _mm_cmple_ps(_mm_add_ps(lU, lV), lOne));
+				lMask = _mm_and_ps(lMask, _mm_cmpge_ps(lDistance, lZero));
+				lMask = _mm_and_ps(lMask, _mm_cmple_ps(lDistance, lBest));
+				if (_mm_movemask_ps(lMask) == 0) continue;
+				if (AnyHit) return true;
+
+				alignas(16) float lDistances[4];
+				_mm_store_ps(lDistances, _mm_or_ps(_mm_and_ps(lMask, lDistance), _mm_andnot_ps(lMask, lInfinity)));
+				for (int lLane = 0; lLane < 4; ++lLane)
+				{
+					if (lDistances[lLane] <= distance)
+					{
+						distance = lDistances[lLane];
+						triangle = lPack.index[lLane];
+					}
+				}
+				lBest = _mm_set1_ps(distance);
+				lHit = true;
+			}
+		}
+
+		// Pop the next node, skipping the ones that are farther away than
+		// the nearest hit so far.
+		do
+		{
+			if (lStackSize == 0) return lHit;
+			--lStackSize;
+		} while (lStack[lStackSize].nearDistance > distance);
+		lIndex = lStack[lStackSize].node;
+	}
+}
+
+bool TriangleBVH::raycast(
+	const ray3f& ray,
+	const float maxDistance,
+	float& distance,
+	std::uint32_t& triangle) const noexcept
+{
+	auto lDistance = maxDistance;
+	std::uint32_t lTriangle;
+	if (!traverse<false>(ray, lDistance, lTriangle)) return false;
+	distance = lDistance;
+	triangle = lTriangle;
+	return true;
+}
+
+bool TriangleBVH::occluded(const ray3f& ray, const float maxDistance) const noexcept
+{
+	auto lDistance = maxDistance;
+	std::uint32_t lTriangle;
+	return traverse<true>(ray, lDistance, lTriangle);
+}
+
+std::size_t TriangleBVH::memoryUsage() const noexcept
+{
+	return sizeof(TriangleBVH)
+		+ mNodes.capacity() * sizeof(Node)
+		+ mPacks.capacity() * sizeof(TrianglePack);
+}
+
+box3f TriangleBVH::getBounds() const noexcept
+{
+	if (mNodes.empty()) return box3f();
+	const auto& lRoot = mNodes.front();
+	return box3f(
+		vec3f(lRoot.minCorner[0], lRoot.minCorner[1], lRoot.minCorner[2]),
+		vec3f(lRoot.maxCorner[0], lRoot.maxCorner[1], lRoot.maxCorner[2]));
+}
+
+} // namespace gintonic
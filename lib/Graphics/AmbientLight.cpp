@@ -14,7 +14,7 @@ AmbientLight::AmbientLight(const vec4f& intensity)
 
 void AmbientLight::shine(
 	const Entity& lightEntity, 
-	const std::vector<std::shared_ptr<Entity>>& /*shadowCastingGeometryEntities*/) const noexcept
+	const std::vector<Entity*>& /*shadowCastingGeometryEntities*/) const noexcept
 {
 	const auto& lProgram = AmbientLightShaderProgram::get();
 	lProgram.activate();
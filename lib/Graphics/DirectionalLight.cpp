@@ -27,7 +27,7 @@ DirectionalLight::DirectionalLight(const vec4f& intensity)
 
 void DirectionalLight::shine(
 	const Entity& lightEntity, 
-	const std::vector<std::shared_ptr<Entity>>& /*shadowCastingGeometryEntities*/) const noexcept
+	const std::vector<Entity*>& /*shadowCastingGeometryEntities*/) const noexcept
 {
 
 	const vec3f lLightDir = vec3f((Renderer::matrix_V() * (lightEntity.globalTransform() * vec4f(0.0f, 0.0f, -1.0f, 0.0f))).data).normalize();
@@ -36,7 +36,7 @@ DirectionalShadowBuffer::DirectionalShadowBuffer()
 
 void DirectionalShadowBuffer::collect(
 	const Entity& lightEntity, 
-	const std::vector<std::shared_ptr<Entity>>& shadowCastingGeometryEntities) noexcept
+	const std::vector<Entity*>& shadowCastingGeometryEntities) noexcept
 {
 	updateProjectionMatrix(lightEntity);
 
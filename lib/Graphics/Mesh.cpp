@@ -270,6 +270,7 @@ void Mesh::set(const std::vector<GLuint>& indices,
     mPosition_XYZ_uv_X = position_XYZ_uv_X;
     mNormal_XYZ_uv_Y = normal_XYZ_uv_Y;
     mTangent_XYZ_hand.clear();
+    mBVH.reset();
     computeAdjacencyFromPositionInformation();
     computeLocalBoundingBoxFromPositionInformation(mPosition_XYZ_uv_X);
     uploadData();
@@ -284,6 +285,7 @@ void Mesh::set(const std::vector<GLuint>& indices,
     mPosition_XYZ_uv_X = position_XYZ_uv_X;
     mNormal_XYZ_uv_Y = normal_XYZ_uv_Y;
     mTangent_XYZ_hand = tangent_XYZ_handedness;
+    mBVH.reset();
     computeAdjacencyFromPositionInformation();
     computeLocalBoundingBoxFromPositionInformation(mPosition_XYZ_uv_X);
     uploadData();
@@ -294,6 +296,33 @@ void Mesh::set(const boost::filesystem::path& nativeMeshFile)
     THROW_NOT_IMPLEMENTED_EXCEPTION();
 }
 
+bool Mesh::raycast(const ray3f& ray, const float maxDistance, float& distance,
+                   GLuint& triangle) const
+{
+    std::uint32_t index;
+    if (!getBVH().raycast(ray, maxDistance, distance, index)) return false;
+    triangle = static_cast<GLuint>(index);
+    return true;
+}
+
+bool Mesh::occluded(const ray3f& ray, const float maxDistance) const
+{
+    return getBVH().occluded(ray, maxDistance);
+}
+
+const TriangleBVH& Mesh::getBVH() const
+{
+    if (!mBVH)
+    {
+        // The positions are the first three floats of every vec4f.
+        mBVH.reset(new TriangleBVH(
+            mIndices.data(), mIndices.size(),
+            mPosition_XYZ_uv_X.empty() ? nullptr : &mPosition_XYZ_uv_X[0].x,
+            4));
+    }
+    return *mBVH;
+}
+
 void Mesh::draw() const noexcept
 {
     glBindVertexArray(mVertexArrayObject);
@@ -42,7 +42,7 @@ void PointLight::setAttenuation(const vec4f& att)
 vec4f PointLight::getAttenuation() const noexcept { return mAttenuation; }
 
 void PointLight::shine(const Entity& lightEntity,
-                       const std::vector<std::shared_ptr<Entity>>&
+                       const std::vector<Entity*>&
                            shadowCastingGeometryEntities) const noexcept
 {
     const auto& lShadowVolumeProgram = ShadowVolumeShaderProgram::get();
@@ -20,7 +20,7 @@ PointShadowBuffer::PointShadowBuffer()
 
 void PointShadowBuffer::collect(
 	const Entity& /*lightEntity*/, 
-	const std::vector<std::shared_ptr<Entity>>& /*shadowCastingGeometryEntities*/) noexcept
+	const std::vector<Entity*>& /*shadowCastingGeometryEntities*/) noexcept
 {
 	/* Empty on purpose. */
 }
@@ -0,0 +1,211 @@
+#include "Graphics/RenderLists.hpp"
+
+#include "Entity.hpp"
+#include "Graphics/Light.hpp"
+#include "Graphics/PointLight.hpp"
+#include "Graphics/ShadowBuffer.hpp"
+#include "Graphics/SpotLight.hpp"
+
+#include <cassert>
+
+namespace gintonic {
+
+void RenderLists::setRoot(Entity* root)
+{
+	if (root == mRoot && (!root || root->getHandle() == mRootHandle)) return;
+
+	// Start recording the changes. The ones that happened before do not
+	// matter, since everything is sorted from scratch.
+	Entity::takeRenderStateChanges(mChanges);
+	clear();
+	if (!root) return;
+	mRoot = root;
+	mRootHandle = root->getHandle();
+	setInScene(*root, true);
+}
+
+void RenderLists::update()
+{
+	if (!mRoot) return;
+	Entity::takeRenderStateChanges(mChanges);
+	if (Entity::fromHandle(mRootHandle) != mRoot)
+	{
+		clear();
+		return;
+	}
+	for (const auto lHandle : mChanges) process(lHandle);
+}
+
+void RenderLists::clear() noexcept
+{
+	mRoot = nullptr;
+	mRootHandle = EntityHandle();
+	for (std::size_t i = 0; i < kListCount; ++i)
+	{
+		mLists[i].clear();
+		mHandles[i].clear();
+	}
+	mSlots.clear();
+}
+
+void RenderLists::process(const EntityHandle handle)
+{
+	auto* lEntity = Entity::fromHandle(handle);
+	if (!lEntity)
+	{
+		// The Entity died. Its children were detached from it, so they are
+		// in the list of changes themselves.
+		if (handle.index() < mSlots.size() && mSlots[handle.index()].handle == handle)
+		{
+			eraseAll(mSlots[handle.index()]);
+			mSlots[handle.index()] = Slot();
+		}
+		return;
+	}
+	const auto lInScene = isInScene(*lEntity);
+	auto& lSlot = slotOf(*lEntity);
+	if (lSlot.inScene != lInScene) setInScene(*lEntity, lInScene);
+	else if (lInScene) sort(*lEntity, lSlot);
+}
+
+RenderLists::Slot& RenderLists::slotOf(Entity& entity)
+{
+	const auto lHandle = entity.getHandle();
+	if (lHandle.index() >= mSlots.size()) mSlots.resize(lHandle.index() + 1);
+	auto& lSlot = mSlots[lHandle.index()];
+	if (lSlot.handle != lHandle)
+	{
+		// The slot still belongs to an Entity that died.
+		eraseAll(lSlot);
+		lSlot = Slot();
+		lSlot.handle = lHandle;
+	}
+	return lSlot;
+}
+
+bool RenderLists::isInScene(const Entity& entity) const noexcept
+{
+	for (auto* lEntity = &entity; lEntity; lEntity = lEntity->getParent())
+	{
+		if (lEntity == mRoot) return true;
+	}
+	return false;
+}
+
+void RenderLists::setInScene(Entity& entity, const bool inScene)
+{
+	mStack.push_back(&entity);
+	while (!mStack.empty())
+	{
+		auto* lEntity = mStack.back();
+		mStack.pop_back();
+		auto& lSlot = slotOf(*lEntity);
+		lSlot.inScene = inScene;
+		if (inScene) sort(*lEntity, lSlot);
+		else eraseAll(lSlot);
+		for (const auto& lChild : *lEntity) mStack.push_back(lChild.get());
+	}
+}
+
+void RenderLists::sort(Entity& entity, Slot& slot)
+{
+	auto lLightList = kNoList;
+	if (entity.light)
+	{
+		if (!entity.castShadow)
+		{
+			lLightList = kNonShadowCastingLights;
+		}
+		// Catch SpotLight before PointLight. This is needed because
+		// SpotLight inherits from PointLight, and spot lights apply the
+		// shadow map algorithm like all other light types.
+		else if (dynamic_cast<const SpotLight*>(entity.light.get()))
+		{
+			lLightList = kShadowCastingLights;
+		}
+		// Point lights need to be treated separately.
+		else if (dynamic_cast<const PointLight*>(entity.light.get()))
+		{
+			lLightList = kShadowCastingPointLights;
+		}
+		else
+		{
+			lLightList = kShadowCastingLights;
+		}
+	}
+	auto lGeometryList = kNoList;
+	if (entity.material && entity.mesh)
+	{
+		lGeometryList = entity.castShadow ? kShadowCastingGeometries : kNonShadowCastingGeometries;
+	}
+
+	if (slot.lightList != lLightList)
+	{
+		if (slot.lightList != kNoList) erase(List(slot.lightList), slot.lightPosition);
+		slot.lightList = kNoList;
+		if (lLightList != kNoList) insert(entity, slot, lLightList, true);
+	}
+	if (slot.geometryList != lGeometryList)
+	{
+		if (slot.geometryList != kNoList) erase(List(slot.geometryList), slot.geometryPosition);
+		slot.geometryList = kNoList;
+		if (lGeometryList != kNoList) insert(entity, slot, lGeometryList, false);
+	}
+
+	if (lLightList == kShadowCastingLights)
+	{
+		if (!entity.shadowBuffer) entity.light->initializeShadowBuffer(entity);
+		assert(entity.shadowBuffer);
+	}
+	else if (lLightList == kNonShadowCastingLights)
+	{
+		// A light that does not cast shadows has no use for a shadow buffer.
+		entity.shadowBuffer.reset();
+	}
+}
+
+void RenderLists::insert(Entity& entity, Slot& slot, const List list, const bool isLight)
+{
+	const auto lPosition = static_cast<std::uint32_t>(mLists[list].size());
+	mLists[list].push_back(&entity);
+	mHandles[list].push_back(entity.getHandle());
+	if (isLight)
+	{
+		slot.lightList = list;
+		slot.lightPosition = lPosition;
+	}
+	else
+	{
+		slot.geometryList = list;
+		slot.geometryPosition = lPosition;
+	}
+}
+
+void RenderLists::erase(const List list, const std::uint32_t position) noexcept
+{
+	// Move the last entry into the gap. Its Entity may have died already,
+	// so find its slot through the handle.
+	auto& lEntities = mLists[list];
+	auto& lHandles = mHandles[list];
+	const auto lLast = static_cast<std::uint32_t>(lEntities.size() - 1);
+	if (position != lLast)
+	{
+		lEntities[position] = lEntities[lLast];
+		lHandles[position] = lHandles[lLast];
+		auto& lMoved = mSlots[lHandles[position].index()];
+		if (lMoved.lightList == list) lMoved.lightPosition = position;
+		else lMoved.geometryPosition = position;
+	}
+	lEntities.pop_back();
+	lHandles.pop_back();
+}
+
+void RenderLists::eraseAll(Slot& slot) noexcept
+{
+	if (slot.lightList != kNoList) erase(List(slot.lightList), slot.lightPosition);
+	if (slot.geometryList != kNoList) erase(List(slot.geometryList), slot.geometryPosition);
+	slot.lightList = kNoList;
+	slot.geometryList = kNoList;
+}
+
+} // namespace gintonic
@@ -2,6 +2,7 @@
 
 #include "Graphics/GUI/Base.hpp"
 
+#include "Foundation/LinearOctree.hpp"
 #include "Foundation/Octree.hpp"
 #include "Foundation/exception.hpp"
 #include "Math/MatrixPipeline.hpp"
@@ -13,6 +14,7 @@
 #include "Graphics/Material.hpp"
 #include "Graphics/Mesh.hpp"
 #include "Graphics/PointLight.hpp"
+#include "Graphics/RenderLists.hpp"
 #include "Graphics/ShaderPrograms.hpp"
 #include "Graphics/ShadowBuffer.hpp"
 #include "Graphics/Skeleton.hpp"
@@ -20,7 +22,6 @@
 
 #include "Camera.hpp"
 #include "Entity.hpp"
-#include "EntityVisitor.hpp"
 
 #include "imgui.h"
 
@@ -42,6 +43,10 @@
 #define NUM_SUBDIVISIONS 2
 #define PREFERRED_LINE_WIDTH 4
 
+// The debug overlay of the octrees draws nodes with this many entities or
+// more in red.
+#define GT_OCTREE_DEBUG_FULL_NODE 8.0f
+
 #define FONT_FILE_LOCATION "assets/fonts/Inconsolata-Regular.ttf"
 
 #define HAS_DIFFUSE_TEXTURE 1
@@ -70,89 +75,12 @@ GeometryBuffer* sGeometryBuffer = nullptr;
 
 std::shared_ptr<Camera> sDefaultCamera = Camera::create("DefaultCamera");
 
-std::vector<std::shared_ptr<Entity>> sShadowCastingLightEntities;
-std::vector<std::shared_ptr<Entity>> sShadowCastingPointLightEntities;
-std::vector<std::shared_ptr<Entity>> sShadowCastingGeometryEntities;
-std::vector<std::shared_ptr<Entity>> sNonShadowCastingLightEntities;
-std::vector<std::shared_ptr<Entity>> sNonShadowCastingGeometryEntities;
+RenderLists sRenderLists;
 
 WriteLock sEntitiesLock;
 
 MaterialShaderProgram* sMaterialShaderProgram = nullptr;
 
-class EntitySorter : public EntityVisitor
-{
-  public:
-    EntitySorter(std::shared_ptr<Entity> root) : EntityVisitor(root)
-    {
-        sEntitiesLock.obtain();
-    }
-
-    virtual ~EntitySorter() { sEntitiesLock.release(); }
-
-    virtual bool onVisit(std::shared_ptr<Entity> entity)
-    {
-        if (entity->castShadow)
-        {
-            if (entity->light)
-            {
-                // Catch SpotLight before PointLight. This is needed
-                // because SpotLight inherits from PointLight. Otherwise
-                // every SpotLight would also match the dynamic cast to a
-                // PointLight. That is not what we want.
-                if (dynamic_cast<SpotLight*>(entity->light.get()))
-                {
-                    sShadowCastingLightEntities.push_back(entity);
-                    if (!entity->shadowBuffer)
-                    {
-                        entity->light->initializeShadowBuffer(*entity);
-                    }
-                    assert(entity->shadowBuffer);
-                }
-                // Point lights need to be treated separately.
-                else if (dynamic_cast<PointLight*>(entity->light.get()))
-                {
-                    sShadowCastingPointLightEntities.push_back(entity);
-                }
-                // Treat all other light types as if they apply the
-                // shadow map algorithm.
-                else
-                {
-                    sShadowCastingLightEntities.push_back(entity);
-                    if (!entity->shadowBuffer)
-                    {
-                        entity->light->initializeShadowBuffer(*entity);
-                    }
-                    assert(entity->shadowBuffer);
-                }
-            }
-            if (entity->material && entity->mesh)
-            {
-                sShadowCastingGeometryEntities.push_back(entity);
-            }
-        }
-        else // non-shadow casting entity
-        {
-            if (entity->light)
-            {
-                sNonShadowCastingLightEntities.push_back(entity);
-                if (entity->shadowBuffer)
-                {
-                    // Non-shadow casting light entity
-                    // But it has a shadow buffer. We can remove that.
-                    entity->shadowBuffer.reset();
-                    assert(!entity->shadowBuffer);
-                }
-            }
-            if (entity->material && entity->mesh)
-            {
-                sNonShadowCastingGeometryEntities.push_back(entity);
-            }
-        }
-        return true;
-    }
-};
-
 // ALL the global variables.
 
 std::shared_ptr<Font> sDebugFont = nullptr;
@@ -214,6 +142,7 @@ std::shared_ptr<Entity> Renderer::sCameraEntity =
 std::shared_ptr<Entity> Renderer::sDebugShadowBufferEntity =
     std::shared_ptr<Entity>(nullptr);
 const Octree* Renderer::sOctreeRoot = nullptr;
+const LinearOctree* Renderer::sLinearOctreeRoot = nullptr;
 vec3f Renderer::sCameraPosition = vec3f(0.0f, 0.0f, 0.0f);
 
 std::shared_ptr<Mesh> Renderer::sUnitQuadPUN = nullptr;
@@ -620,6 +549,7 @@ bool Renderer::mouseButton(const int buttoncode) noexcept
 
 void Renderer::release()
 {
+    sRenderLists.setRoot(nullptr);
     if (sMatrix33UniformBuffer)
     {
         delete sMatrix33UniformBuffer;
@@ -768,7 +698,7 @@ void Renderer::update() noexcept
         sGeometryBuffer->finalize(sWidth, sHeight);
     }
 
-    if (sOctreeRoot)
+    if (sOctreeRoot || sLinearOctreeRoot)
     {
         glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
         glDisable(GL_CULL_FACE);
@@ -776,8 +706,13 @@ void Renderer::update() noexcept
         glLineWidth(1.0f);
         const auto& lProgram = OctreeDebugShaderProgram::get();
         lProgram.activate();
-        lProgram.setColor(vec3f(0.0f, 0.0f, 1.0f));
-        sOctreeRoot->forEachNode([&lProgram](const Octree* node) {
+        const auto lDrawNode = [&lProgram](const auto* node) {
+            // Colour the node by the number of entities in it: empty nodes
+            // are blue, full nodes are red.
+            const auto lLoad = std::min(
+                1.0f, static_cast<float>(node->entityCount()) /
+                          GT_OCTREE_DEBUG_FULL_NODE);
+            lProgram.setColor(vec3f(lLoad, 0.0f, 1.0f - lLoad));
             SQT lTransform;
             const auto lBBox = node->bounds();
             lTransform.rotation = quatf(1.0f, 0.0f, 0.0f, 0.0f);
@@ -787,7 +722,9 @@ void Renderer::update() noexcept
             setModelMatrix(lTransform);
             lProgram.setMatrixPVM(matrix_PVM());
             sUnitCubePUN->draw();
-        });
+        };
+        if (sOctreeRoot) sOctreeRoot->forEachNode(lDrawNode);
+        if (sLinearOctreeRoot) sLinearOctreeRoot->forEachNode(lDrawNode);
     }
 
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
@@ -826,12 +763,13 @@ void Renderer::renderGeometry() noexcept
     std::vector<mat4f, allocator<mat4f>> matrixBs(GT_SKELETON_MAX_JOINTS);
     std::vector<mat3f> matrixBNs(GT_SKELETON_MAX_JOINTS);
 
-    renderGeometry(sShadowCastingGeometryEntities, matrixBs, matrixBNs);
-    renderGeometry(sNonShadowCastingGeometryEntities, matrixBs, matrixBNs);
+    renderGeometry(sRenderLists.shadowCastingGeometries(), matrixBs, matrixBNs);
+    renderGeometry(sRenderLists.nonShadowCastingGeometries(), matrixBs,
+                   matrixBNs);
 }
 
 void Renderer::renderGeometry(
-    const std::vector<std::shared_ptr<Entity>>& geometries,
+    const std::vector<Entity*>& geometries,
     std::vector<mat4f, allocator<mat4f>>& matrixBs,
     std::vector<mat3f>& matrixBNs) noexcept
 {
@@ -944,18 +882,18 @@ void Renderer::renderShadows() noexcept
 {
     // ShadowShaderProgram::get().activate();
     // ShadowShaderProgram::get().setInstancedRendering(0);
-    for (auto lEntity : sShadowCastingLightEntities)
+    for (auto* lEntity : sRenderLists.shadowCastingLights())
     {
         lEntity->shadowBuffer->collect(*lEntity,
-                                       sShadowCastingGeometryEntities);
+                                       sRenderLists.shadowCastingGeometries());
     }
 }
 
 void Renderer::renderPointLights() noexcept
 {
-    for (const auto lEntity : sShadowCastingPointLightEntities)
+    for (auto* lEntity : sRenderLists.shadowCastingPointLights())
     {
-        lEntity->light->shine(*lEntity, sShadowCastingGeometryEntities);
+        lEntity->light->shine(*lEntity, sRenderLists.shadowCastingGeometries());
     }
 }
 
@@ -969,13 +907,13 @@ void Renderer::renderLights() noexcept
     lAmbientLightShaderProgram.setLightIntensity(vec4f(1.0f, 1.0f, 1.0f, 1.0f));
     sUnitQuadPUN->draw();
 
-    for (auto lEntity : sShadowCastingLightEntities)
+    for (auto* lEntity : sRenderLists.shadowCastingLights())
     {
-        lEntity->light->shine(*lEntity, sShadowCastingGeometryEntities);
+        lEntity->light->shine(*lEntity, sRenderLists.shadowCastingGeometries());
     }
-    for (auto lEntity : sNonShadowCastingLightEntities)
+    for (auto* lEntity : sRenderLists.nonShadowCastingLights())
     {
-        lEntity->light->shine(*lEntity, sShadowCastingGeometryEntities);
+        lEntity->light->shine(*lEntity, sRenderLists.shadowCastingGeometries());
     }
 }
 
@@ -991,11 +929,6 @@ void Renderer::renderGUI() noexcept
 
 void Renderer::finalizeRendering() noexcept
 {
-    sShadowCastingLightEntities.clear();
-    sShadowCastingPointLightEntities.clear();
-    sShadowCastingGeometryEntities.clear();
-    sNonShadowCastingLightEntities.clear();
-    sNonShadowCastingGeometryEntities.clear();
     sEntitiesLock.release();
 
     const auto& lTextProgram = FlatTextShaderProgram::get();
@@ -1174,8 +1107,15 @@ const char* Renderer::version()
 
 void Renderer::submitEntityRecursive(std::shared_ptr<Entity> current)
 {
-    EntitySorter lEntitySorter(current);
-    lEntitySorter.execute();
+    Entity::flushTransformChanges();
+
+    // The render lists persist between frames. Only the entities that
+    // changed since the previous frame are sorted again. Global transforms
+    // are resolved lazily by whatever draws the entities.
+    sEntitiesLock.obtain();
+    sRenderLists.setRoot(current.get());
+    sRenderLists.update();
+    sEntitiesLock.release();
 
     // sEntityQueueLock.obtain();
     // submitEntityRecursiveHelper(current);
@@ -42,8 +42,7 @@ SpotLight::SpotLight(const vec4f& intensity, const vec4f& attenuation,
 
 void SpotLight::shine(
     const Entity& lightEntity,
-    const std::vector<
-        std::shared_ptr<Entity>>& /*shadowCastingGeometryEntities*/) const
+    const std::vector<Entity*>& /*shadowCastingGeometryEntities*/) const
     noexcept
 {
     // The transformation data is delivered in WORLD coordinates.
@@ -32,7 +32,7 @@ SpotShadowBuffer::SpotShadowBuffer()
 
 void SpotShadowBuffer::collect(
 	const Entity& lightEntity, 
-	const std::vector<std::shared_ptr<Entity>>& shadowCastingGeometryEntities) noexcept
+	const std::vector<Entity*>& shadowCastingGeometryEntities) noexcept
 {
 	mProjectionMatrix.set_perspective
 	(
@@ -71,13 +71,23 @@ void box3f::addPoint(const vec4f& point) noexcept
 	maxCorner.data = _mm_max_ps(maxCorner.data, point.data);
 }
 
-#define GT_INTERSECTS_VERSION 0
+#define GT_INTERSECTS_VERSION 2
 
 bool intersects(const box3f& a, const box3f& b) noexcept
 {
 	GT_PROFILE_FUNCTION;
 
-	#if GT_INTERSECTS_VERSION == 1
+	#if GT_INTERSECTS_VERSION == 2
+
+	// Two boxes are disjoint if and only if they are separated along one
+	// of the three axes. The corner tests below miss the case where two
+	// boxes cross each other without containing any corner of the other.
+	const auto lSeparated = _mm_or_ps(
+		_mm_cmplt_ps(a.maxCorner.data, b.minCorner.data),
+		_mm_cmplt_ps(b.maxCorner.data, a.minCorner.data));
+	return (_mm_movemask_ps(lSeparated) & 0x7) == 0;
+
+	#elif GT_INTERSECTS_VERSION == 1
 
 	auto x = a.contains(b.minCorner);
 	auto y = a.contains(b.maxCorner);
@@ -104,6 +114,21 @@ bool intersects(const box3f& a, const box3f& b) noexcept
 	#endif // GT_INTERSECTS_VERSION
 }
 
+float distance2(const box3f& box, const vec3f& point) noexcept
+{
+	GT_PROFILE_FUNCTION;
+
+	// Per axis, at most one of these is positive, and both are negative if
+	// the point is between the two planes of the box.
+	const auto lBelow = _mm_sub_ps(box.minCorner.data, point.data);
+	const auto lAbove = _mm_sub_ps(point.data, box.maxCorner.data);
+	const auto lMaskXYZ = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+	auto lDelta = _mm_and_ps(_mm_max_ps(_mm_max_ps(lBelow, lAbove), _mm_setzero_ps()), lMaskXYZ);
+	lDelta = _mm_mul_ps(lDelta, lDelta);
+	lDelta = _mm_hadd_ps(lDelta, lDelta);
+	return _mm_cvtss_f32(_mm_hadd_ps(lDelta, lDelta));
+}
+
 std::ostream& operator << (std::ostream& os, const box3f& b)
 {
 	GT_PROFILE_FUNCTION;
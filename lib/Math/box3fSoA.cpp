@@ -0,0 +1,188 @@
+#include "Math/box3fSoA.hpp"
+#include "Math/mat4f.hpp"
+
+#include <algorithm>
+
+namespace gintonic {
+
+namespace {
+
+inline float& lane(__m128& x, const std::size_t i) noexcept
+{
+	return reinterpret_cast<float*>(&x)[i];
+}
+
+inline float lane(const __m128& x, const std::size_t i) noexcept
+{
+	return reinterpret_cast<const float*>(&x)[i];
+}
+
+inline __m128 absolute(const __m128 x) noexcept
+{
+	return _mm_andnot_ps(_mm_set1_ps(-0.0f), x);
+}
+
+} // anonymous namespace
+
+void box3fSoA::clear() noexcept
+{
+	mBlocks.clear();
+	mSize = 0;
+}
+
+void box3fSoA::reserve(const std::size_t count)
+{
+	mBlocks.reserve((count + 3) / 4);
+}
+
+void box3fSoA::push_back(const box3f& box)
+{
+	if (mSize == 4 * mBlocks.size())
+	{
+		const auto lZero = _mm_setzero_ps();
+		mBlocks.push_back(Block{lZero, lZero, lZero, lZero, lZero, lZero});
+	}
+	++mSize;
+	set(mSize - 1, box);
+}
+
+void box3fSoA::set(const std::size_t index, const box3f& box) noexcept
+{
+	GT_PROFILE_FUNCTION;
+
+	auto& lBlock = mBlocks[index / 4];
+	const auto l = index % 4;
+	lane(lBlock.minX, l) = box.minCorner.x;
+	lane(lBlock.minY, l) = box.minCorner.y;
+	lane(lBlock.minZ, l) = box.minCorner.z;
+	lane(lBlock.maxX, l) = box.maxCorner.x;
+	lane(lBlock.maxY, l) = box.maxCorner.y;
+	lane(lBlock.maxZ, l) = box.maxCorner.z;
+}
+
+box3f box3fSoA::get(const std::size_t index) const noexcept
+{
+	GT_PROFILE_FUNCTION;
+
+	const auto& lBlock = mBlocks[index / 4];
+	const auto l = index % 4;
+	return box3f(
+		vec3f(lane(lBlock.minX, l), lane(lBlock.minY, l), lane(lBlock.minZ, l)),
+		vec3f(lane(lBlock.maxX, l), lane(lBlock.maxY, l), lane(lBlock.maxZ, l)));
+}
+
+void box3fSoA::assignTransformed(const box3fSoA& boxes, const mat4f* const* matrices)
+{
+	GT_PROFILE_FUNCTION;
+
+	mBlocks.resize(boxes.mBlocks.size());
+	mSize = boxes.mSize;
+	const auto lHalf = _mm_set1_ps(0.5f);
+	for (std::size_t b = 0; b < mBlocks.size(); ++b)
+	{
+		const auto& lSource = boxes.mBlocks[b];
+		const __m128 lCenter[3] =
+		{
+			_mm_mul_ps(_mm_add_ps(lSource.minX, lSource.maxX), lHalf),
+			_mm_mul_ps(_mm_add_ps(lSource.minY, lSource.maxY), lHalf),
+			_mm_mul_ps(_mm_add_ps(lSource.minZ, lSource.maxZ), lHalf)
+		};
+		const __m128 lExtent[3] =
+		{
+			_mm_mul_ps(_mm_sub_ps(lSource.maxX, lSource.minX), lHalf),
+			_mm_mul_ps(_mm_sub_ps(lSource.maxY, lSource.minY), lHalf),
+			_mm_mul_ps(_mm_sub_ps(lSource.maxZ, lSource.minZ), lHalf)
+		};
+
+		// The lanes past the last box borrow the matrix of the last box.
+		const float* lMatrix[4];
+		for (std::size_t l = 0; l < 4; ++l)
+		{
+			const auto lIndex = std::min(4 * b + l, mSize - 1);
+			lMatrix[l] = reinterpret_cast<const float*>(matrices[lIndex]->data);
+		}
+
+		// Gather entry (row, column) of the four matrices. The matrices are
+		// column-major.
+		const auto lEntry = [&lMatrix] (const std::size_t row, const std::size_t column)
+		{
+			const auto i = 4 * column + row;
+			return _mm_setr_ps(lMatrix[0][i], lMatrix[1][i], lMatrix[2][i], lMatrix[3][i]);
+		};
+
+		__m128 lMin[3], lMax[3];
+		for (std::size_t r = 0; r < 3; ++r)
+		{
+			auto lC = lEntry(r, 3);
+			auto lE = _mm_setzero_ps();
+			for (std::size_t c = 0; c < 3; ++c)
+			{
+				const auto lM = lEntry(r, c);
+				lC = _mm_add_ps(lC, _mm_mul_ps(lM, lCenter[c]));
+				lE = _mm_add_ps(lE, _mm_mul_ps(absolute(lM), lExtent[c]));
+			}
+			lMin[r] = _mm_sub_ps(lC, lE);
+			lMax[r] = _mm_add_ps(lC, lE);
+		}
+		mBlocks[b] = Block{lMin[0], lMin[1], lMin[2], lMax[0], lMax[1], lMax[2]};
+	}
+}
+
+void box3fSoA::swapRemove(const std::size_t index) noexcept
+{
+	const auto lLast = mSize - 1;
+	if (index != lLast) set(index, get(lLast));
+	--mSize;
+	if (mSize == 4 * (mBlocks.size() - 1)) mBlocks.pop_back();
+}
+
+unsigned box3fSoA::intersectionMask(const Block& block, const box3f& volume) noexcept
+{
+	GT_PROFILE_FUNCTION;
+
+	// Two boxes intersect if they are not separated along any axis.
+	auto lSeparated = _mm_cmplt_ps(block.maxX, _mm_set1_ps(volume.minCorner.x));
+	lSeparated = _mm_or_ps(lSeparated, _mm_cmplt_ps(block.maxY, _mm_set1_ps(volume.minCorner.y)));
+	lSeparated = _mm_or_ps(lSeparated, _mm_cmplt_ps(block.maxZ, _mm_set1_ps(volume.minCorner.z)));
+	lSeparated = _mm_or_ps(lSeparated, _mm_cmpgt_ps(block.minX, _mm_set1_ps(volume.maxCorner.x)));
+	lSeparated = _mm_or_ps(lSeparated, _mm_cmpgt_ps(block.minY, _mm_set1_ps(volume.maxCorner.y)));
+	lSeparated = _mm_or_ps(lSeparated, _mm_cmpgt_ps(block.minZ, _mm_set1_ps(volume.maxCorner.z)));
+	return ~unsigned(_mm_movemask_ps(lSeparated)) & 0xf;
+}
+
+unsigned box3fSoA::intersectionMask(
+	const Block& block,
+	const frustum& volume,
+	const unsigned planeMask) noexcept
+{
+	GT_PROFILE_FUNCTION;
+
+	const auto lHalf = _mm_set1_ps(0.5f);
+	const auto lCX = _mm_mul_ps(_mm_add_ps(block.minX, block.maxX), lHalf);
+	const auto lCY = _mm_mul_ps(_mm_add_ps(block.minY, block.maxY), lHalf);
+	const auto lCZ = _mm_mul_ps(_mm_add_ps(block.minZ, block.maxZ), lHalf);
+	const auto lEX = _mm_mul_ps(_mm_sub_ps(block.maxX, block.minX), lHalf);
+	const auto lEY = _mm_mul_ps(_mm_sub_ps(block.maxY, block.minY), lHalf);
+	const auto lEZ = _mm_mul_ps(_mm_sub_ps(block.maxZ, block.minZ), lHalf);
+
+	// A box is outside if it is completely outside one of the planes.
+	auto lOutside = _mm_setzero_ps();
+	for (int p = 0; p < 6; ++p)
+	{
+		if ((planeMask & (1u << p)) == 0) continue;
+		const auto& lPlane = volume.planes[p];
+		const auto lA = _mm_set1_ps(lPlane.x);
+		const auto lB = _mm_set1_ps(lPlane.y);
+		const auto lC = _mm_set1_ps(lPlane.z);
+		const auto lDistance = _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(lA, lCX), _mm_mul_ps(lB, lCY)),
+			_mm_add_ps(_mm_mul_ps(lC, lCZ), _mm_set1_ps(lPlane.w)));
+		const auto lRadius = _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(absolute(lA), lEX), _mm_mul_ps(absolute(lB), lEY)),
+			_mm_mul_ps(absolute(lC), lEZ));
+		lOutside = _mm_or_ps(lOutside, _mm_cmplt_ps(_mm_add_ps(lDistance, lRadius), _mm_setzero_ps()));
+	}
+	return ~unsigned(_mm_movemask_ps(lOutside)) & 0xf;
+}
+
+} // namespace gintonic
@@ -0,0 +1,157 @@
+#include "Math/frustum.hpp"
+
+#include <cmath>
+#include <iostream>
+
+namespace gintonic {
+
+namespace {
+
+inline __m128 absolute(const __m128 x) noexcept
+{
+	return _mm_andnot_ps(_mm_set1_ps(-0.0f), x);
+}
+
+inline __m128 splat(const __m128 x, const int i) noexcept
+{
+	switch (i)
+	{
+		case 0: return _mm_shuffle_ps(x, x, _MM_SHUFFLE(0, 0, 0, 0));
+		case 1: return _mm_shuffle_ps(x, x, _MM_SHUFFLE(1, 1, 1, 1));
+		default: return _mm_shuffle_ps(x, x, _MM_SHUFFLE(2, 2, 2, 2));
+	}
+}
+
+} // anonymous namespace
+
+frustum::frustum()
+{
+	GT_PROFILE_FUNCTION;
+
+	for (auto& lPlane : planes) lPlane = vec4f(0.0f, 0.0f, 0.0f, 1.0f);
+	transpose();
+}
+
+frustum::frustum(const mat4f& m)
+{
+	GT_PROFILE_FUNCTION;
+
+	const vec4f lRow0(m.m00, m.m01, m.m02, m.m03);
+	const vec4f lRow1(m.m10, m.m11, m.m12, m.m13);
+	const vec4f lRow2(m.m20, m.m21, m.m22, m.m23);
+	const vec4f lRow3(m.m30, m.m31, m.m32, m.m33);
+
+	planes[kLeft]   = lRow3 + lRow0;
+	planes[kRight]  = lRow3 - lRow0;
+	planes[kBottom] = lRow3 + lRow1;
+	planes[kTop]    = lRow3 - lRow1;
+	planes[kNear]   = lRow3 + lRow2;
+	planes[kFar]    = lRow3 - lRow2;
+
+	for (auto& lPlane : planes)
+	{
+		const auto lLength = std::sqrt(lPlane.x * lPlane.x
+			+ lPlane.y * lPlane.y + lPlane.z * lPlane.z);
+		if (lLength > 0.0f) lPlane /= lLength;
+	}
+
+	transpose();
+}
+
+void frustum::transpose() noexcept
+{
+	// Pad the second group with planes that contain everything.
+	const auto lEverything = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
+	__m128 lGroups[2][4] =
+	{
+		{ planes[0].data, planes[1].data, planes[2].data, planes[3].data },
+		{ planes[4].data, planes[5].data, lEverything, lEverything }
+	};
+	for (int g = 0; g < 2; ++g)
+	{
+		_MM_TRANSPOSE4_PS(lGroups[g][0], lGroups[g][1], lGroups[g][2], lGroups[g][3]);
+		mA[g] = lGroups[g][0];
+		mB[g] = lGroups[g][1];
+		mC[g] = lGroups[g][2];
+		mD[g] = lGroups[g][3];
+	}
+}
+
+bool frustum::contains(const vec3f& point) const noexcept
+{
+	GT_PROFILE_FUNCTION;
+
+	const auto lX = splat(point.data, 0);
+	const auto lY = splat(point.data, 1);
+	const auto lZ = splat(point.data, 2);
+	int lOutside = 0;
+	for (int g = 0; g < 2; ++g)
+	{
+		const auto lDistance = _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(mA[g], lX), _mm_mul_ps(mB[g], lY)),
+			_mm_add_ps(_mm_mul_ps(mC[g], lZ), mD[g]));
+		lOutside |= _mm_movemask_ps(_mm_cmplt_ps(lDistance, _mm_setzero_ps()));
+	}
+	return lOutside == 0;
+}
+
+bool frustum::contains(const box3f& box) const noexcept
+{
+	unsigned lMask = kAllPlanes;
+	return classify(box, lMask) == kInside;
+}
+
+frustum::Classification frustum::classify(
+	const box3f& box,
+	unsigned& planeMask) const noexcept
+{
+	GT_PROFILE_FUNCTION;
+
+	// Project the half extents of the box onto the normal of every plane.
+	// The box is outside a plane if even its nearest corner is outside, and
+	// inside a plane if even its farthest corner is inside.
+	const auto lHalf = _mm_set1_ps(0.5f);
+	const auto lCenter = _mm_mul_ps(_mm_add_ps(box.minCorner.data, box.maxCorner.data), lHalf);
+	const auto lExtent = _mm_mul_ps(_mm_sub_ps(box.maxCorner.data, box.minCorner.data), lHalf);
+	const auto lCX = splat(lCenter, 0), lCY = splat(lCenter, 1), lCZ = splat(lCenter, 2);
+	const auto lEX = splat(lExtent, 0), lEY = splat(lExtent, 1), lEZ = splat(lExtent, 2);
+
+	unsigned lOutside = 0;
+	unsigned lInside = 0;
+	for (int g = 0; g < 2; ++g)
+	{
+		const auto lDistance = _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(mA[g], lCX), _mm_mul_ps(mB[g], lCY)),
+			_mm_add_ps(_mm_mul_ps(mC[g], lCZ), mD[g]));
+		const auto lRadius = _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(absolute(mA[g]), lEX), _mm_mul_ps(absolute(mB[g]), lEY)),
+			_mm_mul_ps(absolute(mC[g]), lEZ));
+		const auto lZero = _mm_setzero_ps();
+		lOutside |= unsigned(_mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(lDistance, lRadius), lZero))) << (4 * g);
+		lInside |= unsigned(_mm_movemask_ps(_mm_cmpge_ps(_mm_sub_ps(lDistance, lRadius), lZero))) << (4 * g);
+	}
+
+	if (lOutside & planeMask) return kOutside;
+	planeMask &= ~lInside;
+	return planeMask == 0 ? kInside : kIntersecting;
+}
+
+bool intersects(const frustum& a, const box3f& b) noexcept
+{
+	unsigned lMask = frustum::kAllPlanes;
+	return a.classify(b, lMask) != frustum::kOutside;
+}
+
+std::ostream& operator << (std::ostream& os, const frustum& f)
+{
+	GT_PROFILE_FUNCTION;
+
+	for (int i = 0; i < 6; ++i)
+	{
+		if (i) os << ' ';
+		os << f.planes[i];
+	}
+	return os;
+}
+
+} // namespace gintonic
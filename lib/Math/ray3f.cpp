@@ -0,0 +1,72 @@
+#include "Math/ray3f.hpp"
+
+#include <iostream>
+#include <limits>
+
+namespace gintonic {
+
+ray3f::ray3f()
+: origin(0.0f, 0.0f, 0.0f)
+, direction(1.0f, 0.0f, 0.0f)
+, invDirection(1.0f, std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity())
+{
+	/* Empty on purpose. */
+}
+
+ray3f::ray3f(const vec3f& origin, const vec3f& direction)
+: origin(origin)
+, direction(direction)
+, invDirection(_mm_div_ps(_mm_set1_ps(1.0f), direction.data))
+{
+	/* Empty on purpose. */
+}
+
+bool ray3f::intersects(
+	const box3f& box,
+	const float minDistance,
+	const float maxDistance,
+	float& distance) const noexcept
+{
+	GT_PROFILE_FUNCTION;
+
+	// The distances at which the ray crosses the six planes of the slabs.
+	const auto lT1 = _mm_mul_ps(_mm_sub_ps(box.minCorner.data, origin.data), invDirection.data);
+	const auto lT2 = _mm_mul_ps(_mm_sub_ps(box.maxCorner.data, origin.data), invDirection.data);
+
+	// A ray parallel to a slab gives 0 * inf = NaN if its origin is on one
+	// of the planes of the slab. In that case the ray runs inside the
+	// (closed) slab, so the slab does not restrict it at all.
+	const auto lParallel = _mm_cmpunord_ps(lT1, lT2);
+	const auto lInfinity = _mm_set1_ps(std::numeric_limits<float>::infinity());
+	const auto lNearPerSlab = _mm_or_ps(
+		_mm_andnot_ps(lParallel, _mm_min_ps(lT1, lT2)),
+		_mm_and_ps(lParallel, _mm_sub_ps(_mm_setzero_ps(), lInfinity)));
+	const auto lFarPerSlab = _mm_or_ps(
+		_mm_andnot_ps(lParallel, _mm_max_ps(lT1, lT2)),
+		_mm_and_ps(lParallel, lInfinity));
+
+	// Reduce the X, Y and Z lanes, together with the given range.
+	auto lNear = _mm_max_ss(lNearPerSlab, _mm_shuffle_ps(lNearPerSlab, lNearPerSlab, _MM_SHUFFLE(1, 1, 1, 1)));
+	lNear = _mm_max_ss(lNear, _mm_shuffle_ps(lNearPerSlab, lNearPerSlab, _MM_SHUFFLE(2, 2, 2, 2)));
+	lNear = _mm_max_ss(lNear, _mm_set_ss(minDistance));
+	auto lFar = _mm_min_ss(lFarPerSlab, _mm_shuffle_ps(lFarPerSlab, lFarPerSlab, _MM_SHUFFLE(1, 1, 1, 1)));
+	lFar = _mm_min_ss(lFar, _mm_shuffle_ps(lFarPerSlab, lFarPerSlab, _MM_SHUFFLE(2, 2, 2, 2)));
+	lFar = _mm_min_ss(lFar, _mm_set_ss(maxDistance));
+
+	if (_mm_comile_ss(lNear, lFar) == 0) return false;
+	distance = _mm_cvtss_f32(lNear);
+	return true;
+}
+
+bool intersects(const ray3f& a, const box3f& b) noexcept
+{
+	float lDistance;
+	return a.intersects(b, 0.0f, std::numeric_limits<float>::infinity(), lDistance);
+}
+
+std::ostream& operator << (std::ostream& os, const ray3f& r)
+{
+	return os << r.origin << ' ' << r.direction;
+}
+
+} // namespace gintonic
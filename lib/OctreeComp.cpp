@@ -1,14 +1,28 @@
 #include "OctreeComp.hpp"
 #include "Collider.hpp"
 #include "Entity.hpp"
+#include "Foundation/ThreadPool.hpp"
 #include "Transform.hpp"
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 
 #define GT_OCTREE_SUBDIV_THRESHOLD 1.0f
 
+// The default margin by which the bounds of an OctreeComp are inflated.
+#define GT_OCTREE_DEFAULT_MARGIN 0.5f
+
+// The number of box queries that traverse the tree together in a batch. At
+// most the number of bits in an unsigned.
+#define GT_OCTREE_QUERY_PACKET_SIZE 16u
+
+// The minimum number of packets per task of a batch.
+#define GT_OCTREE_QUERY_PACKET_GRAIN 2
+
 using namespace gintonic;
 
-OctreeComp::OctreeComp(EntityBase* owner) : Component(Kind::OctreeComp, owner)
+OctreeComp::OctreeComp(EntityBase* owner)
+    : Component(Kind::OctreeComp, owner), mMargin(GT_OCTREE_DEFAULT_MARGIN)
 {
     mTransform = mEntityBase->add<Transform>();
     mCollider = mEntityBase->get<Collider>();
@@ -27,9 +41,15 @@ void OctreeComp::setNode(Node& node)
     mNode->insert(this);
 }
 
+void OctreeComp::setStatic(const bool isStatic)
+{
+    if (isStatic && !mStatic && mNode) mNode->update(this);
+    mStatic = isStatic;
+}
+
 void OctreeComp::update()
 {
-    if (mNode) mNode->update(this);
+    if (mNode && !mStatic) mNode->update(this);
 }
 
 box3f OctreeComp::getBounds() const noexcept
@@ -40,11 +60,19 @@ box3f OctreeComp::getBounds() const noexcept
 std::unique_ptr<Component> OctreeComp::clone(EntityBase* newOwner) const
 {
     auto octree = std::make_unique<OctreeComp>(newOwner);
+    octree->mMargin = mMargin;
+    octree->mStatic = mStatic;
     octree->mNode = mNode;
     if (mNode) mNode->insert(octree.get());
     return std::move(octree);
 }
 
+OctreeComp::Node::Node(const vec3f& min, const vec3f& max) : mBounds(min, max)
+{
+}
+
+OctreeComp::Node::Node(const box3f& bounds) : mBounds(bounds) {}
+
 OctreeComp::Node::Node(Node* parent, const vec3f& min, const vec3f& max)
     : mBounds(min, max), mParent(parent)
 {
@@ -66,15 +94,304 @@ const OctreeComp::Node* OctreeComp::Node::getRoot() const noexcept
 
 const box3f& OctreeComp::Node::getBounds() const noexcept { return mBounds; }
 
+OctreeComp* OctreeComp::Node::raycast(const vec3f& origin,
+                                      const vec3f& direction,
+                                      const float maxDistance, float& distance)
+{
+    const ray3f ray(origin, vec3f(direction).normalize());
+    auto maxDistanceSoFar = maxDistance;
+    std::vector<DistanceAndComp> hits;
+    raycastRecursive(ray, maxDistanceSoFar, true, hits);
+    if (hits.empty()) return nullptr;
+    GT_SPATIAL_COUNT(results, 1);
+    distance = hits.front().first;
+    return hits.front().second;
+}
+
+const OctreeComp* OctreeComp::Node::raycast(const vec3f& origin,
+                                            const vec3f& direction,
+                                            const float maxDistance,
+                                            float& distance) const
+{
+    const ray3f ray(origin, vec3f(direction).normalize());
+    auto maxDistanceSoFar = maxDistance;
+    std::vector<DistanceAndComp> hits;
+    raycastRecursive(ray, maxDistanceSoFar, true, hits);
+    if (hits.empty()) return nullptr;
+    GT_SPATIAL_COUNT(results, 1);
+    distance = hits.front().first;
+    return hits.front().second;
+}
+
+void OctreeComp::Node::raycastSorted(const vec3f& origin,
+                                     const vec3f& direction,
+                                     const float maxDistance,
+                                     std::vector<DistanceAndComp>& hits) const
+{
+    const ray3f ray(origin, vec3f(direction).normalize());
+    auto maxDistanceSoFar = maxDistance;
+    raycastRecursive(ray, maxDistanceSoFar, false, hits);
+    GT_SPATIAL_COUNT(results, hits.size());
+    std::stable_sort(hits.begin(), hits.end(),
+                     [](const DistanceAndComp& a, const DistanceAndComp& b) {
+                         return a.first < b.first;
+                     });
+}
+
+void OctreeComp::Node::raycastRecursive(const ray3f& ray, float& maxDistance,
+                                        const bool closestOnly,
+                                        std::vector<DistanceAndComp>& hits) const
+{
+    GT_SPATIAL_COUNT(nodesVisited, 1);
+    GT_SPATIAL_COUNT(boxesTested, mComps.size());
+    float distance;
+    for (auto* comp : mComps)
+    {
+        if (ray.intersects(comp->getBounds(), 0.0f, maxDistance, distance))
+        {
+            if (closestOnly)
+            {
+                // Everything beyond this hit can be ignored from now on.
+                hits.clear();
+                maxDistance = distance;
+            }
+            hits.emplace_back(distance, comp);
+        }
+    }
+    if (isLeaf()) return;
+
+    // Sort the children that the ray hits by their entry distance, so that
+    // the closest hit is found early and prunes the children behind it.
+    std::pair<float, const Node*> order[8];
+    int orderCount = 0;
+    for (const auto* child : mChildren)
+    {
+        if (child->isLeaf() && child->hasNoOctreeComponents()) continue;
+        if (!ray.intersects(child->mBounds, 0.0f, maxDistance, distance))
+        {
+            continue;
+        }
+        auto i = orderCount++;
+        for (; i > 0 && order[i - 1].first > distance; --i)
+        {
+            order[i] = order[i - 1];
+        }
+        order[i] = std::make_pair(distance, child);
+    }
+    for (int i = 0; i < orderCount; ++i)
+    {
+        if (order[i].first > maxDistance) break;
+        order[i].second->raycastRecursive(ray, maxDistance, closestOnly, hits);
+    }
+}
+
+void OctreeComp::Node::nearestSorted(const vec3f& point, const std::size_t k,
+                                     std::vector<DistanceAndComp>& result) const
+{
+    result.clear();
+    if (k == 0) return;
+    result.reserve(k);
+
+    // The result is a max-heap of squared distances, so that its front is the
+    // k-th nearest component found so far. The nodes still to visit are in a
+    // min-heap on the squared distance to their bounds.
+    using NodeEntry = std::pair<float, const Node*>;
+    const auto fartherLast = [](const DistanceAndComp& a,
+                                const DistanceAndComp& b) {
+        return a.first < b.first;
+    };
+    const auto nearerFirst = [](const NodeEntry& a, const NodeEntry& b) {
+        return a.first > b.first;
+    };
+    std::vector<NodeEntry> queue;
+    queue.emplace_back(0.0f, this);
+
+    while (!queue.empty())
+    {
+        std::pop_heap(queue.begin(), queue.end(), nearerFirst);
+        const auto entry = queue.back();
+        queue.pop_back();
+
+        // Every node still in the queue is at least this far away.
+        if (result.size() == k && entry.first > result.front().first) break;
+
+        const auto* node = entry.second;
+        GT_SPATIAL_COUNT(nodesVisited, 1);
+        GT_SPATIAL_COUNT(boxesTested, node->mComps.size());
+        for (auto* comp : node->mComps)
+        {
+            const auto dist2 = distance2(comp->getBounds(), point);
+            if (result.size() < k)
+            {
+                result.emplace_back(dist2, comp);
+                std::push_heap(result.begin(), result.end(), fartherLast);
+            }
+            else if (dist2 < result.front().first)
+            {
+                std::pop_heap(result.begin(), result.end(), fartherLast);
+                result.back() = DistanceAndComp(dist2, comp);
+                std::push_heap(result.begin(), result.end(), fartherLast);
+            }
+        }
+        if (node->isLeaf()) continue;
+        for (const auto* child : node->mChildren)
+        {
+            if (child->isLeaf() && child->hasNoOctreeComponents()) continue;
+            const auto dist2 = distance2(child->mBounds, point);
+            if (result.size() == k && dist2 > result.front().first) continue;
+            queue.emplace_back(dist2, child);
+            std::push_heap(queue.begin(), queue.end(), nearerFirst);
+        }
+    }
+
+    std::sort_heap(result.begin(), result.end(), fartherLast);
+    GT_SPATIAL_COUNT(results, result.size());
+    for (auto& pair : result) pair.first = std::sqrt(pair.first);
+}
+
+void OctreeComp::Node::query(const box3f* first, const box3f* last,
+                             QueryBatch& batch)
+{
+    const auto queryCount = static_cast<std::size_t>(last - first);
+    const auto packetCount =
+        (queryCount + GT_OCTREE_QUERY_PACKET_SIZE - 1) /
+        GT_OCTREE_QUERY_PACKET_SIZE;
+    batch.mOffsets.assign(queryCount + 1, 0);
+    if (batch.mPackets.size() < packetCount) batch.mPackets.resize(packetCount);
+
+    ThreadPool::get().parallelFor(
+        0, packetCount, GT_OCTREE_QUERY_PACKET_GRAIN,
+        [&](const std::size_t firstPacket, const std::size_t lastPacket) {
+            std::vector<QueryAndComp> hits;
+            for (auto p = firstPacket; p < lastPacket; ++p)
+            {
+                const auto firstQuery = p * GT_OCTREE_QUERY_PACKET_SIZE;
+                const auto count = static_cast<unsigned>(std::min<std::size_t>(
+                    GT_OCTREE_QUERY_PACKET_SIZE, queryCount - firstQuery));
+                const auto* volumes = first + firstQuery;
+                unsigned mask = 0;
+                for (unsigned i = 0; i < count; ++i)
+                {
+                    if (intersects(volumes[i], mBounds)) mask |= 1u << i;
+                }
+                hits.clear();
+                if (mask) queryPacket(volumes, count, mask, hits);
+
+                // Sort the hits by query. Every packet writes its counts to
+                // its own part of the offsets; the prefix sum comes later.
+                auto* counts = batch.mOffsets.data() + firstQuery + 1;
+                for (const auto& hit : hits) ++counts[hit.first];
+                std::size_t start[GT_OCTREE_QUERY_PACKET_SIZE];
+                std::size_t sum = 0;
+                for (unsigned i = 0; i < count; ++i)
+                {
+                    start[i] = sum;
+                    sum += counts[i];
+                }
+                auto& packet = batch.mPackets[p];
+                packet.resize(hits.size());
+                for (const auto& hit : hits)
+                {
+                    packet[start[hit.first]++] = hit.second;
+                }
+            }
+        });
+
+    auto& offsets = batch.mOffsets;
+    for (std::size_t i = 1; i < offsets.size(); ++i)
+    {
+        offsets[i] += offsets[i - 1];
+    }
+    batch.mResults.resize(offsets.back());
+    for (std::size_t p = 0; p < packetCount; ++p)
+    {
+        const auto& packet = batch.mPackets[p];
+        std::copy(packet.begin(), packet.end(),
+                  batch.mResults.begin() +
+                      offsets[p * GT_OCTREE_QUERY_PACKET_SIZE]);
+    }
+}
+
+void OctreeComp::Node::queryPacket(const box3f* volumes, const unsigned count,
+                                   const unsigned mask,
+                                   std::vector<QueryAndComp>& hits) const
+{
+    GT_SPATIAL_COUNT(nodesVisited, 1);
+    GT_SPATIAL_COUNT(boxesTested, mComps.size());
+    for (auto* comp : mComps)
+    {
+        // The bounds are computed once for all queries of the packet.
+        const auto bounds = comp->getBounds();
+        for (unsigned i = 0; i < count; ++i)
+        {
+            if ((mask & (1u << i)) && intersects(volumes[i], bounds))
+            {
+                hits.emplace_back(i, comp);
+                GT_SPATIAL_COUNT(results, 1);
+            }
+        }
+    }
+    if (isLeaf()) return;
+    for (const auto* child : mChildren)
+    {
+        if (child->isLeaf() && child->hasNoOctreeComponents()) continue;
+        unsigned childMask = 0;
+        for (unsigned i = 0; i < count; ++i)
+        {
+            if ((mask & (1u << i)) && intersects(volumes[i], child->mBounds))
+            {
+                childMask |= 1u << i;
+            }
+        }
+        if (childMask) child->queryPacket(volumes, count, childMask, hits);
+    }
+}
+
+SpatialStatistics OctreeComp::Node::statistics() const
+{
+    SpatialStatistics result;
+    gatherStatistics(result, 0);
+    return result;
+}
+
+void OctreeComp::Node::gatherStatistics(SpatialStatistics& statistics,
+                                        const std::size_t depth) const
+{
+    const auto bytes =
+        sizeof(Node) + mComps.capacity() * sizeof(OctreeComp*);
+    statistics.addNode(depth, mComps.size(), isLeaf(), bytes);
+    if (isLeaf()) return;
+    for (const auto* child : mChildren)
+    {
+        child->gatherStatistics(statistics, depth + 1);
+    }
+}
+
 void OctreeComp::Node::insert(OctreeComp* comp)
 {
-    if (!mBounds.contains(comp->getBounds()))
+    const auto bounds = comp->getBounds();
+    if (!mBounds.contains(bounds))
     {
         // FIXME: Make a proper exception type.
         throw std::runtime_error(
             "entity not contained in octree bounding box :-(");
     }
 
+    // Inflate the bounds by the margin. Clamp them to this node, so that the
+    // inflated bounds fit wherever the actual bounds fit.
+    const auto margin = comp->mMargin;
+    comp->mFatBounds = box3f(
+        vec3f(std::max(bounds.minCorner.x - margin, mBounds.minCorner.x),
+              std::max(bounds.minCorner.y - margin, mBounds.minCorner.y),
+              std::max(bounds.minCorner.z - margin, mBounds.minCorner.z)),
+        vec3f(std::min(bounds.maxCorner.x + margin, mBounds.maxCorner.x),
+              std::min(bounds.maxCorner.y + margin, mBounds.maxCorner.y),
+              std::min(bounds.maxCorner.z + margin, mBounds.maxCorner.z)));
+    insertFat(comp);
+}
+
+void OctreeComp::Node::insertFat(OctreeComp* comp)
+{
     // If we are at a leaf node, subdivide the space into eight octants. If the
     // subdivision threshold is reached, no more subdivision will take place. In
     // that case, isLeaf() will still return true, so we have to check for that
@@ -87,9 +404,9 @@ void OctreeComp::Node::insert(OctreeComp* comp)
     {
         for (auto* child : mChildren)
         {
-            if (child->mBounds.contains(comp->getBounds()))
+            if (child->mBounds.contains(comp->mFatBounds))
             {
-                child->insert(comp);
+                child->insertFat(comp);
                 return;
             }
         }
@@ -122,17 +439,21 @@ void OctreeComp::Node::insertRecursive(OctreeComp* comp)
     }
 }
 
+bool OctreeComp::Node::erase(OctreeComp* comp) noexcept
+{
+    // The order of the components is irrelevant, so swap the last one into
+    // the hole instead of shifting everything after it.
+    const auto iter = std::find(mComps.begin(), mComps.end(), comp);
+    if (iter == mComps.end()) return false;
+    *iter = mComps.back();
+    mComps.pop_back();
+    comp->mNode = nullptr;
+    return true;
+}
+
 OctreeComp::Node* OctreeComp::Node::remove(OctreeComp* comp) noexcept
 {
-    for (auto iter = mComps.begin(); iter != mComps.end(); ++iter)
-    {
-        if (*iter == comp)
-        {
-            mComps.erase(iter);
-            comp->mNode = nullptr;
-            return mParent ? mParent->removeRecursive() : this;
-        }
-    }
+    if (erase(comp)) return mParent ? mParent->removeRecursive() : this;
     if (isLeaf())
     {
         return nullptr;
@@ -172,13 +493,21 @@ OctreeComp::Node* OctreeComp::Node::removeRecursive() noexcept
 
 void OctreeComp::Node::update(OctreeComp* comp)
 {
-    auto upmostParent = remove(comp);
-    upmostParent->insertRecursive(comp);
+    // Nothing changes as long as the collider stays within the fat bounds.
+    if (comp->mFatBounds.contains(comp->getBounds())) return;
+
+    // Start the search for the new node from the old one instead of from the
+    // root; the component usually moved only a little. Prune the empty nodes
+    // afterwards, so that no node is freed and allocated again.
+    auto parent = mParent;
+    erase(comp);
+    insertRecursive(comp);
+    if (parent) parent->removeRecursive();
 }
 
 bool OctreeComp::Node::isLeaf() const noexcept
 {
-    return mAllocPlace != nullptr;
+    return mAllocPlace == nullptr;
 }
 
 bool OctreeComp::Node::hasNoOctreeComponents() const noexcept
@@ -197,7 +526,7 @@ void OctreeComp::Node::subdivide()
         return;
     }
 
-    assert(!isLeaf());
+    assert(isLeaf());
 
     mAllocPlace = _mm_malloc(sizeof(Node) * 8, 16);
 
@@ -0,0 +1,200 @@
+#include "SpatialHashGridComp.hpp"
+#include "Collider.hpp"
+#include "Entity.hpp"
+#include "Foundation/ThreadPool.hpp"
+#include "Foundation/hashing.hpp"
+#include "Transform.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <mutex>
+
+// The number of components that a task of the rebuild handles at least.
+#define GT_HASHGRID_REBUILD_GRAIN 4096
+
+using namespace gintonic;
+
+constexpr std::uint64_t SpatialHashGridComp::Grid::kEmpty;
+constexpr std::uint32_t SpatialHashGridComp::Grid::kNone;
+
+SpatialHashGridComp::SpatialHashGridComp(EntityBase* owner)
+    : Component(Kind::SpatialHashGridComp, owner)
+{
+    mTransform = mEntityBase->add<Transform>();
+    mCollider = mEntityBase->get<Collider>();
+    if (!mCollider) throw std::runtime_error("Missing component: Collider");
+}
+
+SpatialHashGridComp::~SpatialHashGridComp() noexcept
+{
+    if (mGrid) mGrid->remove(this);
+}
+
+void SpatialHashGridComp::setGrid(Grid& grid)
+{
+    if (mGrid) mGrid->remove(this);
+    grid.insert(this);
+}
+
+box3f SpatialHashGridComp::getBounds() const noexcept
+{
+    return mCollider->getGlobalBounds();
+}
+
+std::unique_ptr<Component>
+SpatialHashGridComp::clone(EntityBase* newOwner) const
+{
+    auto comp = std::make_unique<SpatialHashGridComp>(newOwner);
+    if (mGrid) mGrid->insert(comp.get());
+    return std::move(comp);
+}
+
+SpatialHashGridComp::Grid::Grid(const float cellSize)
+    : mCellSize(cellSize), mInverseCellSize(1.0f / cellSize),
+      mNextCellSize(cellSize)
+{
+}
+
+SpatialHashGridComp::Grid::~Grid() noexcept
+{
+    for (auto* comp : mComps)
+    {
+        comp->mGrid = nullptr;
+        comp->mIndex = kNone;
+        comp->mEntry = kNone;
+    }
+}
+
+void SpatialHashGridComp::Grid::insert(SpatialHashGridComp* comp)
+{
+    comp->mIndex = static_cast<std::uint32_t>(mComps.size());
+    comp->mEntry = kNone;
+    mComps.push_back(comp);
+    comp->mGrid = this;
+}
+
+void SpatialHashGridComp::Grid::remove(SpatialHashGridComp* comp) noexcept
+{
+    assert(comp->mGrid == this);
+    if (comp->mEntry != kNone) mEntries[comp->mEntry].comp = nullptr;
+    mComps[comp->mIndex] = mComps.back();
+    mComps[comp->mIndex]->mIndex = comp->mIndex;
+    mComps.pop_back();
+    comp->mGrid = nullptr;
+    comp->mIndex = kNone;
+    comp->mEntry = kNone;
+}
+
+std::size_t SpatialHashGridComp::Grid::memoryUsage() const noexcept
+{
+    return sizeof(Grid) +
+           mComps.capacity() * sizeof(SpatialHashGridComp*) +
+           mEntries.capacity() * sizeof(Entry) +
+           mSlots.capacity() * sizeof(Slot) + mCells.capacity() * sizeof(Cell) +
+           mBounds.capacity() * sizeof(box3f) +
+           mKeys.capacity() * sizeof(std::uint64_t) +
+           mCellOfComp.capacity() * sizeof(std::uint32_t) +
+           mRankInCell.capacity() * sizeof(std::uint32_t);
+}
+
+int SpatialHashGridComp::Grid::cellCoordinate(const float value) const
+    noexcept
+{
+    // Clamp before converting, so that far away or infinite coordinates do
+    // not overflow.
+    const auto cell = std::floor(value * mInverseCellSize);
+    return static_cast<int>(std::max(-1.0e9f, std::min(cell, 1.0e9f)));
+}
+
+SpatialHashGridComp::Grid::Slot&
+SpatialHashGridComp::Grid::findOrInsert(const std::uint64_t key) noexcept
+{
+    // rebuild sizes the table for twice as many cells as there can be.
+    return mSlots[probeLinear(mSlots, key, kEmpty)];
+}
+
+const SpatialHashGridComp::Grid::Slot*
+SpatialHashGridComp::Grid::find(const std::uint64_t key) const noexcept
+{
+    const auto& slot = mSlots[probeLinear(mSlots, key, kEmpty)];
+    return slot.key == key ? &slot : nullptr;
+}
+
+void SpatialHashGridComp::Grid::rebuild()
+{
+    mCellSize = mNextCellSize;
+    mInverseCellSize = 1.0f / mCellSize;
+    const auto count = mComps.size();
+    mEntries.resize(count);
+    mBounds.resize(count);
+    mKeys.resize(count);
+    mCellOfComp.resize(count);
+    mRankInCell.resize(count);
+    auto& pool = ThreadPool::get();
+
+    // First pass, in parallel: gather the bounds and find the cell of every
+    // component.
+    std::mutex reachMutex;
+    mReach = 0.0f;
+    pool.parallelFor(
+        0, count, GT_HASHGRID_REBUILD_GRAIN,
+        [&](const std::size_t first, const std::size_t last) {
+            auto reach = 0.0f;
+            for (auto i = first; i < last; ++i)
+            {
+                const auto bounds = mComps[i]->getBounds();
+                const auto center = 0.5f * (bounds.minCorner + bounds.maxCorner);
+                const auto extent = bounds.maxCorner - center;
+                reach = std::max(
+                    reach, std::max(extent.x, std::max(extent.y, extent.z)));
+                mBounds[i] = bounds;
+                mKeys[i] = cellKey(cellCoordinate(center.x),
+                                   cellCoordinate(center.y),
+                                   cellCoordinate(center.z));
+            }
+            std::lock_guard<std::mutex> lock(reachMutex);
+            mReach = std::max(mReach, reach);
+        });
+
+    // Second pass: count the components per cell, and remember the rank of
+    // every component within its cell. There are at most as many cells as
+    // components. Keep the table at most half full, so that probe sequences
+    // stay short.
+    std::size_t slotCount = 16;
+    while (slotCount < 2 * count) slotCount *= 2;
+    mSlots.assign(slotCount, Slot{kEmpty, 0});
+    mCells.clear();
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        auto& slot = findOrInsert(mKeys[i]);
+        if (slot.key == kEmpty)
+        {
+            slot.key = mKeys[i];
+            slot.cell = static_cast<std::uint32_t>(mCells.size());
+            mCells.push_back(Cell{0, 0});
+        }
+        mCellOfComp[i] = slot.cell;
+        mRankInCell[i] = mCells[slot.cell].count++;
+    }
+    std::uint32_t offset = 0;
+    for (auto& cell : mCells)
+    {
+        cell.first = offset;
+        offset += cell.count;
+    }
+
+    // Third pass, in parallel: put every component at its place. The ranks
+    // make the places unique, so no synchronization is needed, and the order
+    // within a cell does not depend on the scheduling of the tasks.
+    pool.parallelFor(0, count, GT_HASHGRID_REBUILD_GRAIN,
+                     [this](const std::size_t first, const std::size_t last) {
+                         for (auto i = first; i < last; ++i)
+                         {
+                             const auto entry =
+                                 mCells[mCellOfComp[i]].first + mRankInCell[i];
+                             mEntries[entry].bounds = mBounds[i];
+                             mEntries[entry].comp = mComps[i];
+                             mComps[i]->mEntry = entry;
+                         }
+                     });
+}
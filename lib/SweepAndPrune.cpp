@@ -0,0 +1,327 @@
+#include "SweepAndPrune.hpp"
+#include "Collider.hpp"
+#include "Foundation/hashing.hpp"
+#include <algorithm>
+#include <cassert>
+
+// The initial number of slots of the pair table. Must be a power of two.
+#define GT_SAP_INITIAL_PAIR_SLOTS 1024
+
+using namespace gintonic;
+
+namespace
+{
+
+std::uint64_t pairKey(std::uint32_t a, std::uint32_t b) noexcept
+{
+    if (b < a) std::swap(a, b);
+    return (std::uint64_t(a) << 32) | b;
+}
+
+} // anonymous namespace
+
+constexpr std::uint64_t SweepAndPrune::kEmpty;
+constexpr std::uint32_t SweepAndPrune::kNew;
+constexpr std::uint32_t SweepAndPrune::kEnded;
+
+SweepAndPrune::SweepAndPrune()
+    : mPairs(GT_SAP_INITIAL_PAIR_SLOTS, Pair{kEmpty, 0})
+{
+}
+
+SweepAndPrune::~SweepAndPrune() noexcept
+{
+    for (auto& proxy : mProxies)
+    {
+        if (proxy.collider) proxy.collider->mBroadphase = nullptr;
+    }
+}
+
+void SweepAndPrune::add(Collider* collider)
+{
+    if (collider->mBroadphase == this) return;
+    if (collider->mBroadphase) collider->mBroadphase->remove(collider);
+
+    std::uint32_t index;
+    if (mFreeProxies.empty())
+    {
+        index = static_cast<std::uint32_t>(mProxies.size());
+        mProxies.emplace_back();
+
+        // Every proxy fits, so that remove never allocates.
+        mRemovedProxies.reserve(mProxies.size());
+    }
+    else
+    {
+        index = mFreeProxies.back();
+        mFreeProxies.pop_back();
+    }
+
+    // The next update sorts the endpoints into place, and finds the
+    // overlaps of the new proxy on the way.
+    mAddedProxies.push_back(index);
+    mProxies[index].collider = collider;
+    collider->mBroadphase = this;
+    collider->mBroadphaseProxy = index;
+    ++mCount;
+}
+
+void SweepAndPrune::remove(Collider* collider) noexcept
+{
+    if (collider->mBroadphase != this) return;
+    const auto index = collider->mBroadphaseProxy;
+    mProxies[index].collider = nullptr;
+    mRemovedProxies.push_back(index);
+    collider->mBroadphase = nullptr;
+    --mCount;
+}
+
+void SweepAndPrune::eraseRemovedProxies()
+{
+    if (mRemovedProxies.empty()) return;
+    const auto removed = [this](const std::uint32_t index) {
+        return mProxies[index].collider == nullptr;
+    };
+    for (auto& endpoints : mEndpoints)
+    {
+        endpoints.erase(std::remove_if(endpoints.begin(), endpoints.end(),
+                                       [&removed](const Endpoint& endpoint) {
+                                           return removed(endpoint.proxy());
+                                       }),
+                        endpoints.end());
+    }
+    mAddedProxies.erase(std::remove_if(mAddedProxies.begin(),
+                                       mAddedProxies.end(), removed),
+                        mAddedProxies.end());
+    rehash(mPairs.size());
+    mFreeProxies.insert(mFreeProxies.end(), mRemovedProxies.begin(),
+                        mRemovedProxies.end());
+    mRemovedProxies.clear();
+}
+
+void SweepAndPrune::updateBounds() noexcept
+{
+    for (auto& proxy : mProxies)
+    {
+        if (!proxy.collider) continue;
+        const auto bounds = proxy.collider->getGlobalBounds();
+        proxy.minCorner[0] = bounds.minCorner.x;
+        proxy.minCorner[1] = bounds.minCorner.y;
+        proxy.minCorner[2] = bounds.minCorner.z;
+        proxy.maxCorner[0] = bounds.maxCorner.x;
+        proxy.maxCorner[1] = bounds.maxCorner.y;
+        proxy.maxCorner[2] = bounds.maxCorner.z;
+    }
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        for (auto& endpoint : mEndpoints[axis])
+        {
+            const auto& proxy = mProxies[endpoint.proxy()];
+            endpoint.value = endpoint.isMax() ? proxy.maxCorner[axis]
+                                              : proxy.minCorner[axis];
+        }
+    }
+}
+
+void SweepAndPrune::sortAxis(const int axis)
+{
+    auto& endpoints = mEndpoints[axis];
+    for (std::size_t i = 1; i < endpoints.size(); ++i)
+    {
+        const auto key = endpoints[i];
+        auto j = i;
+        for (; j > 0 && key < endpoints[j - 1]; --j)
+        {
+            const auto& other = endpoints[j - 1];
+            if (!key.isMax() && other.isMax())
+            {
+                // A minimum moves below a maximum: the proxies may start to
+                // overlap, if they overlap along the other axes, too.
+                GT_SPATIAL_COUNT(boxesTested, 1);
+                if (overlaps(key.proxy(), other.proxy()))
+                {
+                    addPair(key.proxy(), other.proxy());
+                }
+            }
+            else if (key.isMax() && !other.isMax())
+            {
+                // A maximum moves below a minimum: the proxies stop
+                // overlapping.
+                removePair(key.proxy(), other.proxy());
+            }
+            endpoints[j] = other;
+        }
+        endpoints[j] = key;
+    }
+}
+
+void SweepAndPrune::insertAddedProxies()
+{
+    if (mAddedProxies.empty()) return;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        mAddedEndpoints.clear();
+        for (const auto index : mAddedProxies)
+        {
+            const auto& proxy = mProxies[index];
+            mAddedEndpoints.push_back(
+                Endpoint{proxy.minCorner[axis], index << 1});
+            mAddedEndpoints.push_back(
+                Endpoint{proxy.maxCorner[axis], (index << 1) | 1});
+        }
+        std::sort(mAddedEndpoints.begin(), mAddedEndpoints.end());
+
+        // Merge by hand, so that the sweep along the first axis knows which
+        // endpoints are new. A new proxy may overlap any proxy. An old
+        // proxy may only overlap new ones, since sortAxis found the pairs
+        // of old proxies.
+        auto& endpoints = mEndpoints[axis];
+        mMergedEndpoints.clear();
+        mMergedEndpoints.reserve(endpoints.size() + mAddedEndpoints.size());
+        std::size_t i = 0;
+        std::size_t j = 0;
+        while (i < endpoints.size() || j < mAddedEndpoints.size())
+        {
+            const bool added =
+                j < mAddedEndpoints.size() &&
+                (i == endpoints.size() || mAddedEndpoints[j] < endpoints[i]);
+            const auto endpoint = added ? mAddedEndpoints[j++] : endpoints[i++];
+            mMergedEndpoints.push_back(endpoint);
+            if (axis != 0 || endpoint.isMax()) continue;
+            const auto index = endpoint.proxy();
+            if (added)
+            {
+                sweep(index, mActive);
+                mActiveAdded.push_back(index);
+            }
+            else
+            {
+                sweep(index, mActiveAdded);
+            }
+            mActive.push_back(index);
+        }
+        endpoints.swap(mMergedEndpoints);
+    }
+    mActive.clear();
+    mActiveAdded.clear();
+    mAddedProxies.clear();
+}
+
+void SweepAndPrune::sweep(const std::uint32_t proxy,
+                          std::vector<std::uint32_t>& active)
+{
+    // Proxies that end before this one starts along the first axis end
+    // before every later one starts, too. Drop them on the way.
+    const auto start = mProxies[proxy].minCorner[0];
+    for (std::size_t k = 0; k < active.size();)
+    {
+        const auto other = active[k];
+        if (mProxies[other].maxCorner[0] < start)
+        {
+            active[k] = active.back();
+            active.pop_back();
+            continue;
+        }
+        GT_SPATIAL_COUNT(boxesTested, 1);
+        if (overlaps(proxy, other)) addPair(proxy, other);
+        ++k;
+    }
+}
+
+bool SweepAndPrune::overlaps(const std::uint32_t a, const std::uint32_t b) const
+    noexcept
+{
+    const auto& p = mProxies[a];
+    const auto& q = mProxies[b];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        if (p.maxCorner[axis] < q.minCorner[axis] ||
+            q.maxCorner[axis] < p.minCorner[axis])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::size_t SweepAndPrune::slot(const std::uint64_t key) const noexcept
+{
+    // addPair grows the table before it gets more than half full.
+    return probeLinear(mPairs, key, kEmpty);
+}
+
+void SweepAndPrune::addPair(const std::uint32_t a, const std::uint32_t b)
+{
+    const auto key = pairKey(a, b);
+    auto index = slot(key);
+    if (mPairs[index].key == key)
+    {
+        // The pair stopped overlapping earlier during this update, but now
+        // it overlaps again.
+        mPairs[index].state &= ~kEnded;
+        return;
+    }
+    if (2 * (mPairCount + 1) > mPairs.size())
+    {
+        rehash(2 * mPairs.size());
+        index = slot(key);
+    }
+    mPairs[index] = Pair{key, kNew};
+    ++mPairCount;
+}
+
+void SweepAndPrune::removePair(const std::uint32_t a,
+                               const std::uint32_t b) noexcept
+{
+    const auto index = slot(pairKey(a, b));
+    auto& pair = mPairs[index];
+    if (pair.key == kEmpty) return;
+
+    // A pair that was never reported can go right away.
+    if (pair.state & kNew) erasePair(index);
+    else pair.state |= kEnded;
+}
+
+void SweepAndPrune::erasePair(std::size_t index) noexcept
+{
+    // Backward shift deletion: move later entries of the probe sequence into
+    // the hole, so that lookups never need tombstones.
+    const auto mask = mPairs.size() - 1;
+    auto next = index;
+    for (;;)
+    {
+        next = (next + 1) & mask;
+        if (mPairs[next].key == kEmpty) break;
+        const auto home =
+            static_cast<std::size_t>(hashKey64(mPairs[next].key)) & mask;
+
+        // Move the entry if its home slot is not in the cyclic range
+        // (index, next].
+        const auto inRange =
+            index <= next ? (index < home && home <= next)
+                          : (index < home || home <= next);
+        if (inRange) continue;
+        mPairs[index] = mPairs[next];
+        index = next;
+    }
+    mPairs[index].key = kEmpty;
+    --mPairCount;
+}
+
+void SweepAndPrune::rehash(const std::size_t slots)
+{
+    // The pairs of removed proxies are dropped on the way.
+    std::vector<Pair> pairs(slots, Pair{kEmpty, 0});
+    pairs.swap(mPairs);
+    mPairCount = 0;
+    for (const auto& pair : pairs)
+    {
+        if (pair.key == kEmpty || !mProxies[pair.key >> 32].collider ||
+            !mProxies[pair.key & 0xffffffff].collider)
+        {
+            continue;
+        }
+        mPairs[slot(pair.key)] = pair;
+        ++mPairCount;
+    }
+}
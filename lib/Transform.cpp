@@ -1,8 +1,27 @@
 #include "Transform.hpp"
+#include "Casting.hpp"
 #include "Entity.hpp"
 
 using namespace gintonic;
 
+TransformHierarchy& Transform::getHierarchy()
+{
+    // Constructed by the first Transform, so that it outlives all of them.
+    static TransformHierarchy hierarchy;
+    return hierarchy;
+}
+
+void Transform::updateGlobalTransforms() { getHierarchy().update(); }
+
+Transform::Transform(EntityBase* entity)
+    : Component(Kind::Transform, entity),
+      mIndex(getHierarchy().create())
+{
+    attachToParent();
+}
+
+Transform::~Transform() noexcept { getHierarchy().destroy(mIndex); }
+
 std::unique_ptr<Component> Transform::clone(EntityBase* newOwner) const
 {
     auto transform = std::make_unique<Transform>(newOwner);
@@ -10,40 +29,62 @@ std::unique_ptr<Component> Transform::clone(EntityBase* newOwner) const
     return std::move(transform);
 }
 
-void Transform::onParentChange() { mIsUpdated = false; }
+void Transform::onParentChange() { attachToParent(); }
 
-const SQT& Transform::local() const noexcept { return mLocal; }
+void Transform::attachToParent() noexcept
+{
+    auto parent = TransformHierarchy::kNone;
+    if (const auto entity = dynCast<experimental::Entity>(mEntityBase))
+    {
+        if (const auto parentEntity = entity->getParent())
+        {
+            if (const auto parentTransform = parentEntity->get<Transform>())
+            {
+                parent = parentTransform->mIndex;
+            }
+        }
+    }
+    auto& hierarchy = getHierarchy();
+    if (hierarchy.getParent(mIndex) != parent)
+    {
+        hierarchy.setParent(mIndex, parent);
+    }
+}
 
-SQT& Transform::local() noexcept
+const SQT& Transform::local() const noexcept
 {
-    mIsUpdated = false;
-    return mLocal;
+    return getHierarchy().getLocal(mIndex);
 }
 
+SQT& Transform::local() noexcept { return getHierarchy().local(mIndex); }
+
 const mat4f& Transform::global() const noexcept
 {
-    updateImpl();
-    return mGlobalMatrix;
+    return getHierarchy().getWorld(mIndex);
+}
+
+std::uint32_t Transform::getGlobalVersion() const noexcept
+{
+    return getHierarchy().getVersion(mIndex);
 }
 
 const vec3f& Transform::getGlobalPosition() const noexcept
 {
-    updateImpl();
+    decompose();
     return mGlobal.translation;
 }
 
 const quatf& Transform::getGlobalRotation() const noexcept
 {
-    updateImpl();
+    decompose();
     return mGlobal.rotation;
 }
 
 const vec3f& Transform::getGlobalScale() const noexcept
 {
-    updateImpl();
+    decompose();
     return mGlobal.scale;
 }
-
 void Transform::setGlobalPosition(const vec3f& position) noexcept
 {
     // TODO!!! INCORRECT!
@@ -68,29 +109,11 @@ void Transform::setGlobalScale(const vec3f& scale) noexcept
     local().scale = sqt.scale;
 }
 
-void Transform::updateImpl() const noexcept
+void Transform::decompose() const noexcept
 {
-    if (mIsUpdated)
-    {
-        return;
-    }
-    else if (auto ptr = getEntity().getParent())
-    {
-        if (const auto parentTransform = ptr->get<Transform>())
-        {
-            mGlobalMatrix = parentTransform->global() * mat4f(mLocal);
-        }
-        else
-        {
-            mGlobalMatrix = mat4f(mLocal);
-        }
-    }
-    else
-    {
-        mGlobalMatrix = mat4f(mLocal);
-    }
-    mGlobalMatrix.decompose(mGlobal);
-    mIsUpdated = true;
+    const auto version = getGlobalVersion();
+    if (mIsDecomposed && mGlobalVersion == version) return;
+    global().decompose(mGlobal);
+    mGlobalVersion = version;
+    mIsDecomposed = true;
 }
-
-void Transform::update() { updateImpl(); }
@@ -48,6 +48,7 @@
 #cmakedefine gintonic_ENABLE_DEBUG_TRACE
 #cmakedefine gintonic_WITH_PROFILING
 #cmakedefine gintonic_WITH_MEMORY_PROFILING
+#cmakedefine gintonic_WITH_SPATIAL_STATISTICS
 #cmakedefine gintonic_HIDE_CONSOLE
 #cmakedefine gintonic_REDIRECT_OUTPUT_WHEN_HIDDEN_CONSOLE
 
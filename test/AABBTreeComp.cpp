@@ -0,0 +1,149 @@
+#define BOOST_TEST_MODULE AABBTreeComp test
+#include <boost/test/unit_test.hpp>
+
+#include "AABBTreeComp.hpp"
+#include "BoxCollider.hpp"
+#include "Entity.hpp"
+#include "Math/mat4f.hpp"
+#include "OctreeComp.hpp"
+#include "Transform.hpp"
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+using namespace gintonic;
+
+namespace
+{
+
+// An entity that is in both spatial indices.
+struct Box
+{
+    std::unique_ptr<experimental::Entity> entity;
+    Transform* transform;
+    OctreeComp* octree;
+    AABBTreeComp* bvh;
+
+    Box(OctreeComp::Node& root, AABBTreeComp::Tree& tree,
+        const vec3f& position, const float size)
+        : entity(new experimental::Entity())
+    {
+        auto collider = entity->add<BoxCollider>();
+        collider->localOffset = vec3f(0.0f, 0.0f, 0.0f);
+        collider->localBounds =
+            box3f(vec3f(-size, -size, -size), vec3f(size, size, size));
+        transform = entity->get<Transform>();
+        transform->local().translation = position;
+        octree = entity->add<OctreeComp>();
+        octree->setNode(root);
+        bvh = entity->add<AABBTreeComp>();
+        bvh->setTree(tree);
+    }
+};
+
+template <class Volume>
+void checkSameResults(OctreeComp::Node& root, AABBTreeComp::Tree& tree,
+                      const Volume& volume)
+{
+    std::vector<const EntityBase*> expected, result;
+    root.query(volume, [&](OctreeComp* comp) {
+        expected.push_back(&comp->getEntity());
+    });
+    tree.query(volume, [&](AABBTreeComp* comp) {
+        result.push_back(&comp->getEntity());
+    });
+    std::sort(expected.begin(), expected.end());
+    std::sort(result.begin(), result.end());
+    BOOST_CHECK(result == expected);
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(same_results_as_octree)
+{
+    OctreeComp::Node root(vec3f(-256.0f, -256.0f, -256.0f),
+                          vec3f(256.0f, 256.0f, 256.0f));
+    AABBTreeComp::Tree tree;
+    std::mt19937 generator(7);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> size(0.1f, 8.0f);
+    std::vector<std::unique_ptr<Box>> boxes;
+    for (int i = 0; i < 1000; ++i)
+    {
+        const vec3f p(position(generator), position(generator),
+                      position(generator));
+        boxes.emplace_back(new Box(root, tree, p, size(generator)));
+    }
+    BOOST_CHECK_EQUAL(tree.count(), boxes.size());
+
+    // The rotations keep the tree balanced.
+    BOOST_CHECK(tree.height() <= 2 * std::log2(boxes.size()) + 2);
+    const auto stats = tree.statistics();
+    BOOST_CHECK_EQUAL(stats.leafCount, boxes.size());
+    BOOST_CHECK_EQUAL(stats.nodeCount, 2 * boxes.size() - 1);
+    BOOST_CHECK_EQUAL(stats.nodesPerDepth.size(), tree.height());
+
+    const box3f small(vec3f(-20.0f, -20.0f, -20.0f),
+                      vec3f(20.0f, 20.0f, 20.0f));
+    const box3f large(vec3f(-150.0f, -50.0f, -150.0f),
+                      vec3f(150.0f, 50.0f, 150.0f));
+    checkSameResults(root, tree, small);
+    checkSameResults(root, tree, large);
+
+    mat4f projection;
+    projection.set_perspective(deg2rad(60.0f), 1.0f, 1.0f, 150.0f);
+    const frustum view(projection);
+    checkSameResults(root, tree, view);
+
+    // Move half of the entities and remove a quarter of them.
+    for (std::size_t i = 0; i < boxes.size(); i += 2)
+    {
+        boxes[i]->transform->local().translation =
+            vec3f(position(generator), position(generator),
+                  position(generator));
+        boxes[i]->entity->update();
+    }
+    for (std::size_t i = 1; i < boxes.size(); i += 4) boxes[i].reset();
+    BOOST_CHECK_EQUAL(tree.count(), 750);
+    BOOST_CHECK(tree.height() <= 2 * std::log2(tree.count()) + 2);
+    checkSameResults(root, tree, small);
+    checkSameResults(root, tree, large);
+    checkSameResults(root, tree, view);
+}
+
+BOOST_AUTO_TEST_CASE(fat_bounds)
+{
+    OctreeComp::Node root(vec3f(-64.0f, -64.0f, -64.0f),
+                          vec3f(64.0f, 64.0f, 64.0f));
+    AABBTreeComp::Tree tree;
+    Box box(root, tree, vec3f(1.0f, 2.0f, 3.0f), 1.0f);
+    const auto fat = box.bvh->getFatBounds();
+    const auto bounds = box.entity->get<BoxCollider>()->getGlobalBounds();
+    BOOST_CHECK(fat.contains(bounds));
+    BOOST_CHECK_EQUAL(tree.height(), 1);
+
+    // Small movements keep the fat bounds.
+    box.transform->local().translation = vec3f(1.1f, 2.0f, 3.0f);
+    box.entity->update();
+    BOOST_CHECK(box.bvh->getFatBounds().minCorner == fat.minCorner);
+
+    box.transform->local().translation = vec3f(10.0f, 2.0f, 3.0f);
+    box.entity->update();
+    BOOST_CHECK(!(box.bvh->getFatBounds().minCorner == fat.minCorner));
+    BOOST_CHECK(box.bvh->getFatBounds().contains(
+        box.entity->get<BoxCollider>()->getGlobalBounds()));
+}
+
+BOOST_AUTO_TEST_CASE(tree_destroyed_before_components)
+{
+    OctreeComp::Node root(vec3f(-64.0f, -64.0f, -64.0f),
+                          vec3f(64.0f, 64.0f, 64.0f));
+    std::unique_ptr<Box> box;
+    {
+        AABBTreeComp::Tree tree;
+        box.reset(new Box(root, tree, vec3f(0.0f, 0.0f, 0.0f), 1.0f));
+    }
+    // The tree is gone, so the component must not touch it anymore.
+    BOOST_CHECK(box->bvh->getTree() == nullptr);
+    box->entity->update();
+}
@@ -0,0 +1,98 @@
+#define BOOST_TEST_MODULE BoxCollider test
+#include <boost/test/unit_test.hpp>
+
+#include "BoxCollider.hpp"
+#include "Entity.hpp"
+#include "Transform.hpp"
+
+using namespace gintonic;
+
+namespace
+{
+
+void checkSame(const box3f& a, const box3f& b)
+{
+    BOOST_CHECK_SMALL(a.minCorner.x - b.minCorner.x, 1e-4f);
+    BOOST_CHECK_SMALL(a.minCorner.y - b.minCorner.y, 1e-4f);
+    BOOST_CHECK_SMALL(a.minCorner.z - b.minCorner.z, 1e-4f);
+    BOOST_CHECK_SMALL(a.maxCorner.x - b.maxCorner.x, 1e-4f);
+    BOOST_CHECK_SMALL(a.maxCorner.y - b.maxCorner.y, 1e-4f);
+    BOOST_CHECK_SMALL(a.maxCorner.z - b.maxCorner.z, 1e-4f);
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(global_bounds)
+{
+    experimental::Entity entity;
+    auto collider = entity.add<BoxCollider>();
+    collider->localBounds =
+        box3f(vec3f(-1.0f, -2.0f, -3.0f), vec3f(1.0f, 2.0f, 3.0f));
+    collider->localOffset = vec3f(1.0f, 0.0f, 0.0f);
+    auto transform = entity.get<Transform>();
+    transform->local().translation = vec3f(10.0f, 0.0f, 0.0f);
+    transform->local().scale = vec3f(2.0f, 2.0f, 2.0f);
+
+    // The offset is scaled along with the bounds.
+    checkSame(collider->getGlobalBounds(),
+              box3f(vec3f(10.0f, -4.0f, -6.0f), vec3f(14.0f, 4.0f, 6.0f)));
+
+    // A quarter turn around the Z axis swaps the extents along X and Y.
+    transform->local().scale = vec3f(1.0f, 1.0f, 1.0f);
+    transform->local().rotation =
+        quatf::axis_angle(vec3f(0.0f, 0.0f, 1.0f), 0.5f * 3.14159265f);
+    checkSame(collider->getGlobalBounds(),
+              box3f(vec3f(8.0f, 0.0f, -3.0f), vec3f(12.0f, 2.0f, 3.0f)));
+}
+
+BOOST_AUTO_TEST_CASE(cached_global_bounds)
+{
+    std::vector<std::unique_ptr<experimental::Entity>> entities;
+    std::vector<BoxCollider*> colliders;
+    for (int i = 0; i < 7; ++i)
+    {
+        const auto f = static_cast<float>(i);
+        entities.emplace_back(new experimental::Entity());
+        auto collider = entities.back()->add<BoxCollider>();
+        collider->localBounds =
+            box3f(vec3f(-f, -1.0f, -1.0f), vec3f(f, 1.0f, 1.0f));
+        auto transform = entities.back()->get<Transform>();
+        transform->local().translation = vec3f(f, 2.0f * f, 0.0f);
+        transform->local().rotation =
+            quatf::axis_angle(vec3f(0.0f, 1.0f, 0.0f), f);
+        colliders.push_back(collider);
+    }
+    std::vector<box3f> expected;
+    for (auto* collider : colliders)
+    {
+        expected.push_back(collider->getGlobalBounds());
+    }
+
+    BoxCollider::updateGlobalBounds();
+    for (std::size_t i = 0; i < colliders.size(); ++i)
+    {
+        checkSame(colliders[i]->getGlobalBounds(), expected[i]);
+    }
+
+    // Moving a collider bypasses its stale cache entry.
+    entities[3]->get<Transform>()->local().translation =
+        vec3f(100.0f, 0.0f, 0.0f);
+    BOOST_CHECK(colliders[3]->getGlobalBounds().minCorner.x > 90.0f);
+
+    // So does changing the local bounds or the local offset.
+    colliders[5]->localBounds =
+        box3f(vec3f(-1.0f, -1.0f, -1.0f), vec3f(1.0f, 1.0f, 1.0f));
+    colliders[5]->localOffset = vec3f(0.0f, 50.0f, 0.0f);
+    const auto moved = colliders[5]->getGlobalBounds();
+    BOOST_CHECK(moved.minCorner.y > 55.0f);
+    BoxCollider::updateGlobalBounds();
+    checkSame(colliders[5]->getGlobalBounds(), moved);
+    expected[5] = moved;
+
+    // Destroying a collider moves another one into its cache slot.
+    entities[1].reset();
+    for (std::size_t i = 4; i < colliders.size(); ++i)
+    {
+        checkSame(colliders[i]->getGlobalBounds(), expected[i]);
+    }
+}
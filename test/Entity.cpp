@@ -2,6 +2,8 @@
 #include <boost/test/unit_test.hpp>
 
 #include "Entity.hpp"
+#include "BoxCollider.hpp"
+#include "OctreeComp.hpp"
 #include "Transform.hpp"
 
 using namespace gintonic;
@@ -32,3 +34,276 @@ BOOST_AUTO_TEST_CASE(exp_entity)
     auto comp = ent.add<Transform>();
     BOOST_CHECK(comp == ent.get<Transform>());
 }
+
+BOOST_AUTO_TEST_CASE(exp_entity_component_slots)
+{
+    experimental::Entity ent;
+    BOOST_CHECK(!ent.has<Transform>());
+    BOOST_CHECK(ent.get<Collider>() == nullptr);
+
+    // A BoxCollider adds a Transform of its own.
+    const auto box = ent.add<BoxCollider>();
+    const auto& constEnt = ent;
+    BOOST_CHECK(ent.has<Transform>());
+    BOOST_CHECK(ent.has<Collider>());
+    BOOST_CHECK(!ent.has<OctreeComp>());
+    BOOST_CHECK(ent.get<BoxCollider>() == box);
+    BOOST_CHECK(ent.get<Collider>() == box);
+    BOOST_CHECK(constEnt.get<Collider>() == box);
+
+    // The first Transform wins, and the next one takes over its slot.
+    const auto first = ent.get<Transform>();
+    const auto second = ent.add<Transform>();
+    BOOST_CHECK(ent.get<Transform>() == first);
+    BOOST_CHECK(ent.remove<Transform>());
+    BOOST_CHECK(ent.get<Transform>() == second);
+
+    BOOST_CHECK(ent.remove<Collider>());
+    BOOST_CHECK(!ent.has<BoxCollider>());
+    BOOST_CHECK(!ent.remove<Collider>());
+    BOOST_CHECK(ent.get<Transform>() == second);
+}
+
+BOOST_AUTO_TEST_CASE(lazy_global_transform)
+{
+    auto lRoot = Entity::create("root");
+    auto lChild = Entity::create("child");
+    auto lGrandChild = Entity::create("grandchild");
+    lRoot->addChild(lChild);
+    lChild->addChild(lGrandChild);
+    lChild->setTranslation(vec3f(0.0f, 1.0f, 0.0f));
+    lGrandChild->setTranslation(vec3f(0.0f, 0.0f, 1.0f));
+
+    // Moving the root several times only costs one update of the children.
+    lRoot->setTranslation(vec3f(1.0f, 0.0f, 0.0f));
+    lRoot->moveForward(2.0f);
+    lRoot->setScale(vec3f(2.0f, 2.0f, 2.0f));
+
+    const auto lExpected = mat4f(lRoot->localTransform()) *
+                           mat4f(lChild->localTransform()) *
+                           mat4f(lGrandChild->localTransform());
+    for (int i = 0; i < 4; ++i)
+    {
+        BOOST_CHECK(vec4f(lGrandChild->globalTransform().data[i]) ==
+                    vec4f(lExpected.data[i]));
+    }
+    BOOST_CHECK(vec3f(lGrandChild->globalTransform().data[3]) ==
+                vec3f(1.0f, 2.0f, 0.0f));
+
+    // A full pass gives the same transforms.
+    lRoot->setTranslation(vec3f(-3.0f, 0.0f, 0.0f));
+    lRoot->updateGlobalTransforms();
+    BOOST_CHECK(vec3f(lChild->globalTransform().data[3]) ==
+                vec3f(-3.0f, 2.0f, 0.0f));
+    BOOST_CHECK(vec3f(lGrandChild->globalTransform().data[3]) ==
+                vec3f(-3.0f, 2.0f, 2.0f));
+
+    // A child that loses its parent has its local transform as global
+    // transform.
+    lChild->unsetParent();
+    BOOST_CHECK(vec3f(lChild->globalTransform().data[3]) ==
+                vec3f(0.0f, 1.0f, 0.0f));
+    BOOST_CHECK(vec3f(lGrandChild->globalTransform().data[3]) ==
+                vec3f(0.0f, 1.0f, 1.0f));
+}
+
+BOOST_AUTO_TEST_CASE(children_keep_their_place_when_the_parent_dies)
+{
+    auto lRoot = Entity::create("root");
+    auto lChild = Entity::create("child");
+    lRoot->addChild(lChild);
+    lChild->setTranslation(vec3f(0.0f, 1.0f, 0.0f));
+    lRoot->setTranslation(vec3f(5.0f, 0.0f, 0.0f));
+    lRoot.reset();
+    BOOST_CHECK(lChild->parent().expired());
+    const vec3f lPosition(lChild->globalTransform().data[3]);
+    BOOST_CHECK_CLOSE(lPosition.x, 5.0f, 0.001f);
+    BOOST_CHECK_CLOSE(lPosition.y, 1.0f, 0.001f);
+}
+
+BOOST_AUTO_TEST_CASE(deferred_transform_notification)
+{
+    std::vector<Entity::SharedPtr> lEntities;
+    for (int i = 0; i < 4; ++i) lEntities.push_back(Entity::create());
+    int lSingleEvents = 0;
+    std::vector<Entity::SharedPtr> lBatch;
+    int lBatches = 0;
+    lEntities[0]->onTransformChange.connect(
+        [&lSingleEvents](Entity::SharedPtr) { ++lSingleEvents; });
+    auto lConnection = Entity::onTransformChangeBatch.connect(
+        [&](const Entity::SharedPtr* first, const Entity::SharedPtr* last) {
+            lBatch.assign(first, last);
+            ++lBatches;
+        });
+
+    Entity::setTransformNotification(Entity::TransformNotification::Deferred);
+    BOOST_CHECK(Entity::getTransformNotification() ==
+                Entity::TransformNotification::Deferred);
+
+    // Every Entity is reported once, however often it moves.
+    for (int i = 0; i < 3; ++i)
+    {
+        lEntities[0]->moveForward(1.0f);
+        lEntities[1]->setTranslationX(float(i));
+    }
+    lEntities[2]->setScale(vec3f(2.0f, 2.0f, 2.0f));
+    BOOST_CHECK_EQUAL(lSingleEvents, 0);
+    Entity::flushTransformChanges();
+    BOOST_CHECK_EQUAL(lSingleEvents, 1);
+    BOOST_CHECK_EQUAL(lBatches, 1);
+    BOOST_REQUIRE_EQUAL(lBatch.size(), 3);
+    BOOST_CHECK(lBatch[0] == lEntities[0]);
+    BOOST_CHECK(lBatch[1] == lEntities[1]);
+    BOOST_CHECK(lBatch[2] == lEntities[2]);
+
+    // Nothing changed, so nothing fires.
+    Entity::flushTransformChanges();
+    BOOST_CHECK_EQUAL(lBatches, 1);
+
+    // Entities that die before the flush are not reported.
+    lEntities[3]->moveUp(1.0f);
+    lEntities[1]->moveUp(1.0f);
+    lEntities[3].reset();
+    Entity::flushTransformChanges();
+    BOOST_REQUIRE_EQUAL(lBatch.size(), 1);
+    BOOST_CHECK(lBatch[0] == lEntities[1]);
+
+    Entity::setTransformNotification(Entity::TransformNotification::Immediate);
+    lEntities[0]->moveForward(1.0f);
+    BOOST_CHECK_EQUAL(lSingleEvents, 2);
+    BOOST_CHECK_EQUAL(lBatches, 2);
+    lConnection.disconnect();
+}
+
+BOOST_AUTO_TEST_CASE(handles)
+{
+    BOOST_CHECK(Entity::fromHandle(EntityHandle()) == nullptr);
+
+    auto lEntity = Entity::create("entity");
+    const auto lHandle = lEntity->getHandle();
+    BOOST_CHECK(lHandle);
+    BOOST_CHECK(Entity::fromHandle(lHandle) == lEntity.get());
+
+    // Copies get a handle of their own.
+    auto lClone = lEntity->cloneRecursive();
+    BOOST_CHECK(lClone->getHandle() != lHandle);
+    BOOST_CHECK(Entity::fromHandle(lClone->getHandle()) == lClone.get());
+
+    // A dead Entity no longer resolves, and its slot is not handed out
+    // again right away.
+    const auto lCount = Entity::count();
+    lEntity.reset();
+    BOOST_CHECK_EQUAL(Entity::count(), lCount - 1);
+    BOOST_CHECK(Entity::fromHandle(lHandle) == nullptr);
+    auto lNewEntity = Entity::create("new entity");
+    BOOST_CHECK(lNewEntity->getHandle().index() != lHandle.index());
+    BOOST_CHECK(Entity::fromHandle(lHandle) == nullptr);
+    BOOST_CHECK(Entity::fromHandle(lNewEntity->getHandle()) == lNewEntity.get());
+}
+
+BOOST_AUTO_TEST_CASE(handles_never_wrap_around)
+{
+    // Spawn and kill one Entity at a time, for long enough that every slot
+    // that is handed out runs out of generations.
+    const auto lCount = Entity::count();
+    auto lEntity = Entity::create("first");
+    const auto lFirst = lEntity->getHandle();
+    auto lReused = false;
+    for (std::uint32_t i = 0; i < 1100 * EntityHandle::kMaxGeneration; ++i)
+    {
+        lEntity = Entity::create("entity");
+        BOOST_REQUIRE(Entity::fromHandle(lFirst) == nullptr);
+        lReused = lReused || lEntity->getHandle().index() == lFirst.index();
+    }
+    BOOST_CHECK(lReused);
+    BOOST_CHECK(Entity::fromHandle(lEntity->getHandle()) == lEntity.get());
+    BOOST_CHECK_EQUAL(Entity::count(), lCount + 1);
+}
+
+BOOST_AUTO_TEST_CASE(raw_parent_pointers)
+{
+    auto lParent = Entity::create("parent");
+    auto lChild = Entity::create("child");
+    lParent->addChild(lChild);
+    BOOST_CHECK(lChild->getParent() == lParent.get());
+    BOOST_CHECK(lChild->parent().lock() == lParent);
+
+    lChild->unsetParent();
+    BOOST_CHECK(lChild->getParent() == nullptr);
+    BOOST_CHECK(lChild->parent().expired());
+
+    lChild->setParent(lParent);
+    lParent.reset();
+    BOOST_CHECK(lChild->getParent() == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(bulk_clone)
+{
+    // A prototype that has a parent itself, which the copies do not get.
+    auto lWorld = Entity::create("world");
+    auto lPrototype = Entity::create("prototype");
+    lWorld->addChild(lPrototype);
+    lWorld->setTranslation(vec3f(100.0f, 0.0f, 0.0f));
+    lPrototype->setTranslation(vec3f(1.0f, 0.0f, 0.0f));
+    for (int i = 0; i < 3; ++i)
+    {
+        auto lChild = Entity::create("child" + std::to_string(i));
+        lChild->setTranslation(vec3f(0.0f, float(i), 0.0f));
+        lChild->castShadow = i == 1;
+        lPrototype->addChild(lChild);
+        auto lGrandChild = Entity::create("grandchild");
+        lGrandChild->setTranslation(vec3f(0.0f, 0.0f, 1.0f));
+        lChild->addChild(lGrandChild);
+    }
+
+    const auto lCount = Entity::count();
+    const auto lCopies = lPrototype->cloneRecursive(50);
+    BOOST_REQUIRE_EQUAL(lCopies.size(), 50);
+    BOOST_CHECK_EQUAL(Entity::count(), lCount + 50 * 7);
+
+    for (const auto& lCopy : lCopies)
+    {
+        BOOST_CHECK(lCopy->getParent() == nullptr);
+        BOOST_CHECK(lCopy->getHandle() != lPrototype->getHandle());
+        BOOST_CHECK(vec3f(lCopy->globalTransform().data[3]) ==
+                    vec3f(1.0f, 0.0f, 0.0f));
+
+        // The children are in the same order as in the prototype.
+        auto lOriginal = lPrototype->begin();
+        for (const auto& lChild : *lCopy)
+        {
+            BOOST_REQUIRE(lOriginal != lPrototype->end());
+            BOOST_CHECK(lChild->getParent() == lCopy.get());
+            BOOST_CHECK_EQUAL(lChild->name, (*lOriginal)->name);
+            BOOST_CHECK_EQUAL(lChild->castShadow, (*lOriginal)->castShadow);
+            const auto& lGrandChild = *lChild->begin();
+            BOOST_CHECK(lGrandChild->getParent() == lChild.get());
+            BOOST_CHECK(vec3f(lGrandChild->globalTransform().data[3]) ==
+                        vec3f(1.0f, lChild->localTransform().translation.y,
+                              1.0f));
+            ++lOriginal;
+        }
+        BOOST_CHECK(lOriginal == lPrototype->end());
+    }
+
+    // A single copy has its children in the same order, too.
+    const auto lSingle = lPrototype->cloneRecursive();
+    auto lBulkChild = lCopies[0]->begin();
+    for (const auto& lChild : *lSingle)
+    {
+        BOOST_REQUIRE(lBulkChild != lCopies[0]->end());
+        BOOST_CHECK_EQUAL(lChild->name, (*lBulkChild)->name);
+        ++lBulkChild;
+    }
+    BOOST_CHECK(lBulkChild == lCopies[0]->end());
+
+    // The copies are independent of each other.
+    lCopies[0]->setTranslation(vec3f(5.0f, 0.0f, 0.0f));
+    const auto lY = (*lPrototype->begin())->localTransform().translation.y;
+    const auto& lMoved = *(*lCopies[0]->begin())->begin();
+    const auto& lUnmoved = *(*lCopies[1]->begin())->begin();
+    BOOST_CHECK(vec3f(lMoved->globalTransform().data[3]) ==
+                vec3f(5.0f, lY, 1.0f));
+    BOOST_CHECK(vec3f(lUnmoved->globalTransform().data[3]) ==
+                vec3f(1.0f, lY, 1.0f));
+}
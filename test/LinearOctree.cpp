@@ -0,0 +1,171 @@
+#define BOOST_TEST_MODULE LinearOctree test
+#include <boost/test/unit_test.hpp>
+
+#include "Entity.hpp"
+#include "Foundation/LinearOctree.hpp"
+#include <algorithm>
+#include <random>
+#include <set>
+#include <vector>
+
+using namespace gintonic;
+
+namespace {
+
+std::set<Entity*> bruteForce(
+	const std::vector<Entity::SharedPtr>& entities,
+	const box3f& volume)
+{
+	std::set<Entity*> lResult;
+	for (const auto& lEntity : entities)
+	{
+		if (intersects(volume, lEntity->globalBoundingBox()))
+		{
+			lResult.insert(lEntity.get());
+		}
+	}
+	return lResult;
+}
+
+std::set<Entity*> query(LinearOctree& tree, const box3f& volume)
+{
+	std::vector<Entity::SharedPtr> lResult;
+	tree.query(volume, std::back_inserter(lResult));
+	std::set<Entity*> lSet;
+	for (const auto& lEntity : lResult) lSet.insert(lEntity.get());
+	BOOST_CHECK_EQUAL(lSet.size(), lResult.size());
+	return lSet;
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE( morton_codes )
+{
+	std::uint32_t x, y, z;
+	mortonDecode(mortonEncode(1234, 56789, 2097151), x, y, z);
+	BOOST_CHECK_EQUAL(x, 1234);
+	BOOST_CHECK_EQUAL(y, 56789);
+	BOOST_CHECK_EQUAL(z, 2097151);
+	BOOST_CHECK_EQUAL(mortonEncode(1, 0, 0), 1);
+	BOOST_CHECK_EQUAL(mortonEncode(0, 1, 0), 2);
+	BOOST_CHECK_EQUAL(mortonEncode(0, 0, 1), 4);
+	BOOST_CHECK_EQUAL(locationCodeDepth(1), 0);
+	BOOST_CHECK_EQUAL(locationCodeDepth(0xf), 1);
+	BOOST_CHECK(locationCodeIsAncestor(1, 0xf));
+	BOOST_CHECK(locationCodeIsAncestor(0xf, (0xf << 3) | 5));
+	BOOST_CHECK(!locationCodeIsAncestor(0xe, (0xf << 3) | 5));
+}
+
+BOOST_AUTO_TEST_CASE( query_matches_brute_force )
+{
+	std::mt19937 lGenerator(42);
+	std::uniform_real_distribution<float> lDist(-127.0f, 127.0f);
+
+	LinearOctree lTree(vec3f(-128.0f), vec3f(128.0f));
+	std::vector<Entity::SharedPtr> lEntities;
+	for (int i = 0; i < 1000; ++i)
+	{
+		auto lEntity = Entity::create();
+		lEntity->setTranslation(vec3f(lDist(lGenerator), lDist(lGenerator), lDist(lGenerator)));
+		lTree.insert(lEntity);
+		lEntities.push_back(std::move(lEntity));
+	}
+	BOOST_CHECK_EQUAL(lTree.count(), lEntities.size());
+	BOOST_CHECK_GT(lTree.nodeCount(), 1);
+
+	for (int i = 0; i < 50; ++i)
+	{
+		const vec3f lA(lDist(lGenerator), lDist(lGenerator), lDist(lGenerator));
+		const vec3f lB(lDist(lGenerator), lDist(lGenerator), lDist(lGenerator));
+		const box3f lVolume(
+			vec3f(std::min(lA.x, lB.x), std::min(lA.y, lB.y), std::min(lA.z, lB.z)),
+			vec3f(std::max(lA.x, lB.x), std::max(lA.y, lB.y), std::max(lA.z, lB.z)));
+		BOOST_CHECK(query(lTree, lVolume) == bruteForce(lEntities, lVolume));
+	}
+
+	// Every node lies within the bounds of the tree, and the root comes
+	// first in depth-first order.
+	std::size_t lNodeCount = 0;
+	lTree.forEachNode([&lTree, &lNodeCount] (const LinearOctree::NodeView* node)
+	{
+		BOOST_CHECK(lTree.bounds().contains(node->bounds()));
+		BOOST_CHECK_EQUAL(node->isRoot(), lNodeCount == 0);
+		++lNodeCount;
+	});
+	BOOST_CHECK_EQUAL(lNodeCount, lTree.nodeCount());
+}
+
+BOOST_AUTO_TEST_CASE( moving_erasing_and_dying_entities )
+{
+	LinearOctree lTree(vec3f(-128.0f), vec3f(128.0f));
+	auto lA = Entity::create();
+	auto lB = Entity::create();
+	lA->setTranslation(vec3f(10.0f, 10.0f, 10.0f));
+	lB->setTranslation(vec3f(-10.0f, -10.0f, -10.0f));
+	lTree.insert(lA);
+	lTree.insert(lB);
+	lTree.insert(lA);
+	BOOST_CHECK_EQUAL(lTree.count(), 2);
+
+	const box3f lPositive(vec3f(0.0f), vec3f(20.0f));
+	BOOST_CHECK_EQUAL(query(lTree, lPositive).size(), 1);
+
+	// The tree follows the transform of an Entity.
+	lB->setTranslation(vec3f(15.0f, 15.0f, 15.0f));
+	BOOST_CHECK_EQUAL(query(lTree, lPositive).size(), 2);
+
+	// An Entity that leaves the bounds is kept in the root.
+	lB->setTranslation(vec3f(500.0f, 0.0f, 0.0f));
+	BOOST_CHECK_EQUAL(lTree.count(), 2);
+	BOOST_CHECK_EQUAL(query(lTree, box3f(vec3f(499.0f, -1.0f, -1.0f), vec3f(501.0f, 1.0f, 1.0f))).size(), 1);
+
+	BOOST_CHECK(lTree.erase(lA));
+	BOOST_CHECK(!lTree.erase(lA));
+	BOOST_CHECK_EQUAL(lTree.count(), 1);
+
+	// Erasing and re-inserting before a rebuild keeps a single copy.
+	lTree.insert(lA);
+	BOOST_CHECK(lTree.erase(lA));
+	lTree.insert(lA);
+	BOOST_CHECK_EQUAL(lTree.count(), 2);
+
+	// A dying Entity removes itself.
+	lB = nullptr;
+	BOOST_CHECK_EQUAL(lTree.count(), 1);
+
+	auto lOutside = Entity::create("outside");
+	lOutside->setTranslation(vec3f(200.0f, 0.0f, 0.0f));
+	BOOST_CHECK_THROW(lTree.insert(lOutside), LinearOctree::EntityNotContainedInOctreeBoundingBox);
+}
+
+BOOST_AUTO_TEST_CASE( subdivision_threshold )
+{
+	LinearOctree lTree(vec3f(-128.0f), vec3f(128.0f));
+	lTree.subdivisionThreshold = 1000.0f;
+	auto lEntity = Entity::create();
+	lEntity->setTranslation(vec3f(1.0f, 2.0f, 3.0f));
+	lTree.insert(lEntity);
+	BOOST_CHECK_EQUAL(lTree.nodeCount(), 1);
+	lTree.subdivisionThreshold = 1.0f;
+	BOOST_CHECK_GT(lTree.nodeCount(), 1);
+	BOOST_CHECK_EQUAL(query(lTree, box3f(vec3f(0.0f), vec3f(4.0f))).size(), 1);
+}
+
+BOOST_AUTO_TEST_CASE( threshold_change_before_insert )
+{
+	// The entities that were there before the threshold changed are coded
+	// again when the next insert picks up the new depth.
+	LinearOctree lTree(vec3f(-128.0f), vec3f(128.0f));
+	lTree.subdivisionThreshold = 1.0f;
+	auto lFirst = Entity::create();
+	lFirst->setTranslation(vec3f(1.0f, 2.0f, 3.0f));
+	lTree.insert(lFirst);
+	BOOST_CHECK_GT(lTree.nodeCount(), 1);
+	lTree.subdivisionThreshold = 1000.0f;
+	auto lSecond = Entity::create();
+	lSecond->setTranslation(vec3f(-50.0f, 2.0f, 3.0f));
+	lTree.insert(lSecond);
+	BOOST_CHECK_EQUAL(lTree.nodeCount(), 1);
+	BOOST_CHECK_EQUAL(query(lTree, box3f(vec3f(0.0f), vec3f(4.0f))).size(), 1);
+	BOOST_CHECK_EQUAL(query(lTree, box3f(vec3f(-128.0f), vec3f(128.0f))).size(), 2);
+}
@@ -0,0 +1,192 @@
+#define BOOST_TEST_MODULE OctreeComp test
+#include <boost/test/unit_test.hpp>
+
+#include "BoxCollider.hpp"
+#include "Entity.hpp"
+#include "Foundation/allocator.hpp"
+#include "OctreeComp.hpp"
+#include "Transform.hpp"
+#include <algorithm>
+#include <random>
+
+using namespace gintonic;
+
+namespace
+{
+
+struct Box
+{
+    std::unique_ptr<experimental::Entity> entity;
+    Transform* transform;
+    OctreeComp* octree;
+
+    Box(OctreeComp::Node& root, const vec3f& position)
+        : entity(new experimental::Entity())
+    {
+        auto collider = entity->add<BoxCollider>();
+        collider->localOffset = vec3f(0.0f, 0.0f, 0.0f);
+        collider->localBounds =
+            box3f(vec3f(-1.0f, -1.0f, -1.0f), vec3f(1.0f, 1.0f, 1.0f));
+        transform = entity->get<Transform>();
+        transform->local().translation = position;
+        octree = entity->add<OctreeComp>();
+        octree->setNode(root);
+    }
+
+    void moveTo(const vec3f& position)
+    {
+        transform->local().translation = position;
+        entity->update();
+    }
+};
+
+bool sameBox(const box3f& a, const box3f& b)
+{
+    return a.minCorner == b.minCorner && a.maxCorner == b.maxCorner;
+}
+
+std::size_t count(const OctreeComp::Node& root, const box3f& volume,
+                  const OctreeComp* comp)
+{
+    std::size_t result = 0;
+    root.query(volume, [&](const OctreeComp* found) {
+        if (found == comp) ++result;
+    });
+    return result;
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(fat_bounds)
+{
+    OctreeComp::Node root(vec3f(-64.0f, -64.0f, -64.0f),
+                          vec3f(64.0f, 64.0f, 64.0f));
+    Box box(root, vec3f(5.0f, 5.0f, 5.0f));
+    const auto fat = box.octree->getFatBounds();
+    BOOST_CHECK(fat.contains(
+        box.entity->get<BoxCollider>()->getGlobalBounds()));
+
+    // Small movements stay inside the fat bounds.
+    box.moveTo(vec3f(5.1f, 5.0f, 4.9f));
+    BOOST_CHECK(sameBox(box.octree->getFatBounds(), fat));
+
+    // Large movements relocate.
+    box.moveTo(vec3f(-20.0f, 10.0f, 5.0f));
+    const auto bounds = box.entity->get<BoxCollider>()->getGlobalBounds();
+    BOOST_CHECK(!sameBox(box.octree->getFatBounds(), fat));
+    BOOST_CHECK(box.octree->getFatBounds().contains(bounds));
+    BOOST_CHECK_EQUAL(count(root, bounds, box.octree), 1);
+    BOOST_CHECK_EQUAL(count(root, fat, box.octree), 0);
+
+    // Without margin, the fat bounds are the actual bounds.
+    box.octree->setMargin(0.0f);
+    box.moveTo(vec3f(20.0f, 10.0f, 5.0f));
+    BOOST_CHECK(sameBox(box.octree->getFatBounds(),
+                        box.entity->get<BoxCollider>()->getGlobalBounds()));
+}
+
+BOOST_AUTO_TEST_CASE(static_components)
+{
+    OctreeComp::Node root(vec3f(-64.0f, -64.0f, -64.0f),
+                          vec3f(64.0f, 64.0f, 64.0f));
+    Box box(root, vec3f(5.0f, 5.0f, 5.0f));
+
+    // Marking it static relocates one last time.
+    box.transform->local().translation = vec3f(-10.0f, -10.0f, -10.0f);
+    box.octree->setStatic(true);
+    BOOST_CHECK(box.octree->isStatic());
+    const auto fat = box.octree->getFatBounds();
+    BOOST_CHECK(fat.contains(
+        box.entity->get<BoxCollider>()->getGlobalBounds()));
+
+    box.moveTo(vec3f(10.0f, 10.0f, 10.0f));
+    BOOST_CHECK(sameBox(box.octree->getFatBounds(), fat));
+
+    box.octree->setStatic(false);
+    box.entity->update();
+    BOOST_CHECK(box.octree->getFatBounds().contains(
+        box.entity->get<BoxCollider>()->getGlobalBounds()));
+}
+
+BOOST_AUTO_TEST_CASE(many_components)
+{
+    OctreeComp::Node root(vec3f(-64.0f, -64.0f, -64.0f),
+                          vec3f(64.0f, 64.0f, 64.0f));
+    std::vector<std::unique_ptr<Box>> boxes;
+    for (int i = 0; i < 20; ++i)
+    {
+        const auto f = static_cast<float>(i);
+        boxes.emplace_back(new Box(root, vec3f(f - 10.0f, 0.0f, 0.0f)));
+    }
+    const box3f everything(vec3f(-64.0f, -64.0f, -64.0f),
+                           vec3f(64.0f, 64.0f, 64.0f));
+
+    // Remove every other component.
+    for (std::size_t i = 0; i < boxes.size(); i += 2) boxes[i].reset();
+    for (std::size_t i = 0; i < boxes.size(); ++i)
+    {
+        if (!boxes[i]) continue;
+        BOOST_CHECK_EQUAL(count(root, everything, boxes[i]->octree), 1);
+    }
+
+    for (std::size_t i = 1; i < boxes.size(); i += 2)
+    {
+        const auto f = static_cast<float>(i);
+        boxes[i]->moveTo(vec3f(0.0f, f - 10.0f, 10.0f));
+    }
+    std::size_t total = 0;
+    root.query(everything, [&](const OctreeComp*) { ++total; });
+    BOOST_CHECK_EQUAL(total, boxes.size() / 2);
+    BOOST_CHECK_EQUAL(root.statistics().entityCount, boxes.size() / 2);
+}
+
+BOOST_AUTO_TEST_CASE(query_batch)
+{
+    OctreeComp::Node root(vec3f(-128.0f, -128.0f, -128.0f),
+                          vec3f(128.0f, 128.0f, 128.0f));
+    std::mt19937 generator(13);
+    std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+    std::vector<std::unique_ptr<Box>> boxes;
+    for (int i = 0; i < 1000; ++i)
+    {
+        boxes.emplace_back(new Box(root, vec3f(position(generator),
+                                               position(generator),
+                                               position(generator))));
+    }
+
+    std::vector<box3f, allocator<box3f>> volumes;
+    for (int i = 0; i < 300; ++i)
+    {
+        const vec3f center(2.0f * position(generator),
+                           2.0f * position(generator),
+                           2.0f * position(generator));
+        const vec3f extent(8.0f, 8.0f, 8.0f);
+        volumes.emplace_back(center - extent, center + extent);
+    }
+
+    OctreeComp::QueryBatch batch;
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        root.query(volumes.data(), volumes.data() + volumes.size(), batch);
+        BOOST_REQUIRE_EQUAL(batch.size(), volumes.size());
+        std::size_t total = 0;
+        for (std::size_t q = 0; q < volumes.size(); ++q)
+        {
+            std::vector<OctreeComp*> expected;
+            root.query(volumes[q],
+                       [&](OctreeComp* comp) { expected.push_back(comp); });
+            std::vector<OctreeComp*> result(batch.begin(q), batch.end(q));
+            std::sort(expected.begin(), expected.end());
+            std::sort(result.begin(), result.end());
+            BOOST_CHECK(result == expected);
+            total += batch.count(q);
+        }
+        BOOST_CHECK(total > 0);
+        BOOST_CHECK_EQUAL(batch.results().size(), total);
+    }
+
+    // An empty batch.
+    root.query(volumes.data(), volumes.data(), batch);
+    BOOST_CHECK_EQUAL(batch.size(), 0);
+    BOOST_CHECK(batch.results().empty());
+}
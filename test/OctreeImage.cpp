@@ -0,0 +1,133 @@
+#define BOOST_TEST_MODULE OctreeImage test
+#include <boost/test/unit_test.hpp>
+
+#include "Foundation/OctreeImage.hpp"
+#include "Foundation/exception.hpp"
+#include "Foundation/filesystem.hpp"
+#include "Math/mat4f.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <random>
+#include <sstream>
+
+using namespace gintonic;
+
+namespace {
+
+struct Fixture
+{
+	std::vector<Entity::SharedPtr> entities;
+	std::map<const Entity*, std::uint32_t> indices;
+	Octree tree{box3f(vec3f(-128.0f, -128.0f, -128.0f), vec3f(128.0f, 128.0f, 128.0f))};
+
+	Fixture()
+	{
+		std::mt19937 lGenerator(7);
+		std::uniform_real_distribution<float> lDist(-120.0f, 120.0f);
+		for (std::uint32_t i = 0; i < 500; ++i)
+		{
+			auto lEntity = Entity::create();
+			lEntity->setTranslation(vec3f(lDist(lGenerator), lDist(lGenerator), lDist(lGenerator)));
+			indices[lEntity.get()] = i;
+			entities.push_back(lEntity);
+		}
+		tree = Octree(tree.bounds(), entities.begin(), entities.end(), 2.0f);
+	}
+
+	std::string image() const
+	{
+		std::ostringstream lStream(std::ios::binary);
+		OctreeImage::write(tree, lStream, [this] (const Entity& entity)
+		{
+			return indices.at(&entity);
+		});
+		return lStream.str();
+	}
+
+	template <class Volume>
+	std::vector<std::uint32_t> expected(const Volume& volume) const
+	{
+		std::vector<Entity::ConstSharedPtr> lEntities;
+		tree.query(volume, std::back_inserter(lEntities));
+		std::vector<std::uint32_t> lResult;
+		for (const auto& lEntity : lEntities) lResult.push_back(indices.at(lEntity.get()));
+		std::sort(lResult.begin(), lResult.end());
+		return lResult;
+	}
+};
+
+template <class Volume>
+std::vector<std::uint32_t> queried(const OctreeImage& image, const Volume& volume)
+{
+	std::vector<std::uint32_t> lResult;
+	image.query(volume, std::back_inserter(lResult));
+	std::sort(lResult.begin(), lResult.end());
+	return lResult;
+}
+
+} // anonymous namespace
+
+BOOST_FIXTURE_TEST_CASE( queries_match_the_octree, Fixture )
+{
+	const auto lData = image();
+	BOOST_CHECK_EQUAL(lData.size(), OctreeImage::imageSize(tree));
+
+	// std::string does not guarantee the alignment of its buffer.
+	std::vector<std::uint32_t> lAligned((lData.size() + 3) / 4);
+	std::memcpy(lAligned.data(), lData.data(), lData.size());
+	const OctreeImage lImage(lAligned.data(), lData.size());
+
+	BOOST_CHECK_EQUAL(lImage.count(), entities.size());
+	std::size_t lNodeCount = 0;
+	tree.forEachNode([&lNodeCount] (const Octree*) { ++lNodeCount; });
+	BOOST_CHECK_EQUAL(lImage.nodeCount(), lNodeCount);
+	BOOST_CHECK_EQUAL(lImage.bounds().minCorner, tree.bounds().minCorner);
+	BOOST_CHECK_EQUAL(lImage.subdivisionThreshold(), 2.0f);
+
+	const box3f lBox(vec3f(-30.0f, -10.0f, 0.0f), vec3f(40.0f, 50.0f, 60.0f));
+	const auto lFromBox = queried(lImage, lBox);
+	BOOST_CHECK(!lFromBox.empty());
+	BOOST_CHECK(lFromBox == expected(lBox));
+
+	mat4f lProjection;
+	lProjection.set_perspective(deg2rad(60.0f), 1.0f, 1.0f, 100.0f);
+	const frustum lFrustum(lProjection);
+	const auto lFromFrustum = queried(lImage, lFrustum);
+	BOOST_CHECK(!lFromFrustum.empty());
+	BOOST_CHECK(lFromFrustum == expected(lFrustum));
+}
+
+BOOST_FIXTURE_TEST_CASE( mapped_file, Fixture )
+{
+	const auto lFilename = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+	{
+		std::ofstream lFile(lFilename.string(), std::ios::binary);
+		const auto lData = image();
+		lFile.write(lData.data(), lData.size());
+	}
+	{
+		const OctreeImage lImage(lFilename);
+		const box3f lBox(vec3f(-100.0f, -100.0f, -100.0f), vec3f(0.0f, 0.0f, 0.0f));
+		BOOST_CHECK(queried(lImage, lBox) == expected(lBox));
+		BOOST_CHECK(queried(lImage, tree.bounds()).size() == entities.size());
+	}
+	boost::filesystem::remove(lFilename);
+}
+
+BOOST_AUTO_TEST_CASE( rejects_invalid_images )
+{
+	std::uint32_t lGarbage[16] = {0};
+	BOOST_CHECK_THROW(OctreeImage(lGarbage, sizeof(lGarbage)), exception);
+	BOOST_CHECK_THROW(OctreeImage(lGarbage, 4), exception);
+
+	Octree lEmpty(box3f(vec3f(-1.0f, -1.0f, -1.0f), vec3f(1.0f, 1.0f, 1.0f)));
+	std::ostringstream lStream(std::ios::binary);
+	OctreeImage::write(lEmpty, lStream, [] (const Entity&) { return 0u; });
+	const auto lData = lStream.str();
+	std::vector<std::uint32_t> lAligned((lData.size() + 3) / 4);
+	std::memcpy(lAligned.data(), lData.data(), lData.size());
+	BOOST_CHECK_EQUAL(OctreeImage(lAligned.data(), lData.size()).count(), 0);
+	BOOST_CHECK_THROW(OctreeImage(lAligned.data(), lData.size() - 1), exception);
+}
@@ -0,0 +1,141 @@
+#define BOOST_TEST_MODULE OctreeSnapshot test
+#include <boost/test/unit_test.hpp>
+
+#include "Foundation/OctreeSnapshot.hpp"
+#include "Math/mat4f.hpp"
+#include <algorithm>
+#include <random>
+
+using namespace gintonic;
+
+namespace {
+
+// Counts how many instances are alive.
+struct Counted
+{
+	static std::atomic<int> alive;
+	const std::uint64_t version;
+	const std::uint64_t check;
+
+	Counted(const std::uint64_t version) : version(version), check(~version) { ++alive; }
+	~Counted() { --alive; }
+};
+
+std::atomic<int> Counted::alive{0};
+
+using Publisher = SnapshotPublisher<Counted>;
+
+std::unique_ptr<const Counted> counted(const std::uint64_t version)
+{
+	return std::unique_ptr<const Counted>(new Counted(version));
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE( snapshot_is_immutable )
+{
+	const box3f lBoundingBox(vec3f(-128.0f, -128.0f, -128.0f), vec3f(128.0f, 128.0f, 128.0f));
+	std::mt19937 lGenerator(3);
+	std::uniform_real_distribution<float> lDist(-120.0f, 120.0f);
+	std::vector<Entity::SharedPtr> lEntities;
+	for (int i = 0; i < 300; ++i)
+	{
+		auto lEntity = Entity::create();
+		lEntity->setTranslation(vec3f(lDist(lGenerator), lDist(lGenerator), lDist(lGenerator)));
+		lEntities.push_back(std::move(lEntity));
+	}
+	Octree lTree(lBoundingBox, lEntities.begin(), lEntities.end());
+
+	const OctreeSnapshot lSnapshot(lTree);
+	BOOST_CHECK_EQUAL(lSnapshot.count(), lEntities.size());
+
+	const box3f lVolume(vec3f(-50.0f, -50.0f, -50.0f), vec3f(50.0f, 50.0f, 50.0f));
+	std::vector<Entity::ConstSharedPtr> lExpected, lResult;
+	lTree.query(lVolume, std::back_inserter(lExpected));
+	lSnapshot.query(lVolume, std::back_inserter(lResult));
+	BOOST_CHECK(!lExpected.empty());
+	std::sort(lExpected.begin(), lExpected.end());
+	std::sort(lResult.begin(), lResult.end());
+	BOOST_CHECK(lResult == lExpected);
+
+	mat4f lProjection;
+	lProjection.set_perspective(deg2rad(60.0f), 1.0f, 1.0f, 100.0f);
+	const frustum lFrustum(lProjection);
+	lExpected.clear();
+	lResult.clear();
+	lTree.query(lFrustum, std::back_inserter(lExpected));
+	lSnapshot.query(lFrustum, std::back_inserter(lResult));
+	BOOST_CHECK_EQUAL(lResult.size(), lExpected.size());
+
+	// Moving entities does not change the snapshot, dead entities are
+	// skipped.
+	for (auto& lEntity : lEntities) lEntity->setTranslation(vec3f(500.0f, 0.0f, 0.0f));
+	lEntities.front().reset();
+	lResult.clear();
+	lSnapshot.query(lBoundingBox, std::back_inserter(lResult));
+	BOOST_CHECK_EQUAL(lResult.size(), lEntities.size() - 1);
+}
+
+BOOST_AUTO_TEST_CASE( publisher_reclaims_unread_snapshots )
+{
+	{
+		Publisher lPublisher;
+		BOOST_CHECK(!lPublisher.read());
+
+		lPublisher.publish(counted(1));
+		BOOST_CHECK_EQUAL(lPublisher.epoch(), 1);
+		{
+			const auto lReader = lPublisher.read();
+			BOOST_REQUIRE(lReader);
+			BOOST_CHECK_EQUAL(lReader->version, 1);
+
+			// The reader keeps its snapshot alive.
+			lPublisher.publish(counted(2));
+			lPublisher.publish(counted(3));
+			BOOST_CHECK_EQUAL(lReader->version, 1);
+			BOOST_CHECK_EQUAL(lPublisher.retiredCount(), 2);
+			BOOST_CHECK_EQUAL(Counted::alive, 3);
+
+			// New readers get the new snapshot.
+			BOOST_CHECK_EQUAL(lPublisher.read()->version, 3);
+		}
+		BOOST_CHECK_EQUAL(lPublisher.reclaim(), 0);
+		BOOST_CHECK_EQUAL(Counted::alive, 1);
+
+		// Without readers, the previous snapshot goes away immediately.
+		lPublisher.publish(counted(4));
+		BOOST_CHECK_EQUAL(lPublisher.retiredCount(), 0);
+		BOOST_CHECK_EQUAL(lPublisher.current()->version, 4);
+	}
+	BOOST_CHECK_EQUAL(Counted::alive, 0);
+}
+
+BOOST_AUTO_TEST_CASE( concurrent_readers )
+{
+	{
+		Publisher lPublisher(counted(0));
+		std::atomic<bool> lDone{false};
+		std::atomic<int> lErrors{0};
+		std::vector<std::thread> lReaders;
+		for (int t = 0; t < 4; ++t)
+		{
+			lReaders.emplace_back([&lPublisher, &lDone, &lErrors] ()
+			{
+				std::uint64_t lLast = 0;
+				while (!lDone)
+				{
+					const auto lSnapshot = lPublisher.read();
+					if (lSnapshot->check != ~lSnapshot->version || lSnapshot->version < lLast) ++lErrors;
+					lLast = lSnapshot->version;
+				}
+			});
+		}
+		for (std::uint64_t v = 1; v <= 20000; ++v) lPublisher.publish(counted(v));
+		lDone = true;
+		for (auto& lReader : lReaders) lReader.join();
+		BOOST_CHECK_EQUAL(lErrors, 0);
+		BOOST_CHECK_EQUAL(lPublisher.reclaim(), 0);
+		BOOST_CHECK_EQUAL(Counted::alive, 1);
+	}
+	BOOST_CHECK_EQUAL(Counted::alive, 0);
+}
@@ -7,6 +7,7 @@
 #include <chrono>
 #include <vector>
 #include <algorithm>
+#include <random>
 
 using namespace gintonic;
 
@@ -38,3 +39,390 @@ BOOST_AUTO_TEST_CASE( main_test )
 	}
 	DEBUG_PRINT;
 }
+
+namespace {
+
+// Flatten the structure of an Octree in depth-first order: the bounds and
+// the entity count of every node, and every entity in traversal order.
+void flatten(
+	const Octree& tree,
+	std::vector<box3f>& bounds,
+	std::vector<std::size_t>& counts,
+	std::vector<Entity::ConstSharedPtr>& entities)
+{
+	tree.forEachNode([&bounds, &counts] (const Octree* node)
+	{
+		bounds.push_back(node->bounds());
+		counts.push_back(node->count());
+	});
+	tree.getEntities(std::back_inserter(entities));
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE( bulk_build_matches_incremental_insertion )
+{
+	std::mt19937 lGenerator(1234);
+	std::uniform_real_distribution<float> lDist(-120.0f, 120.0f);
+	const box3f lBoundingBox(vec3f(-128.0f, -128.0f, -128.0f), vec3f(128.0f, 128.0f, 128.0f));
+
+	std::vector<Entity::SharedPtr> lEntities;
+	for (int i = 0; i < 5000; ++i)
+	{
+		auto lEntity = Entity::create();
+		lEntity->setTranslation(vec3f(lDist(lGenerator), lDist(lGenerator), lDist(lGenerator)));
+		lEntities.push_back(std::move(lEntity));
+	}
+	// Put a few entities right on the splitting planes.
+	lEntities[0]->setTranslation(vec3f(0.0f, 0.0f, 0.0f));
+	lEntities[1]->setTranslation(vec3f(64.0f, -64.0f, 0.0f));
+
+	Octree lIncremental(lBoundingBox);
+	lIncremental.subdivisionThreshold = 4.0f;
+	for (const auto& lEntity : lEntities) lIncremental.insert(lEntity);
+
+	Octree lBulk(lBoundingBox, lEntities.begin(), lEntities.end(), 4.0f);
+
+	std::vector<box3f> lBoundsA, lBoundsB;
+	std::vector<std::size_t> lCountsA, lCountsB;
+	std::vector<Entity::ConstSharedPtr> lEntitiesA, lEntitiesB;
+	flatten(lIncremental, lBoundsA, lCountsA, lEntitiesA);
+	flatten(lBulk, lBoundsB, lCountsB, lEntitiesB);
+
+	BOOST_CHECK_EQUAL(lBulk.count(), lEntities.size());
+	BOOST_REQUIRE_EQUAL(lBoundsA.size(), lBoundsB.size());
+	for (std::size_t i = 0; i < lBoundsA.size(); ++i)
+	{
+		BOOST_CHECK_EQUAL(lBoundsA[i].minCorner, lBoundsB[i].minCorner);
+		BOOST_CHECK_EQUAL(lBoundsA[i].maxCorner, lBoundsB[i].maxCorner);
+	}
+	BOOST_CHECK(lCountsA == lCountsB);
+	BOOST_CHECK(lEntitiesA == lEntitiesB);
+
+	// The bulk-built tree follows transform changes just like the other one.
+	lEntities[2]->setTranslation(vec3f(100.0f, 100.0f, 100.0f));
+	lBulk.commitUpdates();
+	std::vector<Entity::SharedPtr> lResult;
+	lBulk.query(box3f(vec3f(99.0f, 99.0f, 99.0f), vec3f(101.0f, 101.0f, 101.0f)), std::back_inserter(lResult));
+	BOOST_CHECK(std::find(lResult.begin(), lResult.end(), lEntities[2]) != lResult.end());
+
+	auto lOutside = Entity::create();
+	lOutside->setTranslation(vec3f(200.0f, 0.0f, 0.0f));
+	lEntities.push_back(lOutside);
+	BOOST_CHECK_THROW(Octree(lBoundingBox, lEntities.begin(), lEntities.end()), Octree::EntityNotContainedInOctreeBoundingBox);
+}
+
+BOOST_AUTO_TEST_CASE( frustum_query )
+{
+	std::mt19937 lGenerator(5678);
+	std::uniform_real_distribution<float> lDist(-120.0f, 120.0f);
+	const box3f lBoundingBox(vec3f(-128.0f, -128.0f, -128.0f), vec3f(128.0f, 128.0f, 128.0f));
+
+	std::vector<Entity::SharedPtr> lEntities;
+	for (int i = 0; i < 2000; ++i)
+	{
+		auto lEntity = Entity::create();
+		lEntity->setTranslation(vec3f(lDist(lGenerator), lDist(lGenerator), lDist(lGenerator)));
+		lEntities.push_back(std::move(lEntity));
+	}
+	const Octree lTree(lBoundingBox, lEntities.begin(), lEntities.end(), 4.0f);
+
+	mat4f lProjection;
+	lProjection.set_perspective(deg2rad(60.0f), 1.5f, 1.0f, 80.0f);
+	const frustum lFrustum(lProjection);
+
+	std::vector<Entity::ConstSharedPtr> lResult;
+	lTree.query(lFrustum, std::back_inserter(lResult));
+	std::sort(lResult.begin(), lResult.end());
+
+	// The entities are points, so the frustum test is exact.
+	std::vector<Entity::ConstSharedPtr> lExpected;
+	for (const auto& lEntity : lEntities)
+	{
+		if (lFrustum.contains(lEntity->globalBoundingBox().minCorner)) lExpected.push_back(lEntity);
+	}
+	std::sort(lExpected.begin(), lExpected.end());
+	BOOST_CHECK(!lExpected.empty());
+	BOOST_CHECK(lResult == lExpected);
+}
+
+BOOST_AUTO_TEST_CASE( raycast )
+{
+	std::mt19937 lGenerator(91011);
+	std::uniform_int_distribution<int> lDist(-100, 100);
+	const box3f lBoundingBox(vec3f(-128.0f, -128.0f, -128.0f), vec3f(128.0f, 128.0f, 128.0f));
+
+	// Put the entities on a grid, so that rays along the axes hit some.
+	std::vector<Entity::SharedPtr> lEntities;
+	for (int i = 0; i < 3000; ++i)
+	{
+		auto lEntity = Entity::create();
+		lEntity->setTranslation(vec3f(float(lDist(lGenerator)), float(lDist(lGenerator) % 4), float(lDist(lGenerator) % 4)));
+		lEntities.push_back(std::move(lEntity));
+	}
+	Octree lTree(lBoundingBox, lEntities.begin(), lEntities.end(), 4.0f);
+
+	const vec3f lOrigin(-110.0f, 2.0f, 3.0f);
+	const vec3f lDirection(2.0f, 0.0f, 0.0f);
+
+	std::vector<std::pair<float, Entity::SharedPtr>> lExpected;
+	const ray3f lRay(lOrigin, vec3f(1.0f, 0.0f, 0.0f));
+	for (const auto& lEntity : lEntities)
+	{
+		float lDistance;
+		if (lRay.intersects(lEntity->globalBoundingBox(), 0.0f, 150.0f, lDistance))
+		{
+			lExpected.emplace_back(lDistance, lEntity);
+		}
+	}
+	BOOST_REQUIRE(!lExpected.empty());
+	std::stable_sort(lExpected.begin(), lExpected.end(), [] (const std::pair<float, Entity::SharedPtr>& a, const std::pair<float, Entity::SharedPtr>& b)
+	{
+		return a.first < b.first;
+	});
+
+	float lDistance = -1.0f;
+	const auto lClosest = lTree.raycast(lOrigin, lDirection, 150.0f, lDistance);
+	BOOST_REQUIRE(lClosest);
+	BOOST_CHECK_EQUAL(lDistance, lExpected.front().first);
+	BOOST_CHECK_EQUAL(lClosest->globalBoundingBox().minCorner, lExpected.front().second->globalBoundingBox().minCorner);
+
+	std::vector<float> lDistances;
+	std::vector<Entity::SharedPtr> lHits;
+	lTree.raycastAll(lOrigin, lDirection, 150.0f, [&lDistances, &lHits] (Entity::SharedPtr entity, const float distance)
+	{
+		lDistances.push_back(distance);
+		lHits.push_back(std::move(entity));
+	});
+	BOOST_REQUIRE_EQUAL(lHits.size(), lExpected.size());
+	BOOST_CHECK(std::is_sorted(lDistances.begin(), lDistances.end()));
+	std::vector<Entity::SharedPtr> lExpectedEntities;
+	for (const auto& lPair : lExpected) lExpectedEntities.push_back(lPair.second);
+	std::sort(lHits.begin(), lHits.end());
+	std::sort(lExpectedEntities.begin(), lExpectedEntities.end());
+	BOOST_CHECK(lHits == lExpectedEntities);
+
+	const Octree& lConstTree = lTree;
+	BOOST_CHECK(!lConstTree.raycast(lOrigin, vec3f(0.0f, 1.0f, 0.0f), 150.0f, lDistance));
+	BOOST_CHECK(!lConstTree.raycast(lOrigin, lDirection, 5.0f, lDistance));
+}
+
+BOOST_AUTO_TEST_CASE( nearest_and_within_radius )
+{
+	std::mt19937 lGenerator(1213);
+	std::uniform_real_distribution<float> lDist(-120.0f, 120.0f);
+	const box3f lBoundingBox(vec3f(-128.0f, -128.0f, -128.0f), vec3f(128.0f, 128.0f, 128.0f));
+
+	std::vector<Entity::SharedPtr> lEntities;
+	for (int i = 0; i < 3000; ++i)
+	{
+		auto lEntity = Entity::create();
+		lEntity->setTranslation(vec3f(lDist(lGenerator), lDist(lGenerator), lDist(lGenerator)));
+		lEntities.push_back(std::move(lEntity));
+	}
+	const Octree lTree(lBoundingBox, lEntities.begin(), lEntities.end(), 4.0f);
+
+	const vec3f lPoint(10.0f, -20.0f, 30.0f);
+	std::vector<float> lExpected;
+	for (const auto& lEntity : lEntities)
+	{
+		lExpected.push_back(std::sqrt(distance2(lEntity->globalBoundingBox(), lPoint)));
+	}
+	std::sort(lExpected.begin(), lExpected.end());
+
+	std::vector<float> lDistances;
+	lTree.nearest(lPoint, 25, [&lDistances, &lPoint] (Entity::ConstSharedPtr entity, const float distance)
+	{
+		BOOST_CHECK_CLOSE(distance, std::sqrt(distance2(entity->globalBoundingBox(), lPoint)), 0.001f);
+		lDistances.push_back(distance);
+	});
+	BOOST_REQUIRE_EQUAL(lDistances.size(), 25);
+	for (std::size_t i = 0; i < lDistances.size(); ++i)
+	{
+		BOOST_CHECK_CLOSE(lDistances[i], lExpected[i], 0.001f);
+	}
+
+	std::size_t lCount = 0;
+	lTree.nearest(lPoint, 5000, [&lCount] (Entity::ConstSharedPtr, float) { ++lCount; });
+	BOOST_CHECK_EQUAL(lCount, lEntities.size());
+
+	std::vector<Entity::ConstSharedPtr> lWithin;
+	lTree.withinRadius(lPoint, 40.0f, std::back_inserter(lWithin));
+	BOOST_CHECK_EQUAL(lWithin.size(), std::count_if(lExpected.begin(), lExpected.end(), [] (const float d) { return d <= 40.0f; }));
+	for (const auto& lEntity : lWithin)
+	{
+		BOOST_CHECK(distance2(lEntity->globalBoundingBox(), lPoint) <= 1600.0f);
+	}
+}
+
+BOOST_AUTO_TEST_CASE( visit_follows_moving_and_dying_entities )
+{
+	const box3f lBoundingBox(vec3f(-128.0f, -128.0f, -128.0f), vec3f(128.0f, 128.0f, 128.0f));
+	std::vector<Entity::SharedPtr> lEntities;
+	for (int i = 0; i < 100; ++i)
+	{
+		auto lEntity = Entity::create();
+		lEntity->setTranslation(vec3f(float(i), 0.0f, 0.0f));
+		lEntities.push_back(std::move(lEntity));
+	}
+	Octree lTree(lBoundingBox, lEntities.begin(), lEntities.end(), 4.0f);
+
+	const auto lCount = [] (const Octree& tree, const box3f& volume)
+	{
+		std::size_t lResult = 0;
+		tree.visit(volume, [&lResult] (const Entity*) { ++lResult; });
+		return lResult;
+	};
+	const box3f lVolume(vec3f(9.5f, -1.0f, -1.0f), vec3f(20.5f, 1.0f, 1.0f));
+	BOOST_CHECK_EQUAL(lCount(lTree, lVolume), 11);
+
+	// A small move within the same node, and a big move to another node.
+	lEntities[10]->setTranslation(vec3f(10.25f, 0.0f, 0.0f));
+	lEntities[11]->setTranslation(vec3f(-100.0f, 0.0f, 0.0f));
+	lTree.commitUpdates();
+	BOOST_CHECK_EQUAL(lCount(lTree, lVolume), 10);
+	BOOST_CHECK_EQUAL(lCount(lTree, box3f(vec3f(-101.0f), vec3f(-99.0f, 1.0f, 1.0f))), 1);
+
+	Entity* lSeen = nullptr;
+	lTree.visit(box3f(vec3f(10.0f, -1.0f, -1.0f), vec3f(10.5f, 1.0f, 1.0f)), [&lSeen] (Entity* entity) { lSeen = entity; });
+	BOOST_CHECK_EQUAL(lSeen, lEntities[10].get());
+
+	// Dying entities leave the tree.
+	lEntities[12].reset();
+	lEntities[13].reset();
+	BOOST_CHECK_EQUAL(lCount(lTree, lVolume), 8);
+	BOOST_CHECK_EQUAL(lTree.count(), 98);
+
+	// Moved and copied trees keep following the entities.
+	Octree lMoved(std::move(lTree));
+	Octree lCopy(lMoved);
+	lEntities[14]->setTranslation(vec3f(0.0f, 100.0f, 0.0f));
+	lMoved.commitUpdates();
+	lCopy.commitUpdates();
+	BOOST_CHECK_EQUAL(lCount(lMoved, lVolume), 7);
+	BOOST_CHECK_EQUAL(lCount(lCopy, lVolume), 7);
+	lEntities[15].reset();
+	BOOST_CHECK_EQUAL(lCount(lMoved, lVolume), 6);
+	BOOST_CHECK_EQUAL(lCount(lCopy, lVolume), 6);
+
+	mat4f lProjection;
+	lProjection.set_perspective(deg2rad(90.0f), 1.0f, 1.0f, 200.0f);
+	std::size_t lVisible = 0;
+	lCopy.visit(frustum(lProjection), [&lVisible] (const Entity*) { ++lVisible; });
+	std::vector<Entity::ConstSharedPtr> lQueried;
+	lCopy.query(frustum(lProjection), std::back_inserter(lQueried));
+	BOOST_CHECK_EQUAL(lVisible, lQueried.size());
+}
+
+BOOST_AUTO_TEST_CASE( deferred_relocation )
+{
+	const box3f lBoundingBox(vec3f(-128.0f, -128.0f, -128.0f), vec3f(128.0f, 128.0f, 128.0f));
+	std::vector<Entity::SharedPtr> lEntities;
+	for (int i = 0; i < 10; ++i)
+	{
+		auto lEntity = Entity::create();
+		lEntity->setTranslation(vec3f(float(i), 0.0f, 0.0f));
+		lEntities.push_back(std::move(lEntity));
+	}
+	Octree lTree(lBoundingBox, lEntities.begin(), lEntities.end(), 4.0f);
+
+	const auto lFind = [&lTree] (const vec3f& point)
+	{
+		std::vector<Entity::SharedPtr> lResult;
+		lTree.query(box3f(point - vec3f(0.25f), point + vec3f(0.25f)), std::back_inserter(lResult));
+		return lResult;
+	};
+
+	// An Entity that moves several times is relocated once, to where it
+	// ended up. Until then queries see the old position.
+	lEntities[3]->setTranslation(vec3f(50.0f, 0.0f, 0.0f));
+	lEntities[3]->setTranslation(vec3f(-50.0f, 20.0f, 0.0f));
+	lEntities[3]->setTranslation(vec3f(-60.0f, 30.0f, 40.0f));
+	BOOST_CHECK_EQUAL(lFind(vec3f(3.0f, 0.0f, 0.0f)).size(), 1);
+	BOOST_CHECK(lFind(vec3f(-60.0f, 30.0f, 40.0f)).empty());
+	lTree.commitUpdates();
+	BOOST_CHECK(lFind(vec3f(3.0f, 0.0f, 0.0f)).empty());
+	BOOST_REQUIRE_EQUAL(lFind(vec3f(-60.0f, 30.0f, 40.0f)).size(), 1);
+	BOOST_CHECK_EQUAL(lFind(vec3f(-60.0f, 30.0f, 40.0f)).front(), lEntities[3]);
+
+	// Committing twice does nothing.
+	lTree.commitUpdates();
+	BOOST_CHECK_EQUAL(lTree.count(), 10);
+
+	// An Entity that dies while it waits for the commit is simply gone.
+	lEntities[4]->setTranslation(vec3f(100.0f, 0.0f, 0.0f));
+	lEntities[4].reset();
+	lEntities[5]->setTranslation(vec3f(5.0f, 100.0f, 0.0f));
+	lTree.commitUpdates();
+	BOOST_CHECK_EQUAL(lTree.count(), 9);
+	BOOST_CHECK_EQUAL(lFind(vec3f(5.0f, 100.0f, 0.0f)).size(), 1);
+
+	// An Entity that leaves the root is dropped and reported. The others
+	// are still relocated.
+	lEntities[6]->setTranslation(vec3f(500.0f, 0.0f, 0.0f));
+	lEntities[7]->setTranslation(vec3f(7.0f, -100.0f, 0.0f));
+	BOOST_CHECK_THROW(lTree.commitUpdates(), Octree::EntityNotContainedInOctreeBoundingBox);
+	BOOST_CHECK_EQUAL(lTree.count(), 8);
+	BOOST_CHECK_EQUAL(lFind(vec3f(7.0f, -100.0f, 0.0f)).size(), 1);
+
+	// All entities that leave the root in the same frame are reported.
+	lEntities[8]->setTranslation(vec3f(0.0f, 500.0f, 0.0f));
+	lEntities[9]->setTranslation(vec3f(0.0f, 0.0f, -500.0f));
+	try
+	{
+		lTree.commitUpdates();
+		BOOST_ERROR("commitUpdates did not throw.");
+	}
+	catch (const Octree::EntityNotContainedInOctreeBoundingBox& lException)
+	{
+		const auto& lOutside = lException.getEntities();
+		BOOST_REQUIRE_EQUAL(lOutside.size(), 2);
+		BOOST_CHECK(std::count(lOutside.begin(), lOutside.end(), lEntities[8]) == 1);
+		BOOST_CHECK(std::count(lOutside.begin(), lOutside.end(), lEntities[9]) == 1);
+	}
+	BOOST_CHECK_EQUAL(lTree.count(), 6);
+}
+
+BOOST_AUTO_TEST_CASE( deferred_transform_notification )
+{
+	const box3f lBoundingBox(vec3f(-128.0f, -128.0f, -128.0f), vec3f(128.0f, 128.0f, 128.0f));
+	std::vector<Entity::SharedPtr> lEntities;
+	for (int i = 0; i < 10; ++i)
+	{
+		auto lEntity = Entity::create();
+		lEntity->setTranslation(vec3f(float(i), 0.0f, 0.0f));
+		lEntities.push_back(std::move(lEntity));
+	}
+	Octree lTree(lBoundingBox, lEntities.begin(), lEntities.end(), 4.0f);
+	const auto lFind = [&lTree] (const vec3f& point)
+	{
+		std::vector<Entity::SharedPtr> lResult;
+		lTree.query(box3f(point - vec3f(0.25f), point + vec3f(0.25f)), std::back_inserter(lResult));
+		return lResult;
+	};
+
+	Entity::setTransformNotification(Entity::TransformNotification::Deferred);
+
+	// The Octree only hears about the move at the flush.
+	lEntities[3]->setTranslation(vec3f(50.0f, 0.0f, 0.0f));
+	lEntities[3]->setTranslation(vec3f(-60.0f, 30.0f, 40.0f));
+	lTree.commitUpdates();
+	BOOST_CHECK_EQUAL(lFind(vec3f(3.0f, 0.0f, 0.0f)).size(), 1);
+	Entity::flushTransformChanges();
+	lTree.commitUpdates();
+	BOOST_CHECK(lFind(vec3f(3.0f, 0.0f, 0.0f)).empty());
+	BOOST_CHECK_EQUAL(lFind(vec3f(-60.0f, 30.0f, 40.0f)).size(), 1);
+
+	// A pending Entity that dies is not reported.
+	lEntities[4]->setTranslation(vec3f(100.0f, 0.0f, 0.0f));
+	lEntities[4].reset();
+	Entity::flushTransformChanges();
+	lTree.commitUpdates();
+	BOOST_CHECK_EQUAL(lTree.count(), 9);
+
+	// Switching back flushes what is still pending.
+	lEntities[5]->setTranslation(vec3f(5.0f, 100.0f, 0.0f));
+	Entity::setTransformNotification(Entity::TransformNotification::Immediate);
+	lTree.commitUpdates();
+	BOOST_CHECK_EQUAL(lFind(vec3f(5.0f, 100.0f, 0.0f)).size(), 1);
+}
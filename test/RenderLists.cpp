@@ -0,0 +1,129 @@
+#define BOOST_TEST_MODULE RenderLists test
+#include <boost/test/unit_test.hpp>
+
+#include "Entity.hpp"
+#include "Graphics/AmbientLight.hpp"
+#include "Graphics/PointLight.hpp"
+#include "Graphics/RenderLists.hpp"
+#include "Math/vec4f.hpp"
+#include <algorithm>
+
+using namespace gintonic;
+
+namespace
+{
+
+// Lights that need no OpenGL context: point lights have no shadow buffer,
+// and lights that do not cast shadows neither.
+Entity::SharedPtr makeLight(const char* name, const bool castShadow)
+{
+    auto lEntity = Entity::create(name);
+    lEntity->light = PointLight::create(vec4f(1.0f, 1.0f, 1.0f, 1.0f));
+    lEntity->castShadow = castShadow;
+    return lEntity;
+}
+
+bool contains(const std::vector<Entity*>& list, const Entity::SharedPtr& entity)
+{
+    return std::find(list.begin(), list.end(), entity.get()) != list.end();
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(sorts_the_scene)
+{
+    auto lRoot = Entity::create("root");
+    auto lShadow = makeLight("shadow", true);
+    auto lNoShadow = makeLight("no shadow", false);
+    auto lGrandChild = makeLight("grandchild", true);
+    auto lAmbient = Entity::create("ambient");
+    lAmbient->light = AmbientLight::create(vec4f(1.0f, 1.0f, 1.0f, 1.0f));
+    auto lOutside = makeLight("outside", true);
+    lRoot->addChild(lShadow);
+    lRoot->addChild(lNoShadow);
+    lRoot->addChild(lAmbient);
+    lNoShadow->addChild(lGrandChild);
+
+    RenderLists lLists;
+    lLists.setRoot(lRoot.get());
+    BOOST_CHECK(lLists.getRoot() == lRoot.get());
+    BOOST_CHECK_EQUAL(lLists.shadowCastingPointLights().size(), 2);
+    BOOST_CHECK(contains(lLists.shadowCastingPointLights(), lShadow));
+    BOOST_CHECK(contains(lLists.shadowCastingPointLights(), lGrandChild));
+    BOOST_CHECK_EQUAL(lLists.nonShadowCastingLights().size(), 2);
+    BOOST_CHECK(contains(lLists.nonShadowCastingLights(), lNoShadow));
+    BOOST_CHECK(contains(lLists.nonShadowCastingLights(), lAmbient));
+    BOOST_CHECK(lLists.shadowCastingLights().empty());
+    BOOST_CHECK(lLists.shadowCastingGeometries().empty());
+    BOOST_CHECK(lLists.nonShadowCastingGeometries().empty());
+
+    // Nothing changed, so nothing moves.
+    const auto lBefore = lLists.shadowCastingPointLights();
+    lLists.update();
+    BOOST_CHECK(lLists.shadowCastingPointLights() == lBefore);
+    BOOST_CHECK_EQUAL(lLists.nonShadowCastingLights().size(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(follows_changes)
+{
+    auto lRoot = Entity::create("root");
+    auto lFirst = makeLight("first", true);
+    auto lSecond = makeLight("second", false);
+    auto lChild = makeLight("child", true);
+    lRoot->addChild(lFirst);
+    lRoot->addChild(lSecond);
+    lSecond->addChild(lChild);
+
+    RenderLists lLists;
+    lLists.setRoot(lRoot.get());
+
+    // Changing castShadow and light.
+    lSecond->castShadow = true;
+    lFirst->light = nullptr;
+    lLists.update();
+    BOOST_CHECK_EQUAL(lLists.shadowCastingPointLights().size(), 2);
+    BOOST_CHECK(contains(lLists.shadowCastingPointLights(), lSecond));
+    BOOST_CHECK(contains(lLists.shadowCastingPointLights(), lChild));
+    BOOST_CHECK(lLists.nonShadowCastingLights().empty());
+
+    // Attaching a subtree brings its descendants along.
+    auto lSubtree = makeLight("subtree", false);
+    auto lLeaf = makeLight("leaf", false);
+    lSubtree->addChild(lLeaf);
+    lFirst->addChild(lSubtree);
+    lLists.update();
+    BOOST_CHECK_EQUAL(lLists.nonShadowCastingLights().size(), 2);
+    BOOST_CHECK(contains(lLists.nonShadowCastingLights(), lLeaf));
+
+    // So does detaching one.
+    lSecond->unsetParent();
+    lLists.update();
+    BOOST_CHECK(lLists.shadowCastingPointLights().empty());
+    lRoot->addChild(lSecond);
+    lLists.update();
+    BOOST_CHECK_EQUAL(lLists.shadowCastingPointLights().size(), 2);
+
+    // Entities that die leave the lists, also when their slot in the
+    // handle table is reused before the lists are updated.
+    lFirst->removeChild(lSubtree);
+    lSubtree.reset();
+    lLeaf.reset();
+    auto lNew = makeLight("new", false);
+    lRoot->addChild(lNew);
+    lLists.update();
+    BOOST_REQUIRE_EQUAL(lLists.nonShadowCastingLights().size(), 1);
+    BOOST_CHECK(lLists.nonShadowCastingLights().front() == lNew.get());
+
+    // Entities that are moved around within the scene stay.
+    lChild->setParent(lRoot);
+    lLists.update();
+    BOOST_CHECK_EQUAL(lLists.shadowCastingPointLights().size(), 2);
+    BOOST_CHECK(contains(lLists.shadowCastingPointLights(), lChild));
+
+    // Without a root, the lists are empty.
+    lRoot.reset();
+    lLists.update();
+    BOOST_CHECK(lLists.getRoot() == nullptr);
+    BOOST_CHECK(lLists.shadowCastingPointLights().empty());
+    BOOST_CHECK(lLists.nonShadowCastingLights().empty());
+}
@@ -0,0 +1,165 @@
+#define BOOST_TEST_MODULE SpatialHashGridComp test
+#include <boost/test/unit_test.hpp>
+
+#include "BoxCollider.hpp"
+#include "Entity.hpp"
+#include "OctreeComp.hpp"
+#include "SpatialHashGridComp.hpp"
+#include "Transform.hpp"
+#include <algorithm>
+#include <random>
+
+using namespace gintonic;
+
+namespace
+{
+
+// An entity that is in both spatial indices.
+struct Box
+{
+    std::unique_ptr<experimental::Entity> entity;
+    Transform* transform;
+    OctreeComp* octree;
+    SpatialHashGridComp* grid;
+
+    Box(OctreeComp::Node& root, SpatialHashGridComp::Grid& hashGrid,
+        const vec3f& position, const float size)
+        : entity(new experimental::Entity())
+    {
+        auto collider = entity->add<BoxCollider>();
+        collider->localOffset = vec3f(0.0f, 0.0f, 0.0f);
+        collider->localBounds =
+            box3f(vec3f(-size, -size, -size), vec3f(size, size, size));
+        transform = entity->get<Transform>();
+        transform->local().translation = position;
+        octree = entity->add<OctreeComp>();
+        octree->setNode(root);
+        grid = entity->add<SpatialHashGridComp>();
+        grid->setGrid(hashGrid);
+    }
+};
+
+template <class Query>
+void checkSameResults(OctreeComp::Node& root, SpatialHashGridComp::Grid& grid,
+                      Query query)
+{
+    std::vector<const EntityBase*> expected, result;
+    query(root, [&](OctreeComp* comp) {
+        expected.push_back(&comp->getEntity());
+    });
+    query(grid, [&](SpatialHashGridComp* comp) {
+        result.push_back(&comp->getEntity());
+    });
+    std::sort(expected.begin(), expected.end());
+    std::sort(result.begin(), result.end());
+    BOOST_CHECK(result == expected);
+}
+
+void checkSameResults(OctreeComp::Node& root, SpatialHashGridComp::Grid& grid)
+{
+    const box3f volumes[] = {
+        box3f(vec3f(-5.0f, -5.0f, -5.0f), vec3f(5.0f, 5.0f, 5.0f)),
+        box3f(vec3f(-30.0f, 0.0f, 10.0f), vec3f(-10.0f, 40.0f, 12.0f)),
+        box3f(vec3f(-200.0f, -200.0f, -200.0f), vec3f(200.0f, 200.0f, 200.0f))};
+    for (const auto& volume : volumes)
+    {
+        checkSameResults(root, grid, [&](auto& index, auto f) {
+            index.query(volume, f);
+        });
+    }
+    for (const auto radius : {0.5f, 7.0f, 300.0f})
+    {
+        const vec3f point(3.0f, -4.0f, 5.0f);
+        checkSameResults(root, grid, [&](auto& index, auto f) {
+            index.withinRadius(point, radius, f);
+        });
+    }
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(same_results_as_octree)
+{
+    OctreeComp::Node root(vec3f(-256.0f, -256.0f, -256.0f),
+                          vec3f(256.0f, 256.0f, 256.0f));
+    SpatialHashGridComp::Grid grid(2.0f);
+    std::mt19937 generator(11);
+    std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+    std::uniform_real_distribution<float> size(0.1f, 1.5f);
+    std::vector<std::unique_ptr<Box>> boxes;
+    for (int i = 0; i < 20000; ++i)
+    {
+        const vec3f p(position(generator), position(generator),
+                      position(generator));
+        boxes.emplace_back(new Box(root, grid, p, size(generator)));
+    }
+    BOOST_CHECK_EQUAL(grid.count(), boxes.size());
+    grid.rebuild();
+    BOOST_CHECK(grid.cellCount() > 0);
+    BOOST_CHECK(grid.cellCount() <= grid.count());
+    checkSameResults(root, grid);
+
+    // Move half of the entities and remove a quarter of them.
+    for (std::size_t i = 0; i < boxes.size(); i += 2)
+    {
+        boxes[i]->transform->local().translation =
+            vec3f(position(generator), position(generator),
+                  position(generator));
+        boxes[i]->entity->update();
+    }
+    for (std::size_t i = 1; i < boxes.size(); i += 4) boxes[i].reset();
+    BOOST_CHECK_EQUAL(grid.count(), 15000);
+    grid.rebuild();
+    checkSameResults(root, grid);
+
+    // A different cell size gives the same results.
+    grid.setCellSize(9.0f);
+    grid.rebuild();
+    checkSameResults(root, grid);
+}
+
+BOOST_AUTO_TEST_CASE(rebuild_snapshot)
+{
+    OctreeComp::Node root(vec3f(-64.0f, -64.0f, -64.0f),
+                          vec3f(64.0f, 64.0f, 64.0f));
+    SpatialHashGridComp::Grid grid(1.0f);
+    std::unique_ptr<Box> a(new Box(root, grid, vec3f(0.0f, 0.0f, 0.0f), 0.5f));
+    std::unique_ptr<Box> b(new Box(root, grid, vec3f(0.2f, 0.0f, 0.0f), 0.5f));
+    const box3f volume(vec3f(-1.0f, -1.0f, -1.0f), vec3f(1.0f, 1.0f, 1.0f));
+    const auto count = [&]() {
+        std::size_t result = 0;
+        grid.query(volume, [&](const SpatialHashGridComp*) { ++result; });
+        return result;
+    };
+
+    // Nothing is found before the first rebuild.
+    BOOST_CHECK_EQUAL(count(), 0);
+    grid.rebuild();
+    BOOST_CHECK_EQUAL(grid.cellCount(), 1);
+    BOOST_CHECK_EQUAL(count(), 2);
+
+    // Removed components are not reported, even before the next rebuild.
+    b.reset();
+    BOOST_CHECK_EQUAL(count(), 1);
+
+    // Moved components are found at their old place until the next rebuild.
+    a->transform->local().translation = vec3f(10.0f, 0.0f, 0.0f);
+    a->entity->update();
+    BOOST_CHECK_EQUAL(count(), 1);
+    grid.rebuild();
+    BOOST_CHECK_EQUAL(count(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(grid_destroyed_before_components)
+{
+    OctreeComp::Node root(vec3f(-64.0f, -64.0f, -64.0f),
+                          vec3f(64.0f, 64.0f, 64.0f));
+    std::unique_ptr<Box> box;
+    {
+        SpatialHashGridComp::Grid grid(1.0f);
+        box.reset(new Box(root, grid, vec3f(0.0f, 0.0f, 0.0f), 1.0f));
+        grid.rebuild();
+    }
+    // The grid is gone, so the component must not touch it anymore.
+    BOOST_CHECK(box->grid->getGrid() == nullptr);
+}
@@ -0,0 +1,85 @@
+#define BOOST_TEST_MODULE SpatialStatistics test
+#include <boost/test/unit_test.hpp>
+
+#include "Foundation/Octree.hpp"
+#include <random>
+#include <sstream>
+
+using namespace gintonic;
+
+BOOST_AUTO_TEST_CASE( octree_statistics )
+{
+	const box3f lBoundingBox(vec3f(-128.0f, -128.0f, -128.0f), vec3f(128.0f, 128.0f, 128.0f));
+	std::mt19937 lGenerator(5);
+	std::uniform_real_distribution<float> lDist(-120.0f, 120.0f);
+	std::vector<Entity::SharedPtr> lEntities;
+	for (int i = 0; i < 500; ++i)
+	{
+		auto lEntity = Entity::create();
+		lEntity->setTranslation(vec3f(lDist(lGenerator), lDist(lGenerator), lDist(lGenerator)));
+		lEntities.push_back(std::move(lEntity));
+	}
+	Octree lTree(lBoundingBox, lEntities.begin(), lEntities.end());
+
+	std::size_t lNodes = 0, lLeaves = 0, lInner = 0;
+	lTree.forEachNode([&] (const Octree* lNode)
+	{
+		++lNodes;
+		if (lNode->isLeaf()) ++lLeaves;
+		else lInner += lNode->entityCount();
+	});
+
+	const auto lStats = lTree.statistics();
+	BOOST_CHECK_EQUAL(lStats.nodeCount, lNodes);
+	BOOST_CHECK_EQUAL(lStats.leafCount, lLeaves);
+	BOOST_CHECK_EQUAL(lStats.entityCount, lEntities.size());
+	BOOST_CHECK_EQUAL(lStats.innerEntityCount, lInner);
+	BOOST_CHECK(lStats.memoryUsage >= lNodes * sizeof(Octree));
+	BOOST_REQUIRE(!lStats.nodesPerDepth.empty());
+	BOOST_CHECK_EQUAL(lStats.nodesPerDepth[0], 1);
+
+	std::size_t lSum = 0;
+	for (const auto lCount : lStats.nodesPerDepth) lSum += lCount;
+	BOOST_CHECK_EQUAL(lSum, lNodes);
+	lSum = 0;
+	for (const auto lCount : lStats.entitiesPerDepth) lSum += lCount;
+	BOOST_CHECK_EQUAL(lSum, lEntities.size());
+	lSum = 0;
+	for (const auto lCount : lStats.occupancyHistogram) lSum += lCount;
+	BOOST_CHECK_EQUAL(lSum, lNodes);
+
+	std::ostringstream lStream;
+	lStream << lStats;
+	BOOST_CHECK(!lStream.str().empty());
+}
+
+BOOST_AUTO_TEST_CASE( query_counters )
+{
+	const box3f lBoundingBox(vec3f(-128.0f, -128.0f, -128.0f), vec3f(128.0f, 128.0f, 128.0f));
+	std::vector<Entity::SharedPtr> lEntities;
+	for (int i = 0; i < 100; ++i)
+	{
+		auto lEntity = Entity::create();
+		lEntity->setTranslation(vec3f(static_cast<float>(i) - 50.0f, 0.0f, 0.0f));
+		lEntities.push_back(std::move(lEntity));
+	}
+	Octree lTree(lBoundingBox, lEntities.begin(), lEntities.end());
+
+	SpatialQueryCounters::frame();
+	std::vector<Entity::SharedPtr> lResult;
+	lTree.query(box3f(vec3f(-10.0f, -10.0f, -10.0f), vec3f(10.0f, 10.0f, 10.0f)), std::back_inserter(lResult));
+	BOOST_CHECK(!lResult.empty());
+	const auto lFrame = SpatialQueryCounters::frame();
+
+	#ifdef gintonic_WITH_SPATIAL_STATISTICS
+	BOOST_CHECK_EQUAL(lFrame.results, lResult.size());
+	BOOST_CHECK(lFrame.nodesVisited > 0);
+	#else
+	BOOST_CHECK_EQUAL(lFrame.results, 0);
+	BOOST_CHECK_EQUAL(lFrame.nodesVisited, 0);
+	BOOST_CHECK_EQUAL(lFrame.boxesTested, 0);
+	#endif
+
+	// The frame counters start over.
+	BOOST_CHECK_EQUAL(SpatialQueryCounters::frame().results, 0);
+}
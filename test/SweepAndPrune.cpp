@@ -0,0 +1,242 @@
+#define BOOST_TEST_MODULE SweepAndPrune test
+#include <boost/test/unit_test.hpp>
+
+#include "BoxCollider.hpp"
+#include "Entity.hpp"
+#include "SweepAndPrune.hpp"
+#include "Transform.hpp"
+#include <cmath>
+#include <random>
+#include <set>
+
+using namespace gintonic;
+
+namespace
+{
+
+using ColliderPair = std::pair<const Collider*, const Collider*>;
+
+ColliderPair makePair(const Collider* a, const Collider* b)
+{
+    return a < b ? ColliderPair(a, b) : ColliderPair(b, a);
+}
+
+struct Box
+{
+    std::unique_ptr<experimental::Entity> entity;
+    BoxCollider* collider;
+
+    Box(const vec3f& position, const float size)
+        : entity(new experimental::Entity())
+    {
+        collider = entity->add<BoxCollider>();
+        collider->localOffset = vec3f(0.0f, 0.0f, 0.0f);
+        collider->localBounds =
+            box3f(vec3f(-size, -size, -size), vec3f(size, size, size));
+        moveTo(position);
+    }
+
+    void moveTo(const vec3f& position)
+    {
+        entity->get<Transform>()->local().translation = position;
+    }
+};
+
+std::set<ColliderPair> bruteForce(const std::vector<std::unique_ptr<Box>>& boxes)
+{
+    std::set<ColliderPair> result;
+    for (std::size_t i = 0; i < boxes.size(); ++i)
+    {
+        if (!boxes[i]) continue;
+        for (std::size_t j = i + 1; j < boxes.size(); ++j)
+        {
+            if (!boxes[j]) continue;
+            if (intersects(boxes[i]->collider->getGlobalBounds(),
+                           boxes[j]->collider->getGlobalBounds()))
+            {
+                result.insert(
+                    makePair(boxes[i]->collider, boxes[j]->collider));
+            }
+        }
+    }
+    return result;
+}
+
+// Checks that the events are consistent with the pairs that were reported
+// before, and updates them.
+int update(SweepAndPrune& broadphase, std::set<ColliderPair>& active)
+{
+    int errors = 0;
+    std::vector<ColliderPair> ended;
+    broadphase.update(
+        [&](Collider* a, Collider* b, SweepAndPrune::Overlap overlap) {
+            const auto pair = makePair(a, b);
+            switch (overlap)
+            {
+            case SweepAndPrune::Overlap::Begin:
+                if (!active.insert(pair).second) ++errors;
+                break;
+            case SweepAndPrune::Overlap::Persist:
+                if (!active.count(pair)) ++errors;
+                break;
+            case SweepAndPrune::Overlap::End:
+                if (!active.count(pair)) ++errors;
+                ended.push_back(pair);
+                break;
+            }
+        });
+    for (const auto& pair : ended) active.erase(pair);
+    return errors;
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(two_boxes)
+{
+    SweepAndPrune broadphase;
+    Box a(vec3f(0.0f, 0.0f, 0.0f), 1.0f);
+    Box b(vec3f(10.0f, 0.0f, 0.0f), 1.0f);
+    broadphase.add(a.collider);
+    broadphase.add(b.collider);
+
+    std::vector<SweepAndPrune::Overlap> events;
+    const auto record = [&](Collider*, Collider*,
+                            SweepAndPrune::Overlap overlap) {
+        events.push_back(overlap);
+    };
+
+    broadphase.update(record);
+    BOOST_CHECK(events.empty());
+
+    b.moveTo(vec3f(0.5f, 0.5f, 0.0f));
+    broadphase.update(record);
+    BOOST_REQUIRE_EQUAL(events.size(), 1);
+    BOOST_CHECK(events.back() == SweepAndPrune::Overlap::Begin);
+
+    broadphase.update(record);
+    BOOST_REQUIRE_EQUAL(events.size(), 2);
+    BOOST_CHECK(events.back() == SweepAndPrune::Overlap::Persist);
+
+    b.moveTo(vec3f(0.5f, 20.0f, 0.0f));
+    broadphase.update(record);
+    BOOST_REQUIRE_EQUAL(events.size(), 3);
+    BOOST_CHECK(events.back() == SweepAndPrune::Overlap::End);
+
+    broadphase.update(record);
+    BOOST_CHECK_EQUAL(events.size(), 3);
+    BOOST_CHECK_EQUAL(broadphase.pairCount(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(same_pairs_as_brute_force)
+{
+    SweepAndPrune broadphase;
+    std::mt19937 generator(11);
+    std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+    std::uniform_real_distribution<float> size(0.5f, 4.0f);
+    std::uniform_real_distribution<float> step(-1.0f, 1.0f);
+    std::vector<std::unique_ptr<Box>> boxes;
+    std::vector<vec3f> positions;
+    for (int i = 0; i < 600; ++i)
+    {
+        positions.emplace_back(position(generator), position(generator),
+                               position(generator));
+        boxes.emplace_back(new Box(positions.back(), size(generator)));
+        broadphase.add(boxes.back()->collider);
+    }
+
+    std::set<ColliderPair> active;
+    for (int frame = 0; frame < 30; ++frame)
+    {
+        BOOST_CHECK_EQUAL(update(broadphase, active), 0);
+        BOOST_CHECK(active == bruteForce(boxes));
+        BOOST_CHECK_EQUAL(broadphase.pairCount(), active.size());
+        if (frame == 0) BOOST_CHECK(!active.empty());
+
+        // Move everything a little, and destroy or replace some boxes.
+        for (std::size_t i = 0; i < boxes.size(); ++i)
+        {
+            positions[i] += vec3f(step(generator), step(generator),
+                                  step(generator));
+            if (boxes[i]) boxes[i]->moveTo(positions[i]);
+        }
+        const auto victim = static_cast<std::size_t>(frame * 17) % boxes.size();
+        if (boxes[victim])
+        {
+            // Its pairs are gone without End events.
+            for (auto iter = active.begin(); iter != active.end();)
+            {
+                if (iter->first == boxes[victim]->collider ||
+                    iter->second == boxes[victim]->collider)
+                {
+                    iter = active.erase(iter);
+                }
+                else
+                {
+                    ++iter;
+                }
+            }
+            boxes[victim].reset();
+        }
+        else
+        {
+            boxes[victim].reset(new Box(positions[victim], size(generator)));
+            broadphase.add(boxes[victim]->collider);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(bulk_add_and_remove)
+{
+    SweepAndPrune broadphase;
+    std::mt19937 generator(5);
+    std::uniform_real_distribution<float> position(-30.0f, 30.0f);
+    std::vector<std::unique_ptr<Box>> boxes;
+    const auto spawn = [&]() {
+        // Whole positions, so that plenty of boxes touch.
+        boxes.emplace_back(
+            new Box(vec3f(std::floor(position(generator)),
+                          std::floor(position(generator)),
+                          std::floor(position(generator))),
+                    1.0f));
+        broadphase.add(boxes.back()->collider);
+    };
+    for (int i = 0; i < 2000; ++i) spawn();
+
+    std::set<ColliderPair> active;
+    BOOST_CHECK_EQUAL(update(broadphase, active), 0);
+    BOOST_CHECK(active == bruteForce(boxes));
+    BOOST_CHECK(!active.empty());
+
+    // Destroy half of the boxes and spawn as many new ones in a single
+    // frame. Some of the new ones are destroyed before the update. The pairs
+    // of destroyed boxes are gone without End events.
+    for (std::size_t i = 0; i < boxes.size(); i += 2)
+    {
+        for (auto iter = active.begin(); iter != active.end();)
+        {
+            if (iter->first == boxes[i]->collider ||
+                iter->second == boxes[i]->collider)
+            {
+                iter = active.erase(iter);
+            }
+            else
+            {
+                ++iter;
+            }
+        }
+        boxes[i].reset();
+    }
+    for (int i = 0; i < 1000; ++i) spawn();
+    for (std::size_t i = boxes.size() - 100; i < boxes.size(); ++i)
+    {
+        boxes[i].reset();
+    }
+    BOOST_CHECK_EQUAL(broadphase.count(), 1900);
+
+    for (int frame = 0; frame < 2; ++frame)
+    {
+        BOOST_CHECK_EQUAL(update(broadphase, active), 0);
+        BOOST_CHECK(active == bruteForce(boxes));
+        BOOST_CHECK_EQUAL(broadphase.pairCount(), active.size());
+    }
+}
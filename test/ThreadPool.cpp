@@ -0,0 +1,56 @@
+#define BOOST_TEST_MODULE ThreadPool test
+#include <boost/test/unit_test.hpp>
+
+#include "Foundation/ThreadPool.hpp"
+#include <atomic>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+using namespace gintonic;
+
+BOOST_AUTO_TEST_CASE( parallel_for )
+{
+	ThreadPool lPool(3);
+	std::vector<int> lValues(100000, 0);
+	lPool.parallelFor(0, lValues.size(), 100, [&lValues] (const std::size_t first, const std::size_t last)
+	{
+		for (auto i = first; i < last; ++i) lValues[i] = static_cast<int>(i % 7);
+	});
+	for (std::size_t i = 0; i < lValues.size(); ++i)
+	{
+		BOOST_REQUIRE_EQUAL(lValues[i], static_cast<int>(i % 7));
+	}
+}
+
+BOOST_AUTO_TEST_CASE( nested_task_groups )
+{
+	// Every task waits for a nested group. With only two workers this
+	// deadlocks unless waiting threads help out.
+	ThreadPool lPool(2);
+	std::atomic<int> lCounter(0);
+	ThreadPool::TaskGroup lOuter(lPool);
+	for (int i = 0; i < 16; ++i)
+	{
+		lOuter.run([&lPool, &lCounter] ()
+		{
+			ThreadPool::TaskGroup lInner(lPool);
+			for (int j = 0; j < 16; ++j) lInner.run([&lCounter] () { ++lCounter; });
+			lInner.wait();
+		});
+	}
+	lOuter.wait();
+	BOOST_CHECK_EQUAL(lCounter.load(), 256);
+}
+
+BOOST_AUTO_TEST_CASE( exceptions_propagate )
+{
+	for (std::size_t lThreadCount : {0, 2})
+	{
+		ThreadPool lPool(lThreadCount);
+		ThreadPool::TaskGroup lGroup(lPool);
+		lGroup.run([] () { throw std::runtime_error("task failed"); });
+		lGroup.run([] () { /* Does nothing. */ });
+		BOOST_CHECK_THROW(lGroup.wait(), std::runtime_error);
+	}
+}
@@ -0,0 +1,211 @@
+#define BOOST_TEST_MODULE TransformHierarchy test
+#include <boost/test/unit_test.hpp>
+
+#include "Foundation/TransformHierarchy.hpp"
+#include "Math/vec4f.hpp"
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace gintonic;
+
+namespace {
+
+typedef TransformHierarchy::Index Index;
+
+SQT randomSQT(std::mt19937& generator)
+{
+	std::uniform_real_distribution<float> lScale(0.5f, 2.0f);
+	std::uniform_real_distribution<float> lAngle(-3.0f, 3.0f);
+	std::uniform_real_distribution<float> lPosition(-10.0f, 10.0f);
+	return SQT(
+		vec3f(lScale(generator), lScale(generator), lScale(generator)),
+		quatf::axis_angle(vec3f(0.0f, 1.0f, 0.0f), lAngle(generator)),
+		vec3f(lPosition(generator), lPosition(generator), lPosition(generator)));
+}
+
+// The world transform as the product of the chain of local transforms.
+mat4f bruteForceWorld(const TransformHierarchy& hierarchy, const Index index)
+{
+	const mat4f lLocal(hierarchy.getLocal(index));
+	const auto lParent = hierarchy.getParent(index);
+	if (lParent == TransformHierarchy::kNone) return lLocal;
+	return bruteForceWorld(hierarchy, lParent) * lLocal;
+}
+
+bool equal(const mat4f& a, const mat4f& b)
+{
+	for (int i = 0; i < 4; ++i)
+	{
+		if (!(vec4f(a.data[i]) == vec4f(b.data[i]))) return false;
+	}
+	return true;
+}
+
+// A few thousand nodes: many small trees, one root with enough descendants
+// to be split by update, and a long chain.
+std::vector<Index> makeForest(TransformHierarchy& hierarchy, std::mt19937& generator)
+{
+	std::vector<Index> lNodes;
+	std::uniform_int_distribution<int> lCoin(0, 3);
+	for (int i = 0; i < 2000; ++i)
+	{
+		auto lParent = TransformHierarchy::kNone;
+		if (!lNodes.empty() && lCoin(generator) != 0)
+		{
+			std::uniform_int_distribution<std::size_t> lPick(0, lNodes.size() - 1);
+			lParent = lNodes[lPick(generator)];
+		}
+		lNodes.push_back(hierarchy.create(randomSQT(generator), lParent));
+	}
+	const auto lBigRoot = hierarchy.create(randomSQT(generator));
+	lNodes.push_back(lBigRoot);
+	for (int i = 0; i < 3000; ++i)
+	{
+		lNodes.push_back(hierarchy.create(randomSQT(generator), lBigRoot));
+	}
+	for (int i = 0; i < 500; ++i)
+	{
+		lNodes.push_back(hierarchy.create(SQT(), lNodes.back()));
+	}
+	return lNodes;
+}
+
+void checkAll(const TransformHierarchy& hierarchy, const std::vector<Index>& nodes)
+{
+	for (const auto lIndex : nodes)
+	{
+		BOOST_CHECK(equal(hierarchy.getWorld(lIndex), bruteForceWorld(hierarchy, lIndex)));
+	}
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(update_matches_brute_force)
+{
+	std::mt19937 lGenerator(1);
+	TransformHierarchy lHierarchy;
+	const auto lNodes = makeForest(lHierarchy, lGenerator);
+	BOOST_CHECK_EQUAL(lHierarchy.size(), lNodes.size());
+	lHierarchy.update();
+	checkAll(lHierarchy, lNodes);
+
+	// Change some locals, and move a subtree below a node that was created
+	// after it.
+	for (std::size_t i = 0; i < lNodes.size(); i += 7)
+	{
+		lHierarchy.local(lNodes[i]) = randomSQT(lGenerator);
+	}
+	lHierarchy.setParent(lNodes[1], lNodes.back());
+	BOOST_CHECK_EQUAL(lHierarchy.getParent(lNodes[1]), lNodes.back());
+	lHierarchy.update();
+	checkAll(lHierarchy, lNodes);
+}
+
+BOOST_AUTO_TEST_CASE(lazy_world_transforms)
+{
+	std::mt19937 lGenerator(2);
+	TransformHierarchy lHierarchy;
+	const auto lNodes = makeForest(lHierarchy, lGenerator);
+
+	// Without calling update at all.
+	checkAll(lHierarchy, lNodes);
+
+	// Interleave changes of ancestors with reads of descendants.
+	const auto lLeaf = lNodes.back();
+	const auto lAncestor = lNodes[lNodes.size() - 250];
+	for (int i = 0; i < 10; ++i)
+	{
+		lHierarchy.local(lAncestor).translation.x += 1.0f;
+		BOOST_CHECK(equal(lHierarchy.getWorld(lLeaf), bruteForceWorld(lHierarchy, lLeaf)));
+		lHierarchy.local(lLeaf).translation.y += 1.0f;
+	}
+	lHierarchy.update();
+	checkAll(lHierarchy, lNodes);
+}
+
+BOOST_AUTO_TEST_CASE(destroy_makes_children_roots)
+{
+	TransformHierarchy lHierarchy;
+	SQT lLocal;
+	lLocal.translation = vec3f(1.0f, 2.0f, 3.0f);
+	const auto lRoot = lHierarchy.create(lLocal);
+	const auto lChild = lHierarchy.create(lLocal, lRoot);
+	const auto lGrandChild = lHierarchy.create(lLocal, lChild);
+	lHierarchy.update();
+	BOOST_CHECK(vec3f(lHierarchy.getWorld(lGrandChild).data[3]) == vec3f(3.0f, 6.0f, 9.0f));
+
+	lHierarchy.destroy(lChild);
+	BOOST_CHECK_EQUAL(lHierarchy.size(), 2);
+	BOOST_CHECK_EQUAL(lHierarchy.getParent(lGrandChild), TransformHierarchy::kNone);
+	BOOST_CHECK(vec3f(lHierarchy.getWorld(lGrandChild).data[3]) == vec3f(1.0f, 2.0f, 3.0f));
+
+	// The index is handed out again.
+	const auto lNew = lHierarchy.create(SQT(), lRoot);
+	BOOST_CHECK_EQUAL(lNew, lChild);
+	lHierarchy.update();
+	BOOST_CHECK_EQUAL(lHierarchy.getParent(lGrandChild), TransformHierarchy::kNone);
+	BOOST_CHECK(vec3f(lHierarchy.getWorld(lGrandChild).data[3]) == vec3f(1.0f, 2.0f, 3.0f));
+	BOOST_CHECK(vec3f(lHierarchy.getWorld(lNew).data[3]) == vec3f(1.0f, 2.0f, 3.0f));
+}
+
+BOOST_AUTO_TEST_CASE(versions)
+{
+	TransformHierarchy lHierarchy;
+	const auto lRoot = lHierarchy.create();
+	SQT lLocal;
+	lLocal.translation = vec3f(1.0f, 0.0f, 0.0f);
+	const auto lChild = lHierarchy.create(lLocal, lRoot);
+	lHierarchy.update();
+	const auto lRootVersion = lHierarchy.getVersion(lRoot);
+	const auto lChildVersion = lHierarchy.getVersion(lChild);
+
+	// Writing the same value does not change the world transforms.
+	lHierarchy.local(lRoot) = SQT();
+	lHierarchy.update();
+	BOOST_CHECK_EQUAL(lHierarchy.getVersion(lRoot), lRootVersion);
+	BOOST_CHECK_EQUAL(lHierarchy.getVersion(lChild), lChildVersion);
+
+	// Moving the root changes both.
+	lHierarchy.local(lRoot).translation.z = 5.0f;
+	BOOST_CHECK_NE(lHierarchy.getVersion(lChild), lChildVersion);
+	BOOST_CHECK_NE(lHierarchy.getVersion(lRoot), lRootVersion);
+	BOOST_CHECK(vec3f(lHierarchy.getWorld(lChild).data[3]) == vec3f(1.0f, 0.0f, 5.0f));
+}
+
+BOOST_AUTO_TEST_CASE(concurrent_reads_after_update)
+{
+	std::mt19937 lGenerator(3);
+	TransformHierarchy lHierarchy;
+	const auto lNodes = makeForest(lHierarchy, lGenerator);
+	lHierarchy.update();
+	std::vector<mat4f> lExpected;
+	std::vector<std::uint32_t> lVersions;
+	for (const auto lIndex : lNodes)
+	{
+		lExpected.push_back(bruteForceWorld(lHierarchy, lIndex));
+		lVersions.push_back(lHierarchy.getVersion(lIndex));
+	}
+
+	// Every thread reads every node, starting at a different place.
+	std::atomic<int> lMismatches(0);
+	std::vector<std::thread> lThreads;
+	for (std::size_t t = 0; t < 4; ++t)
+	{
+		lThreads.emplace_back([&, t] ()
+		{
+			for (std::size_t i = 0; i < lNodes.size(); ++i)
+			{
+				const auto n = (i + t * lNodes.size() / 4) % lNodes.size();
+				if (!equal(lHierarchy.getWorld(lNodes[n]), lExpected[n])
+					|| lHierarchy.getVersion(lNodes[n]) != lVersions[n])
+				{
+					++lMismatches;
+				}
+			}
+		});
+	}
+	for (auto& lThread : lThreads) lThread.join();
+	BOOST_CHECK_EQUAL(lMismatches.load(), 0);
+}
@@ -0,0 +1,240 @@
+#define BOOST_TEST_MODULE TriangleBVH test
+#include <boost/test/unit_test.hpp>
+
+#include "Foundation/TriangleBVH.hpp"
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <vector>
+
+using namespace gintonic;
+
+namespace {
+
+// A soup of random triangles, with four floats per vertex like a Mesh.
+struct Soup
+{
+	std::vector<std::uint32_t> indices;
+	std::vector<float> positions;
+
+	Soup(const std::size_t count, const unsigned seed)
+	{
+		std::mt19937 lGenerator(seed);
+		std::uniform_real_distribution<float> lPosition(-50.0f, 50.0f);
+		std::uniform_real_distribution<float> lOffset(-3.0f, 3.0f);
+		for (std::size_t t = 0; t < count; ++t)
+		{
+			const float lCenter[3] = {lPosition(lGenerator), lPosition(lGenerator), lPosition(lGenerator)};
+			for (int v = 0; v < 3; ++v)
+			{
+				indices.push_back(static_cast<std::uint32_t>(positions.size() / 4));
+				for (int i = 0; i < 3; ++i) positions.push_back(lCenter[i] + lOffset(lGenerator));
+				positions.push_back(0.0f);
+			}
+		}
+	}
+
+	TriangleBVH build() const
+	{
+		return TriangleBVH(indices.data(), indices.size(), positions.data(), 4);
+	}
+
+	vec3f vertex(const std::uint32_t triangle, const int v) const
+	{
+		const float* p = &positions[4 * indices[3 * triangle + v]];
+		return vec3f(p[0], p[1], p[2]);
+	}
+
+	// Test every triangle, one at a time.
+	bool raycast(const ray3f& ray, const float maxDistance, float& distance, std::uint32_t& triangle) const
+	{
+		bool lHit = false;
+		distance = maxDistance;
+		for (std::uint32_t t = 0; t < indices.size() / 3; ++t)
+		{
+			const auto lV0 = vertex(t, 0);
+			const auto lE1 = vertex(t, 1) - lV0;
+			const auto lE2 = vertex(t, 2) - lV0;
+			const auto lP = cross(ray.direction, lE2);
+			const auto lDeterminant = dot(lE1, lP);
+			if (lDeterminant == 0.0f) continue;
+			const auto lT = ray.origin - lV0;
+			const auto lQ = cross(lT, lE1);
+			const auto lU = dot(lT, lP) / lDeterminant;
+			const auto lV = dot(ray.direction, lQ) / lDeterminant;
+			const auto lDistance = dot(lE2, lQ) / lDeterminant;
+			if (lU < 0.0f || lV < 0.0f || lU + lV > 1.0f) continue;
+			if (lDistance < 0.0f || lDistance > distance) continue;
+			distance = lDistance;
+			triangle = t;
+			lHit = true;
+		}
+		return lHit;
+	}
+};
+
+std::vector<ray3f> randomRays(const std::size_t count, const unsigned seed)
+{
+	std::mt19937 lGenerator(seed);
+	std::uniform_real_distribution<float> lPosition(-60.0f, 60.0f);
+	std::vector<ray3f> lResult;
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		const vec3f lOrigin(lPosition(lGenerator), lPosition(lGenerator), lPosition(lGenerator));
+		const vec3f lTarget(lPosition(lGenerator), lPosition(lGenerator), lPosition(lGenerator));
+		lResult.emplace_back(lOrigin, (lTarget - lOrigin).normalize());
+	}
+	return lResult;
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE( empty )
+{
+	TriangleBVH lBVH;
+	float lDistance;
+	std::uint32_t lTriangle;
+	const ray3f lRay(vec3f(0.0f, 0.0f, 0.0f), vec3f(1.0f, 0.0f, 0.0f));
+	BOOST_CHECK(!lBVH.raycast(lRay, 100.0f, lDistance, lTriangle));
+	BOOST_CHECK(!lBVH.occluded(lRay, 100.0f));
+	BOOST_CHECK_EQUAL(lBVH.triangleCount(), 0);
+}
+
+BOOST_AUTO_TEST_CASE( single_triangle )
+{
+	const std::uint32_t lIndices[] = {0, 1, 2};
+	const float lPositions[] = {0.0f, 0.0f, 5.0f, 2.0f, 0.0f, 5.0f, 0.0f, 2.0f, 5.0f};
+	const TriangleBVH lBVH(lIndices, 3, lPositions, 3);
+	BOOST_CHECK_EQUAL(lBVH.triangleCount(), 1);
+	BOOST_CHECK_EQUAL(lBVH.nodeCount(), 1);
+
+	float lDistance;
+	std::uint32_t lTriangle;
+	const ray3f lRay(vec3f(0.5f, 0.5f, 0.0f), vec3f(0.0f, 0.0f, 1.0f));
+	BOOST_REQUIRE(lBVH.raycast(lRay, 100.0f, lDistance, lTriangle));
+	BOOST_CHECK_CLOSE(lDistance, 5.0f, 1e-4f);
+	BOOST_CHECK_EQUAL(lTriangle, 0);
+
+	// Triangles are hit from both sides, but not beyond maxDistance.
+	const ray3f lBack(vec3f(0.5f, 0.5f, 10.0f), vec3f(0.0f, 0.0f, -1.0f));
+	BOOST_CHECK(lBVH.raycast(lBack, 100.0f, lDistance, lTriangle));
+	BOOST_CHECK(!lBVH.raycast(lBack, 4.0f, lDistance, lTriangle));
+	BOOST_CHECK(!lBVH.occluded(lBack, 4.0f));
+
+	// Outside the triangle, and parallel to it.
+	BOOST_CHECK(!lBVH.occluded(ray3f(vec3f(1.5f, 1.5f, 0.0f), vec3f(0.0f, 0.0f, 1.0f)), 100.0f));
+	BOOST_CHECK(!lBVH.occluded(ray3f(vec3f(-1.0f, 0.5f, 5.0f), vec3f(1.0f, 0.0f, 0.0f)), 100.0f));
+}
+
+BOOST_AUTO_TEST_CASE( matches_brute_force )
+{
+	const Soup lSoup(3000, 1);
+	const auto lBVH = lSoup.build();
+	BOOST_CHECK_EQUAL(lBVH.triangleCount(), 3000);
+	BOOST_CHECK(lBVH.nodeCount() > 1);
+
+	std::size_t lHits = 0;
+	for (const auto& lRay : randomRays(500, 2))
+	{
+		float lExpectedDistance = 0.0f, lDistance = 0.0f;
+		std::uint32_t lExpectedTriangle = 0, lTriangle = 0;
+		const auto lExpected = lSoup.raycast(lRay, 80.0f, lExpectedDistance, lExpectedTriangle);
+		BOOST_REQUIRE_EQUAL(lBVH.raycast(lRay, 80.0f, lDistance, lTriangle), lExpected);
+		BOOST_REQUIRE_EQUAL(lBVH.occluded(lRay, 80.0f), lExpected);
+		if (!lExpected) continue;
+		++lHits;
+		BOOST_CHECK_CLOSE(lDistance, lExpectedDistance, 1e-3f);
+
+		// Two triangles may be hit at practically the same distance.
+		if (lTriangle != lExpectedTriangle)
+		{
+			float lOtherDistance;
+			std::uint32_t lOtherTriangle;
+			const std::uint32_t lIndices[] = {0, 1, 2};
+			const float lPositions[] =
+			{
+				lSoup.vertex(lTriangle, 0).x, lSoup.vertex(lTriangle, 0).y, lSoup.vertex(lTriangle, 0).z,
+				lSoup.vertex(lTriangle, 1).x, lSoup.vertex(lTriangle, 1).y, lSoup.vertex(lTriangle, 1).z,
+				lSoup.vertex(lTriangle, 2).x, lSoup.vertex(lTriangle, 2).y, lSoup.vertex(lTriangle, 2).z
+			};
+			BOOST_CHECK(TriangleBVH(lIndices, 3, lPositions, 3).raycast(lRay, 80.0f, lOtherDistance, lOtherTriangle));
+		}
+	}
+	BOOST_CHECK(lHits > 50);
+}
+
+BOOST_AUTO_TEST_CASE( coincident_centroids )
+{
+	// Many copies of the same triangle cannot be split by their centroids.
+	std::vector<std::uint32_t> lIndices;
+	const float lPositions[] = {0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f};
+	for (int i = 0; i < 100; ++i)
+	{
+		lIndices.push_back(0);
+		lIndices.push_back(1);
+		lIndices.push_back(2);
+	}
+	const TriangleBVH lBVH(lIndices.data(), lIndices.size(), lPositions, 3);
+	BOOST_CHECK_EQUAL(lBVH.triangleCount(), 100);
+	BOOST_CHECK(lBVH.nodeCount() > 1);
+	float lDistance;
+	std::uint32_t lTriangle;
+	BOOST_CHECK(lBVH.raycast(ray3f(vec3f(0.2f, 0.2f, -1.0f), vec3f(0.0f, 0.0f, 1.0f)), 10.0f, lDistance, lTriangle));
+	BOOST_CHECK_CLOSE(lDistance, 1.0f, 1e-4f);
+	BOOST_CHECK(lTriangle < 100);
+}
+
+BOOST_AUTO_TEST_CASE( splits_clusters_at_the_gap )
+{
+	// Four copies of a triangle at the origin and twelve far away. The bins
+	// in between are empty. The surface area heuristic splits at the gap,
+	// giving a root and two leaves. A split at the median would put four of
+	// the distant triangles with the near ones and need more nodes.
+	std::vector<std::uint32_t> lIndices;
+	const float lPositions[] =
+	{
+		0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f,
+		100.0f, 0.0f, 0.0f, 101.0f, 0.0f, 0.0f, 100.0f, 1.0f, 0.0f
+	};
+	for (std::uint32_t i = 0; i < 16; ++i)
+	{
+		const std::uint32_t lFirst = i < 4 ? 0 : 3;
+		lIndices.push_back(lFirst);
+		lIndices.push_back(lFirst + 1);
+		lIndices.push_back(lFirst + 2);
+	}
+	const TriangleBVH lBVH(lIndices.data(), lIndices.size(), lPositions, 3);
+	BOOST_CHECK_EQUAL(lBVH.triangleCount(), 16);
+	BOOST_CHECK_EQUAL(lBVH.nodeCount(), 3);
+}
+
+BOOST_AUTO_TEST_CASE( serialization )
+{
+	const Soup lSoup(500, 3);
+	const auto lBVH = lSoup.build();
+
+	std::stringstream lStream;
+	{
+		boost::archive::binary_oarchive lOutput(lStream);
+		lOutput << lBVH;
+	}
+	TriangleBVH lLoaded;
+	{
+		boost::archive::binary_iarchive lInput(lStream);
+		lInput >> lLoaded;
+	}
+	BOOST_CHECK_EQUAL(lLoaded.triangleCount(), lBVH.triangleCount());
+	BOOST_CHECK_EQUAL(lLoaded.nodeCount(), lBVH.nodeCount());
+	for (const auto& lRay : randomRays(100, 4))
+	{
+		float lDistance, lLoadedDistance;
+		std::uint32_t lTriangle, lLoadedTriangle;
+		const auto lHit = lBVH.raycast(lRay, 200.0f, lDistance, lTriangle);
+		BOOST_REQUIRE_EQUAL(lLoaded.raycast(lRay, 200.0f, lLoadedDistance, lLoadedTriangle), lHit);
+		if (!lHit) continue;
+		BOOST_CHECK_EQUAL(lLoadedDistance, lDistance);
+		BOOST_CHECK_EQUAL(lLoadedTriangle, lTriangle);
+	}
+}
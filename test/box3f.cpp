@@ -249,4 +249,49 @@ BOOST_AUTO_TEST_CASE ( collisions_test )
 
 	BOOST_CHECK_EQUAL(intersects(a, b), false);
 
-}
\ No newline at end of file
+}
+
+BOOST_AUTO_TEST_CASE ( crossing_touching_and_disjoint_boxes )
+{
+	// Two slabs that cross like a plus sign. Neither contains a corner of
+	// the other.
+	const box3f a({ -10.0f, -1.0f, -1.0f }, { 10.0f, 1.0f, 1.0f });
+	const box3f b({ -1.0f, -10.0f, -1.0f }, { 1.0f, 10.0f, 1.0f });
+	BOOST_CHECK_EQUAL(intersects(a, b), true);
+	BOOST_CHECK_EQUAL(intersects(b, a), true);
+
+	// Three bars along the three axes.
+	const box3f c({ -1.0f, -1.0f, -10.0f }, { 1.0f, 1.0f, 10.0f });
+	BOOST_CHECK_EQUAL(intersects(a, c), true);
+	BOOST_CHECK_EQUAL(intersects(b, c), true);
+
+	// Boxes that share only a face, an edge or a corner touch.
+	const box3f lUnit({ 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f });
+	BOOST_CHECK_EQUAL(intersects(lUnit, box3f({ 1.0f, 0.0f, 0.0f }, { 2.0f, 1.0f, 1.0f })), true);
+	BOOST_CHECK_EQUAL(intersects(lUnit, box3f({ 1.0f, 1.0f, 0.0f }, { 2.0f, 2.0f, 1.0f })), true);
+	BOOST_CHECK_EQUAL(intersects(lUnit, box3f({ -1.0f, -1.0f, -1.0f }, { 0.0f, 0.0f, 0.0f })), true);
+
+	// Boxes that are separated along one axis only, on either side.
+	const vec3f lAxes[] = { { 1.5f, 0.0f, 0.0f }, { 0.0f, 1.5f, 0.0f }, { 0.0f, 0.0f, 1.5f } };
+	for (const auto& lAxis : lAxes)
+	{
+		for (const float lSide : { -1.0f, 1.0f })
+		{
+			const vec3f lOffset = lSide * lAxis;
+			const box3f lOther(lUnit.minCorner + lOffset, lUnit.maxCorner + lOffset);
+			BOOST_CHECK_EQUAL(intersects(lUnit, lOther), false);
+			BOOST_CHECK_EQUAL(intersects(lOther, lUnit), false);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE ( distance_to_point_test )
+{
+	const box3f a({ -1.0f, -2.0f, -3.0f }, { 1.0f, 2.0f, 3.0f });
+
+	BOOST_CHECK_EQUAL(distance2(a, vec3f(0.0f, 0.0f, 0.0f)), 0.0f);
+	BOOST_CHECK_EQUAL(distance2(a, vec3f(1.0f, 2.0f, 3.0f)), 0.0f);
+	BOOST_CHECK_EQUAL(distance2(a, vec3f(4.0f, 0.0f, 0.0f)), 9.0f);
+	BOOST_CHECK_EQUAL(distance2(a, vec3f(0.0f, -6.0f, 0.0f)), 16.0f);
+	BOOST_CHECK_EQUAL(distance2(a, vec3f(2.0f, 3.0f, -5.0f)), 6.0f);
+}
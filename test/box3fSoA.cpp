@@ -0,0 +1,124 @@
+#define BOOST_TEST_MODULE box3fSoA test
+#include <boost/test/unit_test.hpp>
+
+#include "Math/box3fSoA.hpp"
+#include "Math/mat4f.hpp"
+#include "Math/SQT.hpp"
+#include <random>
+#include <vector>
+
+using namespace gintonic;
+
+namespace {
+
+std::vector<box3f> randomBoxes(const std::size_t count, const unsigned seed)
+{
+	std::mt19937 lGenerator(seed);
+	std::uniform_real_distribution<float> lPosition(-50.0f, 50.0f);
+	std::uniform_real_distribution<float> lSize(0.0f, 10.0f);
+	std::vector<box3f> lResult;
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		const vec3f lMin(lPosition(lGenerator), lPosition(lGenerator), lPosition(lGenerator));
+		lResult.emplace_back(lMin, lMin + vec3f(lSize(lGenerator), lSize(lGenerator), lSize(lGenerator)));
+	}
+	return lResult;
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE( push_get_and_swap_remove )
+{
+	const auto lBoxes = randomBoxes(11, 1);
+	box3fSoA lArray;
+	for (const auto& lBox : lBoxes) lArray.push_back(lBox);
+	BOOST_REQUIRE_EQUAL(lArray.size(), lBoxes.size());
+	for (std::size_t i = 0; i < lBoxes.size(); ++i)
+	{
+		BOOST_CHECK_EQUAL(lArray.get(i).minCorner, lBoxes[i].minCorner);
+		BOOST_CHECK_EQUAL(lArray.get(i).maxCorner, lBoxes[i].maxCorner);
+	}
+
+	lArray.swapRemove(2);
+	BOOST_CHECK_EQUAL(lArray.size(), 10);
+	BOOST_CHECK_EQUAL(lArray.get(2).minCorner, lBoxes[10].minCorner);
+	lArray.swapRemove(9);
+	BOOST_CHECK_EQUAL(lArray.size(), 9);
+
+	lArray.set(0, lBoxes[5]);
+	BOOST_CHECK_EQUAL(lArray.get(0).maxCorner, lBoxes[5].maxCorner);
+
+	lArray.clear();
+	BOOST_CHECK(lArray.empty());
+}
+
+BOOST_AUTO_TEST_CASE( intersecting_matches_scalar_tests )
+{
+	const auto lBoxes = randomBoxes(1001, 2);
+	box3fSoA lArray;
+	for (const auto& lBox : lBoxes) lArray.push_back(lBox);
+
+	const box3f lVolume(vec3f(-20.0f, -5.0f, 0.0f), vec3f(10.0f, 25.0f, 30.0f));
+	std::vector<std::size_t> lResult, lExpected;
+	lArray.intersecting(lVolume, [&lResult] (const std::size_t i) { lResult.push_back(i); });
+	for (std::size_t i = 0; i < lBoxes.size(); ++i)
+	{
+		if (intersects(lVolume, lBoxes[i])) lExpected.push_back(i);
+	}
+	BOOST_CHECK(!lExpected.empty());
+	BOOST_CHECK(lResult == lExpected);
+
+	mat4f lProjection;
+	lProjection.set_perspective(deg2rad(60.0f), 1.0f, 1.0f, 40.0f);
+	const frustum lFrustum(lProjection);
+	lResult.clear();
+	lExpected.clear();
+	lArray.intersecting(lFrustum, frustum::kAllPlanes, [&lResult] (const std::size_t i) { lResult.push_back(i); });
+	for (std::size_t i = 0; i < lBoxes.size(); ++i)
+	{
+		if (intersects(lFrustum, lBoxes[i])) lExpected.push_back(i);
+	}
+	BOOST_CHECK(!lExpected.empty());
+	BOOST_CHECK(lResult == lExpected);
+}
+
+BOOST_AUTO_TEST_CASE( assign_transformed_matches_corners )
+{
+	const auto lBoxes = randomBoxes(13, 3);
+	std::mt19937 lGenerator(4);
+	std::uniform_real_distribution<float> lAngle(-3.0f, 3.0f);
+	std::uniform_real_distribution<float> lScale(0.5f, 2.0f);
+	std::vector<mat4f, allocator<mat4f>> lMatrices;
+	box3fSoA lArray;
+	for (const auto& lBox : lBoxes)
+	{
+		const SQT lTransform(
+			vec3f(lScale(lGenerator), lScale(lGenerator), lScale(lGenerator)),
+			quatf::yaw_pitch_roll(lAngle(lGenerator), lAngle(lGenerator), lAngle(lGenerator)),
+			vec3f(lAngle(lGenerator), lAngle(lGenerator), lAngle(lGenerator)));
+		lMatrices.emplace_back(lTransform);
+		lArray.push_back(lBox);
+	}
+	std::vector<const mat4f*> lPointers;
+	for (const auto& lMatrix : lMatrices) lPointers.push_back(&lMatrix);
+
+	box3fSoA lTransformed;
+	lTransformed.assignTransformed(lArray, lPointers.data());
+	BOOST_REQUIRE_EQUAL(lTransformed.size(), lBoxes.size());
+	for (std::size_t i = 0; i < lBoxes.size(); ++i)
+	{
+		// The bounding box of the eight transformed corners.
+		std::vector<vec3f, allocator<vec3f>> lCorners;
+		lBoxes[i].getCorners(std::back_inserter(lCorners));
+		box3f lExpected(lMatrices[i].apply_to_point(lCorners[0]), lMatrices[i].apply_to_point(lCorners[0]));
+		for (const auto& lCorner : lCorners) lExpected.addPoint(lMatrices[i].apply_to_point(lCorner));
+
+		const auto lResult = lTransformed.get(i);
+		BOOST_CHECK_SMALL(lResult.minCorner.x - lExpected.minCorner.x, 1e-4f);
+		BOOST_CHECK_SMALL(lResult.minCorner.y - lExpected.minCorner.y, 1e-4f);
+		BOOST_CHECK_SMALL(lResult.minCorner.z - lExpected.minCorner.z, 1e-4f);
+		BOOST_CHECK_SMALL(lResult.maxCorner.x - lExpected.maxCorner.x, 1e-4f);
+		BOOST_CHECK_SMALL(lResult.maxCorner.y - lExpected.maxCorner.y, 1e-4f);
+		BOOST_CHECK_SMALL(lResult.maxCorner.z - lExpected.maxCorner.z, 1e-4f);
+	}
+}
@@ -0,0 +1,69 @@
+#define BOOST_TEST_MODULE frustum test
+#include <boost/test/unit_test.hpp>
+
+#include "Math/frustum.hpp"
+#include <cmath>
+
+using namespace gintonic;
+
+namespace {
+
+frustum makeFrustum()
+{
+	// The default camera: looking down the negative Z-axis from the origin.
+	mat4f lProjection;
+	lProjection.set_perspective(deg2rad(90.0f), 1.0f, 1.0f, 100.0f);
+	return frustum(lProjection);
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE( plane_extraction )
+{
+	const auto lFrustum = makeFrustum();
+	for (const auto& lPlane : lFrustum.planes)
+	{
+		const auto lLength = std::sqrt(lPlane.x * lPlane.x + lPlane.y * lPlane.y + lPlane.z * lPlane.z);
+		BOOST_CHECK_CLOSE(lLength, 1.0f, 0.001f);
+	}
+	BOOST_CHECK_CLOSE(lFrustum.planes[frustum::kNear].z, -1.0f, 0.001f);
+	BOOST_CHECK_CLOSE(lFrustum.planes[frustum::kNear].w, -1.0f, 0.01f);
+	BOOST_CHECK_CLOSE(lFrustum.planes[frustum::kFar].z, 1.0f, 0.001f);
+	BOOST_CHECK_CLOSE(lFrustum.planes[frustum::kFar].w, 100.0f, 0.01f);
+}
+
+BOOST_AUTO_TEST_CASE( points )
+{
+	const auto lFrustum = makeFrustum();
+	BOOST_CHECK(lFrustum.contains(vec3f(0.0f, 0.0f, -5.0f)));
+	BOOST_CHECK(lFrustum.contains(vec3f(4.0f, -4.0f, -5.0f)));
+	BOOST_CHECK(!lFrustum.contains(vec3f(6.0f, 0.0f, -5.0f)));
+	BOOST_CHECK(!lFrustum.contains(vec3f(0.0f, 0.0f, 5.0f)));
+	BOOST_CHECK(!lFrustum.contains(vec3f(0.0f, 0.0f, -0.5f)));
+	BOOST_CHECK(!lFrustum.contains(vec3f(0.0f, 0.0f, -200.0f)));
+	BOOST_CHECK(frustum().contains(vec3f(1000.0f, -1000.0f, 1000.0f)));
+}
+
+BOOST_AUTO_TEST_CASE( boxes_and_plane_masks )
+{
+	const auto lFrustum = makeFrustum();
+
+	unsigned lMask = frustum::kAllPlanes;
+	BOOST_CHECK_EQUAL(lFrustum.classify(box3f(vec3f(-1.0f, -1.0f, -11.0f), vec3f(1.0f, 1.0f, -9.0f)), lMask), frustum::kInside);
+	BOOST_CHECK_EQUAL(lMask, 0);
+
+	lMask = frustum::kAllPlanes;
+	BOOST_CHECK_EQUAL(lFrustum.classify(box3f(vec3f(-1.0f, -1.0f, 1.0f), vec3f(1.0f, 1.0f, 2.0f)), lMask), frustum::kOutside);
+
+	// A box that straddles the far plane only keeps the far plane in its mask.
+	lMask = frustum::kAllPlanes;
+	BOOST_CHECK_EQUAL(lFrustum.classify(box3f(vec3f(-1.0f, -1.0f, -110.0f), vec3f(1.0f, 1.0f, -90.0f)), lMask), frustum::kIntersecting);
+	BOOST_CHECK_EQUAL(lMask, 1u << frustum::kFar);
+
+	// Planes that are not in the mask are ignored.
+	lMask = 1u << frustum::kFar;
+	BOOST_CHECK_EQUAL(lFrustum.classify(box3f(vec3f(100.0f, -1.0f, -20.0f), vec3f(101.0f, 1.0f, -10.0f)), lMask), frustum::kInside);
+
+	BOOST_CHECK(intersects(lFrustum, box3f(vec3f(-1000.0f), vec3f(1000.0f))));
+	BOOST_CHECK(!lFrustum.contains(box3f(vec3f(-1000.0f), vec3f(1000.0f))));
+}
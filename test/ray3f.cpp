@@ -0,0 +1,58 @@
+#define BOOST_TEST_MODULE ray3f test
+#include <boost/test/unit_test.hpp>
+
+#include "Math/ray3f.hpp"
+#include <limits>
+
+using namespace gintonic;
+
+namespace {
+
+const float kInfinity = std::numeric_limits<float>::infinity();
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE( slabs )
+{
+	const box3f lBox(vec3f(-1.0f, -1.0f, -1.0f), vec3f(1.0f, 1.0f, 1.0f));
+	float lDistance = -1.0f;
+
+	const ray3f lHit(vec3f(-5.0f, 0.5f, 0.0f), vec3f(1.0f, 0.0f, 0.0f));
+	BOOST_CHECK(lHit.intersects(lBox, 0.0f, kInfinity, lDistance));
+	BOOST_CHECK_CLOSE(lDistance, 4.0f, 0.001f);
+	BOOST_CHECK(!lHit.intersects(lBox, 0.0f, 3.0f, lDistance));
+
+	const ray3f lAway(vec3f(-5.0f, 0.5f, 0.0f), vec3f(-1.0f, 0.0f, 0.0f));
+	BOOST_CHECK(!intersects(lAway, lBox));
+
+	const ray3f lMiss(vec3f(-5.0f, 2.0f, 0.0f), vec3f(1.0f, 0.0f, 0.0f));
+	BOOST_CHECK(!intersects(lMiss, lBox));
+
+	const ray3f lDiagonal(vec3f(-5.0f, -5.0f, -5.0f), vec3f(1.0f, 1.0f, 1.0f));
+	BOOST_CHECK(lDiagonal.intersects(lBox, 0.0f, kInfinity, lDistance));
+	BOOST_CHECK_CLOSE(lDistance, 4.0f, 0.001f);
+
+	// A ray that starts inside the box hits it at distance zero.
+	const ray3f lInside(vec3f(0.0f, 0.0f, 0.0f), vec3f(0.0f, 0.0f, -1.0f));
+	BOOST_CHECK(lInside.intersects(lBox, 0.0f, kInfinity, lDistance));
+	BOOST_CHECK_EQUAL(lDistance, 0.0f);
+}
+
+BOOST_AUTO_TEST_CASE( boundaries_and_degenerate_boxes )
+{
+	const box3f lBox(vec3f(-1.0f, -1.0f, -1.0f), vec3f(1.0f, 1.0f, 1.0f));
+	float lDistance = -1.0f;
+
+	// Rays that run inside one of the faces hit the box.
+	BOOST_CHECK(intersects(ray3f(vec3f(-5.0f, 1.0f, 0.0f), vec3f(1.0f, 0.0f, 0.0f)), lBox));
+	BOOST_CHECK(intersects(ray3f(vec3f(-5.0f, -1.0f, -1.0f), vec3f(1.0f, 0.0f, 0.0f)), lBox));
+
+	// A point box on the ray.
+	const box3f lPoint(vec3f(3.0f, 2.0f, 1.0f), vec3f(3.0f, 2.0f, 1.0f));
+	const ray3f lRay(vec3f(-3.0f, 2.0f, 1.0f), vec3f(1.0f, 0.0f, 0.0f));
+	BOOST_CHECK(lRay.intersects(lPoint, 0.0f, kInfinity, lDistance));
+	BOOST_CHECK_CLOSE(lDistance, 6.0f, 0.001f);
+	BOOST_CHECK(!intersects(ray3f(vec3f(-3.0f, 2.5f, 1.0f), vec3f(1.0f, 0.0f, 0.0f)), lPoint));
+
+	BOOST_CHECK_EQUAL(lRay.pointAt(6.0f), lPoint.minCorner);
+}
@@ -0,0 +1,707 @@
+/*
+ * SpatialBenchmark
+ *
+ * Measures the spatial indices on synthetic scenes and writes the results as
+ * JSON. The scenes only depend on the seed, so two runs with the same
+ * arguments do the same work and their results can be compared to catch
+ * performance regressions.
+ *
+ * Every index gets the same objects, the same motion and the same queries.
+ * The Octree and the LinearOctree store the old Entity class, whose bounds
+ * come from its mesh. Creating a mesh needs a rendering context, so for those
+ * two indices the objects are points at the center of their box. The other
+ * indices store the bounds of a BoxCollider.
+ *
+ * Measurements that do not apply to an index, like the bulk build of the
+ * OctreeComp::Node, are written as null.
+ */
+
+#include "AABBTreeComp.hpp"
+#include "BoxCollider.hpp"
+#include "Entity.hpp"
+#include "OctreeComp.hpp"
+#include "SpatialHashGridComp.hpp"
+#include "Transform.hpp"
+#include "Foundation/LinearOctree.hpp"
+#include "Foundation/Octree.hpp"
+#include "Math/frustum.hpp"
+#include "Math/mat4f.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace gt = gintonic;
+
+namespace
+{
+
+// Half of the length of the edges of the world cube.
+constexpr float kWorldExtent = 512.0f;
+
+// The time step of a frame of motion, in seconds.
+constexpr float kTimeStep = 1.0f / 60.0f;
+
+// The cell size of the SpatialHashGridComp::Grid. About the size of the
+// small objects.
+constexpr float kCellSize = 4.0f;
+
+const double kNotApplicable = std::numeric_limits<double>::quiet_NaN();
+
+const char* const kWorkloads[] =
+{
+	"uniform",
+	"clustered",
+	"mixed_sizes",
+	"static_and_dynamic"
+};
+
+const char* const kIndices[] =
+{
+	"Octree",
+	"LinearOctree",
+	"OctreeComp",
+	"AABBTreeComp",
+	"SpatialHashGridComp"
+};
+
+struct Options
+{
+	std::size_t objects = 20000;
+	std::size_t frames = 10;
+	std::size_t boxQueries = 1000;
+	std::size_t frustumQueries = 100;
+	unsigned seed = 1;
+	std::string workload;
+	std::string index;
+	std::string output;
+};
+
+struct Object
+{
+	gt::vec3f position;
+	gt::vec3f velocity;
+	float halfSize;
+	bool dynamic;
+};
+
+typedef std::vector<Object, gt::allocator<Object>> ObjectList;
+
+struct Scene
+{
+	ObjectList objects;
+	std::vector<gt::box3f, gt::allocator<gt::box3f>> boxQueries;
+	std::vector<gt::frustum, gt::allocator<gt::frustum>> frustumQueries;
+};
+
+struct Result
+{
+	std::string index;
+	std::string workload;
+	double insertMilliseconds = kNotApplicable;
+	double bulkBuildMilliseconds = kNotApplicable;
+	double updateMillisecondsPerFrame = kNotApplicable;
+	double boxQueryMicroseconds = kNotApplicable;
+	double frustumQueryMicroseconds = kNotApplicable;
+	std::size_t boxQueryResults = 0;
+	std::size_t frustumQueryResults = 0;
+	std::size_t memoryBytes = 0;
+};
+
+// An entity of the component system, for the indices that are components.
+struct Body
+{
+	std::unique_ptr<gt::experimental::Entity> entity;
+	gt::Transform* transform;
+};
+
+// An output iterator that calls a unary function for everything that is
+// written to it.
+template <class F> struct FunctionIterator
+{
+	F f;
+
+	FunctionIterator& operator * () noexcept { return *this; }
+	FunctionIterator& operator ++ () noexcept { return *this; }
+	FunctionIterator& operator ++ (int) noexcept { return *this; }
+
+	template <class T> FunctionIterator& operator = (const T& value)
+	{
+		f(value);
+		return *this;
+	}
+};
+
+template <class F> FunctionIterator<F> makeFunctionIterator(F f)
+{
+	return FunctionIterator<F>{f};
+}
+
+template <class F> double milliseconds(F f)
+{
+	const auto lStart = std::chrono::steady_clock::now();
+	f();
+	const auto lStop = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(lStop - lStart).count();
+}
+
+gt::box3f worldBounds()
+{
+	return gt::box3f(
+		gt::vec3f(-kWorldExtent, -kWorldExtent, -kWorldExtent),
+		gt::vec3f(kWorldExtent, kWorldExtent, kWorldExtent));
+}
+
+// Keeps a coordinate of an object of the given size inside the world.
+float clampToWorld(const float value, const float halfSize)
+{
+	const auto lLimit = kWorldExtent - halfSize - 1.0f;
+	return std::max(-lLimit, std::min(value, lLimit));
+}
+
+gt::vec3f randomVector(std::mt19937& generator, const float extent)
+{
+	std::uniform_real_distribution<float> lDist(-extent, extent);
+	const auto x = lDist(generator);
+	const auto y = lDist(generator);
+	const auto z = lDist(generator);
+	return gt::vec3f(x, y, z);
+}
+
+Object makeObject(std::mt19937& generator, const gt::vec3f& position,
+	const float halfSize, const float speed)
+{
+	Object lObject;
+	lObject.halfSize = halfSize;
+	lObject.position = gt::vec3f(
+		clampToWorld(position.x, halfSize),
+		clampToWorld(position.y, halfSize),
+		clampToWorld(position.z, halfSize));
+	lObject.velocity = randomVector(generator, speed);
+	lObject.dynamic = speed > 0.0f;
+	return lObject;
+}
+
+Scene makeScene(const std::string& workload, const Options& options)
+{
+	Scene lScene;
+	std::mt19937 lGenerator(options.seed);
+	std::uniform_real_distribution<float> lSmall(0.5f, 2.0f);
+	const auto lCount = options.objects;
+	lScene.objects.reserve(lCount);
+
+	if (workload == "uniform")
+	{
+		// Similarly sized objects, spread evenly over the world.
+		for (std::size_t i = 0; i < lCount; ++i)
+		{
+			const auto lPosition = randomVector(lGenerator, kWorldExtent);
+			lScene.objects.push_back(makeObject(lGenerator, lPosition,
+				lSmall(lGenerator), 5.0f));
+		}
+	}
+	else if (workload == "clustered")
+	{
+		// Similarly sized objects in a few dense clusters.
+		std::vector<gt::vec3f, gt::allocator<gt::vec3f>> lCenters;
+		for (int i = 0; i < 16; ++i)
+		{
+			lCenters.push_back(randomVector(lGenerator, 0.8f * kWorldExtent));
+		}
+		std::uniform_int_distribution<std::size_t> lCluster(0, lCenters.size() - 1);
+		std::normal_distribution<float> lSpread(0.0f, 20.0f);
+		for (std::size_t i = 0; i < lCount; ++i)
+		{
+			const auto& lCenter = lCenters[lCluster(lGenerator)];
+			const auto x = lSpread(lGenerator);
+			const auto y = lSpread(lGenerator);
+			const auto z = lSpread(lGenerator);
+			lScene.objects.push_back(makeObject(lGenerator,
+				lCenter + gt::vec3f(x, y, z), lSmall(lGenerator), 5.0f));
+		}
+	}
+	else if (workload == "mixed_sizes")
+	{
+		// The sizes are spread evenly over orders of magnitude, from pebbles
+		// to buildings.
+		std::uniform_real_distribution<float> lLogSize(std::log(0.1f), std::log(50.0f));
+		for (std::size_t i = 0; i < lCount; ++i)
+		{
+			const auto lPosition = randomVector(lGenerator, kWorldExtent);
+			lScene.objects.push_back(makeObject(lGenerator, lPosition,
+				std::exp(lLogSize(lGenerator)), 5.0f));
+		}
+	}
+	else if (workload == "static_and_dynamic")
+	{
+		// A few large objects that never move, and many small, fast ones.
+		std::uniform_real_distribution<float> lLarge(10.0f, 60.0f);
+		std::uniform_real_distribution<float> lTiny(0.2f, 1.0f);
+		const auto lStaticCount = lCount / 20;
+		for (std::size_t i = 0; i < lCount; ++i)
+		{
+			const auto lPosition = randomVector(lGenerator, kWorldExtent);
+			if (i < lStaticCount)
+			{
+				lScene.objects.push_back(makeObject(lGenerator, lPosition,
+					lLarge(lGenerator), 0.0f));
+			}
+			else
+			{
+				lScene.objects.push_back(makeObject(lGenerator, lPosition,
+					lTiny(lGenerator), 20.0f));
+			}
+		}
+	}
+	else
+	{
+		throw std::invalid_argument("Unknown workload: " + workload);
+	}
+
+	std::uniform_real_distribution<float> lQuerySize(5.0f, 40.0f);
+	for (std::size_t i = 0; i < options.boxQueries; ++i)
+	{
+		const auto lCenter = randomVector(lGenerator, kWorldExtent);
+		const auto lHalf = lQuerySize(lGenerator);
+		const gt::vec3f lExtent(lHalf, lHalf, lHalf);
+		lScene.boxQueries.emplace_back(lCenter - lExtent, lCenter + lExtent);
+	}
+
+	gt::mat4f lProjection;
+	lProjection.set_perspective(gt::deg2rad(60.0f), 16.0f / 9.0f, 0.1f, 200.0f);
+	for (std::size_t i = 0; i < options.frustumQueries; ++i)
+	{
+		const auto lEye = randomVector(lGenerator, 0.5f * kWorldExtent);
+		const auto lSubject = randomVector(lGenerator, kWorldExtent);
+		const gt::mat4f lView(lEye, lSubject, gt::vec3f(0.0f, 1.0f, 0.0f));
+		lScene.frustumQueries.emplace_back(lProjection * lView);
+	}
+	return lScene;
+}
+
+// Moves the dynamic objects one frame ahead. They bounce off the walls of the
+// world, so that they stay inside the bounds of the octrees.
+void advance(ObjectList& objects)
+{
+	for (auto& lObject : objects)
+	{
+		if (!lObject.dynamic) continue;
+		float lPosition[3] = {lObject.position.x, lObject.position.y, lObject.position.z};
+		float lVelocity[3] = {lObject.velocity.x, lObject.velocity.y, lObject.velocity.z};
+		for (int i = 0; i < 3; ++i)
+		{
+			lPosition[i] += kTimeStep * lVelocity[i];
+			const auto lClamped = clampToWorld(lPosition[i], lObject.halfSize);
+			if (lClamped != lPosition[i])
+			{
+				lPosition[i] = lClamped;
+				lVelocity[i] = -lVelocity[i];
+			}
+		}
+		lObject.position = gt::vec3f(lPosition[0], lPosition[1], lPosition[2]);
+		lObject.velocity = gt::vec3f(lVelocity[0], lVelocity[1], lVelocity[2]);
+	}
+}
+
+// Moves all objects along for the requested number of frames. The Move
+// function moves the entity of one object, and the Commit function runs once
+// per frame after that. Returns the average time per frame spent in both.
+template <class Move, class Commit>
+double measureMotion(const Scene& scene, const Options& options, Move move,
+	Commit commit)
+{
+	if (options.frames == 0) return kNotApplicable;
+	auto lObjects = scene.objects;
+	double lTotal = 0.0;
+	for (std::size_t lFrame = 0; lFrame < options.frames; ++lFrame)
+	{
+		advance(lObjects);
+		lTotal += milliseconds([&]()
+		{
+			for (std::size_t i = 0; i < lObjects.size(); ++i)
+			{
+				if (lObjects[i].dynamic) move(i, lObjects[i].position);
+			}
+			commit();
+		});
+	}
+	return lTotal / options.frames;
+}
+
+// The Query function takes a volume and a unary function that it calls for
+// every result.
+template <class Query>
+void measureBoxQueries(const Scene& scene, Result& result, Query query)
+{
+	if (scene.boxQueries.empty()) return;
+	std::size_t lCount = 0;
+	const auto lTime = milliseconds([&]()
+	{
+		for (const auto& lVolume : scene.boxQueries)
+		{
+			query(lVolume, [&lCount](auto&&) { ++lCount; });
+		}
+	});
+	result.boxQueryMicroseconds = 1000.0 * lTime / scene.boxQueries.size();
+	result.boxQueryResults = lCount;
+}
+
+template <class Query>
+void measureFrustumQueries(const Scene& scene, Result& result, Query query)
+{
+	if (scene.frustumQueries.empty()) return;
+	std::size_t lCount = 0;
+	const auto lTime = milliseconds([&]()
+	{
+		for (const auto& lVolume : scene.frustumQueries)
+		{
+			query(lVolume, [&lCount](auto&&) { ++lCount; });
+		}
+	});
+	result.frustumQueryMicroseconds = 1000.0 * lTime / scene.frustumQueries.size();
+	result.frustumQueryResults = lCount;
+}
+
+std::vector<gt::Entity::SharedPtr> makePointEntities(const Scene& scene)
+{
+	std::vector<gt::Entity::SharedPtr> lEntities;
+	lEntities.reserve(scene.objects.size());
+	for (const auto& lObject : scene.objects)
+	{
+		lEntities.push_back(gt::Entity::create());
+		lEntities.back()->setTranslation(lObject.position);
+	}
+	return lEntities;
+}
+
+std::vector<Body> makeBodies(const Scene& scene)
+{
+	std::vector<Body> lBodies;
+	lBodies.reserve(scene.objects.size());
+	for (const auto& lObject : scene.objects)
+	{
+		Body lBody;
+		lBody.entity.reset(new gt::experimental::Entity());
+		auto lCollider = lBody.entity->add<gt::BoxCollider>();
+		const gt::vec3f lHalf(lObject.halfSize, lObject.halfSize, lObject.halfSize);
+		lCollider->localOffset = gt::vec3f(0.0f, 0.0f, 0.0f);
+		lCollider->localBounds = gt::box3f(-lHalf, lHalf);
+		lBody.transform = lBody.entity->get<gt::Transform>();
+		lBody.transform->local().translation = lObject.position;
+		lBody.entity->update();
+		lBodies.push_back(std::move(lBody));
+	}
+	return lBodies;
+}
+
+// Moves the entity of an object, and lets its components catch up.
+struct MoveBody
+{
+	std::vector<Body>& bodies;
+
+	void operator () (const std::size_t i, const gt::vec3f& position) const
+	{
+		bodies[i].transform->local().translation = position;
+		bodies[i].entity->update();
+	}
+};
+
+Result benchmarkOctree(const Scene& scene, const Options& options)
+{
+	Result lResult;
+	std::unique_ptr<gt::Octree> lOctree;
+	auto lEntities = makePointEntities(scene);
+	{
+		gt::Octree lIncremental(worldBounds());
+		lResult.insertMilliseconds = milliseconds([&]()
+		{
+			for (const auto& lEntity : lEntities) lIncremental.insert(lEntity);
+		});
+	}
+	lResult.bulkBuildMilliseconds = milliseconds([&]()
+	{
+		lOctree.reset(new gt::Octree(worldBounds(), lEntities.begin(), lEntities.end()));
+	});
+	lResult.updateMillisecondsPerFrame = measureMotion(scene, options,
+		[&](const std::size_t i, const gt::vec3f& position)
+		{
+			lEntities[i]->setTranslation(position);
+		},
+		[&]() { lOctree->commitUpdates(); });
+	measureBoxQueries(scene, lResult, [&](const gt::box3f& volume, auto f)
+	{
+		lOctree->visit(volume, f);
+	});
+	measureFrustumQueries(scene, lResult, [&](const gt::frustum& volume, auto f)
+	{
+		lOctree->visit(volume, f);
+	});
+	lResult.memoryBytes = lOctree->statistics().memoryUsage;
+	return lResult;
+}
+
+Result benchmarkLinearOctree(const Scene& scene, const Options& options)
+{
+	Result lResult;
+	std::unique_ptr<gt::LinearOctree> lOctree;
+	auto lEntities = makePointEntities(scene);
+
+	// The LinearOctree sorts its entities lazily, at the first query after a
+	// change. An empty query makes that part of the measurement.
+	const auto lIgnore = makeFunctionIterator([](const gt::Entity::SharedPtr&) {});
+	const gt::box3f lEmpty(gt::vec3f(0.0f, 0.0f, 0.0f), gt::vec3f(0.0f, 0.0f, 0.0f));
+	{
+		gt::LinearOctree lIncremental(worldBounds());
+		lResult.insertMilliseconds = milliseconds([&]()
+		{
+			for (const auto& lEntity : lEntities) lIncremental.insert(lEntity);
+			lIncremental.query(lEmpty, lIgnore);
+		});
+	}
+	lResult.bulkBuildMilliseconds = milliseconds([&]()
+	{
+		lOctree.reset(new gt::LinearOctree(worldBounds(), lEntities.begin(), lEntities.end()));
+		lOctree->query(lEmpty, lIgnore);
+	});
+	lResult.updateMillisecondsPerFrame = measureMotion(scene, options,
+		[&](const std::size_t i, const gt::vec3f& position)
+		{
+			lEntities[i]->setTranslation(position);
+		},
+		[&]() { lOctree->query(lEmpty, lIgnore); });
+	measureBoxQueries(scene, lResult, [&](const gt::box3f& volume, auto f)
+	{
+		lOctree->query(volume, makeFunctionIterator(f));
+	});
+	lResult.memoryBytes = lOctree->memoryUsage();
+	return lResult;
+}
+
+Result benchmarkOctreeComp(const Scene& scene, const Options& options)
+{
+	Result lResult;
+	gt::OctreeComp::Node lRoot(worldBounds());
+	auto lBodies = makeBodies(scene);
+	std::vector<gt::OctreeComp*> lComps;
+	for (auto& lBody : lBodies) lComps.push_back(lBody.entity->add<gt::OctreeComp>());
+	lResult.insertMilliseconds = milliseconds([&]()
+	{
+		for (auto* lComp : lComps) lComp->setNode(lRoot);
+	});
+	lResult.updateMillisecondsPerFrame = measureMotion(scene, options,
+		MoveBody{lBodies}, []() {});
+	measureBoxQueries(scene, lResult, [&](const gt::box3f& volume, auto f)
+	{
+		lRoot.query(volume, f);
+	});
+	measureFrustumQueries(scene, lResult, [&](const gt::frustum& volume, auto f)
+	{
+		lRoot.query(volume, f);
+	});
+	lResult.memoryBytes = lRoot.statistics().memoryUsage;
+	return lResult;
+}
+
+Result benchmarkAABBTreeComp(const Scene& scene, const Options& options)
+{
+	Result lResult;
+	gt::AABBTreeComp::Tree lTree;
+	auto lBodies = makeBodies(scene);
+	std::vector<gt::AABBTreeComp*> lComps;
+	for (auto& lBody : lBodies) lComps.push_back(lBody.entity->add<gt::AABBTreeComp>());
+	lResult.insertMilliseconds = milliseconds([&]()
+	{
+		for (auto* lComp : lComps) lComp->setTree(lTree);
+	});
+	lResult.updateMillisecondsPerFrame = measureMotion(scene, options,
+		MoveBody{lBodies}, []() {});
+	measureBoxQueries(scene, lResult, [&](const gt::box3f& volume, auto f)
+	{
+		lTree.query(volume, f);
+	});
+	measureFrustumQueries(scene, lResult, [&](const gt::frustum& volume, auto f)
+	{
+		lTree.query(volume, f);
+	});
+	lResult.memoryBytes = lTree.statistics().memoryUsage;
+	return lResult;
+}
+
+Result benchmarkSpatialHashGridComp(const Scene& scene, const Options& options)
+{
+	Result lResult;
+	gt::SpatialHashGridComp::Grid lGrid(kCellSize);
+	auto lBodies = makeBodies(scene);
+	std::vector<gt::SpatialHashGridComp*> lComps;
+	for (auto& lBody : lBodies) lComps.push_back(lBody.entity->add<gt::SpatialHashGridComp>());
+
+	// Inserting only registers the components. They end up in their cells
+	// at the next rebuild, which counts as the bulk build.
+	lResult.insertMilliseconds = milliseconds([&]()
+	{
+		for (auto* lComp : lComps) lComp->setGrid(lGrid);
+	});
+	lResult.bulkBuildMilliseconds = milliseconds([&]() { lGrid.rebuild(); });
+	lResult.updateMillisecondsPerFrame = measureMotion(scene, options,
+		MoveBody{lBodies}, [&]() { lGrid.rebuild(); });
+	measureBoxQueries(scene, lResult, [&](const gt::box3f& volume, auto f)
+	{
+		lGrid.query(volume, f);
+	});
+	lResult.memoryBytes = lGrid.memoryUsage();
+	return lResult;
+}
+
+Result benchmark(const std::string& index, const Scene& scene,
+	const Options& options)
+{
+	if (index == "Octree") return benchmarkOctree(scene, options);
+	if (index == "LinearOctree") return benchmarkLinearOctree(scene, options);
+	if (index == "OctreeComp") return benchmarkOctreeComp(scene, options);
+	if (index == "AABBTreeComp") return benchmarkAABBTreeComp(scene, options);
+	if (index == "SpatialHashGridComp") return benchmarkSpatialHashGridComp(scene, options);
+	throw std::invalid_argument("Unknown index: " + index);
+}
+
+void writeNumber(std::ostream& os, const double value)
+{
+	if (std::isnan(value)) os << "null";
+	else os << value;
+}
+
+void writeJson(std::ostream& os, const Options& options,
+	const std::vector<Result>& results)
+{
+	os << "{\n";
+	os << "\t\"seed\": " << options.seed << ",\n";
+	os << "\t\"objects\": " << options.objects << ",\n";
+	os << "\t\"frames\": " << options.frames << ",\n";
+	os << "\t\"boxQueries\": " << options.boxQueries << ",\n";
+	os << "\t\"frustumQueries\": " << options.frustumQueries << ",\n";
+	os << "\t\"results\": [";
+	for (std::size_t i = 0; i < results.size(); ++i)
+	{
+		const auto& lResult = results[i];
+		os << (i ? ",\n" : "\n") << "\t\t{\n";
+		os << "\t\t\t\"index\": \"" << lResult.index << "\",\n";
+		os << "\t\t\t\"workload\": \"" << lResult.workload << "\",\n";
+		os << "\t\t\t\"insertMilliseconds\": ";
+		writeNumber(os, lResult.insertMilliseconds);
+		os << ",\n\t\t\t\"bulkBuildMilliseconds\": ";
+		writeNumber(os, lResult.bulkBuildMilliseconds);
+		os << ",\n\t\t\t\"updateMillisecondsPerFrame\": ";
+		writeNumber(os, lResult.updateMillisecondsPerFrame);
+		os << ",\n\t\t\t\"boxQueryMicroseconds\": ";
+		writeNumber(os, lResult.boxQueryMicroseconds);
+		os << ",\n\t\t\t\"frustumQueryMicroseconds\": ";
+		writeNumber(os, lResult.frustumQueryMicroseconds);
+		os << ",\n\t\t\t\"boxQueryResults\": " << lResult.boxQueryResults;
+		os << ",\n\t\t\t\"frustumQueryResults\": " << lResult.frustumQueryResults;
+		os << ",\n\t\t\t\"memoryBytes\": " << lResult.memoryBytes;
+		os << "\n\t\t}";
+	}
+	os << "\n\t]\n}\n";
+}
+
+void printUsage(const char* program)
+{
+	std::cerr << "Usage: " << program << " [options]\n"
+		<< "  --objects N          Number of objects per scene (default 20000)\n"
+		<< "  --frames N           Number of frames of motion (default 10)\n"
+		<< "  --box-queries N      Number of box queries (default 1000)\n"
+		<< "  --frustum-queries N  Number of frustum queries (default 100)\n"
+		<< "  --seed N             Seed of the scene generator (default 1)\n"
+		<< "  --workload NAME      Only run one workload\n"
+		<< "  --index NAME         Only run one spatial index\n"
+		<< "  --output FILE        Write the JSON to FILE instead of stdout\n"
+		<< "Workloads:";
+	for (const auto* lName : kWorkloads) std::cerr << ' ' << lName;
+	std::cerr << "\nIndices:";
+	for (const auto* lName : kIndices) std::cerr << ' ' << lName;
+	std::cerr << '\n';
+}
+
+bool parseOptions(int argc, char** argv, Options& options)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string lOption(argv[i]);
+		if (i + 1 == argc) return false;
+		const std::string lValue(argv[++i]);
+		if (lOption == "--objects") options.objects = std::stoul(lValue);
+		else if (lOption == "--frames") options.frames = std::stoul(lValue);
+		else if (lOption == "--box-queries") options.boxQueries = std::stoul(lValue);
+		else if (lOption == "--frustum-queries") options.frustumQueries = std::stoul(lValue);
+		else if (lOption == "--seed") options.seed = static_cast<unsigned>(std::stoul(lValue));
+		else if (lOption == "--workload") options.workload = lValue;
+		else if (lOption == "--index") options.index = lValue;
+		else if (lOption == "--output") options.output = lValue;
+		else return false;
+	}
+	return true;
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+	Options lOptions;
+	std::vector<Result> lResults;
+	try
+	{
+		if (!parseOptions(argc, argv, lOptions))
+		{
+			printUsage(argv[0]);
+			return EXIT_FAILURE;
+		}
+		for (const auto* lWorkload : kWorkloads)
+		{
+			if (!lOptions.workload.empty() && lOptions.workload != lWorkload) continue;
+			const auto lScene = makeScene(lWorkload, lOptions);
+			for (const auto* lIndex : kIndices)
+			{
+				if (!lOptions.index.empty() && lOptions.index != lIndex) continue;
+				std::cerr << lWorkload << ": " << lIndex << '\n';
+				lResults.push_back(benchmark(lIndex, lScene, lOptions));
+				lResults.back().index = lIndex;
+				lResults.back().workload = lWorkload;
+			}
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "Error: " << e.what() << '\n';
+		return EXIT_FAILURE;
+	}
+	if (lResults.empty())
+	{
+		std::cerr << "Error: No such workload or index.\n";
+		printUsage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if (lOptions.output.empty())
+	{
+		writeJson(std::cout, lOptions, lResults);
+	}
+	else
+	{
+		std::ofstream lOutput(lOptions.output);
+		writeJson(lOutput, lOptions, lResults);
+		if (!lOutput)
+		{
+			std::cerr << "Error: Could not write to " << lOptions.output << '\n';
+			return EXIT_FAILURE;
+		}
+	}
+	return EXIT_SUCCESS;
+}